@@ -0,0 +1,138 @@
+#!/usr/bin/env node
+
+/**
+ * Run the benchmark suite in a browser.
+ *
+ *   node bench/browser.mjs [--browser "chromium --headless=new"] [--port 8787]
+ *                          [--quick] [--variant baseline,simd] [--filter REGEX]
+ *                          [--out results.json] [--baseline bench/baseline.json]
+ *                          [--threshold 0.1]
+ *
+ * Serves the repository over HTTP and opens bench/index.html, which posts
+ * its results back here. With --browser the command is started with the
+ * page URL appended and stopped once results arrive; without it, open the
+ * printed URL yourself. Results and baseline comparison work as in node.mjs.
+ */
+
+import fs from 'fs';
+import http from 'http';
+import path from 'path';
+import { spawn } from 'child_process';
+import { fileURLToPath } from 'url';
+import { compareRuns, formatComparison, DEFAULT_THRESHOLD } from './compare.mjs';
+import { SCHEMA_VERSION } from './suite.mjs';
+
+const ROOT = path.resolve(path.dirname(fileURLToPath(import.meta.url)), '..');
+
+const MIME_TYPES = {
+  '.html': 'text/html',
+  '.js': 'text/javascript',
+  '.mjs': 'text/javascript',
+  '.json': 'application/json',
+  '.wasm': 'application/wasm',
+  '.map': 'application/json'
+};
+
+function parseArgs(argv) {
+  const args = { port: 8787, query: new URLSearchParams({ report: '1' }), threshold: DEFAULT_THRESHOLD };
+  for (let i = 0; i < argv.length; i++) {
+    const arg = argv[i];
+    const value = () => {
+      if (i + 1 >= argv.length) {
+        throw new Error(`${arg} needs a value`);
+      }
+      return argv[++i];
+    };
+    switch (arg) {
+      case '--browser': args.browser = value(); break;
+      case '--port': args.port = Number(value()); break;
+      case '--quick': args.query.set('quick', '1'); break;
+      case '--variant': args.query.set('variant', value()); break;
+      case '--filter': args.query.set('filter', value()); break;
+      case '--out': args.out = path.resolve(value()); break;
+      case '--baseline': args.baseline = path.resolve(value()); break;
+      case '--threshold': args.threshold = Number(value()); break;
+      default: throw new Error(`Unknown argument: ${arg}`);
+    }
+  }
+  return args;
+}
+
+const args = parseArgs(process.argv.slice(2));
+let browser = null;
+
+function finish(report) {
+  if (report.error) {
+    console.error(report.error);
+    return 1;
+  }
+
+  const json = JSON.stringify(report, null, 2);
+  if (args.out) {
+    fs.writeFileSync(args.out, json + '\n');
+    console.error(`Results written to ${args.out}`);
+  } else if (!args.baseline) {
+    console.log(json);
+  }
+
+  if (args.baseline) {
+    const baseline = JSON.parse(fs.readFileSync(args.baseline, 'utf8'));
+    if (baseline.schema !== SCHEMA_VERSION) {
+      console.error(`Baseline schema ${baseline.schema} does not match ${SCHEMA_VERSION}; regenerate it`);
+      return 1;
+    }
+    const rows = compareRuns(report.runs, baseline.runs, args.threshold);
+    console.log(formatComparison(rows));
+    const regressions = rows.filter(r => r.regression);
+    if (regressions.length > 0) {
+      console.error(`${regressions.length} regression(s) beyond ${(args.threshold * 100).toFixed(0)}%`);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+const server = http.createServer((request, response) => {
+  const url = new URL(request.url, `http://${request.headers.host}`);
+
+  if (request.method === 'POST' && url.pathname === '/results') {
+    let body = '';
+    request.setEncoding('utf8');
+    request.on('data', chunk => {
+      body += chunk;
+    });
+    request.on('end', () => {
+      response.end();
+      const status = finish(JSON.parse(body));
+      browser?.kill();
+      server.close();
+      process.exitCode = status;
+    });
+    return;
+  }
+
+  // Static files, confined to the repository
+  const file = path.join(ROOT, decodeURIComponent(url.pathname));
+  if (!file.startsWith(ROOT + path.sep) || !fs.existsSync(file) || !fs.statSync(file).isFile()) {
+    response.writeHead(404);
+    response.end();
+    return;
+  }
+  response.writeHead(200, { 'Content-Type': MIME_TYPES[path.extname(file)] ?? 'application/octet-stream' });
+  fs.createReadStream(file).pipe(response);
+});
+
+server.listen(args.port, '127.0.0.1', () => {
+  const pageUrl = `http://127.0.0.1:${args.port}/bench/index.html?${args.query}`;
+  if (args.browser) {
+    const [command, ...commandArgs] = args.browser.split(/\s+/);
+    browser = spawn(command, [...commandArgs, pageUrl], { stdio: 'ignore' });
+    browser.on('error', e => {
+      console.error(`Failed to start ${command}: ${e.message}`);
+      server.close();
+      process.exitCode = 1;
+    });
+  } else {
+    console.error(`Open ${pageUrl}`);
+  }
+});
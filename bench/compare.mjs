@@ -0,0 +1,73 @@
+/**
+ * Compare benchmark results against a stored baseline
+ */
+
+/** Default relative slowdown reported as a regression */
+export const DEFAULT_THRESHOLD = 0.1;
+
+function throughputKey(run, entry) {
+  return `${run.variant}/${entry.name}/${entry.size}`;
+}
+
+function overheadKey(run, entry) {
+  return `${run.variant}/${entry.name}`;
+}
+
+/**
+ * Compare runs (arrays of runSuite() results) entry by entry.
+ *
+ * Throughput is compared in MiB/s, overhead in ns per message. Each row
+ * holds the baseline and current value and the change, where a positive
+ * change is always an improvement. Rows whose change is below -threshold
+ * are marked as regressions. Entries missing from either side are skipped.
+ */
+export function compareRuns(current, baseline, threshold = DEFAULT_THRESHOLD) {
+  const previous = new Map();
+  for (const run of baseline) {
+    for (const entry of run.throughput) {
+      previous.set(throughputKey(run, entry), entry.throughputMBps);
+    }
+    for (const entry of run.overhead) {
+      previous.set(overheadKey(run, entry), entry.perMessageNs);
+    }
+  }
+
+  const rows = [];
+  for (const run of current) {
+    if (baseline.some(other => other.variant === run.variant && other.quick !== run.quick)) {
+      throw new Error(`Cannot compare a ${run.quick ? 'quick' : 'full'} ${run.variant} run against a ${run.quick ? 'full' : 'quick'} baseline`);
+    }
+    for (const entry of run.throughput) {
+      const key = throughputKey(run, entry);
+      const before = previous.get(key);
+      if (before !== undefined) {
+        rows.push(row(key, 'MiB/s', before, entry.throughputMBps, entry.throughputMBps / before - 1, threshold));
+      }
+    }
+    for (const entry of run.overhead) {
+      const key = overheadKey(run, entry);
+      const before = previous.get(key);
+      if (before !== undefined) {
+        rows.push(row(key, 'ns/msg', before, entry.perMessageNs, before / entry.perMessageNs - 1, threshold));
+      }
+    }
+  }
+  return rows;
+}
+
+function row(name, unit, baseline, current, change, threshold) {
+  return { name, unit, baseline, current, change, regression: change < -threshold };
+}
+
+/**
+ * Format comparison rows as a fixed-width text table
+ */
+export function formatComparison(rows) {
+  const width = Math.max(4, ...rows.map(r => r.name.length));
+  const lines = [`${'name'.padEnd(width)}  ${'baseline'.padStart(12)}  ${'current'.padStart(12)}  change`];
+  for (const r of rows) {
+    const change = `${r.change >= 0 ? '+' : ''}${(r.change * 100).toFixed(1)}%`;
+    lines.push(`${r.name.padEnd(width)}  ${r.baseline.toFixed(2).padStart(12)}  ${r.current.toFixed(2).padStart(12)}  ${change.padStart(7)} ${r.unit}${r.regression ? '  REGRESSION' : ''}`);
+  }
+  return lines.join('\n');
+}
@@ -0,0 +1,92 @@
+#!/usr/bin/env node
+
+/**
+ * Run the benchmark suite in Node against the built library.
+ *
+ *   node bench/node.mjs [--quick] [--variant baseline,simd] [--filter REGEX]
+ *                       [--lib dist/openssl.node.js] [--out results.json]
+ *                       [--baseline bench/baseline.json] [--threshold 0.1]
+ *
+ * Exits with status 1 if --baseline is given and any entry regressed by
+ * more than the threshold.
+ */
+
+import fs from 'fs';
+import os from 'os';
+import path from 'path';
+import { fileURLToPath, pathToFileURL } from 'url';
+import { runSuite, SCHEMA_VERSION } from './suite.mjs';
+import { compareRuns, formatComparison, DEFAULT_THRESHOLD } from './compare.mjs';
+
+const ROOT = path.resolve(path.dirname(fileURLToPath(import.meta.url)), '..');
+
+function parseArgs(argv) {
+  const args = { quick: false, lib: path.join(ROOT, 'dist/openssl.node.js'), threshold: DEFAULT_THRESHOLD };
+  for (let i = 0; i < argv.length; i++) {
+    const arg = argv[i];
+    const value = () => {
+      if (i + 1 >= argv.length) {
+        throw new Error(`${arg} needs a value`);
+      }
+      return argv[++i];
+    };
+    switch (arg) {
+      case '--quick': args.quick = true; break;
+      case '--variant': args.variants = value().split(','); break;
+      case '--filter': args.filter = new RegExp(value()); break;
+      case '--lib': args.lib = path.resolve(value()); break;
+      case '--out': args.out = path.resolve(value()); break;
+      case '--baseline': args.baseline = path.resolve(value()); break;
+      case '--threshold': args.threshold = Number(value()); break;
+      default: throw new Error(`Unknown argument: ${arg}`);
+    }
+  }
+  return args;
+}
+
+const args = parseArgs(process.argv.slice(2));
+if (!fs.existsSync(args.lib)) {
+  console.error(`${args.lib} not found; run npm run build first`);
+  process.exit(1);
+}
+
+const library = await import(pathToFileURL(args.lib).href);
+// Importing the CommonJS build puts its exports object behind default
+const OpenSSLWasmJS = library.default.initialize ? library.default : library.default.default;
+const variants = args.variants ?? (library.supportsWasmSimd() ? ['baseline', 'simd'] : ['baseline']);
+
+const environment = {
+  runtime: `node ${process.version}`,
+  platform: `${os.platform()} ${os.arch()}`,
+  cpu: os.cpus()[0]?.model ?? 'unknown',
+  library: path.relative(ROOT, args.lib)
+};
+
+const runs = [];
+for (const variant of variants) {
+  runs.push(await runSuite(OpenSSLWasmJS, { variant, quick: args.quick, filter: args.filter, environment }, line => console.error(line)));
+}
+
+const report = { schema: SCHEMA_VERSION, runs };
+const json = JSON.stringify(report, null, 2);
+if (args.out) {
+  fs.writeFileSync(args.out, json + '\n');
+  console.error(`Results written to ${args.out}`);
+} else if (!args.baseline) {
+  console.log(json);
+}
+
+if (args.baseline) {
+  const baseline = JSON.parse(fs.readFileSync(args.baseline, 'utf8'));
+  if (baseline.schema !== SCHEMA_VERSION) {
+    console.error(`Baseline schema ${baseline.schema} does not match ${SCHEMA_VERSION}; regenerate it`);
+    process.exit(1);
+  }
+  const rows = compareRuns(runs, baseline.runs, args.threshold);
+  console.log(formatComparison(rows));
+  const regressions = rows.filter(r => r.regression);
+  if (regressions.length > 0) {
+    console.error(`${regressions.length} regression(s) beyond ${(args.threshold * 100).toFixed(0)}%`);
+    process.exit(1);
+  }
+}
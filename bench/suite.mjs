@@ -0,0 +1,387 @@
+/**
+ * Benchmark suite shared by the Node and browser runners.
+ *
+ * Runs against the built library (dist/openssl.esm.js) and the real WASM
+ * modules it loads, never against mocks. Results are plain JSON so they can
+ * be stored and compared with compare.mjs.
+ */
+
+/** Result format version, bumped when fields change meaning */
+export const SCHEMA_VERSION = 1;
+
+/** Message sizes for the throughput sweep, 16 B to 64 MiB */
+export const SIZES = [16, 64, 256, 1024, 16 * 1024, 256 * 1024, 1024 * 1024, 16 * 1024 * 1024, 64 * 1024 * 1024];
+
+/** Largest size in quick runs */
+const QUICK_MAX_SIZE = 1024 * 1024;
+
+/** Sizes at or below this are measured per call for latency percentiles */
+const LATENCY_MAX_SIZE = 16 * 1024;
+
+/** Messages per batch in the batch and arena comparisons */
+const BATCH_COUNT = 1024;
+
+const now = () => performance.now();
+
+/**
+ * Algorithms in the throughput sweep. Each setup() returns the operation to
+ * time, bound to fixed keys so only the data varies.
+ */
+const ALGORITHMS = [
+  { name: 'sha256', setup: openssl => data => openssl.sha256(data) },
+  { name: 'sha512', setup: openssl => data => openssl.sha512(data) },
+  { name: 'sha1', setup: openssl => data => openssl.sha1(data) },
+  { name: 'md5', setup: openssl => data => openssl.md5(data) },
+  {
+    name: 'hmac-sha256',
+    setup: openssl => {
+      const key = openssl.createHmacKey('sha256', fill(new Uint8Array(32), 1));
+      return data => key.hmac(data);
+    }
+  },
+  {
+    name: 'aes-256-cbc',
+    setup: openssl => {
+      const key = fill(new Uint8Array(32), 2);
+      const iv = fill(new Uint8Array(16), 3);
+      return data => openssl.aesEncrypt(data, key, iv);
+    }
+  },
+  {
+    name: 'aes-256-gcm',
+    setup: openssl => {
+      const key = fill(new Uint8Array(32), 4);
+      const iv = fill(new Uint8Array(12), 5);
+      return data => openssl.seal('aes-256-gcm', key, iv, data);
+    }
+  },
+  {
+    name: 'chacha20-poly1305',
+    setup: openssl => {
+      const key = fill(new Uint8Array(32), 6);
+      const iv = fill(new Uint8Array(12), 7);
+      return data => openssl.seal('chacha20-poly1305', key, iv, data);
+    }
+  },
+  { name: 'base64-encode', setup: openssl => data => openssl.base64Encode(data) }
+];
+
+/**
+ * Fill an array with a cheap deterministic pattern (xorshift32). Inputs are
+ * not generated with the library itself so that setup does not grow the heap
+ * being measured.
+ */
+export function fill(array, seed = 1) {
+  let x = seed * 2654435761 >>> 0 || 1;
+  for (let i = 0; i < array.length; i++) {
+    x ^= x << 13;
+    x ^= x >>> 17;
+    x ^= x << 5;
+    array[i] = x;
+  }
+  return array;
+}
+
+function percentile(sorted, p) {
+  if (sorted.length === 0) {
+    return 0;
+  }
+  return sorted[Math.min(sorted.length - 1, Math.floor(p * sorted.length))];
+}
+
+/**
+ * Time op until minTime has passed, after a warm-up call. Returns the number
+ * of calls, the total time and, if sampling, each call's time.
+ */
+function measure(op, minTime, sample) {
+  op();
+
+  const samples = [];
+  let iterations = 0;
+  const start = now();
+  let elapsed = 0;
+  while (elapsed < minTime || iterations < 3) {
+    if (sample) {
+      const t0 = now();
+      op();
+      samples.push(now() - t0);
+    } else {
+      op();
+    }
+    iterations++;
+    elapsed = now() - start;
+  }
+  return { iterations, totalMs: elapsed, samples };
+}
+
+function latencyOf(samples) {
+  if (samples.length === 0) {
+    return null;
+  }
+  const sorted = samples.slice().sort((a, b) => a - b);
+  return {
+    medianUs: percentile(sorted, 0.5) * 1000,
+    p99Us: percentile(sorted, 0.99) * 1000
+  };
+}
+
+/**
+ * Throughput and latency of each algorithm across the size sweep
+ */
+function runThroughput(openssl, options, log) {
+  const results = [];
+  const sizes = SIZES.filter(size => size <= options.maxSize);
+  const input = fill(new Uint8Array(sizes[sizes.length - 1]), 42);
+
+  for (const algorithm of ALGORITHMS) {
+    if (options.filter && !options.filter.test(algorithm.name)) {
+      continue;
+    }
+    const op = algorithm.setup(openssl);
+    for (const size of sizes) {
+      const data = input.subarray(0, size);
+      const heapBefore = openssl.heapSize;
+      const { iterations, totalMs, samples } = measure(() => op(data), options.minTime, size <= LATENCY_MAX_SIZE);
+      const result = {
+        name: algorithm.name,
+        size,
+        iterations,
+        totalMs,
+        throughputMBps: (size * iterations) / (totalMs / 1000) / (1024 * 1024),
+        latency: latencyOf(samples),
+        heapGrowth: openssl.heapSize - heapBefore
+      };
+      results.push(result);
+      log(`${algorithm.name} ${size} B: ${result.throughputMBps.toFixed(2)} MiB/s`);
+    }
+  }
+  return results;
+}
+
+/**
+ * Per-message cost of crossing the JS/WASM boundary: single calls against
+ * the batch APIs, and the scratch arena against a malloc per call
+ */
+function runOverhead(openssl, unpooled, options, log) {
+  const messages = Array.from({ length: BATCH_COUNT }, (_, i) => fill(new Uint8Array(16), i + 1));
+  const hmacKey = openssl.createHmacKey('sha256', fill(new Uint8Array(32), 9));
+  const empty = new Uint8Array(0);
+
+  const cases = [
+    // One call with nothing to copy: the fixed price of a wrapper call
+    { name: 'call-sha256-empty', count: 1, op: () => openssl.sha256(empty) },
+    { name: 'call-random-16', count: 1, op: () => openssl.randomBytes(16) },
+    { name: 'sha256-16B-loop', count: BATCH_COUNT, op: () => { for (const m of messages) openssl.sha256(m); } },
+    { name: 'sha256-16B-hashMany', count: BATCH_COUNT, op: () => openssl.hashMany('sha256', messages) },
+    { name: 'hmac-16B-loop', count: BATCH_COUNT, op: () => { for (const m of messages) hmacKey.hmac(m); } },
+    { name: 'hmac-16B-hmacMany', count: BATCH_COUNT, op: () => hmacKey.hmacMany(messages) },
+    // Same loop on an instance whose arena is too small to hold any input,
+    // so every call falls back to _malloc/_free
+    { name: 'sha256-16B-loop-no-arena', count: BATCH_COUNT, op: () => { for (const m of messages) unpooled.sha256(m); } }
+  ];
+
+  const results = [];
+  for (const entry of cases) {
+    if (options.filter && !options.filter.test(entry.name)) {
+      continue;
+    }
+    const { iterations, totalMs, samples } = measure(entry.op, options.minTime, entry.count === 1);
+    const result = {
+      name: entry.name,
+      messages: entry.count,
+      iterations,
+      totalMs,
+      perMessageNs: (totalMs * 1e6) / (iterations * entry.count),
+      latency: latencyOf(samples)
+    };
+    results.push(result);
+    log(`${entry.name}: ${result.perMessageNs.toFixed(0)} ns/message`);
+  }
+  hmacKey.dispose();
+  return results;
+}
+
+/** Output lengths for the HKDF comparison, up to the SHA-256 limit */
+const HKDF_LENGTHS = [32, 1024, 8160];
+
+/** Iteration counts for the PBKDF2 comparison */
+const PBKDF2_ITERATIONS = [1000, 10000, 100000];
+
+/**
+ * Operations compared against crypto.subtle, named as in the crossover
+ * points WebCryptoDispatcher reads. Each setup() returns the WASM call and
+ * the equivalent WebCrypto call for one size.
+ */
+const OFFLOADS = [
+  ...['sha1', 'sha256', 'sha384', 'sha512'].map(name => ({
+    name,
+    sizes: 'sweep',
+    setup: (openssl, subtle, input) => {
+      const hash = `SHA-${name.slice(3)}`;
+      return { wasm: () => openssl[name](input), webCrypto: () => subtle.digest(hash, input) };
+    }
+  })),
+  ...[16, 32].map(keyLength => ({
+    name: `aes-${keyLength * 8}-gcm`,
+    sizes: 'sweep',
+    setup: async (openssl, subtle, input) => {
+      const key = fill(new Uint8Array(keyLength), 10 + keyLength);
+      const iv = fill(new Uint8Array(12), 11);
+      const cryptoKey = await subtle.importKey('raw', key, 'AES-GCM', false, ['encrypt']);
+      return {
+        wasm: () => openssl.seal(`aes-${keyLength * 8}-gcm`, key, iv, input),
+        webCrypto: () => subtle.encrypt({ name: 'AES-GCM', iv, tagLength: 128 }, cryptoKey, input)
+      };
+    }
+  })),
+  {
+    name: 'hkdf',
+    sizes: () => HKDF_LENGTHS,
+    setup: async (openssl, subtle, length) => {
+      const key = fill(new Uint8Array(32), 12);
+      const salt = fill(new Uint8Array(32), 13);
+      const info = fill(new Uint8Array(16), 14);
+      const baseKey = await subtle.importKey('raw', key, 'HKDF', false, ['deriveBits']);
+      return {
+        wasm: () => openssl.hkdf(key, { length, salt, info }),
+        webCrypto: () => subtle.deriveBits({ name: 'HKDF', hash: 'SHA-256', salt, info }, baseKey, length * 8)
+      };
+    }
+  },
+  {
+    name: 'pbkdf2',
+    sizes: quick => quick ? PBKDF2_ITERATIONS.slice(0, 2) : PBKDF2_ITERATIONS,
+    setup: async (openssl, subtle, iterations) => {
+      const password = fill(new Uint8Array(16), 15);
+      const salt = fill(new Uint8Array(16), 16);
+      const baseKey = await subtle.importKey('raw', password, 'PBKDF2', false, ['deriveBits']);
+      return {
+        wasm: () => openssl.pbkdf2(password, salt, { iterations, length: 32 }),
+        webCrypto: () => subtle.deriveBits({ name: 'PBKDF2', hash: 'SHA-256', salt, iterations }, baseKey, 256)
+      };
+    }
+  }
+];
+
+/**
+ * Async counterpart of measure(): awaits every call, so a synchronous WASM
+ * call and a WebCrypto promise are timed through the same loop
+ */
+async function measureAsync(op, minTime) {
+  await op();
+
+  let iterations = 0;
+  const start = now();
+  let elapsed = 0;
+  while (elapsed < minTime || iterations < 3) {
+    await op();
+    iterations++;
+    elapsed = now() - start;
+  }
+  return { iterations, totalMs: elapsed };
+}
+
+/**
+ * Smallest measured size from which WebCrypto is faster at that size and
+ * every larger one, or null if it never is. A single win below a WASM win
+ * is treated as noise.
+ */
+export function findCrossover(entries) {
+  let crossover = null;
+  for (let i = entries.length - 1; i >= 0; i--) {
+    if (entries[i].webCryptoUs >= entries[i].wasmUs) {
+      break;
+    }
+    crossover = entries[i].size;
+  }
+  return crossover;
+}
+
+/**
+ * Per-call time of the WASM path and of crypto.subtle for the operations
+ * WebCryptoDispatcher can route, and the crossover point of each
+ */
+async function runWebCrypto(openssl, subtle, options, log) {
+  const sweep = SIZES.filter(size => size <= options.maxSize);
+  const input = fill(new Uint8Array(sweep[sweep.length - 1]), 43);
+  const entries = [];
+  const crossovers = {};
+
+  for (const offload of OFFLOADS) {
+    if (options.filter && !options.filter.test(`webcrypto-${offload.name}`)) {
+      continue;
+    }
+    const sizes = offload.sizes === 'sweep' ? sweep : offload.sizes(options.quick);
+    const measured = [];
+    for (const size of sizes) {
+      const { wasm, webCrypto } = await offload.setup(openssl, subtle, offload.sizes === 'sweep' ? input.subarray(0, size) : size);
+      const wasmRun = await measureAsync(wasm, options.minTime);
+      const webCryptoRun = await measureAsync(webCrypto, options.minTime);
+      const entry = {
+        name: offload.name,
+        size,
+        wasmUs: (wasmRun.totalMs * 1000) / wasmRun.iterations,
+        webCryptoUs: (webCryptoRun.totalMs * 1000) / webCryptoRun.iterations
+      };
+      measured.push(entry);
+      log(`webcrypto-${offload.name} ${size}: wasm ${entry.wasmUs.toFixed(1)} us, webcrypto ${entry.webCryptoUs.toFixed(1)} us`);
+    }
+    entries.push(...measured);
+    crossovers[offload.name] = findCrossover(measured);
+  }
+  return { entries, crossovers };
+}
+
+/**
+ * Run the suite on one build variant.
+ *
+ * options.variant: 'baseline' or 'simd'
+ * options.quick: stop the size sweep at 1 MiB and shorten each measurement
+ * options.filter: RegExp of benchmark names to run
+ * options.environment: description of the runtime, copied into the result
+ */
+export async function runSuite(OpenSSLWasmJS, options = {}, log = () => undefined) {
+  const variant = options.variant ?? 'baseline';
+  const settings = {
+    filter: options.filter,
+    quick: Boolean(options.quick),
+    minTime: options.minTime ?? (options.quick ? 50 : 250),
+    maxSize: options.maxSize ?? (options.quick ? QUICK_MAX_SIZE : SIZES[SIZES.length - 1])
+  };
+
+  const openssl = await OpenSSLWasmJS.initialize({ simd: variant === 'simd' });
+  // Still copies whole inputs in, so every call mallocs and frees rather
+  // than streaming
+  const unpooled = await OpenSSLWasmJS.initialize({
+    simd: variant === 'simd',
+    scratchSize: 8,
+    scratchHighWaterMark: 8,
+    streamingThreshold: SIZES[SIZES.length - 1]
+  });
+  try {
+    const heapInitial = openssl.heapSize;
+    log(`Running ${variant} (${openssl.version()})`);
+    const throughput = runThroughput(openssl, settings, log);
+    const overhead = runOverhead(openssl, unpooled, settings, log);
+    const subtle = globalThis.crypto?.subtle;
+    if (!subtle) {
+      log('crypto.subtle is not available, skipping the WebCrypto comparison');
+    }
+    const webcrypto = subtle ? await runWebCrypto(openssl, subtle, settings, log) : null;
+    return {
+      schema: SCHEMA_VERSION,
+      timestamp: new Date().toISOString(),
+      environment: options.environment ?? {},
+      variant,
+      openssl: openssl.version(),
+      quick: Boolean(options.quick),
+      heap: { initial: heapInitial, final: openssl.heapSize },
+      throughput,
+      overhead,
+      webcrypto
+    };
+  } finally {
+    openssl.cleanup();
+    unpooled.cleanup();
+  }
+}
@@ -7,6 +7,9 @@ import dts from 'rollup-plugin-dts';
 import wasm from 'rollup-plugin-wasm';
 import pkg from './package.json';
 
+// Node built-ins used by the Node entry points
+const NODE_BUILTINS = ['stream', 'fs', 'os', 'worker_threads'];
+
 export default [
   // Browser-friendly UMD build
   {
@@ -15,7 +18,9 @@ export default [
       name: 'OpenSSLWasmJS',
       file: pkg.browser,
       format: 'umd',
-      sourcemap: true
+      sourcemap: true,
+      // UMD cannot split chunks, so every tier is bundled in
+      inlineDynamicImports: true
     },
     plugins: [
       wasm(),
@@ -31,12 +36,15 @@ export default [
     ]
   },
 
-  // CommonJS (for Node) and ES module (for bundlers) build
+  // CommonJS (for Node) and ES module (for bundlers) build. Each WASM tier
+  // becomes its own chunk, loaded only when selected. Chunks stay at the
+  // dist root, next to the .wasm files the Emscripten glue locates relative
+  // to itself.
   {
     input: 'src/index.ts',
     output: [
-      { file: pkg.main, format: 'cjs', sourcemap: true },
-      { file: pkg.module, format: 'es', sourcemap: true }
+      { dir: 'dist', entryFileNames: 'openssl.js', chunkFileNames: '[name].chunk.js', format: 'cjs', sourcemap: true },
+      { dir: 'dist', entryFileNames: 'openssl.esm.js', chunkFileNames: '[name].chunk.esm.js', format: 'es', sourcemap: true }
     ],
     plugins: [
       wasm(),
@@ -46,6 +54,62 @@ export default [
     ]
   },
 
+  // Worker entry for WorkerPool, loaded as a module worker
+  {
+    input: 'src/worker.ts',
+    output: {
+      file: 'dist/openssl.worker.js',
+      format: 'es',
+      sourcemap: true,
+      inlineDynamicImports: true
+    },
+    plugins: [
+      wasm(),
+      resolve(),
+      commonjs(),
+      typescript({ tsconfig: './tsconfig.json' }),
+      terser()
+    ]
+  },
+
+  // Node entry, resolved by the "node" export condition. A single CommonJS
+  // file, so it loads with both require() and import.
+  {
+    input: 'src/node.ts',
+    external: NODE_BUILTINS,
+    output: {
+      file: 'dist/openssl.node.js',
+      format: 'cjs',
+      exports: 'named',
+      sourcemap: true,
+      inlineDynamicImports: true
+    },
+    plugins: [
+      wasm(),
+      resolve({ preferBuiltins: true }),
+      commonjs(),
+      typescript({ tsconfig: './tsconfig.json' })
+    ]
+  },
+
+  // worker_threads entry for createNodePool()
+  {
+    input: 'src/node-worker.ts',
+    external: NODE_BUILTINS,
+    output: {
+      file: 'dist/openssl.node-worker.js',
+      format: 'cjs',
+      sourcemap: true,
+      inlineDynamicImports: true
+    },
+    plugins: [
+      wasm(),
+      resolve({ preferBuiltins: true }),
+      commonjs(),
+      typescript({ tsconfig: './tsconfig.json' })
+    ]
+  },
+
   // TypeScript declaration files
   {
     input: 'src/index.ts',
@@ -54,5 +118,14 @@ export default [
       format: 'es'
     },
     plugins: [dts()]
+  },
+  {
+    input: 'src/node.ts',
+    external: NODE_BUILTINS,
+    output: {
+      file: 'dist/types/node.d.ts',
+      format: 'es'
+    },
+    plugins: [dts()]
   }
 ];
@@ -10,6 +10,7 @@
 const fs = require('fs');
 const path = require('path');
 const { execSync } = require('child_process');
+const crypto = require('crypto');
 const os = require('os');
 
 // Configuration
@@ -19,7 +20,62 @@ const BUILD_DIR = path.resolve(__dirname, '../build');
 const DIST_DIR = path.resolve(__dirname, '../dist');
 const PATCHES_DIR = path.resolve(__dirname, '../src/patches');
 const OPENSSL_DIR = path.resolve(BUILD_DIR, `openssl-${OPENSSL_VERSION}`);
-const EMSCRIPTEN_OUTPUT = path.resolve(BUILD_DIR, 'openssl-wasm');
+
+// Build variants. The baseline is size-optimized scalar code that runs
+// everywhere; the SIMD variant trades bundle size for throughput and is only
+// loaded where WebAssembly SIMD128 is supported (see src/loader.ts).
+const VARIANTS = [
+  { name: 'baseline', output: 'openssl-wasm', cflags: '-Oz' },
+  { name: 'simd', output: 'openssl-wasm-simd', cflags: '-O3 -msimd128' }
+];
+
+// Size tiers. Each tier links only the parts of OpenSSL its glue functions
+// need (see OPENSSL_WASM_TIER in src/wasm/openssl_wasm_glue.c) and exports
+// its own functions plus those of every lower tier. The tls tier is the full
+// library and keeps the original output names.
+const TIERS = [
+  {
+    name: 'hash',
+    level: 0,
+    suffix: '-hash',
+    configure: ['no-rsa', 'no-dsa', 'no-dh', 'no-ec', 'no-sm2', 'no-des', 'no-aria', 'no-camellia',
+      'no-chacha', 'no-poly1305', 'no-sm4', 'no-ocb', 'no-siv']
+  },
+  {
+    name: 'cipher',
+    level: 1,
+    suffix: '-cipher',
+    configure: ['no-rsa', 'no-dsa', 'no-dh', 'no-ec', 'no-sm2']
+  },
+  { name: 'pkey', level: 2, suffix: '-pkey', configure: [] },
+  { name: 'tls', level: 3, suffix: '', configure: [] }
+];
+
+// Allow building a subset, e.g. WASM_VARIANTS=baseline npm run build:wasm
+const selectedVariants = process.env.WASM_VARIANTS
+  ? VARIANTS.filter(variant => process.env.WASM_VARIANTS.split(',').includes(variant.name))
+  : VARIANTS;
+
+// Likewise for tiers, e.g. WASM_TIERS=hash,tls
+const selectedTiers = process.env.WASM_TIERS
+  ? TIERS.filter(tier => process.env.WASM_TIERS.split(',').includes(tier.name))
+  : TIERS;
+
+// Linear memory bounds in bytes, e.g. WASM_MAXIMUM_MEMORY=268435456 for a
+// long-lived page. Memory grows on demand between the two but never
+// shrinks, so the maximum caps what a module can ever hold on to.
+const WASM_PAGE_SIZE = 64 * 1024;
+const INITIAL_MEMORY = Number(process.env.WASM_INITIAL_MEMORY || 16 * 1024 * 1024);
+const MAXIMUM_MEMORY = Number(process.env.WASM_MAXIMUM_MEMORY || 2 * 1024 * 1024 * 1024);
+
+for (const [name, value] of [['WASM_INITIAL_MEMORY', INITIAL_MEMORY], ['WASM_MAXIMUM_MEMORY', MAXIMUM_MEMORY]]) {
+  if (!Number.isInteger(value) || value <= 0 || value % WASM_PAGE_SIZE !== 0) {
+    throw new Error(`${name} must be a positive multiple of ${WASM_PAGE_SIZE}`);
+  }
+}
+if (INITIAL_MEMORY > MAXIMUM_MEMORY) {
+  throw new Error('WASM_INITIAL_MEMORY must not exceed WASM_MAXIMUM_MEMORY');
+}
 
 // Ensure build directory exists
 if (!fs.existsSync(BUILD_DIR)) {
@@ -84,60 +140,130 @@ const configureArgs = [
   'no-stdio',
   'no-threads',
   'no-ui-console',
+  // Algorithms only available from the legacy provider, and features the
+  // glue never calls. TLS below 1.2 is disabled because the API cannot
+  // select it.
+  'no-md4',
+  'no-mdc2',
+  'no-whirlpool',
+  'no-rc2',
+  'no-rc4',
+  'no-rc5',
+  'no-idea',
+  'no-seed',
+  'no-bf',
+  'no-cast',
+  'no-engine',
+  'no-comp',
+  'no-ct',
+  'no-ocsp',
+  'no-srp',
+  'no-cms',
+  'no-ts',
+  'no-cmp',
+  'no-srtp',
+  'no-nextprotoneg',
+  'no-ssl3',
+  'no-tls1',
+  'no-tls1_1',
+  'no-dtls',
   '--prefix=/usr',
   '--openssldir=/etc/ssl',
   // Use a generic 32-bit target for Emscripten. emcc does not support the wasm32-wasi target.
   'linux-generic32'
-].join(' ');
+];
+
+// Export lists are cumulative: a tier exports its own functions and those below it
+function writeExports(tier) {
+  const names = [];
+  for (const lower of TIERS.filter(t => t.level <= tier.level)) {
+    names.push(...JSON.parse(fs.readFileSync(path.resolve(__dirname, `exports/${lower.name}.json`), 'utf8')));
+  }
+  const file = path.resolve(BUILD_DIR, `exports-${tier.name}.json`);
+  fs.writeFileSync(file, JSON.stringify(names, null, 2) + '\n');
+  return file;
+}
 
 // Determine number of CPU cores for parallel build
 const numCPUs = os.cpus().length;
 
-// Set up Emscripten environment variables
-const emscriptenEnv = {
-  CROSS_COMPILE: '',
-  CC: 'emcc',
-  CXX: 'em++',
-  CFLAGS: '-Oz -Werror -Qunused-arguments -Wno-shift-count-overflow',
-  CPPFLAGS: '-D BSD_SOURCE -D WASI_EMULATED_GETPID -Dgetuid=getpagesize -Dgetgid=getpagesize -Dgeteuid=getpagesize -Dgetegid=getpagesize',
-  LDFLAGS: '-s WASM=1 -s ALLOW_MEMORY_GROWTH=1 -s MODULARIZE=1 -s EXPORT_ES6=1 -s EXPORT_NAME=OpenSSLWasm -s ENVIRONMENT=web',
-};
-
-const envString = Object.entries(emscriptenEnv)
-  .map(([key, value]) => `${key}="${value}"`)
-  .join(' ');
-
-// Configure and build OpenSSL with Emscripten
-exec(`${envString} ./Configure ${configureArgs}`, OPENSSL_DIR);
-exec(`${envString} make -j${numCPUs} build_libs`, OPENSSL_DIR);
-
-// Create the output directory
-if (!fs.existsSync(EMSCRIPTEN_OUTPUT)) {
-  fs.mkdirSync(EMSCRIPTEN_OUTPUT, { recursive: true });
-}
+for (const tier of selectedTiers) {
+  const exportsFile = writeExports(tier);
+  const linksSsl = tier.name === 'tls';
+  const libs = linksSsl ? ['libcrypto.a', 'libssl.a'] : ['libcrypto.a'];
+
+  for (const variant of selectedVariants) {
+    console.log(`Building ${tier.name} tier, ${variant.name} variant (${variant.cflags})...`);
+
+    // Each tier and variant gets its own out-of-tree OpenSSL build directory
+    const variantBuildDir = path.resolve(BUILD_DIR, `openssl-build-${tier.name}-${variant.name}`);
+    const output = variant.output.replace('openssl-wasm', `openssl-wasm${tier.suffix}`);
+    const emscriptenOutput = path.resolve(BUILD_DIR, output);
+
+    for (const dir of [variantBuildDir, emscriptenOutput]) {
+      if (!fs.existsSync(dir)) {
+        fs.mkdirSync(dir, { recursive: true });
+      }
+    }
+
+    // Set up Emscripten environment variables
+    const emscriptenEnv = {
+      CROSS_COMPILE: '',
+      CC: 'emcc',
+      CXX: 'em++',
+      CFLAGS: `${variant.cflags} -Werror -Qunused-arguments -Wno-shift-count-overflow`,
+      CPPFLAGS: '-D BSD_SOURCE -D WASI_EMULATED_GETPID -Dgetuid=getpagesize -Dgetgid=getpagesize -Dgeteuid=getpagesize -Dgetegid=getpagesize',
+      LDFLAGS: '-s WASM=1 -s ALLOW_MEMORY_GROWTH=1 -s MODULARIZE=1 -s EXPORT_ES6=1 -s EXPORT_NAME=OpenSSLWasm -s ENVIRONMENT=web,worker,node',
+    };
+
+    const envString = Object.entries(emscriptenEnv)
+      .map(([key, value]) => `${key}="${value}"`)
+      .join(' ');
 
-// Copy the compiled libraries
-console.log('Copying compiled libraries...');
-exec(`cp ${OPENSSL_DIR}/libcrypto.a ${EMSCRIPTEN_OUTPUT}/`);
-exec(`cp ${OPENSSL_DIR}/libssl.a ${EMSCRIPTEN_OUTPUT}/`);
-
-// Compile the final WebAssembly module
-console.log('Compiling final WebAssembly module...');
-exec(`
-  emcc -Oz \
-  -s WASM=1 \
-  -s ALLOW_MEMORY_GROWTH=1 \
-  -s MODULARIZE=1 \
-  -s EXPORT_ES6=1 \
-  -s EXPORT_NAME=OpenSSLWasm \
-  -s ENVIRONMENT=web \
-  -s EXPORTED_FUNCTIONS=@${path.resolve(__dirname, 'exported_functions.json')} \
-  -s EXPORTED_RUNTIME_METHODS='["ccall", "cwrap", "getValue", "setValue", "UTF8ToString", "stringToUTF8"]' \
-  -I${OPENSSL_DIR}/include \
-  ${path.resolve(__dirname, '../src/wasm/openssl_wasm_glue.c')} \
-  ${EMSCRIPTEN_OUTPUT}/libcrypto.a \
-  ${EMSCRIPTEN_OUTPUT}/libssl.a \
-  -o ${DIST_DIR}/openssl-wasm.js
-`);
+    // Configure and build OpenSSL with Emscripten. Tiers without TLS only
+    // need libcrypto.
+    exec(`${envString} ${OPENSSL_DIR}/Configure ${[...configureArgs, ...tier.configure].join(' ')}`, variantBuildDir);
+    if (linksSsl) {
+      exec(`${envString} make -j${numCPUs} build_libs`, variantBuildDir);
+    } else {
+      exec(`${envString} make -j${numCPUs} build_generated`, variantBuildDir);
+      exec(`${envString} make -j${numCPUs} libcrypto.a`, variantBuildDir);
+    }
+
+    // Copy the compiled libraries
+    console.log('Copying compiled libraries...');
+    for (const lib of libs) {
+      exec(`cp ${variantBuildDir}/${lib} ${emscriptenOutput}/`);
+    }
+
+    // Compile the final WebAssembly module
+    console.log('Compiling final WebAssembly module...');
+    exec(`
+      emcc ${variant.cflags} \
+      -DOPENSSL_WASM_TIER=${tier.level} \
+      -s WASM=1 \
+      -s ALLOW_MEMORY_GROWTH=1 \
+      -s INITIAL_MEMORY=${INITIAL_MEMORY} \
+      -s MAXIMUM_MEMORY=${MAXIMUM_MEMORY} \
+      -s MODULARIZE=1 \
+      -s EXPORT_ES6=1 \
+      -s EXPORT_NAME=OpenSSLWasm \
+      -s ENVIRONMENT=web,worker,node \
+      -s FILESYSTEM=0 \
+      -s EXPORTED_FUNCTIONS=@${exportsFile} \
+      -s EXPORTED_RUNTIME_METHODS='["ccall", "cwrap", "getValue", "setValue", "UTF8ToString", "stringToUTF8", "HEAPU8"]' \
+      -I${variantBuildDir}/include \
+      -I${OPENSSL_DIR}/include \
+      ${path.resolve(__dirname, '../src/wasm/openssl_wasm_glue.c')} \
+      ${libs.map(lib => `${emscriptenOutput}/${lib}`).join(' ')} \
+      -o ${DIST_DIR}/${output}.js
+    `);
+
+    // The loader keys its Cache API entry on this, so a rebuilt module is
+    // never confused with one cached from an earlier deploy
+    const digest = crypto.createHash('sha256').update(fs.readFileSync(`${DIST_DIR}/${output}.wasm`)).digest('hex').slice(0, 16);
+    fs.appendFileSync(`${DIST_DIR}/${output}.js`, `\nexport const wasmDigest = '${digest}';\n`);
+  }
+}
 
 console.log('WebAssembly build completed successfully!');
@@ -0,0 +1,216 @@
+/**
+ * Scratch memory arena in the WASM heap
+ */
+
+import type { OpenSSLWasmInstance } from './index';
+
+/**
+ * Initial size of the scratch arena
+ */
+export const DEFAULT_SCRATCH_SIZE = 64 * 1024;
+
+/**
+ * Largest size the scratch arena is allowed to grow to. Requests that do not
+ * fit below this mark are served by a one-off _malloc and freed on release.
+ */
+export const DEFAULT_SCRATCH_HIGH_WATER_MARK = 1024 * 1024;
+
+// Slack added when growing, so the small outputs that follow a large input
+// in the same call still fit in the arena
+const GROWTH_SLACK = 4096;
+
+/**
+ * Bump allocator over a single persistent _malloc region.
+ *
+ * Each wrapper call takes a mark(), allocates what it needs with alloc() and
+ * returns everything with release(mark) in a finally block. Marks nest, so a
+ * wrapper may call another wrapper while holding scratch memory.
+ *
+ * Pointers handed out stay valid across memory growth; typed array views of
+ * the heap do not, so always go through heapU8/heapU32 after any call into
+ * the module.
+ */
+export class ScratchArena {
+  private instance: OpenSSLWasmInstance;
+  private highWaterMark: number;
+  private base: number = 0;
+  private capacity: number = 0;
+  private offset: number = 0;
+  private overflow: number[] = [];
+  private marks: number[] = [];
+  private u8: Uint8Array;
+  private u32: Uint32Array;
+
+  /**
+   * Constructor
+   */
+  constructor(instance: OpenSSLWasmInstance, initialSize: number = DEFAULT_SCRATCH_SIZE, highWaterMark: number = DEFAULT_SCRATCH_HIGH_WATER_MARK) {
+    this.instance = instance;
+    this.highWaterMark = Math.max(highWaterMark, initialSize);
+    this.u8 = instance.HEAPU8;
+    this.u32 = new Uint32Array(this.u8.buffer);
+    this.grow(initialSize);
+  }
+
+  /**
+   * Byte view of the whole heap, refreshed if memory growth detached it
+   */
+  get heapU8(): Uint8Array {
+    if (this.u8.byteLength === 0) {
+      this.revalidate();
+    }
+    return this.u8;
+  }
+
+  /**
+   * 32-bit view of the whole heap, refreshed if memory growth detached it
+   */
+  get heapU32(): Uint32Array {
+    if (this.u32.byteLength === 0) {
+      this.revalidate();
+    }
+    return this.u32;
+  }
+
+  /**
+   * Current size of the persistent region
+   */
+  get size(): number {
+    return this.capacity;
+  }
+
+  /**
+   * Start a scratch scope
+   */
+  mark(): number {
+    this.marks.push(this.overflow.length);
+    return this.offset;
+  }
+
+  /**
+   * End a scratch scope, returning everything allocated since mark()
+   */
+  release(mark: number): void {
+    const overflowCount = this.marks.pop() ?? 0;
+    while (this.overflow.length > overflowCount) {
+      this.instance._free(this.overflow.pop() as number);
+    }
+    this.offset = mark;
+  }
+
+  /**
+   * Allocate size bytes, 8-byte aligned, valid until the enclosing release()
+   */
+  alloc(size: number): number {
+    const aligned = size + ((8 - (size & 7)) & 7);
+
+    if (this.offset + aligned > this.capacity) {
+      // The region can only be replaced while nothing in it is live
+      if (this.offset === 0 && aligned <= this.highWaterMark) {
+        this.grow(Math.min(this.highWaterMark, nextPowerOfTwo(aligned + GROWTH_SLACK)));
+      } else {
+        return this.allocOverflow(aligned);
+      }
+    }
+
+    const ptr = this.base + this.offset;
+    this.offset += aligned;
+    return ptr;
+  }
+
+  /**
+   * Allocate room for data and copy it into the heap
+   */
+  copyIn(data: Uint8Array): number {
+    const ptr = this.alloc(data.length);
+    this.heapU8.set(data, ptr);
+    return ptr;
+  }
+
+  /**
+   * Copy len bytes at ptr out of the heap into a new array
+   */
+  copyOut(ptr: number, len: number): Uint8Array {
+    return this.heapU8.slice(ptr, ptr + len);
+  }
+
+  /**
+   * Copy messages into one contiguous region and build the pointer and
+   * length arrays the *_batch glue functions take
+   */
+  packMessages(messages: Uint8Array[]): { ptrsPtr: number; lensPtr: number } {
+    let totalLength = 0;
+    for (const message of messages) {
+      totalLength += message.length;
+    }
+
+    const dataPtr = this.alloc(totalLength);
+    const ptrsPtr = this.alloc(messages.length * 4);
+    const lensPtr = this.alloc(messages.length * 4);
+
+    const heapU8 = this.heapU8;
+    const heapU32 = this.heapU32;
+    let offset = dataPtr;
+    for (let i = 0; i < messages.length; i++) {
+      heapU8.set(messages[i], offset);
+      heapU32[(ptrsPtr >> 2) + i] = offset;
+      heapU32[(lensPtr >> 2) + i] = messages[i].length;
+      offset += messages[i].length;
+    }
+
+    return { ptrsPtr, lensPtr };
+  }
+
+  /**
+   * Free the persistent region
+   */
+  dispose(): void {
+    while (this.overflow.length > 0) {
+      this.instance._free(this.overflow.pop() as number);
+    }
+    if (this.base !== 0) {
+      this.instance._free(this.base);
+      this.base = 0;
+      this.capacity = 0;
+      this.offset = 0;
+    }
+  }
+
+  private grow(size: number): void {
+    if (this.base !== 0) {
+      this.instance._free(this.base);
+      this.base = 0;
+      this.capacity = 0;
+    }
+
+    const base = this.instance._malloc(size);
+    if (base === 0) {
+      throw new Error('Failed to allocate scratch memory');
+    }
+
+    this.base = base;
+    this.capacity = size;
+  }
+
+  private allocOverflow(size: number): number {
+    const ptr = this.instance._malloc(size);
+    if (ptr === 0) {
+      throw new Error(`Failed to allocate ${size} bytes of scratch memory`);
+    }
+    this.overflow.push(ptr);
+    return ptr;
+  }
+
+  private revalidate(): void {
+    this.u8 = this.instance.HEAPU8;
+    this.u32 = new Uint32Array(this.u8.buffer);
+  }
+}
+
+function nextPowerOfTwo(n: number): number {
+  let size = 1;
+  while (size < n) {
+    size *= 2;
+  }
+  return size;
+}
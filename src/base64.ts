@@ -0,0 +1,290 @@
+/**
+ * Base64 encoding over EVP_EncodeBlock / EVP_DecodeBlock
+ *
+ * Base64 text is pure ASCII, so strings are moved in and out of the heap
+ * with TextEncoder.encodeInto and a single-byte TextDecoder rather than
+ * UTF-8 conversion.
+ */
+
+import type { OpenSSLWasmInstance } from './index';
+
+/**
+ * Bytes of input encoded per call by Base64Encoder. A multiple of 3, so
+ * every window except the last encodes without padding.
+ */
+export const BASE64_WINDOW_SIZE = 48 * 1024;
+
+// Characters decoded per call by Base64Decoder, the encoding of one window
+const BASE64_WINDOW_CHARS = (BASE64_WINDOW_SIZE / 3) * 4;
+
+const asciiEncoder = new TextEncoder();
+const asciiDecoder = new TextDecoder('latin1');
+const WHITESPACE = /[ \t\r\n]/g;
+
+/**
+ * Wrapped base64 glue functions
+ */
+export interface Base64Functions {
+  encode: (inPtr: number, inLen: number, outPtr: number) => number;
+  decode: (inPtr: number, inLen: number, outPtr: number) => number;
+}
+
+/**
+ * Create the base64 function wrappers for a module instance
+ */
+export function wrapBase64Functions(instance: OpenSSLWasmInstance): Base64Functions {
+  return {
+    encode: instance.cwrap('base64_encode', 'number', ['number', 'number', 'number']) as Base64Functions['encode'],
+    decode: instance.cwrap('base64_decode', 'number', ['number', 'number', 'number']) as Base64Functions['decode']
+  };
+}
+
+/**
+ * Length of the padded encoding of length bytes
+ */
+export function base64EncodedLength(length: number): number {
+  return Math.ceil(length / 3) * 4;
+}
+
+/**
+ * Largest decoded length of length characters of padded base64
+ */
+export function base64DecodedLength(length: number): number {
+  return (length / 4) * 3;
+}
+
+/**
+ * Pad unpadded base64 to a whole number of 4-character groups
+ */
+export function padBase64(text: string): string {
+  const remainder = text.length % 4;
+  if (remainder === 1) {
+    throw new Error('Invalid base64 input');
+  }
+  return remainder === 0 ? text : text + '='.repeat(4 - remainder);
+}
+
+/**
+ * Copy ASCII text into the heap. Throws if the text is not ASCII, which is
+ * never valid base64.
+ */
+export function writeAscii(heapU8: Uint8Array, text: string, ptr: number): void {
+  const { read, written } = asciiEncoder.encodeInto(text, heapU8.subarray(ptr, ptr + text.length));
+  if (read !== text.length || written !== text.length) {
+    throw new Error('Invalid base64 input');
+  }
+}
+
+/**
+ * Read ASCII text out of the heap
+ */
+export function readAscii(heapU8: Uint8Array, ptr: number, length: number): string {
+  return asciiDecoder.decode(heapU8.subarray(ptr, ptr + length));
+}
+
+/**
+ * Incremental base64 encoder.
+ *
+ * Created with OpenSSL.createBase64Encoder(). update() returns the encoding
+ * of every complete 3-byte group seen so far; final() flushes the padded tail.
+ */
+export class Base64Encoder {
+  private instance: OpenSSLWasmInstance;
+  private fns: Base64Functions;
+  private window: number = 0;
+  private pending = new Uint8Array(2);
+  private pendingLength = 0;
+  private finished = false;
+
+  /**
+   * Constructor - should not be called directly, use OpenSSL.createBase64Encoder() instead
+   */
+  constructor(instance: OpenSSLWasmInstance, fns: Base64Functions) {
+    this.instance = instance;
+    this.fns = fns;
+  }
+
+  /**
+   * Encode more data. Up to two trailing bytes are held back until the next
+   * update() or final().
+   */
+  update(data: Uint8Array | string): string {
+    if (this.finished) {
+      throw new Error('Base64Encoder has already been finalized');
+    }
+
+    const input = typeof data === 'string' ? asciiEncoder.encode(data) : data;
+    const parts: string[] = [];
+    let offset = 0;
+
+    while (this.pendingLength + input.length - offset >= 3) {
+      // Fill the window with the held-back bytes, then whole groups of input
+      let total = this.pendingLength + Math.min(BASE64_WINDOW_SIZE - this.pendingLength, input.length - offset);
+      total -= total % 3;
+      const take = total - this.pendingLength;
+
+      parts.push(this.encodeWindow(input.subarray(offset, offset + take)));
+      offset += take;
+    }
+
+    this.pending.set(input.subarray(offset), this.pendingLength);
+    this.pendingLength += input.length - offset;
+    return parts.join('');
+  }
+
+  /**
+   * Encode the held-back bytes with padding. The encoder cannot be used
+   * afterwards.
+   */
+  final(): string {
+    if (this.finished) {
+      throw new Error('Base64Encoder has already been finalized');
+    }
+
+    try {
+      return this.pendingLength > 0 ? this.encodeWindow(new Uint8Array(0)) : '';
+    } finally {
+      this.dispose();
+    }
+  }
+
+  /**
+   * Release the heap window
+   */
+  dispose(): void {
+    this.finished = true;
+    this.pendingLength = 0;
+    if (this.window !== 0) {
+      this.instance._free(this.window);
+      this.window = 0;
+    }
+  }
+
+  // Encode the held-back bytes followed by input, which together fit a window
+  private encodeWindow(input: Uint8Array): string {
+    if (this.window === 0) {
+      this.window = this.instance._malloc(BASE64_WINDOW_SIZE + base64EncodedLength(BASE64_WINDOW_SIZE) + 1);
+      if (this.window === 0) {
+        throw new Error('Failed to allocate base64 buffer');
+      }
+    }
+
+    const total = this.pendingLength + input.length;
+    const outPtr = this.window + BASE64_WINDOW_SIZE;
+    const heapU8 = this.instance.HEAPU8;
+    heapU8.set(this.pending.subarray(0, this.pendingLength), this.window);
+    heapU8.set(input, this.window + this.pendingLength);
+    this.pendingLength = 0;
+
+    const outLength = this.fns.encode(this.window, total, outPtr);
+    return readAscii(this.instance.HEAPU8, outPtr, outLength);
+  }
+}
+
+/**
+ * Incremental base64 decoder.
+ *
+ * Created with OpenSSL.createBase64Decoder(). Accepts text split at any
+ * point, ignores line breaks and tolerates a missing final padding.
+ */
+export class Base64Decoder {
+  private instance: OpenSSLWasmInstance;
+  private fns: Base64Functions;
+  private window: number = 0;
+  private pending = '';
+  private padded = false;
+  private finished = false;
+
+  /**
+   * Constructor - should not be called directly, use OpenSSL.createBase64Decoder() instead
+   */
+  constructor(instance: OpenSSLWasmInstance, fns: Base64Functions) {
+    this.instance = instance;
+    this.fns = fns;
+  }
+
+  /**
+   * Decode more text. Characters that do not complete a 4-character group
+   * are held back until the next update() or final().
+   */
+  update(text: string): Uint8Array {
+    if (this.finished) {
+      throw new Error('Base64Decoder has already been finalized');
+    }
+
+    const input = this.pending + text.replace(WHITESPACE, '');
+    const usable = input.length - (input.length % 4);
+    this.pending = input.substring(usable);
+
+    return this.decode(input, usable);
+  }
+
+  /**
+   * Decode the held-back characters. The decoder cannot be used afterwards.
+   */
+  final(): Uint8Array {
+    if (this.finished) {
+      throw new Error('Base64Decoder has already been finalized');
+    }
+
+    try {
+      const tail = padBase64(this.pending);
+      return this.decode(tail, tail.length);
+    } finally {
+      this.dispose();
+    }
+  }
+
+  /**
+   * Release the heap window
+   */
+  dispose(): void {
+    this.finished = true;
+    this.pending = '';
+    if (this.window !== 0) {
+      this.instance._free(this.window);
+      this.window = 0;
+    }
+  }
+
+  // Decode the first length characters of input, which is a multiple of 4
+  private decode(input: string, length: number): Uint8Array {
+    if (length === 0) {
+      return new Uint8Array(0);
+    }
+    if (this.padded) {
+      throw new Error('Invalid base64 input: data after padding');
+    }
+
+    if (this.window === 0) {
+      this.window = this.instance._malloc(BASE64_WINDOW_CHARS + BASE64_WINDOW_SIZE);
+      if (this.window === 0) {
+        throw new Error('Failed to allocate base64 buffer');
+      }
+    }
+
+    const output = new Uint8Array(base64DecodedLength(length));
+    const outPtr = this.window + BASE64_WINDOW_CHARS;
+    let written = 0;
+
+    for (let offset = 0; offset < length; offset += BASE64_WINDOW_CHARS) {
+      if (this.padded) {
+        throw new Error('Invalid base64 input: data after padding');
+      }
+
+      const chunk = input.substring(offset, Math.min(offset + BASE64_WINDOW_CHARS, length));
+      writeAscii(this.instance.HEAPU8, chunk, this.window);
+
+      const outLength = this.fns.decode(this.window, chunk.length, outPtr);
+      if (outLength < 0) {
+        throw new Error('Invalid base64 input');
+      }
+
+      output.set(this.instance.HEAPU8.subarray(outPtr, outPtr + outLength), written);
+      written += outLength;
+      this.padded = outLength < base64DecodedLength(chunk.length);
+    }
+
+    return output.subarray(0, written);
+  }
+}
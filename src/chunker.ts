@@ -0,0 +1,275 @@
+/**
+ * Content-defined chunking with per-chunk digests, for deduplication
+ *
+ * The glue runs FastCDC over the input and hashes every chunk in the same
+ * pass, returning one packed record per chunk: its offset in the whole
+ * input (uint64), its length (uint32), both little endian, then its digest.
+ */
+
+import type { OpenSSLWasmInstance } from './index';
+import { HeapBuffer } from './heap';
+
+/**
+ * Bytes before the digest in a packed chunk record
+ */
+export const CHUNK_RECORD_HEADER = 12;
+
+/**
+ * Amount of input handed to the chunker per call
+ */
+export const CHUNK_WINDOW_SIZE = 1024 * 1024;
+
+/**
+ * Default average chunk size in bytes
+ */
+export const DEFAULT_CHUNK_AVG_SIZE = 64 * 1024;
+
+// Limits enforced by cdc_init
+const CDC_MIN_SIZE = 64;
+const CDC_MAX_SIZE = 1024 * 1024 * 1024;
+
+export interface ChunkerOptions {
+  /**
+   * Digest for each chunk (default: 'sha256')
+   */
+  algorithm?: string;
+  /**
+   * Target average chunk size in bytes (default: 64 KiB)
+   */
+  avgSize?: number;
+  /**
+   * Smallest chunk except the last (default: avgSize / 4)
+   */
+  minSize?: number;
+  /**
+   * Largest chunk (default: avgSize * 4)
+   */
+  maxSize?: number;
+}
+
+/**
+ * One chunk of the input
+ */
+export interface ChunkRecord {
+  /**
+   * Offset of the chunk in the whole input
+   */
+  offset: number;
+  length: number;
+  digest: Uint8Array;
+}
+
+/**
+ * Wrapped chunker glue functions
+ */
+export interface ChunkerFunctions {
+  init: (name: string, minSize: number, avgSize: number, maxSize: number) => number;
+  recordSize: (state: number) => number;
+  update: (state: number, dataPtr: number, dataLen: number, outPtr: number) => number;
+  final: (state: number, outPtr: number) => number;
+  free: (state: number) => void;
+}
+
+/**
+ * Create the chunker function wrappers for a module instance
+ */
+export function wrapChunkerFunctions(instance: OpenSSLWasmInstance): ChunkerFunctions {
+  return {
+    init: instance.cwrap('cdc_init', 'number', ['string', 'number', 'number', 'number']) as ChunkerFunctions['init'],
+    recordSize: instance.cwrap('cdc_record_size', 'number', ['number']) as ChunkerFunctions['recordSize'],
+    update: instance.cwrap('cdc_update', 'number', ['number', 'number', 'number', 'number']) as ChunkerFunctions['update'],
+    final: instance.cwrap('cdc_final', 'number', ['number', 'number']) as ChunkerFunctions['final'],
+    free: instance.cwrap('cdc_free', 'void', ['number']) as ChunkerFunctions['free']
+  };
+}
+
+/**
+ * Split packed records from Chunker.update() or final() into objects. The
+ * digests are views of records.
+ */
+export function unpackChunks(records: Uint8Array, digestLength: number): ChunkRecord[] {
+  const recordSize = CHUNK_RECORD_HEADER + digestLength;
+  const view = new DataView(records.buffer, records.byteOffset, records.byteLength);
+  const chunks: ChunkRecord[] = [];
+  for (let offset = 0; offset + recordSize <= records.length; offset += recordSize) {
+    chunks.push({
+      offset: view.getUint32(offset, true) + view.getUint32(offset + 4, true) * 0x100000000,
+      length: view.getUint32(offset + 8, true),
+      digest: records.subarray(offset + CHUNK_RECORD_HEADER, offset + recordSize)
+    });
+  }
+  return chunks;
+}
+
+/**
+ * Content-defined chunker that hashes each chunk as it is found.
+ *
+ * Created with OpenSSL.createChunker(). Feed the input in order with
+ * update(), which returns the records of the chunks that ended in it, and
+ * finish with final(), which returns the record of the last chunk. A chunk
+ * may span any number of update() calls. Boundaries depend only on the
+ * content and the sizes, so the same data always gives the same chunks and
+ * an edit only changes the chunks around it. The native state is released
+ * by final() or dispose().
+ */
+export class Chunker {
+  private instance: OpenSSLWasmInstance;
+  private fns: ChunkerFunctions;
+  private state: number;
+  private window: number = 0;
+  private output: number = 0;
+  private encoder = new TextEncoder();
+
+  /**
+   * Digest length in bytes
+   */
+  readonly digestLength: number;
+  /**
+   * Size of one packed record: CHUNK_RECORD_HEADER plus digestLength
+   */
+  readonly recordSize: number;
+  readonly minSize: number;
+
+  /**
+   * Constructor - should not be called directly, use OpenSSL.createChunker() instead
+   */
+  constructor(instance: OpenSSLWasmInstance, fns: ChunkerFunctions, options: ChunkerOptions = {}) {
+    const algorithm = options.algorithm ?? 'sha256';
+    const avgSize = options.avgSize ?? DEFAULT_CHUNK_AVG_SIZE;
+    const minSize = options.minSize ?? Math.max(CDC_MIN_SIZE, Math.floor(avgSize / 4));
+    const maxSize = options.maxSize ?? Math.min(CDC_MAX_SIZE, avgSize * 4);
+
+    for (const size of [minSize, avgSize, maxSize]) {
+      if (!Number.isInteger(size)) {
+        throw new Error('Chunk sizes must be integers');
+      }
+    }
+    if (minSize < CDC_MIN_SIZE || minSize > avgSize || avgSize > maxSize || maxSize > CDC_MAX_SIZE) {
+      throw new Error(`Chunk sizes must satisfy ${CDC_MIN_SIZE} <= minSize <= avgSize <= maxSize <= ${CDC_MAX_SIZE}`);
+    }
+
+    this.instance = instance;
+    this.fns = fns;
+    this.state = fns.init(algorithm, minSize, avgSize, maxSize);
+    if (this.state === 0) {
+      throw new Error(`Unsupported digest algorithm: ${algorithm}`);
+    }
+
+    this.recordSize = fns.recordSize(this.state);
+    this.digestLength = this.recordSize - CHUNK_RECORD_HEADER;
+    this.minSize = minSize;
+  }
+
+  /**
+   * Chunk more input and return the packed records of the chunks that ended
+   * in it (possibly none). A HeapBuffer is read where it is, without
+   * copying.
+   */
+  update(data: Uint8Array | string | HeapBuffer): Uint8Array {
+    if (this.state === 0) {
+      throw new Error('Chunker has already been finalized');
+    }
+
+    const inHeap = data instanceof HeapBuffer;
+    const input = inHeap ? null : typeof data === 'string' ? this.encoder.encode(data) : data;
+    const length = inHeap ? data.length : input!.length;
+    if (inHeap) {
+      data.checkRange(length);
+    }
+    this.ensureBuffers(!inHeap && length > 0);
+
+    const parts: Uint8Array[] = [];
+    let total = 0;
+    for (let offset = 0; offset < length; offset += CHUNK_WINDOW_SIZE) {
+      const size = Math.min(CHUNK_WINDOW_SIZE, length - offset);
+      let ptr: number;
+      if (inHeap) {
+        ptr = data.ptr + offset;
+      } else {
+        this.instance.HEAPU8.set(input!.subarray(offset, offset + size), this.window);
+        ptr = this.window;
+      }
+
+      const count = this.fns.update(this.state, ptr, size, this.output);
+      if (count < 0) {
+        this.dispose();
+        throw new Error('Chunking failed');
+      }
+      if (count > 0) {
+        parts.push(this.instance.HEAPU8.slice(this.output, this.output + count * this.recordSize));
+        total += count * this.recordSize;
+      }
+    }
+
+    if (parts.length === 1) {
+      return parts[0];
+    }
+    const records = new Uint8Array(total);
+    let position = 0;
+    for (const part of parts) {
+      records.set(part, position);
+      position += part.length;
+    }
+    return records;
+  }
+
+  /**
+   * Finish chunking and return the packed record of the last chunk, or an
+   * empty array if no input is left over. The Chunker cannot be used
+   * afterwards.
+   */
+  final(): Uint8Array {
+    if (this.state === 0) {
+      throw new Error('Chunker has already been finalized');
+    }
+
+    this.ensureBuffers(false);
+    const count = this.fns.final(this.state, this.output);
+    this.state = 0;
+
+    try {
+      if (count < 0) {
+        throw new Error('Chunking failed');
+      }
+      return this.instance.HEAPU8.slice(this.output, this.output + count * this.recordSize);
+    } finally {
+      this.releaseBuffers();
+    }
+  }
+
+  /**
+   * Release the native state without finishing
+   */
+  dispose(): void {
+    if (this.state !== 0) {
+      this.fns.free(this.state);
+      this.state = 0;
+    }
+    this.releaseBuffers();
+  }
+
+  // One allocation holds the output records for a full window and, when
+  // the input has to be copied in, the input window after them
+  private ensureBuffers(needWindow: boolean): void {
+    const outputSize = (Math.floor(CHUNK_WINDOW_SIZE / this.minSize) + 1) * this.recordSize;
+    if (this.output !== 0 && (this.window !== 0 || !needWindow)) {
+      return;
+    }
+    this.releaseBuffers();
+
+    const size = outputSize + (needWindow ? CHUNK_WINDOW_SIZE : 0);
+    this.output = this.instance._malloc(size);
+    if (this.output === 0) {
+      throw new Error('Failed to allocate chunker buffer');
+    }
+    this.window = needWindow ? this.output + outputSize : 0;
+  }
+
+  private releaseBuffers(): void {
+    if (this.output !== 0) {
+      this.instance._free(this.output);
+      this.output = 0;
+      this.window = 0;
+    }
+  }
+}
@@ -0,0 +1,392 @@
+/**
+ * Streaming cipher support
+ */
+
+import type { OpenSSLWasmInstance } from './index';
+
+/**
+ * Size of the heap windows used to feed data through a streaming cipher.
+ * Inputs larger than this are processed window by window, so a Cipher keeps
+ * a constant working set in the WASM heap no matter how much data it sees.
+ */
+export const CIPHER_WINDOW_SIZE = 64 * 1024;
+
+/**
+ * AES block size in bytes
+ */
+export const AES_BLOCK_SIZE = 16;
+
+/**
+ * Largest block size of any supported cipher
+ */
+export const MAX_BLOCK_SIZE = 32;
+
+/**
+ * Default (and largest) AEAD authentication tag length in bytes
+ */
+export const AEAD_TAG_LENGTH = 16;
+
+/**
+ * Options for OpenSSL.createCipher() and OpenSSL.createDecipher()
+ */
+export interface CipherOptions {
+  /**
+   * OpenSSL cipher name, e.g. 'aes-256-gcm' or 'chacha20-poly1305'.
+   * Defaults to AES-CBC with the key size implied by the key.
+   */
+  algorithm?: string;
+  /**
+   * Authentication tag length for AEAD ciphers (default: 16)
+   */
+  authTagLength?: number;
+}
+
+/**
+ * Wrapped glue functions used by Cipher
+ */
+export interface CipherFunctions {
+  init: (name: string, keyPtr: number, keyLen: number, ivPtr: number, ivLen: number, enc: number) => number;
+  update: (ctx: number, inPtr: number, inLen: number, outPtr: number, outLenPtr: number) => number;
+  updateAad: (ctx: number, aadPtr: number, aadLen: number) => number;
+  setTag: (ctx: number, tagPtr: number, tagLen: number) => number;
+  final: (ctx: number, outPtr: number, outLenPtr: number, tagPtr: number, tagLen: number) => number;
+  blockSize: (ctx: number) => number;
+  isAead: (ctx: number) => number;
+  seal: (name: string, keyPtr: number, keyLen: number, ivPtr: number, ivLen: number, aadPtr: number, aadLen: number,
+         inPtr: number, inLen: number, outPtr: number, tagPtr: number, tagLen: number) => number;
+  open: (name: string, keyPtr: number, keyLen: number, ivPtr: number, ivLen: number, aadPtr: number, aadLen: number,
+         inPtr: number, inLen: number, tagPtr: number, tagLen: number, outPtr: number) => number;
+  free: (ctx: number) => void;
+  error: () => string;
+}
+
+/**
+ * Create the cipher function wrappers for a module instance
+ */
+export function wrapCipherFunctions(instance: OpenSSLWasmInstance): CipherFunctions {
+  return {
+    init: instance.cwrap('cipher_init', 'number', ['string', 'number', 'number', 'number', 'number', 'number']) as CipherFunctions['init'],
+    update: instance.cwrap('cipher_update', 'number', ['number', 'number', 'number', 'number', 'number']) as CipherFunctions['update'],
+    updateAad: instance.cwrap('cipher_update_aad', 'number', ['number', 'number', 'number']) as CipherFunctions['updateAad'],
+    setTag: instance.cwrap('cipher_set_tag', 'number', ['number', 'number', 'number']) as CipherFunctions['setTag'],
+    final: instance.cwrap('cipher_final', 'number', ['number', 'number', 'number', 'number', 'number']) as CipherFunctions['final'],
+    blockSize: instance.cwrap('cipher_block_size', 'number', ['number']) as CipherFunctions['blockSize'],
+    isAead: instance.cwrap('cipher_is_aead', 'number', ['number']) as CipherFunctions['isAead'],
+    seal: instance.cwrap('aead_seal', 'number', ['string', 'number', 'number', 'number', 'number', 'number', 'number', 'number', 'number', 'number', 'number', 'number']) as CipherFunctions['seal'],
+    open: instance.cwrap('aead_open', 'number', ['string', 'number', 'number', 'number', 'number', 'number', 'number', 'number', 'number', 'number', 'number', 'number']) as CipherFunctions['open'],
+    free: instance.cwrap('evp_cipher_ctx_free', 'void', ['number']) as CipherFunctions['free'],
+    error: instance.cwrap('get_error_string', 'string', []) as CipherFunctions['error']
+  };
+}
+
+/**
+ * Check an AES key and IV before handing them to the module
+ */
+export function checkAesParameters(key: Uint8Array, iv: Uint8Array): void {
+  if (key.length !== 16 && key.length !== 24 && key.length !== 32) {
+    throw new Error('AES key must be 16, 24, or 32 bytes');
+  }
+  if (iv.length !== AES_BLOCK_SIZE) {
+    throw new Error(`AES IV must be ${AES_BLOCK_SIZE} bytes`);
+  }
+}
+
+/**
+ * Name of the AES-CBC cipher matching a key
+ */
+export function aesCbcName(key: Uint8Array): string {
+  return `aes-${key.length * 8}-cbc`;
+}
+
+/**
+ * Incremental encryption or decryption over a persistent EVP_CIPHER_CTX.
+ *
+ * Created with OpenSSL.createCipher() or OpenSSL.createDecipher(). Data is
+ * copied through fixed input/output windows in the heap; results can either
+ * be returned as new arrays (update/final) or written straight into a caller
+ * buffer (updateInto/finalInto). The native context is released by final()
+ * or dispose().
+ *
+ * For AEAD ciphers (AES-GCM, ChaCha20-Poly1305), call setAAD() before the
+ * first update. When encrypting, read the tag with getAuthTag() after
+ * final(); when decrypting, supply it with setAuthTag() before final(), which
+ * throws if authentication fails. Decrypted output must not be trusted until
+ * final() has succeeded.
+ */
+export class Cipher {
+  private instance: OpenSSLWasmInstance;
+  private fns: CipherFunctions;
+  private ctx: number = 0;
+  private inWindow: number = 0;
+  private outWindow: number = 0;
+  private outLenPtr: number = 0;
+  private tagPtr: number = 0;
+  private pending: number = 0;
+  private started: boolean = false;
+  private authTag: Uint8Array | null = null;
+
+  /**
+   * Whether this object encrypts or decrypts
+   */
+  readonly mode: 'encrypt' | 'decrypt';
+
+  /**
+   * OpenSSL cipher name
+   */
+  readonly algorithm: string;
+
+  /**
+   * Cipher block size in bytes (1 for stream and AEAD modes)
+   */
+  readonly blockSize: number;
+
+  /**
+   * Whether the cipher is an AEAD mode
+   */
+  readonly aead: boolean;
+
+  /**
+   * Authentication tag length for AEAD modes
+   */
+  readonly authTagLength: number;
+
+  /**
+   * Constructor - should not be called directly, use OpenSSL.createCipher()
+   * or OpenSSL.createDecipher() instead
+   */
+  constructor(instance: OpenSSLWasmInstance, fns: CipherFunctions, mode: 'encrypt' | 'decrypt', key: Uint8Array, iv: Uint8Array, options: CipherOptions = {}) {
+    if (options.algorithm === undefined) {
+      checkAesParameters(key, iv);
+    }
+
+    this.instance = instance;
+    this.fns = fns;
+    this.mode = mode;
+    this.algorithm = options.algorithm ?? aesCbcName(key);
+    this.authTagLength = options.authTagLength ?? AEAD_TAG_LENGTH;
+
+    if (this.authTagLength < 1 || this.authTagLength > AEAD_TAG_LENGTH) {
+      throw new Error(`Authentication tag length must be between 1 and ${AEAD_TAG_LENGTH} bytes`);
+    }
+
+    // One allocation holds both windows, the output length slot and the tag
+    const outWindowSize = CIPHER_WINDOW_SIZE + MAX_BLOCK_SIZE;
+    this.inWindow = this.instance._malloc(CIPHER_WINDOW_SIZE + outWindowSize + 8 + AEAD_TAG_LENGTH);
+    if (this.inWindow === 0) {
+      throw new Error('Failed to allocate cipher buffers');
+    }
+    this.outWindow = this.inWindow + CIPHER_WINDOW_SIZE;
+    this.outLenPtr = this.outWindow + outWindowSize;
+    this.tagPtr = this.outLenPtr + 8;
+
+    if (key.length + iv.length > outWindowSize) {
+      this.releaseWindows();
+      throw new Error('Key or IV is too long');
+    }
+
+    // Key and IV pass through the output window and are wiped right after use
+    const heap = this.instance.HEAPU8;
+    heap.set(key, this.outWindow);
+    heap.set(iv, this.outWindow + key.length);
+
+    this.ctx = this.fns.init(this.algorithm, this.outWindow, key.length, this.outWindow + key.length, iv.length, mode === 'encrypt' ? 1 : 0);
+    this.instance.HEAPU8.fill(0, this.outWindow, this.outWindow + key.length + iv.length);
+
+    if (this.ctx === 0) {
+      this.releaseWindows();
+      throw new Error(`Cipher initialization failed for ${this.algorithm}: ${this.fns.error() || 'unsupported cipher or invalid key/IV length'}`);
+    }
+
+    this.blockSize = this.fns.blockSize(this.ctx);
+    this.aead = this.fns.isAead(this.ctx) === 1;
+  }
+
+  /**
+   * Feed additional authenticated data (AEAD only, before the first update)
+   */
+  setAAD(aad: Uint8Array | string): this {
+    this.checkActive();
+
+    if (!this.aead) {
+      throw new Error(`${this.algorithm} does not support additional authenticated data`);
+    }
+    if (this.started) {
+      throw new Error('setAAD() must be called before update()');
+    }
+
+    const aadData = typeof aad === 'string' ? new TextEncoder().encode(aad) : aad;
+    for (let offset = 0; offset < aadData.length; offset += CIPHER_WINDOW_SIZE) {
+      const chunk = aadData.subarray(offset, offset + CIPHER_WINDOW_SIZE);
+      this.instance.HEAPU8.set(chunk, this.inWindow);
+
+      if (this.fns.updateAad(this.ctx, this.inWindow, chunk.length) !== 1) {
+        this.dispose();
+        throw new Error(`Cipher AAD update failed: ${this.fns.error()}`);
+      }
+    }
+
+    return this;
+  }
+
+  /**
+   * Set the expected authentication tag (AEAD decryption only, before final)
+   */
+  setAuthTag(tag: Uint8Array): this {
+    this.checkActive();
+
+    if (!this.aead || this.mode !== 'decrypt') {
+      throw new Error('setAuthTag() is only valid when decrypting with an AEAD cipher');
+    }
+    if (tag.length !== this.authTagLength) {
+      throw new Error(`Authentication tag must be ${this.authTagLength} bytes`);
+    }
+
+    this.instance.HEAPU8.set(tag, this.tagPtr);
+    if (this.fns.setTag(this.ctx, this.tagPtr, tag.length) !== 1) {
+      this.dispose();
+      throw new Error(`Setting authentication tag failed: ${this.fns.error()}`);
+    }
+
+    return this;
+  }
+
+  /**
+   * Get the authentication tag (AEAD encryption only, after final)
+   */
+  getAuthTag(): Uint8Array {
+    if (this.authTag === null) {
+      throw new Error('getAuthTag() is only valid after final() when encrypting with an AEAD cipher');
+    }
+    return this.authTag;
+  }
+
+  /**
+   * Upper bound on the bytes update() produces for an input of the given size
+   */
+  updateOutputSize(inputLength: number): number {
+    const total = this.pending + inputLength;
+    return total - (total % this.blockSize);
+  }
+
+  /**
+   * Process more data and return the output produced so far
+   */
+  update(data: Uint8Array | string): Uint8Array {
+    const inputData = typeof data === 'string' ? new TextEncoder().encode(data) : data;
+    const output = new Uint8Array(this.updateOutputSize(inputData.length));
+    const written = this.updateInto(inputData, output);
+    return written === output.length ? output : output.subarray(0, written);
+  }
+
+  /**
+   * Process more data, writing the output into output starting at
+   * outputOffset. Returns the number of bytes written.
+   *
+   * output must have room for updateOutputSize(data.length) bytes. It may be
+   * the input array itself: output never runs ahead of the input consumed,
+   * so encrypting in place is safe as long as outputOffset does not exceed
+   * the input's own offset within the shared buffer.
+   */
+  updateInto(data: Uint8Array, output: Uint8Array, outputOffset: number = 0): number {
+    this.checkActive();
+
+    if (output.length - outputOffset < this.updateOutputSize(data.length)) {
+      throw new Error('Output buffer is too small');
+    }
+
+    this.started = true;
+    let written = 0;
+
+    for (let offset = 0; offset < data.length; offset += CIPHER_WINDOW_SIZE) {
+      const chunk = data.subarray(offset, offset + CIPHER_WINDOW_SIZE);
+      this.instance.HEAPU8.set(chunk, this.inWindow);
+
+      if (this.fns.update(this.ctx, this.inWindow, chunk.length, this.outWindow, this.outLenPtr) !== 1) {
+        this.dispose();
+        throw new Error(`Cipher update failed: ${this.fns.error()}`);
+      }
+
+      const heap = this.instance.HEAPU8;
+      const outLen = this.instance.getValue(this.outLenPtr, 'i32');
+      output.set(heap.subarray(this.outWindow, this.outWindow + outLen), outputOffset + written);
+      written += outLen;
+      this.pending += chunk.length - outLen;
+    }
+
+    return written;
+  }
+
+  /**
+   * Finish processing and return the remaining output. The Cipher cannot be
+   * used afterwards.
+   */
+  final(): Uint8Array {
+    const output = new Uint8Array(this.blockSize);
+    const written = this.finalInto(output);
+    return output.subarray(0, written);
+  }
+
+  /**
+   * Finish processing, writing the remaining output (at most blockSize bytes)
+   * into output starting at outputOffset. Returns the number of bytes written.
+   */
+  finalInto(output: Uint8Array, outputOffset: number = 0): number {
+    this.checkActive();
+
+    const wantTag = this.aead && this.mode === 'encrypt';
+    const result = this.fns.final(this.ctx, this.outWindow, this.outLenPtr, wantTag ? this.tagPtr : 0, this.authTagLength);
+    this.ctx = 0;
+
+    try {
+      if (result !== 1) {
+        if (this.aead && this.mode === 'decrypt') {
+          throw new Error('Authentication failed');
+        }
+        throw new Error(`Cipher final failed: ${this.fns.error()}`);
+      }
+
+      const heap = this.instance.HEAPU8;
+      const outLen = this.instance.getValue(this.outLenPtr, 'i32');
+      if (output.length - outputOffset < outLen) {
+        throw new Error('Output buffer is too small');
+      }
+
+      output.set(heap.subarray(this.outWindow, this.outWindow + outLen), outputOffset);
+      if (wantTag) {
+        this.authTag = heap.slice(this.tagPtr, this.tagPtr + this.authTagLength);
+      }
+      return outLen;
+    } finally {
+      this.releaseWindows();
+    }
+  }
+
+  /**
+   * Release the native context without finishing
+   */
+  dispose(): void {
+    if (this.ctx !== 0) {
+      this.fns.free(this.ctx);
+      this.ctx = 0;
+    }
+    this.releaseWindows();
+  }
+
+  private checkActive(): void {
+    if (this.ctx === 0) {
+      throw new Error('Cipher has already been finalized');
+    }
+  }
+
+  private releaseWindows(): void {
+    if (this.inWindow !== 0) {
+      // Plaintext may still be sitting in either window
+      this.instance.HEAPU8.fill(0, this.inWindow, this.tagPtr);
+      this.instance._free(this.inWindow);
+      this.inWindow = 0;
+      this.outWindow = 0;
+      this.outLenPtr = 0;
+      this.tagPtr = 0;
+    }
+  }
+}
@@ -0,0 +1,227 @@
+/**
+ * Opt-in tracking of handles that own native memory
+ */
+
+/**
+ * One handle that has not been released
+ */
+export interface LiveHandle {
+  /**
+   * Class of the handle, e.g. 'Hash' or 'KeyHandle'
+   */
+  kind: string;
+  /**
+   * Method that created it, e.g. 'createHash'
+   */
+  createdBy: string;
+  /**
+   * Growth of the allocator's in-use bytes while it was created
+   */
+  bytes: number;
+  /**
+   * performance.now() at creation
+   */
+  createdAt: number;
+  /**
+   * Whether the handle frees its native memory itself when it is garbage
+   * collected, as KeyHandle does. Other handles' memory stays allocated
+   * until OpenSSL.cleanup() once they are collected unreleased.
+   */
+  freedOnCollect: boolean;
+  /**
+   * Stack at creation, when the stacks option is set
+   */
+  stack?: string;
+}
+
+export interface HandleTotals {
+  count: number;
+  bytes: number;
+}
+
+export interface HandleReport extends HandleTotals {
+  /**
+   * Totals per handle kind
+   */
+  byKind: Record<string, HandleTotals>;
+  handles: LiveHandle[];
+}
+
+export interface HandleTrackingOptions {
+  /**
+   * Record the creation stack of every handle (default: false)
+   */
+  stacks?: boolean;
+  /**
+   * Called when a handle is garbage collected without having been released
+   * (default: console.warn). Unless the handle's freedOnCollect is set, its
+   * native memory stays allocated until OpenSSL.cleanup().
+   */
+  onLeak?: (handle: LiveHandle) => void;
+}
+
+/**
+ * How a factory method's result is released
+ */
+interface HandleKind {
+  kind: string;
+  release: string[];
+  freedOnCollect?: boolean;
+}
+
+/**
+ * OpenSSL methods that return a handle, and the handle methods that
+ * release it
+ */
+export const HANDLE_FACTORIES: Record<string, HandleKind> = {
+  alloc: { kind: 'HeapBuffer', release: ['dispose'] },
+  createHash: { kind: 'Hash', release: ['digest', 'dispose'] },
+  createHmacKey: { kind: 'HmacKey', release: ['dispose'] },
+  createChunker: { kind: 'Chunker', release: ['final', 'dispose'] },
+  createCipher: { kind: 'Cipher', release: ['final', 'finalInto', 'dispose'] },
+  createDecipher: { kind: 'Cipher', release: ['final', 'finalInto', 'dispose'] },
+  createBase64Encoder: { kind: 'Base64Encoder', release: ['final', 'dispose'] },
+  createBase64Decoder: { kind: 'Base64Decoder', release: ['final', 'dispose'] },
+  generateKey: { kind: 'KeyHandle', release: ['dispose'], freedOnCollect: true },
+  importPrivateKey: { kind: 'KeyHandle', release: ['dispose'], freedOnCollect: true },
+  importPublicKey: { kind: 'KeyHandle', release: ['dispose'], freedOnCollect: true },
+  importRawPublicKey: { kind: 'KeyHandle', release: ['dispose'], freedOnCollect: true },
+  createTrustStore: { kind: 'TrustStore', release: ['dispose'] },
+  createTlsContext: { kind: 'TlsContext', release: ['dispose'] }
+};
+
+/**
+ * Registry of the live handles of one OpenSSL instance.
+ *
+ * Created only when the trackHandles option is set; otherwise no factory
+ * is wrapped. When enabled, every handle returned by a method in
+ * HANDLE_FACTORIES is recorded until one of its release methods is called,
+ * and a FinalizationRegistry reports handles that are garbage collected
+ * while still live. The registry holds no reference to the handles
+ * themselves. Measuring bytes samples the allocator twice per handle, which
+ * walks the heap, so this is a debugging aid rather than something to leave
+ * on in production.
+ */
+export class HandleRegistry {
+  private live = new Map<object, LiveHandle>();
+  private tokens = new WeakMap<object, object>();
+  private finalizer: FinalizationRegistry<object> | null;
+  private stacks: boolean;
+  private inUse: () => number;
+
+  /**
+   * Constructor - should not be called directly, enable with the trackHandles option instead
+   */
+  constructor(inUse: () => number, options: HandleTrackingOptions = {}) {
+    this.inUse = inUse;
+    this.stacks = options.stacks ?? false;
+    const onLeak = options.onLeak ?? ((handle: LiveHandle) => {
+      const outcome = handle.freedOnCollect ? 'freed by the collector' : 'held until cleanup()';
+      console.warn(`openssl-wasm-js: ${handle.kind} from ${handle.createdBy}() was garbage collected without being released (${handle.bytes} bytes, ${outcome})`, handle.stack ?? '');
+    });
+
+    this.finalizer = typeof FinalizationRegistry === 'function'
+      ? new FinalizationRegistry<object>(token => {
+          const entry = this.live.get(token);
+          if (entry) {
+            this.live.delete(token);
+            onLeak(entry);
+          }
+        })
+      : null;
+  }
+
+  /**
+   * Record the handles returned by the factory methods of target, an
+   * OpenSSL instance
+   */
+  attachFactories(target: object): void {
+    const methods = target as Record<string, Function>;
+    for (const [name, spec] of Object.entries(HANDLE_FACTORIES)) {
+      const method = methods[name];
+      if (typeof method !== 'function') {
+        continue;
+      }
+      const registry = this;
+      methods[name] = function (this: unknown, ...args: unknown[]) {
+        const before = registry.inUse();
+        const handle = method.apply(this, args);
+        registry.track(handle, name, spec, registry.inUse() - before);
+        return handle;
+      };
+    }
+  }
+
+  /**
+   * Handles created and not yet released
+   */
+  report(): HandleReport {
+    const byKind: Record<string, HandleTotals> = {};
+    const handles = Array.from(this.live.values());
+    let bytes = 0;
+    for (const handle of handles) {
+      const totals = byKind[handle.kind] ?? (byKind[handle.kind] = { count: 0, bytes: 0 });
+      totals.count++;
+      totals.bytes += handle.bytes;
+      bytes += handle.bytes;
+    }
+    return { count: handles.length, bytes, byKind, handles: handles.map(handle => ({ ...handle })) };
+  }
+
+  /**
+   * Number of handles created and not yet released
+   */
+  get size(): number {
+    return this.live.size;
+  }
+
+  /**
+   * Forget every handle, e.g. once the instance has been cleaned up
+   */
+  clear(): void {
+    this.live.clear();
+  }
+
+  private track(handle: unknown, createdBy: string, spec: HandleKind, bytes: number): void {
+    if (typeof handle !== 'object' || handle === null) {
+      return;
+    }
+
+    const token = {};
+    this.live.set(token, {
+      kind: spec.kind,
+      createdBy,
+      bytes: Math.max(bytes, 0),
+      createdAt: performance.now(),
+      freedOnCollect: spec.freedOnCollect ?? false,
+      stack: this.stacks ? new Error().stack : undefined
+    });
+    this.tokens.set(handle, token);
+    this.finalizer?.register(handle, token, token);
+
+    const methods = handle as Record<string, Function>;
+    for (const name of spec.release) {
+      const release = methods[name];
+      if (typeof release !== 'function') {
+        continue;
+      }
+      const registry = this;
+      methods[name] = function (this: unknown, ...args: unknown[]) {
+        try {
+          return release.apply(this, args);
+        } finally {
+          registry.untrack(handle);
+        }
+      };
+    }
+  }
+
+  private untrack(handle: object): void {
+    const token = this.tokens.get(handle);
+    if (token !== undefined) {
+      this.tokens.delete(handle);
+      this.live.delete(token);
+      this.finalizer?.unregister(token);
+    }
+  }
+}
@@ -0,0 +1,191 @@
+/**
+ * Streaming digest support
+ */
+
+import type { OpenSSLWasmInstance } from './index';
+import { HeapBuffer } from './heap';
+
+/**
+ * Size of the heap window used to feed data to a streaming digest.
+ * Inputs larger than this are hashed window by window, so the WASM heap
+ * never holds more than one window of input per Hash object.
+ */
+export const HASH_WINDOW_SIZE = 64 * 1024;
+
+// Largest digest OpenSSL produces (EVP_MAX_MD_SIZE)
+const MAX_DIGEST_LENGTH = 64;
+
+/**
+ * Wrapped glue functions used by Hash
+ */
+export interface DigestFunctions {
+  init: (namePtr: string) => number;
+  update: (ctx: number, dataPtr: number, dataLen: number) => number;
+  final: (ctx: number, mdPtr: number, mdLenPtr: number) => number;
+  size: (ctx: number) => number;
+  free: (ctx: number) => void;
+  error: () => string;
+}
+
+/**
+ * Create the digest function wrappers for a module instance
+ */
+export function wrapDigestFunctions(instance: OpenSSLWasmInstance): DigestFunctions {
+  return {
+    init: instance.cwrap('digest_init', 'number', ['string']) as DigestFunctions['init'],
+    update: instance.cwrap('digest_update', 'number', ['number', 'number', 'number']) as DigestFunctions['update'],
+    final: instance.cwrap('digest_final', 'number', ['number', 'number', 'number']) as DigestFunctions['final'],
+    size: instance.cwrap('digest_size', 'number', ['number']) as DigestFunctions['size'],
+    free: instance.cwrap('evp_md_ctx_free', 'void', ['number']) as DigestFunctions['free'],
+    error: instance.cwrap('get_error_string', 'string', []) as DigestFunctions['error']
+  };
+}
+
+/**
+ * Incremental hash over a persistent EVP_MD_CTX.
+ *
+ * Created with OpenSSL.createHash(). Feed data with update() and finish with
+ * digest(); the native context is released by digest() or dispose().
+ */
+export class Hash {
+  private instance: OpenSSLWasmInstance;
+  private fns: DigestFunctions;
+  private ctx: number;
+  private window: number = 0;
+  private windowSize: number = 0;
+
+  /**
+   * Digest length in bytes
+   */
+  readonly digestLength: number;
+
+  /**
+   * Constructor - should not be called directly, use OpenSSL.createHash() instead
+   */
+  constructor(instance: OpenSSLWasmInstance, fns: DigestFunctions, algorithm: string) {
+    this.instance = instance;
+    this.fns = fns;
+
+    this.ctx = this.fns.init(algorithm);
+    if (this.ctx === 0) {
+      throw new Error(`Unsupported digest algorithm: ${algorithm}`);
+    }
+
+    this.digestLength = this.fns.size(this.ctx);
+  }
+
+  /**
+   * Feed more data into the hash. A HeapBuffer is hashed where it is,
+   * without copying.
+   */
+  update(data: Uint8Array | string | HeapBuffer): this {
+    if (this.ctx === 0) {
+      throw new Error('Hash has already been finalized');
+    }
+
+    if (data instanceof HeapBuffer) {
+      data.checkRange(data.length);
+      if (this.fns.update(this.ctx, data.ptr, data.length) !== 1) {
+        this.dispose();
+        throw new Error(`Digest update failed: ${this.fns.error()}`);
+      }
+      return this;
+    }
+
+    const inputData = typeof data === 'string' ? new TextEncoder().encode(data) : data;
+    this.ensureWindow(Math.min(inputData.length, HASH_WINDOW_SIZE));
+
+    for (let offset = 0; offset < inputData.length; offset += this.windowSize) {
+      const chunk = inputData.subarray(offset, offset + this.windowSize);
+      this.instance.HEAPU8.set(chunk, this.window);
+
+      if (this.fns.update(this.ctx, this.window, chunk.length) !== 1) {
+        this.dispose();
+        throw new Error(`Digest update failed: ${this.fns.error()}`);
+      }
+    }
+
+    return this;
+  }
+
+  /**
+   * Feed every chunk of a stream (e.g. File.stream()) into the hash
+   */
+  async updateStream(stream: ReadableStream<Uint8Array>): Promise<this> {
+    const reader = stream.getReader();
+    try {
+      for (;;) {
+        const { done, value } = await reader.read();
+        if (done) break;
+        this.update(value);
+      }
+    } finally {
+      reader.releaseLock();
+    }
+    return this;
+  }
+
+  /**
+   * Finish the hash and return the digest. The Hash cannot be used afterwards.
+   */
+  digest(): Uint8Array {
+    if (this.ctx === 0) {
+      throw new Error('Hash has already been finalized');
+    }
+
+    this.ensureWindow(MAX_DIGEST_LENGTH + 4);
+    const mdPtr = this.window;
+    const mdLenPtr = this.window + MAX_DIGEST_LENGTH;
+
+    const result = this.fns.final(this.ctx, mdPtr, mdLenPtr);
+    this.ctx = 0;
+
+    try {
+      if (result !== 1) {
+        throw new Error(`Digest final failed: ${this.fns.error()}`);
+      }
+
+      const mdLen = this.instance.getValue(mdLenPtr, 'i32');
+      const output = new Uint8Array(mdLen);
+      output.set(new Uint8Array(this.instance.HEAPU8.buffer, mdPtr, mdLen));
+      return output;
+    } finally {
+      this.releaseWindow();
+    }
+  }
+
+  /**
+   * Release the native context without producing a digest
+   */
+  dispose(): void {
+    if (this.ctx !== 0) {
+      this.fns.free(this.ctx);
+      this.ctx = 0;
+    }
+    this.releaseWindow();
+  }
+
+  private ensureWindow(size: number): void {
+    if (this.windowSize >= size && this.window !== 0) {
+      return;
+    }
+
+    // Never shrink below what digest() needs, so one window serves both
+    const windowSize = Math.max(size, MAX_DIGEST_LENGTH + 4, this.windowSize);
+    this.releaseWindow();
+
+    this.window = this.instance._malloc(windowSize);
+    if (this.window === 0) {
+      throw new Error('Failed to allocate digest buffer');
+    }
+    this.windowSize = windowSize;
+  }
+
+  private releaseWindow(): void {
+    if (this.window !== 0) {
+      this.instance._free(this.window);
+      this.window = 0;
+      this.windowSize = 0;
+    }
+  }
+}
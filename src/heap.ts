@@ -0,0 +1,108 @@
+/**
+ * Caller-owned buffers in the WASM heap
+ */
+
+import type { OpenSSLWasmInstance } from './index';
+
+/**
+ * A region of the WASM heap owned by the caller.
+ *
+ * Created with OpenSSL.alloc(). Fill it through view, then pass it to the
+ * methods that take a HeapBuffer (digestHeap, sealInPlace, openInPlace,
+ * aesEncryptInPlace, aesDecryptInPlace, Hash.update), which work on the
+ * memory directly instead of copying through the scratch arena. Results of
+ * the in-place methods are views of the same memory.
+ *
+ * Memory growth replaces the heap's ArrayBuffer and detaches every view
+ * made before it, including returned results. view always returns a view
+ * of the current heap, so read it again after any call into the module
+ * rather than keeping one. The memory stays allocated until dispose() or
+ * OpenSSL.cleanup().
+ */
+export class HeapBuffer {
+  /**
+   * Address of the region in the heap
+   */
+  readonly ptr: number;
+  /**
+   * Size of the region in bytes
+   */
+  readonly length: number;
+  private instance: OpenSSLWasmInstance;
+  private released: ((buffer: HeapBuffer) => void) | null;
+  private cached: Uint8Array | null = null;
+
+  /**
+   * Constructor - should not be called directly, use OpenSSL.alloc() instead
+   */
+  constructor(instance: OpenSSLWasmInstance, ptr: number, length: number, released: (buffer: HeapBuffer) => void) {
+    this.instance = instance;
+    this.ptr = ptr;
+    this.length = length;
+    this.released = released;
+  }
+
+  /**
+   * Whether dispose() has been called
+   */
+  get disposed(): boolean {
+    return this.released === null;
+  }
+
+  /**
+   * View of the whole region over the current heap
+   */
+  get view(): Uint8Array {
+    this.checkLive();
+    const heap = this.instance.HEAPU8.buffer;
+    if (this.cached === null || this.cached.buffer !== heap) {
+      this.cached = new Uint8Array(heap, this.ptr, this.length);
+    }
+    return this.cached;
+  }
+
+  /**
+   * View of part of the region over the current heap
+   */
+  subarray(begin?: number, end?: number): Uint8Array {
+    return this.view.subarray(begin, end);
+  }
+
+  /**
+   * Copy data into the region at offset
+   */
+  set(data: ArrayLike<number>, offset: number = 0): void {
+    this.view.set(data, offset);
+  }
+
+  /**
+   * Zero the region and return it to the heap. Views of it must not be used
+   * afterwards.
+   */
+  dispose(): void {
+    if (this.released === null) {
+      return;
+    }
+    this.instance.HEAPU8.fill(0, this.ptr, this.ptr + this.length);
+    this.instance._free(this.ptr);
+    this.released(this);
+    this.released = null;
+    this.cached = null;
+  }
+
+  /**
+   * Throw unless the first length bytes of the region exist and are live
+   */
+  checkRange(length: number, what: string = 'Data'): void {
+    this.checkLive();
+    if (!Number.isInteger(length) || length < 0 || length > this.length) {
+      throw new Error(`${what} length ${length} is outside the ${this.length} byte buffer`);
+    }
+  }
+
+  private checkLive(): void {
+    if (this.released === null) {
+      throw new Error('HeapBuffer has been disposed');
+    }
+  }
+}
@@ -0,0 +1,159 @@
+/**
+ * Keyed HMAC with reusable key schedule
+ */
+
+import type { OpenSSLWasmInstance } from './index';
+import type { ScratchArena } from './arena';
+import { Hash, DigestFunctions } from './hash';
+
+/**
+ * Wrapped HMAC glue functions
+ */
+export interface HmacFunctions {
+  init: (name: string, keyPtr: number, keyLen: number) => number;
+  dup: (ctx: number) => number;
+  update: (ctx: number, dataPtr: number, dataLen: number) => number;
+  final: (ctx: number, mdPtr: number, mdLenPtr: number) => number;
+  size: (ctx: number) => number;
+  batch: (ctx: number, ptrsPtr: number, lensPtr: number, count: number, outPtr: number) => number;
+  free: (ctx: number) => void;
+  error: () => string;
+}
+
+/**
+ * Create the HMAC function wrappers for a module instance
+ */
+export function wrapHmacFunctions(instance: OpenSSLWasmInstance): HmacFunctions {
+  return {
+    init: instance.cwrap('hmac_init', 'number', ['string', 'number', 'number']) as HmacFunctions['init'],
+    dup: instance.cwrap('hmac_dup', 'number', ['number']) as HmacFunctions['dup'],
+    update: instance.cwrap('hmac_update', 'number', ['number', 'number', 'number']) as HmacFunctions['update'],
+    final: instance.cwrap('hmac_final', 'number', ['number', 'number', 'number']) as HmacFunctions['final'],
+    size: instance.cwrap('hmac_size', 'number', ['number']) as HmacFunctions['size'],
+    batch: instance.cwrap('hmac_batch', 'number', ['number', 'number', 'number', 'number', 'number']) as HmacFunctions['batch'],
+    free: instance.cwrap('hmac_free', 'void', ['number']) as HmacFunctions['free'],
+    error: instance.cwrap('get_error_string', 'string', []) as HmacFunctions['error']
+  };
+}
+
+/**
+ * HMAC key with its inner and outer pad state computed once.
+ *
+ * Created with OpenSSL.createHmacKey(). Every message MACed with the key
+ * starts from the keyed state, so the key is never processed again. The
+ * native context holds key material; call dispose() when done.
+ */
+export class HmacKey {
+  private instance: OpenSSLWasmInstance;
+  private fns: HmacFunctions;
+  private arena: ScratchArena;
+  private ctx: number = 0;
+  private encoder = new TextEncoder();
+
+  /**
+   * MAC length in bytes
+   */
+  readonly digestLength: number;
+
+  /**
+   * Digest algorithm the key was created for
+   */
+  readonly algorithm: string;
+
+  /**
+   * Constructor - should not be called directly, use OpenSSL.createHmacKey() instead
+   */
+  constructor(instance: OpenSSLWasmInstance, fns: HmacFunctions, arena: ScratchArena, algorithm: string, key: Uint8Array | string) {
+    this.instance = instance;
+    this.fns = fns;
+    this.arena = arena;
+    this.algorithm = algorithm;
+
+    const keyData = typeof key === 'string' ? this.encoder.encode(key) : key;
+    const mark = arena.mark();
+    try {
+      const keyPtr = arena.copyIn(keyData);
+      this.ctx = fns.init(algorithm, keyPtr, keyData.length);
+      arena.heapU8.fill(0, keyPtr, keyPtr + keyData.length);
+    } finally {
+      arena.release(mark);
+    }
+
+    if (this.ctx === 0) {
+      throw new Error(`Unsupported digest algorithm: ${algorithm}`);
+    }
+
+    this.digestLength = fns.size(this.ctx);
+  }
+
+  /**
+   * MAC one message
+   */
+  hmac(data: Uint8Array | string): Uint8Array {
+    return this.hmacMany([data]);
+  }
+
+  /**
+   * MAC many messages with one call into the module.
+   *
+   * Returns the MACs concatenated in input order; the MAC of message i is at
+   * offset i * digestLength.
+   */
+  hmacMany(messages: Array<Uint8Array | string>): Uint8Array {
+    this.checkOpen();
+
+    const count = messages.length;
+    const inputs = messages.map(m => typeof m === 'string' ? this.encoder.encode(m) : m);
+    const arena = this.arena;
+    const mark = arena.mark();
+
+    try {
+      const { ptrsPtr, lensPtr } = arena.packMessages(inputs);
+      const outPtr = arena.alloc(count * this.digestLength);
+
+      const result = this.fns.batch(this.ctx, ptrsPtr, lensPtr, count, outPtr);
+      if (result !== 1) {
+        throw new Error(`HMAC failed: ${this.fns.error()}`);
+      }
+
+      return arena.copyOut(outPtr, count * this.digestLength);
+    } finally {
+      arena.release(mark);
+    }
+  }
+
+  /**
+   * Start a streaming HMAC of one message, cloned from the keyed state.
+   * Feed it with update() and finish with digest(), as with createHash().
+   */
+  createHmac(): Hash {
+    this.checkOpen();
+
+    const ctx = this.ctx;
+    const fns: DigestFunctions = {
+      init: () => this.fns.dup(ctx),
+      update: this.fns.update,
+      final: this.fns.final,
+      size: this.fns.size,
+      free: this.fns.free,
+      error: this.fns.error
+    };
+    return new Hash(this.instance, fns, `HMAC-${this.algorithm}`);
+  }
+
+  /**
+   * Free the keyed context. Streaming HMACs already created stay usable.
+   */
+  dispose(): void {
+    if (this.ctx !== 0) {
+      this.fns.free(this.ctx);
+      this.ctx = 0;
+    }
+  }
+
+  private checkOpen(): void {
+    if (this.ctx === 0) {
+      throw new Error('HmacKey has been disposed');
+    }
+  }
+}
@@ -3,8 +3,32 @@
  * A minimal JavaScript and WebAssembly port of OpenSSL for web browsers
  */
 
-// Import the WebAssembly module
-import OpenSSLWasmModule from '../dist/openssl-wasm';
+// Import the WebAssembly module loader
+import { WasmVariant, WasmTier, selectVariant, selectTier, loadWasmModule, compileWasmModule, clearWasmCache, supportsWasmSimd } from './loader';
+import { Hash, DigestFunctions, wrapDigestFunctions } from './hash';
+import { Cipher, CipherFunctions, CipherOptions, wrapCipherFunctions, checkAesParameters, aesCbcName, MAX_BLOCK_SIZE, AEAD_TAG_LENGTH, AES_BLOCK_SIZE } from './cipher';
+import { ScratchArena, DEFAULT_SCRATCH_SIZE, DEFAULT_SCRATCH_HIGH_WATER_MARK } from './arena';
+import { TreeHashFunctions, TreeHashOptions, TreeHashResult, wrapTreeHashFunctions, checkChunkSize, leafCount, TREE_WINDOW_SIZE } from './tree';
+import { HmacKey, HmacFunctions, wrapHmacFunctions } from './hmac';
+import { Chunker, ChunkerFunctions, ChunkerOptions, ChunkRecord, wrapChunkerFunctions, unpackChunks, CHUNK_RECORD_HEADER } from './chunker';
+import { Base64Encoder, Base64Decoder, Base64Functions, wrapBase64Functions, base64EncodedLength, base64DecodedLength, padBase64, readAscii, writeAscii } from './base64';
+import { KeyHandle, KeyPair, KeyPairOptions, KeyType, KeygenProgress, SignOptions, EncryptOptions, PkeyFunctions, wrapPkeyFunctions, generatePkey, exportKeyPair, readKey, keyTypeName, isVerified, KeyData, ExportKeyOptions } from './pkey';
+import { KeyCache, DEFAULT_KEY_CACHE_SIZE } from './keycache';
+import { KeyGenerator, KeyGeneratorOptions, GenerateKeyPairOptions } from './keygen';
+import { TlsContext, TlsConnection, TlsContextOptions, TlsConnectOptions, TlsFunctions, wrapTlsFunctions } from './tls';
+import { TrustStore, TrustStoreOptions, TrustFunctions, CertificateData, VerifyChainOptions, VerifyChainResult, wrapTrustFunctions } from './trust';
+import { TlsSessionCache, MemorySessionCache, IndexedDBSessionCache, IndexedDBSessionCacheOptions } from './session';
+import { WorkerPool, WorkerPoolOptions, PooledMethod, PooledOpenSSL } from './pool';
+import { KdfFunctions, Pbkdf2Options, HkdfOptions, ScryptOptions, wrapKdfFunctions, pbkdf2, hkdf, scrypt } from './kdf';
+import { Metrics, MetricsOptions, MetricsSink, MetricsSnapshot, OperationEvent, OperationTotals, FunctionTotals, performanceSink } from './metrics';
+import { RandomPool, DEFAULT_RANDOM_POOL_SIZE, RANDOM_POOL_MAX_REQUEST } from './random';
+import { HeapBuffer } from './heap';
+import { HandleRegistry, HandleTrackingOptions, HandleReport, HandleTotals, LiveHandle } from './handles';
+import { HashTransformStream, CipherTransformStream, base64EncodeStream, base64DecodeStream, STREAM_BLOCK_SIZE } from './streams';
+import { WebCryptoDispatcher, WebCryptoOptions, Crossovers, OffloadOperation, BenchmarkReport, crossoversFromBenchmark } from './webcrypto';
+
+export { Hash, Cipher, Chunker, unpackChunks, CHUNK_RECORD_HEADER, HmacKey, KeyHandle, HeapBuffer, HashTransformStream, CipherTransformStream, STREAM_BLOCK_SIZE, isVerified, Base64Encoder, Base64Decoder, WorkerPool, KeyGenerator, TrustStore, TlsContext, TlsConnection, MemorySessionCache, IndexedDBSessionCache, Metrics, HandleRegistry, WebCryptoDispatcher, crossoversFromBenchmark, performanceSink, supportsWasmSimd, compileWasmModule, clearWasmCache };
+export type { KeyData, ExportKeyOptions, KeyPair, KeyPairOptions, KeyType, KeygenProgress, SignOptions, EncryptOptions, KeyGeneratorOptions, GenerateKeyPairOptions, CipherOptions, TreeHashOptions, TreeHashResult, ChunkerOptions, ChunkRecord, WasmVariant, WasmTier, WorkerPoolOptions, PooledMethod, PooledOpenSSL, TlsContextOptions, TlsConnectOptions, TlsSessionCache, IndexedDBSessionCacheOptions, CertificateData, TrustStoreOptions, VerifyChainOptions, VerifyChainResult, Pbkdf2Options, HkdfOptions, ScryptOptions, MetricsOptions, MetricsSink, MetricsSnapshot, OperationEvent, OperationTotals, FunctionTotals, HandleTrackingOptions, HandleReport, HandleTotals, LiveHandle, WebCryptoOptions, Crossovers, OffloadOperation, BenchmarkReport, MemoryStats, RecycleOptions };
 
 // Type definitions
 export interface OpenSSLWasmInstance {
@@ -17,11 +41,137 @@ export interface OpenSSLWasmInstance {
   _malloc: (size: number) => number;
   _free: (ptr: number) => void;
   HEAPU8: Uint8Array;
+  onKeygenProgress?: KeygenProgress;
+}
+
+export interface OpenSSLOptions {
+  /**
+   * Initial size in bytes of the scratch arena reused across calls
+   */
+  scratchSize?: number;
+  /**
+   * Largest size in bytes the scratch arena may grow to. Larger inputs fall
+   * back to a one-off allocation that is freed when the call returns.
+   */
+  scratchHighWaterMark?: number;
+  /**
+   * Load the SIMD128 build. Defaults to 'auto', which uses it only when the
+   * runtime supports WebAssembly SIMD; `true` throws where it is unsupported.
+   */
+  simd?: boolean | 'auto';
+  /**
+   * Load the smallest build that covers these tiers instead of the full one,
+   * e.g. ['hash'] for digests, HMAC and KDFs only. Methods outside the loaded
+   * tier throw when called.
+   */
+  features?: WasmTier[];
+  /**
+   * Compiled module to instantiate instead of fetching and compiling one,
+   * e.g. from compileWasmModule() on another thread. It must match the
+   * selected variant and tier.
+   */
+  wasmModule?: WebAssembly.Module;
+  /**
+   * Keep the .wasm file in this Cache API cache across page loads (default:
+   * true, using the 'openssl-wasm-js' cache; false disables it)
+   */
+  wasmCache?: boolean | string;
+  /**
+   * Return the instance shared by every initialize() call with the same
+   * options that also sets shared: true (default: false, a private instance
+   * with its own heap). Ignored when wasmModule is given.
+   */
+  shared?: boolean;
+  /**
+   * Number of parsed keys kept by loadPrivateKey() and loadPublicKey()
+   * (default: 64; 0 disables the cache)
+   */
+  keyCacheSize?: number;
+  /**
+   * Size in bytes of the buffer that small randomBytes() requests are served
+   * from (default: 4096; 0 calls RAND_bytes for every request)
+   */
+  randomPoolSize?: number;
+  /**
+   * Count calls, bytes, copies, allocations, memory growth and time per
+   * operation, readable through openssl.metrics. Off by default, in which
+   * case nothing is instrumented.
+   */
+  metrics?: boolean | MetricsOptions;
+  /**
+   * Record every handle that owns native memory until it is released,
+   * readable through liveHandles(), and report handles garbage collected
+   * without being released. Off by default.
+   */
+  trackHandles?: boolean | HandleTrackingOptions;
+  /**
+   * Inputs larger than this many bytes are processed window by window by
+   * the one-shot methods (sha256(), hmac(), aesEncrypt(), seal(),
+   * base64Encode(), ...) instead of being copied into the heap whole
+   * (default: scratchHighWaterMark, and at least 1 MiB)
+   */
+  streamingThreshold?: number;
+  /**
+   * Route digests, AES-GCM, HKDF and PBKDF2 to crypto.subtle from the sizes
+   * at which it was measured to be faster, through openssl.webCrypto. Off
+   * by default; without crossover points everything stays on OpenSSL.
+   */
+  webCrypto?: boolean | WebCryptoOptions;
+}
+
+/**
+ * Allocator statistics from memoryStats()
+ */
+export interface MemoryStats {
+  /**
+   * Size of the WASM linear memory
+   */
+  heapSize: number;
+  /**
+   * Bytes of linear memory the allocator has taken
+   */
+  allocated: number;
+  /**
+   * Bytes in live allocations
+   */
+  inUse: number;
+  /**
+   * Bytes free inside the allocator's memory
+   */
+  free: number;
+  /**
+   * Part of free that is scattered between live allocations rather than at
+   * the top of the heap, as a fraction of allocated (0 to 1)
+   */
+  fragmentation: number;
+  /**
+   * Size of the scratch arena
+   */
+  scratchSize: number;
+  /**
+   * Live heap buffers, plus every other live handle when trackHandles is set
+   */
+  liveHandles: number;
+}
+
+export interface RecycleOptions {
+  /**
+   * Only recycle when memoryStats().fragmentation is at least this
+   * (default: 0, always recycle)
+   */
+  fragmentation?: number;
+  /**
+   * Only recycle when the heap is at least this many bytes (default: 0)
+   */
+  heapSize?: number;
 }
 
 export interface OpenSSLWasm {
   // Core functions
-  initialize(): Promise<OpenSSL>;
+  initialize(options?: OpenSSLOptions): Promise<OpenSSL>;
+  recycle(openssl: OpenSSL, options?: RecycleOptions): Promise<OpenSSL>;
+  createPool(options?: WorkerPoolOptions): Promise<WorkerPool>;
+  createKeyGenerator(options?: KeyGeneratorOptions): KeyGenerator;
 }
 
 /**
@@ -30,40 +180,97 @@ export interface OpenSSLWasm {
 export class OpenSSL {
   private instance: OpenSSLWasmInstance;
   private initialized: boolean = false;
+  /**
+   * Build variant backing this instance
+   */
+  readonly variant: WasmVariant;
+  /**
+   * Size tier of the loaded build
+   */
+  readonly tier: WasmTier;
+  /**
+   * Counters for this instance, or null unless the metrics option was set
+   */
+  readonly metrics: Metrics | null;
+  /**
+   * Async dispatcher between WebCrypto and this instance, or null unless the
+   * webCrypto option was set
+   */
+  readonly webCrypto: WebCryptoDispatcher | null;
+  private handles: HandleRegistry | null;
+  private streamingThreshold: number;
+  private statsPtr: number = 0;
+  private arena: ScratchArena;
+  private keyCache: KeyCache;
+  private randomPool: RandomPool | null;
+  private heapBuffers = new Set<HeapBuffer>();
+  private encoder = new TextEncoder();
+  private digestLengths = new Map<string, number>();
 
   // Function wrappers
   private _openssl_version: () => string;
   private _openssl_init: () => number;
   private _openssl_cleanup: () => void;
+  private _heap_stats: (outPtr: number) => void;
   private _random_bytes: (ptr: number, len: number) => number;
+  private _random_reseed: () => number;
   private _sha1_digest: (dataPtr: number, dataLen: number, mdPtr: number) => number;
   private _sha256_digest: (dataPtr: number, dataLen: number, mdPtr: number) => number;
   private _sha384_digest: (dataPtr: number, dataLen: number, mdPtr: number) => number;
   private _sha512_digest: (dataPtr: number, dataLen: number, mdPtr: number) => number;
   private _md5_digest: (dataPtr: number, dataLen: number, mdPtr: number) => number;
-  private _base64_encode: (inPtr: number, inLen: number, outLenPtr: number) => number;
-  private _base64_decode: (inPtr: number, inLen: number, outLenPtr: number) => number;
+  private _digest_length: (name: string) => number;
+  private _digest_batch: (name: string, ptrsPtr: number, lensPtr: number, count: number, outPtr: number) => number;
   private _get_error_string: () => number;
+  private digestFunctions: DigestFunctions;
+  private cipherFunctions: CipherFunctions;
+  private treeHashFunctions: TreeHashFunctions;
+  private chunkerFunctions: ChunkerFunctions;
+  private base64Functions: Base64Functions;
+  private hmacFunctions: HmacFunctions;
+  private kdfFunctions: KdfFunctions;
+  private pkeyFunctions: PkeyFunctions;
+  private tlsFunctions: TlsFunctions;
+  private trustFunctions: TrustFunctions;
 
   /**
    * Constructor - should not be called directly, use OpenSSLWasm.initialize() instead
    */
-  constructor(instance: OpenSSLWasmInstance) {
+  constructor(instance: OpenSSLWasmInstance, options: OpenSSLOptions = {}, variant: WasmVariant = 'baseline', tier: WasmTier = 'tls') {
     this.instance = instance;
+    this.variant = variant;
+    this.tier = tier;
+
+    // Instrumentation hooks cwrap, so it must be in place before any binding
+    this.metrics = options.metrics
+      ? new Metrics(instance, options.metrics === true ? {} : options.metrics)
+      : null;
     
     // Initialize function wrappers
     this._openssl_version = this.instance.cwrap('openssl_version', 'string', []);
     this._openssl_init = this.instance.cwrap('openssl_init', 'number', []);
     this._openssl_cleanup = this.instance.cwrap('openssl_cleanup', 'void', []);
+    this._heap_stats = this.instance.cwrap('heap_stats', 'void', ['number']);
     this._random_bytes = this.instance.cwrap('random_bytes', 'number', ['number', 'number']);
+    this._random_reseed = this.instance.cwrap('random_reseed', 'number', []);
     this._sha1_digest = this.instance.cwrap('sha1_digest', 'number', ['number', 'number', 'number']);
     this._sha256_digest = this.instance.cwrap('sha256_digest', 'number', ['number', 'number', 'number']);
     this._sha384_digest = this.instance.cwrap('sha384_digest', 'number', ['number', 'number', 'number']);
     this._sha512_digest = this.instance.cwrap('sha512_digest', 'number', ['number', 'number', 'number']);
     this._md5_digest = this.instance.cwrap('md5_digest', 'number', ['number', 'number', 'number']);
-    this._base64_encode = this.instance.cwrap('base64_encode', 'number', ['number', 'number', 'number']);
-    this._base64_decode = this.instance.cwrap('base64_decode', 'number', ['number', 'number', 'number']);
+    this._digest_length = this.instance.cwrap('digest_length', 'number', ['string']);
+    this._digest_batch = this.instance.cwrap('digest_batch', 'number', ['string', 'number', 'number', 'number', 'number']);
     this._get_error_string = this.instance.cwrap('get_error_string', 'string', []);
+    this.digestFunctions = wrapDigestFunctions(this.instance);
+    this.cipherFunctions = wrapCipherFunctions(this.instance);
+    this.treeHashFunctions = wrapTreeHashFunctions(this.instance);
+    this.chunkerFunctions = wrapChunkerFunctions(this.instance);
+    this.base64Functions = wrapBase64Functions(this.instance);
+    this.hmacFunctions = wrapHmacFunctions(this.instance);
+    this.kdfFunctions = wrapKdfFunctions(this.instance);
+    this.pkeyFunctions = wrapPkeyFunctions(this.instance);
+    this.tlsFunctions = wrapTlsFunctions(this.instance);
+    this.trustFunctions = wrapTrustFunctions(this.instance);
     
     // Initialize OpenSSL
     const result = this._openssl_init();
@@ -71,9 +278,86 @@ export class OpenSSL {
       throw new Error('Failed to initialize OpenSSL');
     }
     
+    this.arena = new ScratchArena(
+      this.instance,
+      options.scratchSize ?? DEFAULT_SCRATCH_SIZE,
+      options.scratchHighWaterMark ?? DEFAULT_SCRATCH_HIGH_WATER_MARK
+    );
+    // A small arena limits what is kept between calls, not what a call may
+    // copy in, so it does not lower the default threshold
+    this.streamingThreshold = options.streamingThreshold
+      ?? Math.max(DEFAULT_SCRATCH_HIGH_WATER_MARK, options.scratchHighWaterMark ?? 0, this.arena.size);
+    this.metrics?.attachArena(this.arena);
+    this.keyCache = new KeyCache(this.pkeyFunctions, this.arena, options.keyCacheSize ?? DEFAULT_KEY_CACHE_SIZE, data => this.sha256(data));
+    const randomPoolSize = options.randomPoolSize ?? DEFAULT_RANDOM_POOL_SIZE;
+    this.randomPool = randomPoolSize === 0
+      ? null
+      : new RandomPool(this.instance, this._random_bytes, () => String(this._get_error_string()), randomPoolSize);
+    this.metrics?.attachOperations(this, operationNames());
+    this.handles = options.trackHandles
+      ? new HandleRegistry(() => this.readHeapStats()[1], options.trackHandles === true ? {} : options.trackHandles)
+      : null;
+    this.handles?.attachFactories(this);
+    this.webCrypto = options.webCrypto
+      ? new WebCryptoDispatcher(this, options.webCrypto === true ? {} : options.webCrypto)
+      : null;
     this.initialized = true;
   }
 
+  /**
+   * Current size of the WASM heap in bytes. The heap grows on demand and
+   * never shrinks.
+   */
+  get heapSize(): number {
+    return this.instance.HEAPU8.byteLength;
+  }
+
+  /**
+   * Sample the allocator. This walks the heap, so call it occasionally (for
+   * example on an idle timer) rather than per operation.
+   */
+  memoryStats(): MemoryStats {
+    const [allocated, inUse, free, top] = this.readHeapStats();
+    return {
+      heapSize: this.instance.HEAPU8.byteLength,
+      allocated,
+      inUse,
+      free,
+      fragmentation: allocated > 0 ? (free - top) / allocated : 0,
+      scratchSize: this.arena.size,
+      liveHandles: this.liveHandleCount()
+    };
+  }
+
+  /**
+   * Handles created and not yet released, with the native bytes each one
+   * allocated. Requires the trackHandles option.
+   */
+  liveHandles(): HandleReport {
+    if (!this.handles) {
+      throw new Error('Handle tracking is off; initialize with trackHandles: true');
+    }
+    return this.handles.report();
+  }
+
+  /**
+   * Allocate a buffer in the WASM heap that the in-place methods read and
+   * write directly. The caller owns it and should dispose() it; any still
+   * live are freed by cleanup().
+   */
+  alloc(length: number): HeapBuffer {
+    if (!Number.isInteger(length) || length < 0) {
+      throw new Error('Buffer length must be a non-negative integer');
+    }
+    const ptr = this.instance._malloc(Math.max(length, 1));
+    if (ptr === 0) {
+      throw new Error(`Failed to allocate ${length} bytes`);
+    }
+    const buffer = new HeapBuffer(this.instance, ptr, length, released => this.heapBuffers.delete(released));
+    this.heapBuffers.add(buffer);
+    return buffer;
+  }
+
   /**
    * Get the OpenSSL version string
    */
@@ -82,31 +366,85 @@ export class OpenSSL {
   }
 
   /**
-   * Clean up OpenSSL resources
+   * Clean up OpenSSL resources. A shared instance is cleaned up for every
+   * caller that received it.
    */
   cleanup(): void {
     if (this.initialized) {
+      this.keyCache.clear();
+      this.randomPool?.dispose();
+      for (const buffer of Array.from(this.heapBuffers)) {
+        buffer.dispose();
+      }
+      this.handles?.clear();
+      if (this.statsPtr !== 0) {
+        this.instance._free(this.statsPtr);
+        this.statsPtr = 0;
+      }
+      this.arena.dispose();
       this._openssl_cleanup();
       this.initialized = false;
+      // The next initialize() with the same options starts a new instance
+      const key = sharedKeys.get(this);
+      if (key !== undefined) {
+        sharedInstances.delete(key);
+        sharedKeys.delete(this);
+      }
     }
   }
 
   /**
-   * Generate random bytes
+   * Generate random bytes.
+   *
+   * Requests of up to 256 bytes are served from a buffer of DRBG output
+   * that is refilled with a single RAND_bytes call; see randomInto().
    */
   randomBytes(length: number): Uint8Array {
-    const ptr = this.instance._malloc(length);
+    return this.randomInto(new Uint8Array(length));
+  }
+
+  /**
+   * Fill an existing array with random bytes and return it.
+   *
+   * Bytes served from the buffer were generated ahead of use. OpenSSL's
+   * DRBG reseeds itself from crypto.getRandomValues() after a fixed number
+   * of requests or a time interval, and a reseed applies from the next
+   * refill on. WebAssembly has no fork(), so each instance, including every
+   * worker in a WorkerPool, has its own independently seeded DRBG and
+   * buffer. Anything that duplicates a live heap does copy both, though:
+   * call reseedRandom() after restoring such a snapshot.
+   */
+  randomInto<T extends ArrayBufferView>(target: T): T {
+    const bytes = new Uint8Array(target.buffer, target.byteOffset, target.byteLength);
+    if (this.randomPool && bytes.length <= RANDOM_POOL_MAX_REQUEST) {
+      this.randomPool.take(bytes);
+      return target;
+    }
+
+    const arena = this.arena;
+    const mark = arena.mark();
     try {
-      const result = this._random_bytes(ptr, length);
+      const ptr = arena.alloc(bytes.length);
+      const result = this._random_bytes(ptr, bytes.length);
       if (result !== 1) {
         throw new Error(`Failed to generate random bytes: ${this._get_error_string()}`);
       }
-      
-      const output = new Uint8Array(length);
-      output.set(new Uint8Array(this.instance.HEAPU8.buffer, ptr, length));
-      return output;
+
+      bytes.set(arena.heapU8.subarray(ptr, ptr + bytes.length));
+      arena.heapU8.fill(0, ptr, ptr + bytes.length);
+      return target;
     } finally {
-      this.instance._free(ptr);
+      arena.release(mark);
+    }
+  }
+
+  /**
+   * Reseed the DRBG from the entropy source and discard buffered bytes
+   */
+  reseedRandom(): void {
+    this.randomPool?.discard();
+    if (this._random_reseed() !== 1) {
+      throw new Error(`Failed to reseed random generator: ${this._get_error_string()}`);
     }
   }
 
@@ -114,190 +452,790 @@ export class OpenSSL {
    * Calculate SHA-1 hash
    */
   sha1(data: Uint8Array | string): Uint8Array {
-    const inputData = typeof data === 'string' ? new TextEncoder().encode(data) : data;
-    const digestLength = 20; // SHA-1 digest length is 20 bytes
+    return this.oneShotDigest(this._sha1_digest, 'sha1', 'SHA-1', data, 20);
+  }
+
+  /**
+   * Calculate SHA-256 hash
+   */
+  sha256(data: Uint8Array | string): Uint8Array {
+    return this.oneShotDigest(this._sha256_digest, 'sha256', 'SHA-256', data, 32);
+  }
+
+  /**
+   * Calculate SHA-384 hash
+   */
+  sha384(data: Uint8Array | string): Uint8Array {
+    return this.oneShotDigest(this._sha384_digest, 'sha384', 'SHA-384', data, 48);
+  }
+
+  /**
+   * Calculate SHA-512 hash
+   */
+  sha512(data: Uint8Array | string): Uint8Array {
+    return this.oneShotDigest(this._sha512_digest, 'sha512', 'SHA-512', data, 64);
+  }
+
+  /**
+   * Calculate MD5 hash
+   */
+  md5(data: Uint8Array | string): Uint8Array {
+    return this.oneShotDigest(this._md5_digest, 'md5', 'MD5', data, 16);
+  }
+
+  /**
+   * Create a streaming hash for the named digest (e.g. 'sha256')
+   */
+  createHash(algorithm: string): Hash {
+    return new Hash(this.instance, this.digestFunctions, algorithm);
+  }
+
+  /**
+   * Hash a stream (e.g. File.stream()) chunk by chunk
+   */
+  async hashStream(algorithm: string, stream: ReadableStream<Uint8Array>): Promise<Uint8Array> {
+    const hash = this.createHash(algorithm);
+    try {
+      await hash.updateStream(stream);
+      return hash.digest();
+    } finally {
+      hash.dispose();
+    }
+  }
+
+  /**
+   * Create a TransformStream that hashes its input, for pipeThrough().
+   * The digest is the only output chunk unless passThrough is set, and
+   * resolves the stream's digest promise either way.
+   */
+  createHashStream(algorithm: string, options: { passThrough?: boolean } = {}): HashTransformStream {
+    return new HashTransformStream(this.createHash(algorithm), options.passThrough);
+  }
+
+  /**
+   * Hash many messages with one call into the module.
+   *
+   * Returns the digests concatenated in input order; the digest of message i
+   * is at offset i * digestLength.
+   */
+  hashMany(algorithm: string, messages: Array<Uint8Array | string>): Uint8Array {
+    const digestLength = this.digestLength(algorithm);
+    const count = messages.length;
+    const inputs = messages.map(m => typeof m === 'string' ? this.encoder.encode(m) : m);
     
-    const dataPtr = this.instance._malloc(inputData.length);
-    const digestPtr = this.instance._malloc(digestLength);
+    const arena = this.arena;
+    const mark = arena.mark();
     
     try {
-      this.instance.HEAPU8.set(inputData, dataPtr);
+      // Pack every message into one contiguous region
+      const { ptrsPtr, lensPtr } = arena.packMessages(inputs);
+      const outPtr = arena.alloc(count * digestLength);
       
-      const result = this._sha1_digest(dataPtr, inputData.length, digestPtr);
+      const result = this._digest_batch(algorithm, ptrsPtr, lensPtr, count, outPtr);
       if (result !== 1) {
-        throw new Error(`SHA-1 digest failed: ${this._get_error_string()}`);
+        throw new Error(`Batch digest failed: ${this._get_error_string()}`);
       }
       
-      const output = new Uint8Array(digestLength);
-      output.set(new Uint8Array(this.instance.HEAPU8.buffer, digestPtr, digestLength));
-      return output;
+      return arena.copyOut(outPtr, count * digestLength);
     } finally {
-      this.instance._free(dataPtr);
-      this.instance._free(digestPtr);
+      arena.release(mark);
     }
   }
 
   /**
-   * Calculate SHA-256 hash
+   * Hash the first length bytes of a heap buffer without copying them
    */
-  sha256(data: Uint8Array | string): Uint8Array {
-    const inputData = typeof data === 'string' ? new TextEncoder().encode(data) : data;
-    const digestLength = 32; // SHA-256 digest length is 32 bytes
+  digestHeap(algorithm: string, input: HeapBuffer, length: number = input.length): Uint8Array {
+    input.checkRange(length);
+    const digestLength = this.digestLength(algorithm);
+    const arena = this.arena;
+    const mark = arena.mark();
+
+    try {
+      const ptrsPtr = arena.alloc(4);
+      const lensPtr = arena.alloc(4);
+      const outPtr = arena.alloc(digestLength);
+      const heapU32 = arena.heapU32;
+      heapU32[ptrsPtr >> 2] = input.ptr;
+      heapU32[lensPtr >> 2] = length;
+
+      if (this._digest_batch(algorithm, ptrsPtr, lensPtr, 1, outPtr) !== 1) {
+        throw new Error(`Digest failed: ${this._get_error_string()}`);
+      }
+
+      return arena.copyOut(outPtr, digestLength);
+    } finally {
+      arena.release(mark);
+    }
+  }
+
+  /**
+   * Tree hash a large input split into chunkSize leaves.
+   *
+   * Returns the root, and with `leaves: true` the packed leaf digests so a
+   * later change to one chunk only needs that leaf rehashed (see
+   * treeHashLeaves and treeHashRoot).
+   */
+  treeHash(algorithm: string, data: Uint8Array | string, options: TreeHashOptions = {}): TreeHashResult {
+    const leaves = this.treeHashLeaves(algorithm, data, options.chunkSize);
+    const root = this.treeHashRoot(algorithm, leaves);
+    return options.leaves ? { root, leaves } : { root };
+  }
+
+  /**
+   * Hash every chunkSize leaf of the input. Returns the leaf digests back to
+   * back; leaf i is at offset i * digestLength.
+   */
+  treeHashLeaves(algorithm: string, data: Uint8Array | string, chunkSize?: number): Uint8Array {
+    const size = checkChunkSize(chunkSize);
+    const inputData = typeof data === 'string' ? this.encoder.encode(data) : data;
+    const digestLength = this.digestLength(algorithm);
+    const leaves = new Uint8Array(leafCount(inputData.length, size) * digestLength);
+    
+    // Copy the input in windows of whole leaves so a multi-GB input never
+    // needs to fit in the WASM heap at once
+    const leavesPerWindow = Math.max(1, Math.floor(TREE_WINDOW_SIZE / size));
+    const windowSize = leavesPerWindow * size;
+    const arena = this.arena;
+    
+    for (let offset = 0, leaf = 0; offset < inputData.length; offset += windowSize, leaf += leavesPerWindow) {
+      const chunk = inputData.subarray(offset, offset + windowSize);
+      const outLength = leafCount(chunk.length, size) * digestLength;
+      const mark = arena.mark();
+      try {
+        const dataPtr = arena.copyIn(chunk);
+        const outPtr = arena.alloc(outLength);
+        
+        const result = this.treeHashFunctions.leaves(algorithm, dataPtr, chunk.length, size, outPtr);
+        if (result !== 1) {
+          throw new Error(`Tree hash failed: ${this._get_error_string()}`);
+        }
+        
+        leaves.set(arena.heapU8.subarray(outPtr, outPtr + outLength), leaf * digestLength);
+      } finally {
+        arena.release(mark);
+      }
+    }
+    
+    return leaves;
+  }
+
+  /**
+   * Combine packed leaf digests from treeHashLeaves into the tree root
+   */
+  treeHashRoot(algorithm: string, leaves: Uint8Array): Uint8Array {
+    const digestLength = this.digestLength(algorithm);
+    if (leaves.length % digestLength !== 0) {
+      throw new Error(`Leaf digests must be a multiple of ${digestLength} bytes`);
+    }
     
-    const dataPtr = this.instance._malloc(inputData.length);
-    const digestPtr = this.instance._malloc(digestLength);
+    const arena = this.arena;
+    const mark = arena.mark();
     
     try {
-      this.instance.HEAPU8.set(inputData, dataPtr);
+      const leavesPtr = arena.copyIn(leaves);
+      const outPtr = arena.alloc(digestLength);
       
-      const result = this._sha256_digest(dataPtr, inputData.length, digestPtr);
+      const result = this.treeHashFunctions.root(algorithm, leavesPtr, leaves.length / digestLength, outPtr);
       if (result !== 1) {
-        throw new Error(`SHA-256 digest failed: ${this._get_error_string()}`);
+        throw new Error(`Tree hash failed: ${this._get_error_string()}`);
       }
       
-      const output = new Uint8Array(digestLength);
-      output.set(new Uint8Array(this.instance.HEAPU8.buffer, digestPtr, digestLength));
-      return output;
+      return arena.copyOut(outPtr, digestLength);
     } finally {
-      this.instance._free(dataPtr);
-      this.instance._free(digestPtr);
+      arena.release(mark);
     }
   }
 
   /**
-   * Calculate SHA-384 hash
+   * Create a content-defined chunker that hashes each chunk (SHA-256
+   * unless options.algorithm is given), for deduplication
    */
-  sha384(data: Uint8Array | string): Uint8Array {
-    const inputData = typeof data === 'string' ? new TextEncoder().encode(data) : data;
-    const digestLength = 48; // SHA-384 digest length is 48 bytes
-    
-    const dataPtr = this.instance._malloc(inputData.length);
-    const digestPtr = this.instance._malloc(digestLength);
+  createChunker(options?: ChunkerOptions): Chunker {
+    return new Chunker(this.instance, this.chunkerFunctions, options);
+  }
+
+  /**
+   * Split data into content-defined chunks and hash each one in a single
+   * pass. Returns the chunks in input order.
+   */
+  chunkAndHash(data: Uint8Array | string | HeapBuffer, options?: ChunkerOptions): ChunkRecord[] {
+    const chunker = this.createChunker(options);
+    try {
+      const records = chunker.update(data);
+      const last = chunker.final();
+      const packed = new Uint8Array(records.length + last.length);
+      packed.set(records);
+      packed.set(last, records.length);
+      return unpackChunks(packed, chunker.digestLength);
+    } finally {
+      chunker.dispose();
+    }
+  }
+
+  /**
+   * Set up an HMAC key once for MACing many messages
+   */
+  createHmacKey(algorithm: string, key: Uint8Array | string): HmacKey {
+    return new HmacKey(this.instance, this.hmacFunctions, this.arena, algorithm, key);
+  }
+
+  /**
+   * Calculate the HMAC of one message
+   */
+  hmac(algorithm: string, key: Uint8Array | string, data: Uint8Array | string): Uint8Array {
+    const inputData = typeof data === 'string' ? this.encoder.encode(data) : data;
+    if (inputData.length > this.streamingThreshold) {
+      const hmacKey = this.createHmacKey(algorithm, key);
+      try {
+        return this.streamDigest(hmacKey.createHmac(), inputData);
+      } finally {
+        hmacKey.dispose();
+      }
+    }
+    return this.hmacMany(algorithm, key, [inputData]);
+  }
+
+  /**
+   * MAC many messages with the same key, setting the key up only once.
+   *
+   * Returns the MACs concatenated in input order; the MAC of message i is at
+   * offset i * digestLength.
+   */
+  hmacMany(algorithm: string, key: Uint8Array | string, messages: Array<Uint8Array | string>): Uint8Array {
+    const hmacKey = this.createHmacKey(algorithm, key);
+    try {
+      return hmacKey.hmacMany(messages);
+    } finally {
+      hmacKey.dispose();
+    }
+  }
+
+  /**
+   * Derive a key from a password with PBKDF2-HMAC
+   */
+  pbkdf2(password: Uint8Array | string, salt: Uint8Array | string, options: Pbkdf2Options): Uint8Array {
+    const passwordData = typeof password === 'string' ? this.encoder.encode(password) : password;
+    const saltData = typeof salt === 'string' ? this.encoder.encode(salt) : salt;
+    try {
+      return pbkdf2(this.kdfFunctions, this.arena, passwordData, saltData, options);
+    } finally {
+      if (typeof password === 'string') {
+        passwordData.fill(0);
+      }
+    }
+  }
+
+  /**
+   * Derive keys from input keying material with HKDF
+   */
+  hkdf(key: Uint8Array | string, options: HkdfOptions): Uint8Array {
+    const keyData = typeof key === 'string' ? this.encoder.encode(key) : key;
+    const { salt = '', info = '' } = options;
+    const saltData = typeof salt === 'string' ? this.encoder.encode(salt) : salt;
+    const infoData = typeof info === 'string' ? this.encoder.encode(info) : info;
+    try {
+      return hkdf(this.kdfFunctions, this.arena, keyData, saltData, infoData, options);
+    } finally {
+      if (typeof key === 'string') {
+        keyData.fill(0);
+      }
+    }
+  }
+
+  /**
+   * Derive a key from a password with scrypt. The memory the derivation may
+   * use is capped by options.maxmem (default: 32 MiB).
+   */
+  scrypt(password: Uint8Array | string, salt: Uint8Array | string, options: ScryptOptions): Uint8Array {
+    const passwordData = typeof password === 'string' ? this.encoder.encode(password) : password;
+    const saltData = typeof salt === 'string' ? this.encoder.encode(salt) : salt;
+    try {
+      return scrypt(this.kdfFunctions, this.arena, passwordData, saltData, options);
+    } finally {
+      if (typeof password === 'string') {
+        passwordData.fill(0);
+      }
+    }
+  }
+
+  /**
+   * Encrypt data using AES in CBC mode with PKCS#7 padding
+   */
+  aesEncrypt(data: Uint8Array | string, key: Uint8Array, iv: Uint8Array): Uint8Array {
+    checkAesParameters(key, iv);
+    return this.cipherOneShot(aesCbcName(key), 'encrypt', data, key, iv);
+  }
+
+  /**
+   * Decrypt data using AES in CBC mode with PKCS#7 padding
+   */
+  aesDecrypt(data: Uint8Array, key: Uint8Array, iv: Uint8Array): Uint8Array {
+    checkAesParameters(key, iv);
+    return this.cipherOneShot(aesCbcName(key), 'decrypt', data, key, iv);
+  }
+
+  /**
+   * Create a streaming encryptor (AES-CBC unless options.algorithm is given)
+   */
+  createCipher(key: Uint8Array, iv: Uint8Array, options?: CipherOptions): Cipher {
+    return new Cipher(this.instance, this.cipherFunctions, 'encrypt', key, iv, options);
+  }
+
+  /**
+   * Create a streaming decryptor (AES-CBC unless options.algorithm is given)
+   */
+  createDecipher(key: Uint8Array, iv: Uint8Array, options?: CipherOptions): Cipher {
+    return new Cipher(this.instance, this.cipherFunctions, 'decrypt', key, iv, options);
+  }
+
+  /**
+   * Create an encrypting TransformStream (AES-CBC unless options.algorithm is given)
+   */
+  createCipherStream(key: Uint8Array, iv: Uint8Array, options?: CipherOptions): CipherTransformStream {
+    return new CipherTransformStream(this.createCipher(key, iv, options));
+  }
+
+  /**
+   * Create a decrypting TransformStream (AES-CBC unless options.algorithm is given)
+   */
+  createDecipherStream(key: Uint8Array, iv: Uint8Array, options?: CipherOptions): CipherTransformStream {
+    return new CipherTransformStream(this.createDecipher(key, iv, options));
+  }
+
+  /**
+   * Encrypt and authenticate a message with an AEAD cipher
+   * ('aes-128-gcm', 'aes-256-gcm' or 'chacha20-poly1305').
+   *
+   * Returns the ciphertext with the 16-byte authentication tag appended.
+   */
+  seal(algorithm: string, key: Uint8Array, iv: Uint8Array, data: Uint8Array | string, aad?: Uint8Array | string): Uint8Array {
+    const inputData = typeof data === 'string' ? this.encoder.encode(data) : data;
+    const aadData = typeof aad === 'string' ? this.encoder.encode(aad) : aad;
+    if (inputData.length > this.streamingThreshold) {
+      return this.sealStreamed(algorithm, key, iv, inputData, aadData);
+    }
+    const arena = this.arena;
+    const mark = arena.mark();
+    let inPtr = 0;
     
     try {
-      this.instance.HEAPU8.set(inputData, dataPtr);
+      const keyPtr = arena.copyIn(key);
+      const ivPtr = arena.copyIn(iv);
+      const aadPtr = aadData ? arena.copyIn(aadData) : 0;
+      inPtr = arena.copyIn(inputData);
+      const outPtr = arena.alloc(inputData.length + AEAD_TAG_LENGTH);
       
-      const result = this._sha384_digest(dataPtr, inputData.length, digestPtr);
+      const result = this.cipherFunctions.seal(
+        algorithm, keyPtr, key.length, ivPtr, iv.length, aadPtr, aadData ? aadData.length : 0,
+        inPtr, inputData.length, outPtr, outPtr + inputData.length, AEAD_TAG_LENGTH
+      );
+      arena.heapU8.fill(0, keyPtr, keyPtr + key.length);
       if (result !== 1) {
-        throw new Error(`SHA-384 digest failed: ${this._get_error_string()}`);
+        throw new Error(`${algorithm} encryption failed: ${this._get_error_string() || 'unsupported cipher or invalid key/IV length'}`);
       }
       
-      const output = new Uint8Array(digestLength);
-      output.set(new Uint8Array(this.instance.HEAPU8.buffer, digestPtr, digestLength));
-      return output;
+      return arena.copyOut(outPtr, inputData.length + AEAD_TAG_LENGTH);
     } finally {
-      this.instance._free(dataPtr);
-      this.instance._free(digestPtr);
+      if (inPtr !== 0) {
+        arena.heapU8.fill(0, inPtr, inPtr + inputData.length);
+      }
+      arena.release(mark);
     }
   }
 
   /**
-   * Calculate SHA-512 hash
+   * Verify and decrypt a message produced by seal(). Throws if the message,
+   * key, IV or AAD do not match.
    */
-  sha512(data: Uint8Array | string): Uint8Array {
-    const inputData = typeof data === 'string' ? new TextEncoder().encode(data) : data;
-    const digestLength = 64; // SHA-512 digest length is 64 bytes
+  open(algorithm: string, key: Uint8Array, iv: Uint8Array, sealed: Uint8Array, aad?: Uint8Array | string): Uint8Array {
+    if (sealed.length < AEAD_TAG_LENGTH) {
+      throw new Error('Sealed message is shorter than the authentication tag');
+    }
     
-    const dataPtr = this.instance._malloc(inputData.length);
-    const digestPtr = this.instance._malloc(digestLength);
+    const aadData = typeof aad === 'string' ? this.encoder.encode(aad) : aad;
+    const dataLength = sealed.length - AEAD_TAG_LENGTH;
+    if (dataLength > this.streamingThreshold) {
+      return this.openStreamed(algorithm, key, iv, sealed, aadData);
+    }
+    const arena = this.arena;
+    const mark = arena.mark();
+    let outPtr = 0;
     
     try {
-      this.instance.HEAPU8.set(inputData, dataPtr);
+      const keyPtr = arena.copyIn(key);
+      const ivPtr = arena.copyIn(iv);
+      const aadPtr = aadData ? arena.copyIn(aadData) : 0;
+      const inPtr = arena.copyIn(sealed);
+      outPtr = arena.alloc(dataLength);
       
-      const result = this._sha512_digest(dataPtr, inputData.length, digestPtr);
+      const result = this.cipherFunctions.open(
+        algorithm, keyPtr, key.length, ivPtr, iv.length, aadPtr, aadData ? aadData.length : 0,
+        inPtr, dataLength, inPtr + dataLength, AEAD_TAG_LENGTH, outPtr
+      );
+      arena.heapU8.fill(0, keyPtr, keyPtr + key.length);
       if (result !== 1) {
-        throw new Error(`SHA-512 digest failed: ${this._get_error_string()}`);
+        throw new Error(`${algorithm} decryption failed: authentication failed or invalid key/IV`);
       }
       
-      const output = new Uint8Array(digestLength);
-      output.set(new Uint8Array(this.instance.HEAPU8.buffer, digestPtr, digestLength));
-      return output;
+      return arena.copyOut(outPtr, dataLength);
     } finally {
-      this.instance._free(dataPtr);
-      this.instance._free(digestPtr);
+      if (outPtr !== 0) {
+        arena.heapU8.fill(0, outPtr, outPtr + dataLength);
+      }
+      arena.release(mark);
     }
   }
 
   /**
-   * Calculate MD5 hash
+   * Encrypt the first length bytes of a heap buffer with an AEAD cipher in
+   * place and append the 16-byte tag, as seal(). The buffer must have room
+   * for the tag; returns a view of the ciphertext and tag.
    */
-  md5(data: Uint8Array | string): Uint8Array {
-    const inputData = typeof data === 'string' ? new TextEncoder().encode(data) : data;
-    const digestLength = 16; // MD5 digest length is 16 bytes
+  sealInPlace(algorithm: string, key: Uint8Array, iv: Uint8Array, buffer: HeapBuffer, length: number, aad?: Uint8Array | string): Uint8Array {
+    buffer.checkRange(length + AEAD_TAG_LENGTH, 'Data and tag');
+    const aadData = typeof aad === 'string' ? this.encoder.encode(aad) : aad;
+    const arena = this.arena;
+    const mark = arena.mark();
+
+    try {
+      const keyPtr = arena.copyIn(key);
+      const ivPtr = arena.copyIn(iv);
+      const aadPtr = aadData ? arena.copyIn(aadData) : 0;
+
+      const result = this.cipherFunctions.seal(
+        algorithm, keyPtr, key.length, ivPtr, iv.length, aadPtr, aadData ? aadData.length : 0,
+        buffer.ptr, length, buffer.ptr, buffer.ptr + length, AEAD_TAG_LENGTH
+      );
+      arena.heapU8.fill(0, keyPtr, keyPtr + key.length);
+      if (result !== 1) {
+        throw new Error(`${algorithm} encryption failed: ${this._get_error_string() || 'unsupported cipher or invalid key/IV length'}`);
+      }
+
+      return buffer.subarray(0, length + AEAD_TAG_LENGTH);
+    } finally {
+      arena.release(mark);
+    }
+  }
+
+  /**
+   * Authenticate and decrypt a sealed message held in the first length
+   * bytes of a heap buffer in place, as open(). Returns a view of the
+   * plaintext; on failure the decrypted bytes are zeroed before throwing.
+   */
+  openInPlace(algorithm: string, key: Uint8Array, iv: Uint8Array, buffer: HeapBuffer, length: number, aad?: Uint8Array | string): Uint8Array {
+    buffer.checkRange(length);
+    if (length < AEAD_TAG_LENGTH) {
+      throw new Error('Sealed message is shorter than the authentication tag');
+    }
+
+    const aadData = typeof aad === 'string' ? this.encoder.encode(aad) : aad;
+    const dataLength = length - AEAD_TAG_LENGTH;
+    const arena = this.arena;
+    const mark = arena.mark();
+
+    try {
+      const keyPtr = arena.copyIn(key);
+      const ivPtr = arena.copyIn(iv);
+      const aadPtr = aadData ? arena.copyIn(aadData) : 0;
+
+      const result = this.cipherFunctions.open(
+        algorithm, keyPtr, key.length, ivPtr, iv.length, aadPtr, aadData ? aadData.length : 0,
+        buffer.ptr, dataLength, buffer.ptr + dataLength, AEAD_TAG_LENGTH, buffer.ptr
+      );
+      arena.heapU8.fill(0, keyPtr, keyPtr + key.length);
+      if (result !== 1) {
+        // The ciphertext has been overwritten with unauthenticated plaintext
+        buffer.view.fill(0, 0, dataLength);
+        throw new Error(`${algorithm} decryption failed: authentication failed or invalid key/IV`);
+      }
+
+      return buffer.subarray(0, dataLength);
+    } finally {
+      arena.release(mark);
+    }
+  }
+
+  /**
+   * Encrypt the first length bytes of a heap buffer with AES-CBC in place,
+   * as aesEncrypt(). The buffer must have room for the padding, up to the
+   * next multiple of 16 above length; returns a view of the ciphertext.
+   */
+  aesEncryptInPlace(key: Uint8Array, iv: Uint8Array, buffer: HeapBuffer, length: number): Uint8Array {
+    checkAesParameters(key, iv);
+    buffer.checkRange(length);
+    buffer.checkRange(length - (length % AES_BLOCK_SIZE) + AES_BLOCK_SIZE, 'Padded data');
+    return this.cipherInPlace(aesCbcName(key), 'encrypt', key, iv, buffer, length);
+  }
+
+  /**
+   * Decrypt the first length bytes of a heap buffer with AES-CBC in place,
+   * as aesDecrypt(). Returns a view of the plaintext.
+   */
+  aesDecryptInPlace(key: Uint8Array, iv: Uint8Array, buffer: HeapBuffer, length: number): Uint8Array {
+    checkAesParameters(key, iv);
+    buffer.checkRange(length);
+    return this.cipherInPlace(aesCbcName(key), 'decrypt', key, iv, buffer, length);
+  }
+
+  /**
+   * Generate a key pair and return it as PEM.
+   *
+   * Runs on the calling thread; RSA generation can block for seconds, so
+   * prefer KeyGenerator.generateKeyPair() from UI code.
+   */
+  generateKeyPair(options: KeyPairOptions = {}, onProgress?: KeygenProgress): KeyPair {
+    this.instance.onKeygenProgress = onProgress;
+    try {
+      const pkey = generatePkey(this.pkeyFunctions, options);
+      try {
+        return exportKeyPair(this.pkeyFunctions, this.arena, pkey);
+      } finally {
+        this.pkeyFunctions.free(pkey);
+      }
+    } finally {
+      this.instance.onKeygenProgress = undefined;
+    }
+  }
+
+  /**
+   * Generate a key and keep it as a handle for repeated use
+   */
+  generateKey(options: KeyPairOptions = {}, onProgress?: KeygenProgress): KeyHandle {
+    this.instance.onKeygenProgress = onProgress;
+    try {
+      return new KeyHandle(this.pkeyFunctions, this.arena, generatePkey(this.pkeyFunctions, options), true);
+    } finally {
+      this.instance.onKeygenProgress = undefined;
+    }
+  }
+
+  /**
+   * Parse a private key (PKCS#8 or traditional, optionally encrypted) once.
+   * Strings are read as PEM and byte arrays as DER.
+   */
+  importPrivateKey(key: KeyData, password?: string): KeyHandle {
+    return new KeyHandle(this.pkeyFunctions, this.arena, readKey(this.pkeyFunctions, this.arena, key, 'private', password), true);
+  }
+
+  /**
+   * Parse a SubjectPublicKeyInfo public key once. Strings are read as PEM
+   * and byte arrays as DER.
+   */
+  importPublicKey(key: KeyData): KeyHandle {
+    return new KeyHandle(this.pkeyFunctions, this.arena, readKey(this.pkeyFunctions, this.arena, key, 'public'), false);
+  }
+
+  /**
+   * Like importPrivateKey(), but reuses the parsed key when the same
+   * encoding (and password) was loaded before. The key stays cached until
+   * it is evicted or clearKeyCache() is called.
+   */
+  loadPrivateKey(key: KeyData, password?: string): KeyHandle {
+    return this.keyCache.load(key, 'private', password);
+  }
+
+  /**
+   * Like importPublicKey(), but reuses the parsed key when the same
+   * encoding was loaded before
+   */
+  loadPublicKey(key: KeyData): KeyHandle {
+    return this.keyCache.load(key, 'public');
+  }
+
+  /**
+   * Release every key held by the key cache. Handles already returned stay
+   * usable until disposed.
+   */
+  clearKeyCache(): void {
+    this.keyCache.clear();
+  }
+
+  /**
+   * Create a public key handle from a raw 32-byte X25519 or Ed25519 key
+   */
+  importRawPublicKey(type: 'x25519' | 'ed25519', key: Uint8Array): KeyHandle {
+    const arena = this.arena;
+    const mark = arena.mark();
+    try {
+      const keyPtr = arena.copyIn(key);
+      const pkey = this.pkeyFunctions.fromRawPublic(keyTypeName(type), keyPtr, key.length);
+      if (pkey === 0) {
+        throw new Error(`Invalid ${type} public key: ${this._get_error_string()}`);
+      }
+      return new KeyHandle(this.pkeyFunctions, arena, pkey, false);
+    } finally {
+      arena.release(mark);
+    }
+  }
+
+  /**
+   * Verify many signatures with one call into the module.
+   *
+   * keys is one key for the whole batch or one per signature; PEM public
+   * keys go through the key cache, so each is parsed at most once. Returns
+   * a bitmap in which bit i (byte i >> 3, bit i & 7) is set when signature
+   * i is valid; see isVerified(). Signatures under the same key share one
+   * verification setup.
+   */
+  verifyMany(keys: KeyHandle | string | Array<KeyHandle | string>, messages: Array<Uint8Array | string>, signatures: Uint8Array[], options: SignOptions = {}): Uint8Array {
+    const count = messages.length;
+    if (signatures.length !== count || (Array.isArray(keys) && keys.length !== count)) {
+      throw new Error('verifyMany needs one signature (and key) per message');
+    }
     
-    const dataPtr = this.instance._malloc(inputData.length);
-    const digestPtr = this.instance._malloc(digestLength);
+    // One handle per distinct PEM key for the duration of the call
+    const parsed = new Map<string, KeyHandle>();
+    const resolve = (key: KeyHandle | string): KeyHandle => {
+      if (typeof key !== 'string') {
+        return key;
+      }
+      let handle = parsed.get(key);
+      if (!handle) {
+        handle = this.loadPublicKey(key);
+        parsed.set(key, handle);
+      }
+      return handle;
+    };
+    
+    const arena = this.arena;
+    const mark = arena.mark();
     
     try {
-      this.instance.HEAPU8.set(inputData, dataPtr);
+      const handles = Array.isArray(keys) ? keys.map(resolve) : new Array<KeyHandle>(count).fill(resolve(keys));
+      const inputs = messages.map(m => typeof m === 'string' ? this.encoder.encode(m) : m);
+      
+      const msgs = arena.packMessages(inputs);
+      const sigs = arena.packMessages(signatures);
+      const keysPtr = arena.alloc(count * 4);
+      const bitmapPtr = arena.alloc((count + 7) >> 3);
       
-      const result = this._md5_digest(dataPtr, inputData.length, digestPtr);
+      const heapU32 = arena.heapU32;
+      for (let i = 0; i < count; i++) {
+        heapU32[(keysPtr >> 2) + i] = handles[i].handle;
+      }
+      
+      const digest = options.hash ?? 'sha256';
+      const result = this.pkeyFunctions.verifyBatch(
+        keysPtr, digest, options.padding === 'pss' ? 1 : 0,
+        msgs.ptrsPtr, msgs.lensPtr, sigs.ptrsPtr, sigs.lensPtr, count, bitmapPtr
+      );
       if (result !== 1) {
-        throw new Error(`MD5 digest failed: ${this._get_error_string()}`);
+        throw new Error(`Batch verification failed: ${this._get_error_string()}`);
       }
       
-      const output = new Uint8Array(digestLength);
-      output.set(new Uint8Array(this.instance.HEAPU8.buffer, digestPtr, digestLength));
-      return output;
+      return arena.copyOut(bitmapPtr, (count + 7) >> 3);
     } finally {
-      this.instance._free(dataPtr);
-      this.instance._free(digestPtr);
+      arena.release(mark);
+      parsed.forEach(handle => handle.dispose());
     }
   }
 
+  /**
+   * Parse a trust bundle once into a resident store for verifyChain() and
+   * TLS contexts
+   */
+  createTrustStore(certificates: CertificateData | CertificateData[] = [], options: TrustStoreOptions = {}): TrustStore {
+    const store = new TrustStore(this.trustFunctions, this.arena, data => this.sha256(data), options);
+    try {
+      store.addCertificates(certificates);
+    } catch (e) {
+      store.dispose();
+      throw e;
+    }
+    return store;
+  }
+
+  /**
+   * Create a TLS client configuration for connections over WebSocket relays
+   */
+  createTlsContext(options: TlsContextOptions = {}): TlsContext {
+    return new TlsContext(this.tlsFunctions, this.arena, options);
+  }
+
   /**
    * Base64 encode data
    */
   base64Encode(data: Uint8Array | string): string {
-    const inputData = typeof data === 'string' ? new TextEncoder().encode(data) : data;
-    
-    const dataPtr = this.instance._malloc(inputData.length);
-    const outLenPtr = this.instance._malloc(4); // 4 bytes for int
+    const inputData = typeof data === 'string' ? this.encoder.encode(data) : data;
+    if (inputData.length > this.streamingThreshold) {
+      const encoder = this.createBase64Encoder();
+      try {
+        return encoder.update(inputData) + encoder.final();
+      } finally {
+        encoder.dispose();
+      }
+    }
+    const arena = this.arena;
+    const mark = arena.mark();
     
     try {
-      this.instance.HEAPU8.set(inputData, dataPtr);
-      
-      const resultPtr = this._base64_encode(dataPtr, inputData.length, outLenPtr);
-      if (resultPtr === 0) {
-        throw new Error(`Base64 encoding failed: ${this._get_error_string()}`);
-      }
+      const dataPtr = arena.copyIn(inputData);
+      const outPtr = arena.alloc(base64EncodedLength(inputData.length) + 1);
       
-      const result = this.instance.UTF8ToString(resultPtr);
-      this.instance._free(resultPtr);
-      return result;
+      const outLen = this.base64Functions.encode(dataPtr, inputData.length, outPtr);
+      return readAscii(arena.heapU8, outPtr, outLen);
     } finally {
-      this.instance._free(dataPtr);
-      this.instance._free(outLenPtr);
+      arena.release(mark);
     }
   }
 
   /**
-   * Base64 decode data
+   * Base64 decode data. Surrounding whitespace and missing padding are
+   * tolerated; any other malformed input throws.
    */
   base64Decode(data: string): Uint8Array {
-    const dataPtr = this.instance._malloc(data.length);
-    const outLenPtr = this.instance._malloc(4); // 4 bytes for int
+    const text = padBase64(data.trim());
+    if (text.length > this.streamingThreshold) {
+      return this.base64DecodeStreamed(text);
+    }
+    const arena = this.arena;
+    const mark = arena.mark();
     
     try {
-      this.instance.stringToUTF8(data, dataPtr, data.length + 1);
+      const dataPtr = arena.alloc(text.length);
+      const outPtr = arena.alloc(base64DecodedLength(text.length));
+      writeAscii(arena.heapU8, text, dataPtr);
       
-      const resultPtr = this._base64_decode(dataPtr, data.length, outLenPtr);
-      if (resultPtr === 0) {
-        throw new Error(`Base64 decoding failed: ${this._get_error_string()}`);
+      const outLen = this.base64Functions.decode(dataPtr, text.length, outPtr);
+      if (outLen < 0) {
+        throw new Error('Base64 decoding failed: invalid input');
       }
       
-      const outLen = this.instance.getValue(outLenPtr, 'i32');
-      const output = new Uint8Array(outLen);
-      output.set(new Uint8Array(this.instance.HEAPU8.buffer, resultPtr, outLen));
-      
-      this.instance._free(resultPtr);
-      return output;
+      return arena.copyOut(outPtr, outLen);
     } finally {
-      this.instance._free(dataPtr);
-      this.instance._free(outLenPtr);
+      arena.release(mark);
     }
   }
 
+  /**
+   * Create a streaming base64 encoder for large payloads
+   */
+  createBase64Encoder(): Base64Encoder {
+    return new Base64Encoder(this.instance, this.base64Functions);
+  }
+
+  /**
+   * Create a streaming base64 decoder for large payloads
+   */
+  createBase64Decoder(): Base64Decoder {
+    return new Base64Decoder(this.instance, this.base64Functions);
+  }
+
+  /**
+   * Create a TransformStream from bytes (or text, as UTF-8) to base64 text
+   */
+  createBase64Stream(): TransformStream<Uint8Array | string, string> {
+    return base64EncodeStream(this.createBase64Encoder());
+  }
+
+  /**
+   * Create a TransformStream from base64 text to bytes
+   */
+  createBase64DecodeStream(): TransformStream<string, Uint8Array> {
+    return base64DecodeStream(this.createBase64Decoder());
+  }
+
   /**
    * Convert a Uint8Array to a hex string
    */
@@ -322,6 +1260,307 @@ export class OpenSSL {
     
     return bytes;
   }
+
+  /**
+   * Run a whole non-AEAD cipher operation on scratch memory in one pass
+   */
+  private cipherOneShot(algorithm: string, mode: 'encrypt' | 'decrypt', data: Uint8Array | string, key: Uint8Array, iv: Uint8Array): Uint8Array {
+    const inputData = typeof data === 'string' ? this.encoder.encode(data) : data;
+    if (inputData.length > this.streamingThreshold) {
+      return this.cipherStreamed(algorithm, mode, inputData, key, iv);
+    }
+    const fns = this.cipherFunctions;
+    const arena = this.arena;
+    const mark = arena.mark();
+    let ctx = 0;
+    let inPtr = 0;
+    let outPtr = 0;
+    const outCapacity = inputData.length + MAX_BLOCK_SIZE;
+    
+    try {
+      const keyPtr = arena.copyIn(key);
+      const ivPtr = arena.copyIn(iv);
+      ctx = fns.init(algorithm, keyPtr, key.length, ivPtr, iv.length, mode === 'encrypt' ? 1 : 0);
+      arena.heapU8.fill(0, keyPtr, keyPtr + key.length);
+      if (ctx === 0) {
+        throw new Error(`${algorithm} initialization failed: ${this._get_error_string()}`);
+      }
+      
+      inPtr = arena.copyIn(inputData);
+      outPtr = arena.alloc(outCapacity);
+      const outLenPtr = arena.alloc(4);
+      
+      if (fns.update(ctx, inPtr, inputData.length, outPtr, outLenPtr) !== 1) {
+        throw new Error(`${algorithm} ${mode}ion failed: ${this._get_error_string()}`);
+      }
+      const updateLen = arena.heapU32[outLenPtr >> 2];
+      
+      const result = fns.final(ctx, outPtr + updateLen, outLenPtr, 0, 0);
+      ctx = 0;
+      if (result !== 1) {
+        throw new Error(`${algorithm} ${mode}ion failed: ${this._get_error_string()}`);
+      }
+      
+      return arena.copyOut(outPtr, updateLen + arena.heapU32[outLenPtr >> 2]);
+    } finally {
+      if (ctx !== 0) {
+        fns.free(ctx);
+      }
+      // Don't leave plaintext behind in scratch memory
+      if (inPtr !== 0) {
+        arena.heapU8.fill(0, inPtr, inPtr + inputData.length);
+      }
+      if (outPtr !== 0) {
+        arena.heapU8.fill(0, outPtr, outPtr + outCapacity);
+      }
+      arena.release(mark);
+    }
+  }
+
+  /**
+   * Look up (and cache) the output size of a digest by name
+   */
+  private digestLength(algorithm: string): number {
+    let length = this.digestLengths.get(algorithm);
+    if (length === undefined) {
+      length = this._digest_length(algorithm);
+      if (length === 0) {
+        throw new Error(`Unsupported digest algorithm: ${algorithm}`);
+      }
+      this.digestLengths.set(algorithm, length);
+    }
+    return length;
+  }
+
+  /**
+   * Run a one-shot cipher over a heap buffer. EVP allows the output to
+   * overlap the input exactly, so no scratch copy of the data is made.
+   */
+  private cipherInPlace(algorithm: string, mode: 'encrypt' | 'decrypt', key: Uint8Array, iv: Uint8Array, buffer: HeapBuffer, length: number): Uint8Array {
+    const fns = this.cipherFunctions;
+    const arena = this.arena;
+    const mark = arena.mark();
+    let ctx = 0;
+
+    try {
+      const keyPtr = arena.copyIn(key);
+      const ivPtr = arena.copyIn(iv);
+      ctx = fns.init(algorithm, keyPtr, key.length, ivPtr, iv.length, mode === 'encrypt' ? 1 : 0);
+      arena.heapU8.fill(0, keyPtr, keyPtr + key.length);
+      if (ctx === 0) {
+        throw new Error(`${algorithm} initialization failed: ${this._get_error_string()}`);
+      }
+
+      const outLenPtr = arena.alloc(4);
+      if (fns.update(ctx, buffer.ptr, length, buffer.ptr, outLenPtr) !== 1) {
+        throw new Error(`${algorithm} ${mode}ion failed: ${this._get_error_string()}`);
+      }
+      const updateLen = arena.heapU32[outLenPtr >> 2];
+
+      const result = fns.final(ctx, buffer.ptr + updateLen, outLenPtr, 0, 0);
+      ctx = 0;
+      if (result !== 1) {
+        throw new Error(`${algorithm} ${mode}ion failed: ${this._get_error_string()}`);
+      }
+
+      return buffer.subarray(0, updateLen + arena.heapU32[outLenPtr >> 2]);
+    } finally {
+      if (ctx !== 0) {
+        fns.free(ctx);
+      }
+      arena.release(mark);
+    }
+  }
+
+  // Streaming fallbacks for inputs above streamingThreshold. The handles
+  // feed the module through fixed windows, so the heap holds one window of
+  // the input at a time however large it is.
+
+  private streamDigest(hash: Hash, data: Uint8Array): Uint8Array {
+    try {
+      return hash.update(data).digest();
+    } finally {
+      hash.dispose();
+    }
+  }
+
+  private cipherStreamed(algorithm: string, mode: 'encrypt' | 'decrypt', data: Uint8Array, key: Uint8Array, iv: Uint8Array): Uint8Array {
+    const cipher = mode === 'encrypt'
+      ? this.createCipher(key, iv, { algorithm })
+      : this.createDecipher(key, iv, { algorithm });
+    const output = new Uint8Array(data.length + cipher.blockSize);
+    try {
+      const written = cipher.updateInto(data, output);
+      const total = written + cipher.finalInto(output, written);
+      return total === output.length ? output : output.slice(0, total);
+    } catch (e) {
+      output.fill(0);
+      throw e;
+    } finally {
+      cipher.dispose();
+    }
+  }
+
+  private sealStreamed(algorithm: string, key: Uint8Array, iv: Uint8Array, data: Uint8Array, aad?: Uint8Array): Uint8Array {
+    const cipher = this.createCipher(key, iv, { algorithm });
+    const output = new Uint8Array(data.length + AEAD_TAG_LENGTH);
+    try {
+      // As aead_seal, before any data is processed
+      if (!cipher.aead) {
+        throw new Error('unsupported cipher');
+      }
+      if (aad) {
+        cipher.setAAD(aad);
+      }
+      const written = cipher.updateInto(data, output);
+      cipher.finalInto(output, written);
+      output.set(cipher.getAuthTag(), data.length);
+      return output;
+    } catch (e) {
+      throw new Error(`${algorithm} encryption failed: ${(e as Error).message}`);
+    } finally {
+      cipher.dispose();
+    }
+  }
+
+  private openStreamed(algorithm: string, key: Uint8Array, iv: Uint8Array, sealed: Uint8Array, aad?: Uint8Array): Uint8Array {
+    const dataLength = sealed.length - AEAD_TAG_LENGTH;
+    const cipher = this.createDecipher(key, iv, { algorithm });
+    const output = new Uint8Array(dataLength);
+    try {
+      if (!cipher.aead) {
+        throw new Error('unsupported cipher');
+      }
+      if (aad) {
+        cipher.setAAD(aad);
+      }
+      cipher.setAuthTag(sealed.subarray(dataLength));
+      const written = cipher.updateInto(sealed.subarray(0, dataLength), output);
+      cipher.finalInto(output, written);
+      return output;
+    } catch (e) {
+      // Never hand back plaintext that failed authentication
+      output.fill(0);
+      throw new Error(`${algorithm} decryption failed: authentication failed or invalid key/IV`);
+    } finally {
+      cipher.dispose();
+    }
+  }
+
+  private base64DecodeStreamed(text: string): Uint8Array {
+    // The decoder skips line breaks, but base64Decode() only tolerates
+    // whitespace around the input, as on the one-shot path
+    if (/[ \t\r\n]/.test(text)) {
+      throw new Error('Base64 decoding failed: invalid input');
+    }
+    const decoder = this.createBase64Decoder();
+    const parts: Uint8Array[] = [];
+    let total = 0;
+    try {
+      for (let offset = 0; offset < text.length; offset += this.streamingThreshold) {
+        const part = decoder.update(text.slice(offset, offset + this.streamingThreshold));
+        parts.push(part);
+        total += part.length;
+      }
+      const last = decoder.final();
+      parts.push(last);
+      total += last.length;
+    } catch (e) {
+      throw new Error('Base64 decoding failed: invalid input');
+    } finally {
+      decoder.dispose();
+    }
+
+    const output = new Uint8Array(total);
+    let position = 0;
+    for (const part of parts) {
+      output.set(part, position);
+      position += part.length;
+    }
+    return output;
+  }
+
+  // [arena, in use, free, free at the top of the heap] from the allocator
+  private readHeapStats(): number[] {
+    if (this.statsPtr === 0) {
+      this.statsPtr = this.instance._malloc(16);
+      if (this.statsPtr === 0) {
+        throw new Error('Failed to allocate heap statistics buffer');
+      }
+    }
+    this._heap_stats(this.statsPtr);
+    const heap = new Uint32Array(this.instance.HEAPU8.buffer, this.statsPtr, 4);
+    return Array.from(heap);
+  }
+
+  private liveHandleCount(): number {
+    return this.handles ? this.handles.size : this.heapBuffers.size;
+  }
+
+  /**
+   * Run one of the one-shot *_digest functions using scratch memory
+   */
+  private oneShotDigest(digestFn: (dataPtr: number, dataLen: number, mdPtr: number) => number, algorithm: string, name: string, data: Uint8Array | string, digestLength: number): Uint8Array {
+    const inputData = typeof data === 'string' ? this.encoder.encode(data) : data;
+    if (inputData.length > this.streamingThreshold) {
+      return this.streamDigest(this.createHash(algorithm), inputData);
+    }
+    const arena = this.arena;
+    const mark = arena.mark();
+    
+    try {
+      const dataPtr = arena.copyIn(inputData);
+      const digestPtr = arena.alloc(digestLength);
+      
+      const result = digestFn(dataPtr, inputData.length, digestPtr);
+      if (result !== 1) {
+        throw new Error(`${name} digest failed: ${this._get_error_string()}`);
+      }
+      
+      return arena.copyOut(digestPtr, digestLength);
+    } finally {
+      arena.release(mark);
+    }
+  }
+}
+
+// OpenSSL methods timed by Metrics: everything on the prototype except
+// accessors and cleanup()
+function operationNames(): string[] {
+  return Object.getOwnPropertyNames(OpenSSL.prototype).filter(name => {
+    const descriptor = Object.getOwnPropertyDescriptor(OpenSSL.prototype, name);
+    return name !== 'constructor' && name !== 'cleanup' && typeof descriptor?.value === 'function';
+  });
+}
+
+// Shared instances by variant, tier and options. Promises are stored so
+// concurrent initialize() calls wait for the same instance.
+const sharedInstances = new Map<string, Promise<OpenSSL>>();
+const sharedKeys = new WeakMap<OpenSSL, string>();
+
+// Options each instance was created with, for recycle()
+const instanceOptions = new WeakMap<OpenSSL, OpenSSLOptions>();
+
+// Options that change an instance's behaviour, serialized. Instances with a
+// metrics sink, a leak callback or a caller's own module are never shared,
+// since none of those can be compared by value.
+function instanceKey(variant: WasmVariant, tier: WasmTier, options: OpenSSLOptions): string | null {
+  const { wasmModule, wasmCache, shared, simd, features, ...rest } = options;
+  if (shared !== true
+    || wasmModule !== undefined
+    || (typeof rest.metrics === 'object' && rest.metrics.sink)
+    || (typeof rest.trackHandles === 'object' && rest.trackHandles.onLeak)) {
+    return null;
+  }
+  const settings = Object.keys(rest).sort().map(name => [name, rest[name as keyof typeof rest]]);
+  return JSON.stringify([variant, tier, settings]);
+}
+
+async function createInstance(variant: WasmVariant, tier: WasmTier, options: OpenSSLOptions): Promise<OpenSSL> {
+  const wasmModule = await loadWasmModule(variant, tier, { module: options.wasmModule, cache: options.wasmCache });
+  const openssl = new OpenSSL(wasmModule, options, variant, tier);
+  instanceOptions.set(openssl, options);
+  return openssl;
 }
 
 /**
@@ -329,11 +1568,69 @@ export class OpenSSL {
  */
 const OpenSSLWasmJS: OpenSSLWasm = {
   /**
-   * Initialize the OpenSSL WASM module
+   * Initialize the OpenSSL WASM module. Each call returns a new instance
+   * unless the shared option is true, in which case calls with the same
+   * options return the same one; the module itself is compiled once per
+   * variant and tier either way.
+   */
+  async initialize(options: OpenSSLOptions = {}): Promise<OpenSSL> {
+    const variant = selectVariant(options.simd);
+    const tier = selectTier(options.features);
+    const key = instanceKey(variant, tier, options);
+    if (key === null) {
+      return createInstance(variant, tier, options);
+    }
+
+    let instance = sharedInstances.get(key);
+    if (!instance) {
+      instance = createInstance(variant, tier, options).then(openssl => {
+        sharedKeys.set(openssl, key);
+        return openssl;
+      });
+      instance.catch(() => sharedInstances.delete(key));
+      sharedInstances.set(key, instance);
+    }
+    return instance;
+  },
+
+  /**
+   * Replace an instance with a fresh one created with the same options, to
+   * give back memory that growth or fragmentation has left in its heap
+   * (linear memory never shrinks). The old instance is cleaned up, so
+   * nothing may still use it or any handle created from it. Instances
+   * created with shared: true cannot be recycled, since a shared one may
+   * have been handed to other callers. Returns the instance unchanged when
+   * the thresholds in options are not reached.
+   */
+  async recycle(openssl: OpenSSL, options: RecycleOptions = {}): Promise<OpenSSL> {
+    if (sharedKeys.has(openssl)) {
+      throw new Error('Cannot recycle a shared instance; initialize it without shared: true');
+    }
+    const stats = openssl.memoryStats();
+    if (stats.fragmentation < (options.fragmentation ?? 0) || stats.heapSize < (options.heapSize ?? 0)) {
+      return openssl;
+    }
+    if (stats.liveHandles > 0) {
+      throw new Error(`Cannot recycle an instance with ${stats.liveHandles} live handles`);
+    }
+
+    const initOptions = instanceOptions.get(openssl) ?? {};
+    openssl.cleanup();
+    return OpenSSLWasmJS.initialize(initOptions);
+  },
+
+  /**
+   * Start a pool of workers, each with its own OpenSSL WASM module
+   */
+  async createPool(options?: WorkerPoolOptions): Promise<WorkerPool> {
+    return WorkerPool.create(options);
+  },
+
+  /**
+   * Create a background key generator with an optional pre-generated key pool
    */
-  async initialize(): Promise<OpenSSL> {
-    const wasmModule = await OpenSSLWasmModule();
-    return new OpenSSL(wasmModule);
+  createKeyGenerator(options?: KeyGeneratorOptions): KeyGenerator {
+    return new KeyGenerator(options);
   }
 };
 
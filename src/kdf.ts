@@ -0,0 +1,221 @@
+/**
+ * Key derivation: PBKDF2, HKDF and scrypt
+ */
+
+import type { OpenSSLWasmInstance } from './index';
+import type { ScratchArena } from './arena';
+
+/**
+ * Wrapped KDF glue functions
+ */
+export interface KdfFunctions {
+  pbkdf2: (name: string, passwordPtr: number, passwordLen: number, saltPtr: number, saltLen: number, iterations: number, outPtr: number, outLen: number) => number;
+  hkdf: (name: string, mode: number, keyPtr: number, keyLen: number, saltPtr: number, saltLen: number, infoPtr: number, infoLen: number, outPtr: number, outLen: number) => number;
+  scrypt: (passwordPtr: number, passwordLen: number, saltPtr: number, saltLen: number, n: number, r: number, p: number, maxMem: number, outPtr: number, outLen: number) => number;
+  error: () => string;
+}
+
+/**
+ * Create the KDF function wrappers for a module instance
+ */
+export function wrapKdfFunctions(instance: OpenSSLWasmInstance): KdfFunctions {
+  return {
+    pbkdf2: instance.cwrap('kdf_pbkdf2', 'number', ['string', 'number', 'number', 'number', 'number', 'number', 'number', 'number']) as KdfFunctions['pbkdf2'],
+    hkdf: instance.cwrap('kdf_hkdf', 'number', ['string', 'number', 'number', 'number', 'number', 'number', 'number', 'number', 'number', 'number']) as KdfFunctions['hkdf'],
+    scrypt: instance.cwrap('kdf_scrypt', 'number', ['number', 'number', 'number', 'number', 'number', 'number', 'number', 'number', 'number', 'number']) as KdfFunctions['scrypt'],
+    error: instance.cwrap('get_error_string', 'string', []) as KdfFunctions['error']
+  };
+}
+
+/**
+ * Memory budget OpenSSL applies to scrypt when none is given
+ */
+export const DEFAULT_SCRYPT_MAX_MEMORY = 32 * 1024 * 1024;
+
+// EVP_KDF_HKDF_MODE_* values
+const HKDF_MODES = {
+  'extract-and-expand': 0,
+  'extract': 1,
+  'expand': 2
+} as const;
+
+export interface Pbkdf2Options {
+  /**
+   * Number of HMAC iterations
+   */
+  iterations: number;
+  /**
+   * Output length in bytes
+   */
+  length: number;
+  /**
+   * Digest for the HMAC (default: 'sha256')
+   */
+  hash?: string;
+}
+
+export interface HkdfOptions {
+  /**
+   * Output length in bytes; must be the digest length in 'extract' mode
+   */
+  length: number;
+  /**
+   * Extract salt (default: none, i.e. a string of zeros)
+   */
+  salt?: Uint8Array | string;
+  /**
+   * Expand context and application-specific information
+   */
+  info?: Uint8Array | string;
+  /**
+   * Digest (default: 'sha256')
+   */
+  hash?: string;
+  /**
+   * Run both steps (default), or only the extract or expand step
+   */
+  mode?: keyof typeof HKDF_MODES;
+}
+
+export interface ScryptOptions {
+  /**
+   * Output length in bytes
+   */
+  length: number;
+  /**
+   * CPU/memory cost, a power of two (default: 16384)
+   */
+  N?: number;
+  /**
+   * Block size (default: 8)
+   */
+  r?: number;
+  /**
+   * Parallelization (default: 1)
+   */
+  p?: number;
+  /**
+   * Most memory in bytes the derivation may use (default: 32 MiB)
+   */
+  maxmem?: number;
+}
+
+/**
+ * Bytes scrypt allocates for the given parameters, as OpenSSL counts them
+ */
+function scryptMemory(N: number, r: number, p: number): number {
+  return 128 * r * (N + 2) + 128 * r * p;
+}
+
+function checkLength(length: number): void {
+  if (!Number.isInteger(length) || length < 1) {
+    throw new Error('Derived key length must be a positive integer');
+  }
+}
+
+/**
+ * Derive a key with PBKDF2 (PKCS #5)
+ */
+export function pbkdf2(fns: KdfFunctions, arena: ScratchArena, password: Uint8Array, salt: Uint8Array, options: Pbkdf2Options): Uint8Array {
+  const { iterations, length, hash = 'sha256' } = options;
+  checkLength(length);
+  if (!Number.isInteger(iterations) || iterations < 1) {
+    throw new Error('PBKDF2 iterations must be a positive integer');
+  }
+
+  const mark = arena.mark();
+  let passwordPtr = 0;
+  let outPtr = 0;
+  try {
+    passwordPtr = arena.copyIn(password);
+    const saltPtr = arena.copyIn(salt);
+    outPtr = arena.alloc(length);
+    if (fns.pbkdf2(hash, passwordPtr, password.length, saltPtr, salt.length, iterations, outPtr, length) !== 1) {
+      throw new Error(`PBKDF2 failed: ${fns.error()}`);
+    }
+    return arena.copyOut(outPtr, length);
+  } finally {
+    wipe(arena, passwordPtr, password.length, outPtr, length);
+    arena.release(mark);
+  }
+}
+
+/**
+ * Derive a key with HKDF (RFC 5869)
+ */
+export function hkdf(fns: KdfFunctions, arena: ScratchArena, key: Uint8Array, salt: Uint8Array, info: Uint8Array, options: HkdfOptions): Uint8Array {
+  const { length, hash = 'sha256', mode = 'extract-and-expand' } = options;
+  checkLength(length);
+  if (!(mode in HKDF_MODES)) {
+    throw new Error(`Unknown HKDF mode: ${mode}`);
+  }
+
+  const mark = arena.mark();
+  let keyPtr = 0;
+  let outPtr = 0;
+  try {
+    keyPtr = arena.copyIn(key);
+    const saltPtr = arena.copyIn(salt);
+    const infoPtr = arena.copyIn(info);
+    outPtr = arena.alloc(length);
+    if (fns.hkdf(hash, HKDF_MODES[mode], keyPtr, key.length, saltPtr, salt.length, infoPtr, info.length, outPtr, length) !== 1) {
+      throw new Error(`HKDF failed: ${fns.error()}`);
+    }
+    return arena.copyOut(outPtr, length);
+  } finally {
+    wipe(arena, keyPtr, key.length, outPtr, length);
+    arena.release(mark);
+  }
+}
+
+/**
+ * Derive a key with scrypt (RFC 7914).
+ *
+ * The working memory is allocated in the WASM heap for the duration of the
+ * call. The heap never shrinks, so large cost parameters are best used from
+ * a WorkerPool, whose workers keep that memory out of the main instance.
+ */
+export function scrypt(fns: KdfFunctions, arena: ScratchArena, password: Uint8Array, salt: Uint8Array, options: ScryptOptions): Uint8Array {
+  const { length, N = 16384, r = 8, p = 1, maxmem = DEFAULT_SCRYPT_MAX_MEMORY } = options;
+  checkLength(length);
+  if (!Number.isInteger(N) || N < 2 || N > 0x80000000 || (N & (N - 1)) !== 0) {
+    throw new Error('scrypt N must be a power of two greater than 1');
+  }
+  if (!Number.isInteger(r) || r < 1 || !Number.isInteger(p) || p < 1) {
+    throw new Error('scrypt r and p must be positive integers');
+  }
+  if (!Number.isInteger(maxmem) || maxmem < 1 || maxmem > 0xffffffff) {
+    throw new Error('scrypt maxmem must be a positive 32-bit integer');
+  }
+  const needed = scryptMemory(N, r, p);
+  if (needed > maxmem) {
+    throw new Error(`scrypt parameters need ${needed} bytes, above the maxmem budget of ${maxmem}`);
+  }
+
+  const mark = arena.mark();
+  let passwordPtr = 0;
+  let outPtr = 0;
+  try {
+    passwordPtr = arena.copyIn(password);
+    const saltPtr = arena.copyIn(salt);
+    outPtr = arena.alloc(length);
+    if (fns.scrypt(passwordPtr, password.length, saltPtr, salt.length, N, r, p, maxmem, outPtr, length) !== 1) {
+      throw new Error(`scrypt failed: ${fns.error()}`);
+    }
+    return arena.copyOut(outPtr, length);
+  } finally {
+    wipe(arena, passwordPtr, password.length, outPtr, length);
+    arena.release(mark);
+  }
+}
+
+// Zero the secret input and the derived key left in scratch memory
+function wipe(arena: ScratchArena, inPtr: number, inLen: number, outPtr: number, outLen: number): void {
+  const heapU8 = arena.heapU8;
+  if (inPtr !== 0) {
+    heapU8.fill(0, inPtr, inPtr + inLen);
+  }
+  if (outPtr !== 0) {
+    heapU8.fill(0, outPtr, outPtr + outLen);
+  }
+}
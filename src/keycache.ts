@@ -0,0 +1,128 @@
+/**
+ * LRU cache of parsed keys, keyed by fingerprint
+ */
+
+import type { ScratchArena } from './arena';
+import { KeyData, KeyHandle, PkeyFunctions, readKey } from './pkey';
+
+/**
+ * Default number of parsed keys kept by the cache
+ */
+export const DEFAULT_KEY_CACHE_SIZE = 64;
+
+interface CachedKey {
+  pkey: number;
+  type: string;
+}
+
+/**
+ * Parsed keys keyed by the SHA-256 fingerprint of their encoding.
+ *
+ * Loading a key that is already cached skips the PEM, base64 and ASN.1
+ * decoding entirely: the cache takes another reference to the parsed
+ * EVP_PKEY and wraps it in a new handle. Every handle owns its reference,
+ * so evicting a key never invalidates handles already returned.
+ */
+export class KeyCache {
+  private fns: PkeyFunctions;
+  private arena: ScratchArena;
+  private digest: (data: Uint8Array) => Uint8Array;
+  private entries = new Map<string, CachedKey>();
+  private encoder = new TextEncoder();
+
+  /**
+   * Maximum number of keys kept; 0 disables caching
+   */
+  readonly capacity: number;
+
+  /**
+   * Constructor - should not be called directly, the cache is owned by OpenSSL
+   */
+  constructor(fns: PkeyFunctions, arena: ScratchArena, capacity: number, digest: (data: Uint8Array) => Uint8Array) {
+    if (!Number.isInteger(capacity) || capacity < 0) {
+      throw new Error('Key cache size must be a non-negative integer');
+    }
+    this.fns = fns;
+    this.arena = arena;
+    this.capacity = capacity;
+    this.digest = digest;
+  }
+
+  /**
+   * Number of keys currently cached
+   */
+  get size(): number {
+    return this.entries.size;
+  }
+
+  /**
+   * Return a handle for a PEM or DER key, parsing it only on a cache miss.
+   * The caller owns the returned handle and should dispose() it.
+   */
+  load(key: KeyData, part: 'private' | 'public', password?: string): KeyHandle {
+    const isPrivate = part === 'private';
+    if (this.capacity === 0) {
+      return new KeyHandle(this.fns, this.arena, readKey(this.fns, this.arena, key, part, password), isPrivate);
+    }
+
+    const id = this.fingerprint(key, part, password);
+    let entry = this.entries.get(id);
+    if (entry) {
+      // Move to the most recently used end
+      this.entries.delete(id);
+    } else {
+      const pkey = readKey(this.fns, this.arena, key, part, password);
+      entry = { pkey, type: this.fns.typeName(pkey) };
+      this.evict(this.capacity - 1);
+    }
+    this.entries.set(id, entry);
+
+    if (this.fns.upRef(entry.pkey) !== 1) {
+      throw new Error(`Failed to reference key: ${this.fns.error()}`);
+    }
+    return new KeyHandle(this.fns, this.arena, entry.pkey, isPrivate, entry.type);
+  }
+
+  /**
+   * Release every cached key. Handles already returned stay usable.
+   */
+  clear(): void {
+    this.evict(0);
+  }
+
+  // Drop least recently used keys until at most size remain
+  private evict(size: number): void {
+    for (const [id, entry] of this.entries) {
+      if (this.entries.size <= size) {
+        return;
+      }
+      this.entries.delete(id);
+      this.fns.free(entry.pkey);
+    }
+  }
+
+  // SHA-256 over the part, the encoding and, for private keys, the
+  // password, so a cached decryption is never reused with another password
+  private fingerprint(key: KeyData, part: 'private' | 'public', password?: string): string {
+    const encoded = typeof key === 'string' ? this.encoder.encode(key) : key;
+    const passwordData = part === 'private' && password ? this.encoder.encode(password) : new Uint8Array(0);
+
+    // Header: part, PEM or DER, and the encoding length so the encoding and
+    // password cannot run into each other
+    const input = new Uint8Array(6 + encoded.length + passwordData.length);
+    input[0] = part === 'private' ? 1 : 0;
+    input[1] = typeof key === 'string' ? 1 : 0;
+    new DataView(input.buffer).setUint32(2, encoded.length, true);
+    input.set(encoded, 6);
+    input.set(passwordData, 6 + encoded.length);
+
+    const digest = this.digest(input);
+    if (part === 'private') {
+      input.fill(0);
+      if (typeof key === 'string') {
+        encoded.fill(0);
+      }
+    }
+    return String.fromCharCode(...digest);
+  }
+}
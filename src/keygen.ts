@@ -0,0 +1,223 @@
+/**
+ * Non-blocking key generation with a pre-generated key pool
+ */
+
+import type { OpenSSLOptions } from './index';
+import { WorkerPool } from './pool';
+import { KeyPair, KeyPairOptions, KeygenProgress, keyPairOptionsId, normalizeKeyPairOptions } from './pkey';
+
+export interface KeyGeneratorOptions extends OpenSSLOptions {
+  /**
+   * URL of the worker script (default: openssl.worker.js next to this bundle)
+   */
+  workerUrl?: string | URL;
+}
+
+export interface GenerateKeyPairOptions {
+  /**
+   * Called with the key generation progress reported by OpenSSL
+   */
+  onProgress?: KeygenProgress;
+  /**
+   * Cancels the generation; the promise rejects and the worker is stopped
+   */
+  signal?: AbortSignal;
+}
+
+interface PoolTarget {
+  options: KeyPairOptions;
+  count: number;
+  keys: KeyPair[];
+}
+
+/**
+ * Resolve once the main thread is idle
+ */
+function whenIdle(): Promise<void> {
+  return new Promise(resolve => {
+    if (typeof requestIdleCallback === 'function') {
+      requestIdleCallback(() => resolve());
+    } else {
+      setTimeout(resolve, 0);
+    }
+  });
+}
+
+/**
+ * Generates key pairs in workers so the calling thread never blocks.
+ *
+ * Each foreground generateKeyPair() runs on its own worker, which is what
+ * makes cancellation possible: cancelling terminates that worker. A single
+ * background worker keeps the pools set up with prefill() topped up during
+ * idle time, so interactive flows can take a ready key at once.
+ */
+export class KeyGenerator {
+  private options: KeyGeneratorOptions;
+  private idle: Promise<WorkerPool> | null = null;
+  private background: Promise<WorkerPool> | null = null;
+  // Workers running a foreground request, with the request's reject
+  private foreground = new Map<Promise<WorkerPool>, (error: Error) => void>();
+  private targets = new Map<string, PoolTarget>();
+  private refilling = false;
+  private terminated = false;
+
+  /**
+   * Constructor - should not be called directly, use OpenSSLWasmJS.createKeyGenerator() instead
+   */
+  constructor(options: KeyGeneratorOptions = {}) {
+    this.options = options;
+  }
+
+  /**
+   * Generate a key pair, taking a pre-generated one from the pool if available
+   */
+  async generateKeyPair(params: KeyPairOptions = {}, options: GenerateKeyPairOptions = {}): Promise<KeyPair> {
+    this.checkOpen();
+
+    const target = this.targets.get(keyPairOptionsId(params));
+    const pooled = target?.keys.shift();
+    if (pooled) {
+      this.scheduleRefill();
+      return pooled;
+    }
+
+    return this.generateInForeground(normalizeKeyPairOptions(params), options);
+  }
+
+  /**
+   * Keep count pre-generated key pairs of this shape available. The pool is
+   * filled in the background during idle time, one key at a time.
+   */
+  prefill(params: KeyPairOptions, count: number): void {
+    this.checkOpen();
+
+    const id = keyPairOptionsId(params);
+    const target = this.targets.get(id);
+    if (target) {
+      target.count = count;
+      target.keys.splice(count);
+    } else {
+      this.targets.set(id, { options: normalizeKeyPairOptions(params), count, keys: [] });
+    }
+
+    this.scheduleRefill();
+  }
+
+  /**
+   * Number of pre-generated key pairs of this shape ready to be taken
+   */
+  available(params: KeyPairOptions = {}): number {
+    return this.targets.get(keyPairOptionsId(params))?.keys.length ?? 0;
+  }
+
+  /**
+   * Stop all workers and drop the pre-generated keys. Requests still in
+   * progress are rejected.
+   */
+  terminate(): void {
+    this.terminated = true;
+    this.targets.clear();
+    for (const worker of [this.idle, this.background, ...this.foreground.keys()]) {
+      worker?.then(pool => pool.terminate(), () => undefined);
+    }
+    for (const reject of this.foreground.values()) {
+      reject(new Error('KeyGenerator has been terminated'));
+    }
+    this.foreground.clear();
+    this.idle = null;
+    this.background = null;
+  }
+
+  private async generateInForeground(params: KeyPairOptions, options: GenerateKeyPairOptions): Promise<KeyPair> {
+    const { onProgress, signal } = options;
+    if (signal?.aborted) {
+      throw new Error('Key generation cancelled');
+    }
+
+    // Take the idle worker, or start a new one if it is busy
+    const worker = this.idle ?? this.startWorker();
+    this.idle = null;
+
+    return new Promise<KeyPair>((resolve, reject) => {
+      const onAbort = () => {
+        reject(new Error('Key generation cancelled'));
+        worker.then(pool => pool.terminate(), () => undefined);
+      };
+      signal?.addEventListener('abort', onAbort, { once: true });
+      this.foreground.set(worker, reject);
+
+      worker
+        .then(pool => pool.call('generateKeyPair', params, onProgress))
+        .then(keyPair => {
+          // Keep the worker for the next request unless one is already idle
+          if (!this.terminated && this.idle === null && !signal?.aborted) {
+            this.idle = worker;
+          } else {
+            worker.then(pool => pool.terminate());
+          }
+          resolve(keyPair);
+        }, error => {
+          worker.then(pool => pool.terminate(), () => undefined);
+          reject(error);
+        })
+        .finally(() => {
+          signal?.removeEventListener('abort', onAbort);
+          this.foreground.delete(worker);
+        });
+    });
+  }
+
+  private scheduleRefill(): void {
+    if (this.refilling || this.terminated) {
+      return;
+    }
+    this.refilling = true;
+    this.refill().finally(() => {
+      this.refilling = false;
+    });
+  }
+
+  private async refill(): Promise<void> {
+    for (;;) {
+      let target: PoolTarget | undefined;
+      for (const candidate of this.targets.values()) {
+        if (candidate.keys.length < candidate.count) {
+          target = candidate;
+          break;
+        }
+      }
+      if (!target || this.terminated) {
+        return;
+      }
+
+      await whenIdle();
+      if (this.terminated) {
+        return;
+      }
+
+      this.background = this.background ?? this.startWorker();
+      try {
+        const keyPair = await (await this.background).call('generateKeyPair', target.options);
+        if (target.keys.length < target.count) {
+          target.keys.push(keyPair);
+        }
+      } catch (e) {
+        // Stop refilling on failure; the next request retries on a new worker
+        this.background?.then(pool => pool.terminate(), () => undefined);
+        this.background = null;
+        return;
+      }
+    }
+  }
+
+  private startWorker(): Promise<WorkerPool> {
+    const { workerUrl, ...openSSLOptions } = this.options;
+    return WorkerPool.create({ ...openSSLOptions, workerUrl, size: 1 });
+  }
+
+  private checkOpen(): void {
+    if (this.terminated) {
+      throw new Error('KeyGenerator has been terminated');
+    }
+  }
+}
@@ -0,0 +1,356 @@
+/**
+ * WebAssembly module loading and build variant selection
+ */
+
+import type { OpenSSLWasmInstance } from './index';
+
+/**
+ * Build variants produced by scripts/build-wasm.js
+ */
+export type WasmVariant = 'baseline' | 'simd';
+
+/**
+ * Size tiers produced by scripts/build-wasm.js, smallest first. Each tier
+ * contains everything in the tiers before it:
+ *
+ * - hash: random bytes, digests, HMAC, KDFs and base64
+ * - cipher: adds AES, ChaCha20-Poly1305 and the other symmetric ciphers
+ * - pkey: adds key generation, import/export, signatures and encryption
+ * - tls: adds certificates, trust stores and TLS connections (the full build)
+ */
+export type WasmTier = 'hash' | 'cipher' | 'pkey' | 'tls';
+
+export const WASM_TIERS: readonly WasmTier[] = ['hash', 'cipher', 'pkey', 'tls'];
+
+/**
+ * Emscripten instantiation hook: instantiate the module with the given
+ * imports and hand the result to receiveInstance
+ */
+interface ModuleArguments {
+  instantiateWasm?: (
+    imports: WebAssembly.Imports,
+    receiveInstance: (instance: WebAssembly.Instance, module: WebAssembly.Module) => void
+  ) => object;
+}
+
+type ModuleFactory = (moduleArg?: ModuleArguments) => Promise<OpenSSLWasmInstance>;
+
+/**
+ * An Emscripten glue module. scripts/build-wasm.js appends wasmDigest, a
+ * content hash of the matching .wasm file.
+ */
+interface GlueModule {
+  default: ModuleFactory;
+  wasmDigest?: string;
+}
+
+/**
+ * Name of the Cache API cache compiled modules are fetched through
+ */
+export const DEFAULT_WASM_CACHE = 'openssl-wasm-js';
+
+export interface WasmLoadOptions {
+  /**
+   * Already compiled module for this variant and tier, e.g. one posted from
+   * another thread. Skips fetching and compiling entirely.
+   */
+  module?: WebAssembly.Module;
+  /**
+   * Cache API cache the .wasm file is stored in, so later page loads skip
+   * the download and browsers that keep code caches for cached responses
+   * skip compilation too. `true` uses DEFAULT_WASM_CACHE; `false` fetches
+   * from the network (and HTTP cache) every time.
+   */
+  cache?: boolean | string;
+}
+
+// Dynamic imports so a bundler emits each module as its own chunk and only
+// the selected one is fetched
+const MODULES: Record<WasmTier, Record<WasmVariant, () => Promise<GlueModule>>> = {
+  hash: {
+    baseline: () => import('../dist/openssl-wasm-hash'),
+    simd: () => import('../dist/openssl-wasm-hash-simd')
+  },
+  cipher: {
+    baseline: () => import('../dist/openssl-wasm-cipher'),
+    simd: () => import('../dist/openssl-wasm-cipher-simd')
+  },
+  pkey: {
+    baseline: () => import('../dist/openssl-wasm-pkey'),
+    simd: () => import('../dist/openssl-wasm-pkey-simd')
+  },
+  tls: {
+    baseline: () => import('../dist/openssl-wasm'),
+    simd: () => import('../dist/openssl-wasm-simd')
+  }
+};
+
+/**
+ * Smallest module using a SIMD128 instruction:
+ * (module (func (result v128) i32.const 0 i8x16.splat i8x16.popcnt))
+ */
+const SIMD_PROBE = new Uint8Array([
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x05, 0x01, 0x60,
+  0x00, 0x01, 0x7b, 0x03, 0x02, 0x01, 0x00, 0x0a, 0x0a, 0x01, 0x08, 0x00,
+  0x41, 0x00, 0xfd, 0x0f, 0xfd, 0x62, 0x0b
+]);
+
+let simdSupported: boolean | undefined;
+
+/**
+ * Check whether the runtime supports WebAssembly SIMD128. The probe is
+ * validated once and the result cached.
+ */
+export function supportsWasmSimd(): boolean {
+  if (simdSupported === undefined) {
+    try {
+      simdSupported = typeof WebAssembly === 'object' && WebAssembly.validate(SIMD_PROBE);
+    } catch (e) {
+      simdSupported = false;
+    }
+  }
+  return simdSupported;
+}
+
+/**
+ * Resolve the variant to load. `true` and `false` force a variant; anything
+ * else picks SIMD when the runtime supports it.
+ */
+export function selectVariant(simd?: boolean | 'auto'): WasmVariant {
+  if (simd === true) {
+    if (!supportsWasmSimd()) {
+      throw new Error('WebAssembly SIMD is not supported in this environment');
+    }
+    return 'simd';
+  }
+  if (simd === false) {
+    return 'baseline';
+  }
+  return supportsWasmSimd() ? 'simd' : 'baseline';
+}
+
+/**
+ * Resolve the smallest tier that covers every requested feature. Without
+ * features the full build is used.
+ */
+export function selectTier(features?: WasmTier[]): WasmTier {
+  if (!features || features.length === 0) {
+    return 'tls';
+  }
+  let level = 0;
+  for (const feature of features) {
+    const index = WASM_TIERS.indexOf(feature);
+    if (index < 0) {
+      throw new Error(`Unknown feature tier: ${feature}`);
+    }
+    level = Math.max(level, index);
+  }
+  return WASM_TIERS[level];
+}
+
+/**
+ * URL of the .wasm file for a variant and tier. The bundles sit next to the
+ * modules in dist/, as the Emscripten glue does.
+ */
+export function wasmUrl(variant: WasmVariant, tier: WasmTier = 'tls'): URL {
+  const name = tier === 'tls' ? 'openssl-wasm' : `openssl-wasm-${tier}`;
+  return new URL(`./${name}${variant === 'simd' ? '-simd' : ''}.wasm`, import.meta.url);
+}
+
+// Compiled modules by variant and tier, shared by every instance in this
+// realm. Compiling is most of the cost of a cold start; instantiating a
+// compiled module is cheap.
+const compiledModules = new Map<string, Promise<WebAssembly.Module>>();
+
+/**
+ * Compile the module for a variant and tier once and return the same
+ * WebAssembly.Module on every later call. The result can be posted to
+ * workers, which then only need to instantiate it.
+ */
+export function compileWasmModule(variant: WasmVariant, tier: WasmTier = 'tls', cache: boolean | string = true): Promise<WebAssembly.Module> {
+  const key = `${tier}/${variant}`;
+  let compiled = compiledModules.get(key);
+  if (!compiled) {
+    compiled = MODULES[tier][variant]().then(glue => compileFrom(wasmUrl(variant, tier), cacheName(cache), glue.wasmDigest));
+    // A failed compile is not cached, so a later call can retry
+    compiled.catch(() => compiledModules.delete(key));
+    compiledModules.set(key, compiled);
+  }
+  return compiled;
+}
+
+/**
+ * Delete the modules stored by the Cache API. Entries are keyed on a hash
+ * of each module, so a new build at the same URL is fetched without this.
+ */
+export async function clearWasmCache(name: string = DEFAULT_WASM_CACHE): Promise<boolean> {
+  if (typeof caches === 'undefined') {
+    return false;
+  }
+  return caches.delete(name);
+}
+
+function cacheName(cache: boolean | string): string | null {
+  return cache === true ? DEFAULT_WASM_CACHE : cache || null;
+}
+
+// Cache API key of a build: the .wasm URL plus its content hash. Fragments
+// are ignored when matching, so the hash goes in the query.
+function cacheKey(url: URL, digest: string | undefined): string {
+  if (!digest) {
+    return url.href;
+  }
+  const key = new URL(url.href);
+  key.searchParams.set('v', digest);
+  return key.href;
+}
+
+async function compileFrom(url: URL, name: string | null, digest?: string, reload: boolean = false): Promise<WebAssembly.Module> {
+  if (url.protocol === 'file:' && typeof process === 'object' && process.versions?.node) {
+    // Node (and Deno and Bun, which report it too): fetch does not support
+    // file: URLs there. The specifier is a variable so bundlers leave it
+    // alone in browser builds.
+    const fsModule = 'node:fs/promises';
+    const { readFile } = await import(/* webpackIgnore: true */ /* @vite-ignore */ fsModule);
+    return WebAssembly.compile(await readFile(url));
+  }
+
+  const cache = name ? await openCache(name) : null;
+  const key = cacheKey(url, digest);
+  const cached = cache && !reload ? await cache.match(key) : undefined;
+  if (cache && cached) {
+    try {
+      return await compileResponse(cached);
+    } catch (e) {
+      // A truncated entry; drop it and fetch a fresh copy
+      await cache.delete(key);
+    }
+  }
+
+  // After a failed instantiation the HTTP cache may hold the same stale
+  // copy, so revalidate it
+  const response = await fetch(url.href, reload ? { cache: 'no-cache' } : undefined);
+  if (!response.ok) {
+    throw new Error(`Failed to fetch ${url.href}: ${response.status}`);
+  }
+  if (cache) {
+    // Store a copy in the background, replacing other builds of the same
+    // file; compilation reads the original
+    storeResponse(cache, url, key, response.clone()).catch(() => undefined);
+  }
+  return compileResponse(response);
+}
+
+async function storeResponse(cache: Cache, url: URL, key: string, response: Response): Promise<void> {
+  await cache.put(key, response);
+  for (const request of await cache.keys(url.href, { ignoreSearch: true })) {
+    if (request.url !== key) {
+      await cache.delete(request);
+    }
+  }
+}
+
+// Forget a compiled module that failed to instantiate, along with its
+// Cache API entry, and compile a fresh copy from the network
+async function recompileWasmModule(variant: WasmVariant, tier: WasmTier, cache: boolean | string): Promise<WebAssembly.Module> {
+  const key = `${tier}/${variant}`;
+  const glue = await MODULES[tier][variant]();
+  const url = wasmUrl(variant, tier);
+  const name = cacheName(cache);
+  const opened = name ? await openCache(name) : null;
+  if (opened) {
+    await opened.delete(url.href, { ignoreSearch: true });
+  }
+
+  const compiled = compileFrom(url, name, glue.wasmDigest, true);
+  compiled.catch(() => compiledModules.delete(key));
+  compiledModules.set(key, compiled);
+  return compiled;
+}
+
+function compileResponse(response: Response): Promise<WebAssembly.Module> {
+  // compileStreaming compiles while the bytes arrive, but insists on the
+  // application/wasm content type
+  if (typeof WebAssembly.compileStreaming === 'function' && response.headers.get('Content-Type') === 'application/wasm') {
+    return WebAssembly.compileStreaming(response);
+  }
+  return response.arrayBuffer().then(bytes => WebAssembly.compile(bytes));
+}
+
+async function openCache(name: string): Promise<Cache | null> {
+  if (typeof caches === 'undefined') {
+    return null;
+  }
+  try {
+    return await caches.open(name);
+  } catch (e) {
+    // Storage is unavailable, e.g. in private browsing or opaque origins
+    return null;
+  }
+}
+
+/**
+ * Instantiate the Emscripten module for a build variant and tier from the
+ * shared compiled module. If the module cannot be compiled here (for
+ * example a bundler renamed the .wasm asset), the Emscripten glue loads it
+ * its own way instead.
+ */
+export async function loadWasmModule(variant: WasmVariant, tier: WasmTier = 'tls', options: WasmLoadOptions = {}): Promise<OpenSSLWasmInstance> {
+  const [{ default: factory }, module] = await Promise.all([
+    MODULES[tier][variant](),
+    options.module
+      ? Promise.resolve(options.module)
+      : compileWasmModule(variant, tier, options.cache ?? true).catch(() => null)
+  ]);
+
+  let instance: OpenSSLWasmInstance;
+  if (!module) {
+    instance = await factory();
+  } else if (options.module) {
+    instance = await instantiate(factory, module);
+  } else {
+    try {
+      instance = await instantiate(factory, module);
+    } catch (e) {
+      // A module that compiles but does not fit this glue (a LinkError
+      // after a deploy) came from a stale cache entry: evict it, then retry
+      // once with a fresh copy
+      const fresh = await recompileWasmModule(variant, tier, options.cache ?? true);
+      instance = await instantiate(factory, fresh);
+    }
+  }
+  if (tier !== 'tls') {
+    guardMissingExports(instance, tier);
+  }
+  return instance;
+}
+
+function instantiate(factory: ModuleFactory, module: WebAssembly.Module): Promise<OpenSSLWasmInstance> {
+  return new Promise((resolve, reject) => {
+    factory({
+      instantiateWasm(imports, receiveInstance) {
+        // Emscripten waits for receiveInstance, so report failures here
+        WebAssembly.instantiate(module, imports).then(wasmInstance => receiveInstance(wasmInstance, module), reject);
+        return {};
+      }
+    }).then(resolve, reject);
+  });
+}
+
+/**
+ * Make glue functions left out of a smaller tier fail when called, with a
+ * message pointing at the features option, rather than when they are bound.
+ * Wrappers bind every function up front, so binding itself must not throw.
+ */
+function guardMissingExports(instance: OpenSSLWasmInstance, tier: WasmTier): void {
+  const cwrap = instance.cwrap.bind(instance);
+  const module = instance as unknown as Record<string, unknown>;
+  instance.cwrap = (name: string, returnType: string, argTypes: string[]) => {
+    if (typeof module['_' + name] !== 'function') {
+      return () => {
+        throw new Error(`${name} is not in the '${tier}' build; initialize with a features list that includes the tier it belongs to`);
+      };
+    }
+    return cwrap(name, returnType, argTypes);
+  };
+}
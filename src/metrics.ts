@@ -0,0 +1,360 @@
+/**
+ * Opt-in counters and timing for wrapper calls
+ */
+
+import type { OpenSSLWasmInstance } from './index';
+import type { ScratchArena } from './arena';
+import { HeapBuffer } from './heap';
+
+/**
+ * Measurements for one top-level call of an OpenSSL method
+ */
+export interface OperationEvent {
+  /**
+   * Method name, e.g. 'sha256'
+   */
+  operation: string;
+  /**
+   * performance.now() when the call started
+   */
+  startTime: number;
+  /**
+   * Wall time in milliseconds, including the wrapper's own work
+   */
+  duration: number;
+  /**
+   * Part of duration spent inside glue functions
+   */
+  nativeTime: number;
+  /**
+   * Bytes of data passed in (typed arrays and strings, including arrays of them)
+   */
+  bytes: number;
+  /**
+   * Copies into and out of the heap through the scratch arena
+   */
+  copies: number;
+  copiedBytes: number;
+  /**
+   * Bytes requested from _malloc
+   */
+  mallocBytes: number;
+  /**
+   * Number of times the WASM memory grew
+   */
+  memoryGrowths: number;
+  /**
+   * Heap size in bytes when the call returned
+   */
+  heapSize: number;
+}
+
+/**
+ * Receives one event per top-level operation
+ */
+export type MetricsSink = (event: OperationEvent) => void;
+
+export interface MetricsOptions {
+  /**
+   * Called after every operation, e.g. performanceSink() or a RUM reporter
+   */
+  sink?: MetricsSink;
+}
+
+export interface OperationTotals {
+  calls: number;
+  bytes: number;
+  time: number;
+  nativeTime: number;
+  copies: number;
+  copiedBytes: number;
+  mallocBytes: number;
+  memoryGrowths: number;
+}
+
+export interface FunctionTotals {
+  calls: number;
+  time: number;
+}
+
+export interface MetricsSnapshot {
+  /**
+   * Totals per OpenSSL method
+   */
+  operations: Record<string, OperationTotals>;
+  /**
+   * Calls and time per glue function, including calls made by handles
+   * (Hash, Cipher, KeyHandle, ...) outside any OpenSSL method
+   */
+  functions: Record<string, FunctionTotals>;
+  mallocBytes: number;
+  memoryGrowths: number;
+  heapSize: number;
+}
+
+/**
+ * Sink that records each operation as a User Timing measure named
+ * `${prefix}:${operation}` with the event as its detail, for
+ * PerformanceObserver({ entryTypes: ['measure'] }) to pick up.
+ */
+export function performanceSink(prefix: string = 'openssl'): MetricsSink {
+  return event => {
+    performance.measure(`${prefix}:${event.operation}`, {
+      start: event.startTime,
+      duration: event.duration,
+      detail: event
+    });
+  };
+}
+
+function emptyTotals(): OperationTotals {
+  return { calls: 0, bytes: 0, time: 0, nativeTime: 0, copies: 0, copiedBytes: 0, mallocBytes: 0, memoryGrowths: 0 };
+}
+
+// Bytes of data in a method argument
+function argumentBytes(value: unknown): number {
+  if (typeof value === 'string') {
+    return value.length;
+  }
+  if (ArrayBuffer.isView(value)) {
+    return value.byteLength;
+  }
+  if (value instanceof HeapBuffer) {
+    return value.length;
+  }
+  if (Array.isArray(value)) {
+    let total = 0;
+    for (const item of value) {
+      total += argumentBytes(item);
+    }
+    return total;
+  }
+  return 0;
+}
+
+/**
+ * Counters for one OpenSSL instance.
+ *
+ * Created only when the metrics option is set; otherwise nothing is wrapped
+ * and no call pays for instrumentation. When enabled, the module's cwrap and
+ * _malloc are replaced before any glue function is bound, so every glue call
+ * is timed, and the arena copy helpers and the OpenSSL methods are wrapped
+ * on their instances. Calls an OpenSSL method makes to other methods count
+ * towards the outer call only.
+ */
+export class Metrics {
+  private instance: OpenSSLWasmInstance;
+  private sink: MetricsSink | undefined;
+  private operations = new Map<string, OperationTotals>();
+  private functions = new Map<string, FunctionTotals>();
+  private mallocBytes = 0;
+  private memoryGrowths = 0;
+  private lastHeapSize: number;
+
+  // State of the operation in progress; depth > 0 while one is running
+  private depth = 0;
+  private current: OperationTotals = emptyTotals();
+
+  /**
+   * Constructor - should not be called directly, enable with the metrics option instead
+   */
+  constructor(instance: OpenSSLWasmInstance, options: MetricsOptions = {}) {
+    this.instance = instance;
+    this.sink = options.sink;
+    this.lastHeapSize = instance.HEAPU8.byteLength;
+    this.hookModule();
+  }
+
+  /**
+   * Totals since creation or the last reset()
+   */
+  snapshot(): MetricsSnapshot {
+    const operations: Record<string, OperationTotals> = {};
+    for (const [name, totals] of this.operations) {
+      operations[name] = { ...totals };
+    }
+    const functions: Record<string, FunctionTotals> = {};
+    for (const [name, totals] of this.functions) {
+      functions[name] = { ...totals };
+    }
+    return {
+      operations,
+      functions,
+      mallocBytes: this.mallocBytes,
+      memoryGrowths: this.memoryGrowths,
+      heapSize: this.instance.HEAPU8.byteLength
+    };
+  }
+
+  /**
+   * Zero every counter
+   */
+  reset(): void {
+    this.operations.clear();
+    // Bound glue functions keep their totals objects, so zero them in place
+    for (const totals of this.functions.values()) {
+      totals.calls = 0;
+      totals.time = 0;
+    }
+    this.mallocBytes = 0;
+    this.memoryGrowths = 0;
+  }
+
+  /**
+   * Count copies made through an arena
+   */
+  attachArena(arena: ScratchArena): void {
+    const copyIn = arena.copyIn.bind(arena);
+    const copyOut = arena.copyOut.bind(arena);
+    const packMessages = arena.packMessages.bind(arena);
+
+    arena.copyIn = (data: Uint8Array) => {
+      this.countCopy(data.length);
+      return copyIn(data);
+    };
+    arena.copyOut = (ptr: number, len: number) => {
+      this.countCopy(len);
+      return copyOut(ptr, len);
+    };
+    arena.packMessages = (messages: Uint8Array[]) => {
+      this.countCopy(argumentBytes(messages));
+      return packMessages(messages);
+    };
+  }
+
+  /**
+   * Time every method of target, an OpenSSL instance
+   */
+  attachOperations(target: object, names: string[]): void {
+    const methods = target as Record<string, Function>;
+    for (const name of names) {
+      const method = methods[name];
+      const metrics = this;
+      methods[name] = function (this: unknown, ...args: unknown[]) {
+        return metrics.runOperation(name, method, this, args);
+      };
+    }
+  }
+
+  private runOperation(name: string, method: Function, self: unknown, args: unknown[]): unknown {
+    if (this.depth > 0) {
+      return method.apply(self, args);
+    }
+
+    const outer = this.current;
+    const totals = emptyTotals();
+    totals.bytes = argumentBytes(args);
+    this.current = totals;
+    this.depth++;
+    const startTime = performance.now();
+    let result: unknown;
+    try {
+      result = method.apply(self, args);
+    } catch (e) {
+      this.depth--;
+      this.current = outer;
+      this.finish(name, totals, startTime);
+      throw e;
+    }
+    this.depth--;
+    this.current = outer;
+
+    // Async methods are timed until they settle; glue calls made after the
+    // first await show up in the per-function totals only
+    if (result instanceof Promise) {
+      return result.finally(() => this.finish(name, totals, startTime));
+    }
+    this.finish(name, totals, startTime);
+    return result;
+  }
+
+  private finish(name: string, totals: OperationTotals, startTime: number): void {
+    const duration = performance.now() - startTime;
+    let aggregate = this.operations.get(name);
+    if (!aggregate) {
+      aggregate = emptyTotals();
+      this.operations.set(name, aggregate);
+    }
+    aggregate.calls++;
+    aggregate.bytes += totals.bytes;
+    aggregate.time += duration;
+    aggregate.nativeTime += totals.nativeTime;
+    aggregate.copies += totals.copies;
+    aggregate.copiedBytes += totals.copiedBytes;
+    aggregate.mallocBytes += totals.mallocBytes;
+    aggregate.memoryGrowths += totals.memoryGrowths;
+
+    if (this.sink) {
+      this.sink({
+        operation: name,
+        startTime,
+        duration,
+        nativeTime: totals.nativeTime,
+        bytes: totals.bytes,
+        copies: totals.copies,
+        copiedBytes: totals.copiedBytes,
+        mallocBytes: totals.mallocBytes,
+        memoryGrowths: totals.memoryGrowths,
+        heapSize: this.instance.HEAPU8.byteLength
+      });
+    }
+  }
+
+  private countCopy(bytes: number): void {
+    if (this.depth > 0) {
+      this.current.copies++;
+      this.current.copiedBytes += bytes;
+    }
+  }
+
+  private checkGrowth(): void {
+    const heapSize = this.instance.HEAPU8.byteLength;
+    if (heapSize !== this.lastHeapSize) {
+      this.lastHeapSize = heapSize;
+      this.memoryGrowths++;
+      if (this.depth > 0) {
+        this.current.memoryGrowths++;
+      }
+    }
+  }
+
+  private hookModule(): void {
+    const instance = this.instance;
+    const cwrap = instance.cwrap.bind(instance);
+    const malloc = instance._malloc.bind(instance);
+
+    instance.cwrap = (name: string, returnType: string, argTypes: string[]) => {
+      const fn = cwrap(name, returnType, argTypes);
+      let totals = this.functions.get(name);
+      if (!totals) {
+        totals = { calls: 0, time: 0 };
+        this.functions.set(name, totals);
+      }
+      const functionTotals = totals;
+      return (...args: unknown[]) => {
+        const start = performance.now();
+        try {
+          return fn(...args);
+        } finally {
+          const elapsed = performance.now() - start;
+          functionTotals.calls++;
+          functionTotals.time += elapsed;
+          if (this.depth > 0) {
+            this.current.nativeTime += elapsed;
+          }
+          this.checkGrowth();
+        }
+      };
+    };
+
+    instance._malloc = (size: number) => {
+      this.mallocBytes += size;
+      if (this.depth > 0) {
+        this.current.mallocBytes += size;
+      }
+      const ptr = malloc(size);
+      this.checkGrowth();
+      return ptr;
+    };
+  }
+}
@@ -0,0 +1,23 @@
+/**
+ * worker_threads entry point for the Node worker pool (see createNodePool)
+ */
+
+import { parentPort } from 'worker_threads';
+import { serve, WorkerScope } from './serve';
+
+if (!parentPort) {
+  throw new Error('openssl.node-worker.js must be started as a worker thread');
+}
+
+const port = parentPort;
+const scope: WorkerScope = {
+  onmessage: null,
+  postMessage(message, transfer) {
+    port.postMessage(message, transfer as any);
+  }
+};
+port.on('message', data => {
+  scope.onmessage?.({ data } as MessageEvent);
+});
+
+serve(scope);
@@ -0,0 +1,230 @@
+/**
+ * Node entry point: everything in the main entry plus stream.Transform
+ * adapters, file hashing and a worker_threads pool
+ */
+
+import { Transform, TransformCallback } from 'stream';
+import { createReadStream } from 'fs';
+import { Worker as WorkerThread } from 'worker_threads';
+import os from 'os';
+import OpenSSLWasmJS, { OpenSSL, Hash, Cipher, CipherOptions, WorkerPool, WorkerPoolOptions } from './index';
+import type { PoolWorkerLike, WorkerRequest, WorkerResponse } from './pool';
+
+export * from './index';
+export default OpenSSLWasmJS;
+
+/**
+ * Read size for hashFile(), matching the window Hash feeds the heap with
+ */
+export const FILE_READ_SIZE = 64 * 1024;
+
+// View a result as a Buffer without copying it
+function toBuffer(data: Uint8Array): Buffer {
+  return Buffer.from(data.buffer, data.byteOffset, data.length);
+}
+
+export interface HashStreamOptions {
+  /**
+   * Pass the input through unchanged and report the digest only through
+   * the 'digest' event and the digest property (default: false, in which
+   * case the digest is the stream's only output)
+   */
+  passThrough?: boolean;
+}
+
+/**
+ * Transform that hashes everything written to it.
+ *
+ * Created with createHashStream(). When the input ends, the digest is
+ * emitted as a 'digest' event, kept in digest, and pushed as the only output
+ * chunk unless passThrough is set.
+ */
+export class HashTransform extends Transform {
+  private hash: Hash;
+  private passThrough: boolean;
+
+  /**
+   * The digest, once the input has ended
+   */
+  digest: Uint8Array | null = null;
+
+  /**
+   * Constructor - should not be called directly, use createHashStream() instead
+   */
+  constructor(hash: Hash, options: HashStreamOptions = {}) {
+    super();
+    this.hash = hash;
+    this.passThrough = options.passThrough ?? false;
+  }
+
+  _transform(chunk: Buffer, encoding: BufferEncoding, callback: TransformCallback): void {
+    try {
+      this.hash.update(chunk);
+      callback(null, this.passThrough ? chunk : undefined);
+    } catch (e) {
+      callback(e as Error);
+    }
+  }
+
+  _flush(callback: TransformCallback): void {
+    try {
+      this.digest = this.hash.digest();
+      this.emit('digest', this.digest);
+      callback(null, this.passThrough ? undefined : toBuffer(this.digest));
+    } catch (e) {
+      callback(e as Error);
+    }
+  }
+
+  _destroy(error: Error | null, callback: (error: Error | null) => void): void {
+    this.hash.dispose();
+    callback(error);
+  }
+}
+
+/**
+ * Transform that encrypts or decrypts everything written to it.
+ *
+ * Created with createCipherStream() or createDecipherStream(). For AEAD
+ * ciphers, read the tag with getAuthTag() after the stream ends when
+ * encrypting, and supply it with setAuthTag() before ending the input when
+ * decrypting; the stream then fails with 'Authentication failed' if the
+ * data was modified. Decrypted output must not be trusted before the
+ * stream has ended successfully.
+ */
+export class CipherTransform extends Transform {
+  private cipher: Cipher;
+
+  /**
+   * Constructor - should not be called directly, use createCipherStream()
+   * or createDecipherStream() instead
+   */
+  constructor(cipher: Cipher) {
+    super();
+    this.cipher = cipher;
+  }
+
+  /**
+   * Feed additional authenticated data (AEAD only, before writing any data)
+   */
+  setAAD(aad: Uint8Array | string): this {
+    this.cipher.setAAD(aad);
+    return this;
+  }
+
+  /**
+   * Set the expected authentication tag (AEAD decryption only, before end())
+   */
+  setAuthTag(tag: Uint8Array): this {
+    this.cipher.setAuthTag(tag);
+    return this;
+  }
+
+  /**
+   * Get the authentication tag (AEAD encryption only, after the stream ends)
+   */
+  getAuthTag(): Uint8Array {
+    return this.cipher.getAuthTag();
+  }
+
+  _transform(chunk: Buffer, encoding: BufferEncoding, callback: TransformCallback): void {
+    try {
+      const output = this.cipher.update(chunk);
+      callback(null, output.length > 0 ? toBuffer(output) : undefined);
+    } catch (e) {
+      callback(e as Error);
+    }
+  }
+
+  _flush(callback: TransformCallback): void {
+    try {
+      const output = this.cipher.final();
+      callback(null, output.length > 0 ? toBuffer(output) : undefined);
+    } catch (e) {
+      callback(e as Error);
+    }
+  }
+
+  _destroy(error: Error | null, callback: (error: Error | null) => void): void {
+    this.cipher.dispose();
+    callback(error);
+  }
+}
+
+/**
+ * Create a Transform that hashes its input with the given algorithm
+ */
+export function createHashStream(openssl: OpenSSL, algorithm: string, options?: HashStreamOptions): HashTransform {
+  return new HashTransform(openssl.createHash(algorithm), options);
+}
+
+/**
+ * Create an encrypting Transform (AES-CBC unless options.algorithm is given)
+ */
+export function createCipherStream(openssl: OpenSSL, key: Uint8Array, iv: Uint8Array, options?: CipherOptions): CipherTransform {
+  return new CipherTransform(openssl.createCipher(key, iv, options));
+}
+
+/**
+ * Create a decrypting Transform (AES-CBC unless options.algorithm is given)
+ */
+export function createDecipherStream(openssl: OpenSSL, key: Uint8Array, iv: Uint8Array, options?: CipherOptions): CipherTransform {
+  return new CipherTransform(openssl.createDecipher(key, iv, options));
+}
+
+/**
+ * Hash a file without reading it into memory at once
+ */
+export async function hashFile(openssl: OpenSSL, algorithm: string, path: string | URL): Promise<Uint8Array> {
+  const hash = openssl.createHash(algorithm);
+  try {
+    for await (const chunk of createReadStream(path, { highWaterMark: FILE_READ_SIZE })) {
+      hash.update(chunk as Buffer);
+    }
+    return hash.digest();
+  } finally {
+    hash.dispose();
+  }
+}
+
+/**
+ * worker_threads Worker behind the interface WorkerPool expects of a Worker
+ */
+class ThreadWorker implements PoolWorkerLike {
+  onmessage: ((event: MessageEvent<WorkerResponse>) => void) | null = null;
+  onerror: ((event: ErrorEvent) => void) | null = null;
+  private thread: WorkerThread;
+
+  constructor(url: string | URL) {
+    this.thread = new WorkerThread(url);
+    this.thread.on('message', (data: WorkerResponse) => {
+      this.onmessage?.({ data } as MessageEvent<WorkerResponse>);
+    });
+    this.thread.on('error', (error: Error) => {
+      this.onerror?.({ message: error.message } as ErrorEvent);
+    });
+  }
+
+  postMessage(message: WorkerRequest, transfer?: Transferable[]): void {
+    this.thread.postMessage(message, transfer as any);
+  }
+
+  terminate(): void {
+    void this.thread.terminate();
+  }
+}
+
+/**
+ * Start a WorkerPool on worker_threads. Accepts the createPool() options;
+ * size defaults to the number of available cores and workerUrl to
+ * openssl.node-worker.js next to this bundle.
+ */
+export function createNodePool(options: WorkerPoolOptions = {}): Promise<WorkerPool> {
+  const cores = typeof os.availableParallelism === 'function' ? os.availableParallelism() : os.cpus().length;
+  return WorkerPool.create({
+    size: cores,
+    workerUrl: new URL('./openssl.node-worker.js', import.meta.url),
+    createWorker: url => new ThreadWorker(url),
+    ...options
+  });
+}
@@ -0,0 +1,537 @@
+/**
+ * Asymmetric keys over EVP_PKEY
+ */
+
+import type { OpenSSLWasmInstance } from './index';
+import type { ScratchArena } from './arena';
+import { readAscii } from './base64';
+
+/**
+ * Key types supported by generateKeyPair
+ */
+export type KeyType = 'rsa' | 'rsa-pss' | 'ec' | 'ed25519' | 'x25519';
+
+/**
+ * Default RSA modulus size in bits
+ */
+export const DEFAULT_RSA_BITS = 2048;
+
+/**
+ * Default curve for EC keys
+ */
+export const DEFAULT_EC_CURVE = 'P-256';
+
+export interface KeyPairOptions {
+  /**
+   * Key type (default: 'rsa')
+   */
+  type?: KeyType;
+  /**
+   * Modulus size of RSA keys (default: 2048)
+   */
+  bits?: number;
+  /**
+   * Curve of EC keys (default: 'P-256')
+   */
+  curve?: string;
+}
+
+/**
+ * PEM-encoded key pair: PKCS#8 private key and SubjectPublicKeyInfo public key
+ */
+export interface KeyPair {
+  privateKey: string;
+  publicKey: string;
+}
+
+/**
+ * Key generation progress callback. For RSA, stage 0 is a candidate prime,
+ * 1 a primality test round, 2 a prime found and 3 a prime accepted; count
+ * numbers the events within a stage.
+ */
+export type KeygenProgress = (stage: number, count: number) => void;
+
+// OpenSSL key type names
+const KEY_TYPE_NAMES: Record<KeyType, string> = {
+  'rsa': 'RSA',
+  'rsa-pss': 'RSA-PSS',
+  'ec': 'EC',
+  'ed25519': 'ED25519',
+  'x25519': 'X25519'
+};
+
+/**
+ * OpenSSL name of a key type
+ */
+export function keyTypeName(type: KeyType): string {
+  if (!(type in KEY_TYPE_NAMES)) {
+    throw new Error(`Unsupported key type: ${type}`);
+  }
+  return KEY_TYPE_NAMES[type];
+}
+
+/**
+ * Wrapped EVP_PKEY glue functions
+ */
+export interface PkeyFunctions {
+  generate: (type: string, bits: number, group: string | null) => number;
+  free: (pkey: number) => void;
+  bioNewMem: () => number;
+  bioFree: (bio: number) => void;
+  bioGetMemData: (bio: number, ptrPtr: number) => number;
+  writePrivateKey: (bio: number, pkey: number, password: string | null, iterations: number) => number;
+  writePublicKey: (bio: number, pkey: number) => number;
+  readPrivateKey: (bio: number, password: string | null) => number;
+  readPublicKey: (bio: number) => number;
+  readDerPrivateKey: (bio: number, password: string | null) => number;
+  readDerPublicKey: (bio: number) => number;
+  upRef: (pkey: number) => number;
+  bioNewMemBuf: (ptr: number, len: number) => number;
+  sign: (pkey: number, mdName: string | null, pss: number, dataPtr: number, dataLen: number, sigPtr: number, sigLenPtr: number) => number;
+  verify: (pkey: number, mdName: string | null, pss: number, dataPtr: number, dataLen: number, sigPtr: number, sigLen: number) => number;
+  verifyBatch: (keysPtr: number, mdName: string | null, pss: number, msgPtrsPtr: number, msgLensPtr: number, sigPtrsPtr: number, sigLensPtr: number, count: number, bitmapPtr: number) => number;
+  derive: (pkey: number, peer: number, outPtr: number, outLenPtr: number) => number;
+  crypt: (pkey: number, mdName: string, enc: number, inPtr: number, inLen: number, outPtr: number, outLenPtr: number) => number;
+  size: (pkey: number) => number;
+  typeName: (pkey: number) => string;
+  fromRawPublic: (type: string, keyPtr: number, keyLen: number) => number;
+  getRawPublic: (pkey: number, outPtr: number, outLenPtr: number) => number;
+  error: () => string;
+}
+
+/**
+ * Create the EVP_PKEY function wrappers for a module instance
+ */
+export function wrapPkeyFunctions(instance: OpenSSLWasmInstance): PkeyFunctions {
+  return {
+    generate: instance.cwrap('pkey_generate', 'number', ['string', 'number', 'string']) as PkeyFunctions['generate'],
+    free: instance.cwrap('evp_pkey_free', 'void', ['number']) as PkeyFunctions['free'],
+    bioNewMem: instance.cwrap('bio_new_mem', 'number', []) as PkeyFunctions['bioNewMem'],
+    bioFree: instance.cwrap('bio_free', 'void', ['number']) as PkeyFunctions['bioFree'],
+    bioGetMemData: instance.cwrap('bio_get_mem_data', 'number', ['number', 'number']) as PkeyFunctions['bioGetMemData'],
+    writePrivateKey: instance.cwrap('pem_write_bio_private_key', 'number', ['number', 'number', 'string', 'number']) as PkeyFunctions['writePrivateKey'],
+    writePublicKey: instance.cwrap('pem_write_bio_pubkey', 'number', ['number', 'number']) as PkeyFunctions['writePublicKey'],
+    readPrivateKey: instance.cwrap('pem_read_bio_private_key', 'number', ['number', 'string']) as PkeyFunctions['readPrivateKey'],
+    readPublicKey: instance.cwrap('pem_read_bio_pubkey', 'number', ['number']) as PkeyFunctions['readPublicKey'],
+    readDerPrivateKey: instance.cwrap('der_read_bio_private_key', 'number', ['number', 'string']) as PkeyFunctions['readDerPrivateKey'],
+    readDerPublicKey: instance.cwrap('der_read_bio_pubkey', 'number', ['number']) as PkeyFunctions['readDerPublicKey'],
+    upRef: instance.cwrap('evp_pkey_up_ref', 'number', ['number']) as PkeyFunctions['upRef'],
+    bioNewMemBuf: instance.cwrap('bio_new_mem_buf', 'number', ['number', 'number']) as PkeyFunctions['bioNewMemBuf'],
+    sign: instance.cwrap('pkey_sign', 'number', ['number', 'string', 'number', 'number', 'number', 'number', 'number']) as PkeyFunctions['sign'],
+    verify: instance.cwrap('pkey_verify', 'number', ['number', 'string', 'number', 'number', 'number', 'number', 'number']) as PkeyFunctions['verify'],
+    verifyBatch: instance.cwrap('pkey_verify_batch', 'number', ['number', 'string', 'number', 'number', 'number', 'number', 'number', 'number', 'number']) as PkeyFunctions['verifyBatch'],
+    derive: instance.cwrap('pkey_derive', 'number', ['number', 'number', 'number', 'number']) as PkeyFunctions['derive'],
+    crypt: instance.cwrap('pkey_crypt', 'number', ['number', 'string', 'number', 'number', 'number', 'number', 'number']) as PkeyFunctions['crypt'],
+    size: instance.cwrap('pkey_size', 'number', ['number']) as PkeyFunctions['size'],
+    typeName: instance.cwrap('pkey_type_name', 'string', ['number']) as PkeyFunctions['typeName'],
+    fromRawPublic: instance.cwrap('pkey_from_raw_public', 'number', ['string', 'number', 'number']) as PkeyFunctions['fromRawPublic'],
+    getRawPublic: instance.cwrap('pkey_get_raw_public', 'number', ['number', 'number', 'number']) as PkeyFunctions['getRawPublic'],
+    error: instance.cwrap('get_error_string', 'string', []) as PkeyFunctions['error']
+  };
+}
+
+/**
+ * Apply defaults to key pair options and validate them
+ */
+export function normalizeKeyPairOptions(options: KeyPairOptions = {}): Required<KeyPairOptions> {
+  const type = options.type ?? 'rsa';
+  if (!(type in KEY_TYPE_NAMES)) {
+    throw new Error(`Unsupported key type: ${type}`);
+  }
+
+  const isRsa = type === 'rsa' || type === 'rsa-pss';
+  const bits = isRsa ? options.bits ?? DEFAULT_RSA_BITS : 0;
+  if (isRsa && (!Number.isInteger(bits) || bits < 1024)) {
+    throw new Error('RSA keys must be at least 1024 bits');
+  }
+
+  return { type, bits, curve: type === 'ec' ? options.curve ?? DEFAULT_EC_CURVE : '' };
+}
+
+/**
+ * Stable identifier of a key pair shape, e.g. 'rsa:2048:'
+ */
+export function keyPairOptionsId(options: KeyPairOptions = {}): string {
+  const { type, bits, curve } = normalizeKeyPairOptions(options);
+  return `${type}:${bits}:${curve}`;
+}
+
+/**
+ * Generate an EVP_PKEY and return its handle. The caller owns the handle.
+ */
+export function generatePkey(fns: PkeyFunctions, options: KeyPairOptions = {}): number {
+  const { type, bits, curve } = normalizeKeyPairOptions(options);
+  const pkey = fns.generate(KEY_TYPE_NAMES[type], bits, curve || null);
+  if (pkey === 0) {
+    throw new Error(`Key generation failed: ${fns.error()}`);
+  }
+  return pkey;
+}
+
+export interface ExportKeyOptions {
+  /**
+   * Encrypt the private key with this password (PBES2 with AES-256-CBC)
+   */
+  password?: string;
+  /**
+   * PBKDF2 iterations for the encryption key (default: 2048). Higher counts
+   * slow down brute forcing, and every import, by the same factor.
+   */
+  iterations?: number;
+}
+
+/**
+ * Write a key as PEM using a memory BIO
+ */
+export function writePem(fns: PkeyFunctions, arena: ScratchArena, pkey: number, part: 'private' | 'public', options: ExportKeyOptions = {}): string {
+  // 0 lets the glue use OpenSSL's default count
+  const iterations = options.iterations ?? 0;
+  if (options.iterations !== undefined && (!Number.isInteger(iterations) || iterations < 1)) {
+    throw new Error('PBKDF2 iterations must be a positive integer');
+  }
+
+  const bio = fns.bioNewMem();
+  if (bio === 0) {
+    throw new Error('Failed to allocate BIO');
+  }
+
+  const mark = arena.mark();
+  try {
+    const result = part === 'private'
+      ? fns.writePrivateKey(bio, pkey, options.password || null, iterations)
+      : fns.writePublicKey(bio, pkey);
+    if (result !== 1) {
+      throw new Error(`Failed to write ${part} key: ${fns.error()}`);
+    }
+
+    const ptrPtr = arena.alloc(4);
+    const length = fns.bioGetMemData(bio, ptrPtr);
+    const pem = readAscii(arena.heapU8, arena.heapU32[ptrPtr >> 2], length);
+
+    // The BIO buffer held the private key; wipe it before freeing
+    if (part === 'private') {
+      arena.heapU8.fill(0, arena.heapU32[ptrPtr >> 2], arena.heapU32[ptrPtr >> 2] + length);
+    }
+    return pem;
+  } finally {
+    arena.release(mark);
+    fns.bioFree(bio);
+  }
+}
+
+/**
+ * Write both halves of a key as a PEM key pair
+ */
+export function exportKeyPair(fns: PkeyFunctions, arena: ScratchArena, pkey: number): KeyPair {
+  return {
+    privateKey: writePem(fns, arena, pkey, 'private'),
+    publicKey: writePem(fns, arena, pkey, 'public')
+  };
+}
+
+// Buffer size for pkey_get_raw_public, an uncompressed P-521 point
+const MAX_RAW_PUBLIC_KEY_LENGTH = 133;
+
+export interface SignOptions {
+  /**
+   * Digest to sign with (default: 'sha256'; ignored for Ed25519, which
+   * hashes internally)
+   */
+  hash?: string;
+  /**
+   * Padding for RSA keys (default: 'pkcs1'). RSA-PSS keys always use 'pss'.
+   */
+  padding?: 'pkcs1' | 'pss';
+}
+
+export interface EncryptOptions {
+  /**
+   * OAEP digest (default: 'sha256')
+   */
+  hash?: string;
+}
+
+/**
+ * Check bit i of a verifyMany() result bitmap
+ */
+export function isVerified(bitmap: Uint8Array, index: number): boolean {
+  return (bitmap[index >> 3] & (1 << (index & 7))) !== 0;
+}
+
+/**
+ * Encoded key accepted by the key import functions: PEM text or DER bytes
+ */
+export type KeyData = string | Uint8Array;
+
+/**
+ * Read a PEM (string) or DER (bytes) key into an EVP_PKEY handle. The
+ * caller owns the handle.
+ */
+export function readKey(fns: PkeyFunctions, arena: ScratchArena, key: KeyData, part: 'private' | 'public', password?: string): number {
+  const mark = arena.mark();
+  let bio = 0;
+  try {
+    const der = typeof key !== 'string';
+    const keyData = der ? key : new TextEncoder().encode(key);
+    const keyPtr = arena.copyIn(keyData);
+    bio = fns.bioNewMemBuf(keyPtr, keyData.length);
+    if (bio === 0) {
+      throw new Error('Failed to allocate BIO');
+    }
+
+    const pkey = part === 'private'
+      ? (der ? fns.readDerPrivateKey : fns.readPrivateKey)(bio, password ?? null)
+      : (der ? fns.readDerPublicKey : fns.readPublicKey)(bio);
+    if (part === 'private') {
+      arena.heapU8.fill(0, keyPtr, keyPtr + keyData.length);
+    }
+    if (pkey === 0) {
+      throw new Error(`Failed to read ${part} key: ${fns.error()}`);
+    }
+    return pkey;
+  } finally {
+    if (bio !== 0) {
+      fns.bioFree(bio);
+    }
+    arena.release(mark);
+  }
+}
+
+interface NativeKey {
+  free: (pkey: number) => void;
+  pkey: number;
+}
+
+// Frees the native key of handles that are collected without dispose()
+const keyRegistry = typeof FinalizationRegistry === 'function'
+  ? new FinalizationRegistry<NativeKey>(({ free, pkey }) => free(pkey))
+  : null;
+
+/**
+ * Long-lived handle to a parsed EVP_PKEY.
+ *
+ * Created with OpenSSL.generateKey(), importPrivateKey(), importPublicKey(),
+ * importRawPublicKey() or loadPrivateKey()/loadPublicKey(). The key is
+ * parsed once and reused by every operation. Each handle holds its own
+ * reference to the native key; call dispose() to release it. A handle that
+ * is garbage collected without dispose() is released by a finalizer, but
+ * only eventually, so do not rely on it for heap-heavy workloads.
+ */
+export class KeyHandle {
+  private fns: PkeyFunctions;
+  private arena: ScratchArena;
+  private pkey: number;
+
+  /**
+   * OpenSSL key type name, e.g. 'RSA', 'RSA-PSS', 'EC', 'ED25519', 'X25519'
+   */
+  readonly type: string;
+
+  /**
+   * Whether the handle holds the private half of the key
+   */
+  readonly isPrivate: boolean;
+
+  /**
+   * Constructor - should not be called directly, use OpenSSL.importPrivateKey() and friends instead
+   */
+  constructor(fns: PkeyFunctions, arena: ScratchArena, pkey: number, isPrivate: boolean, type?: string) {
+    this.fns = fns;
+    this.arena = arena;
+    this.pkey = pkey;
+    this.isPrivate = isPrivate;
+    this.type = type ?? fns.typeName(pkey);
+    keyRegistry?.register(this, { free: fns.free, pkey }, this);
+  }
+
+  /**
+   * Native EVP_PKEY pointer, for passing to other glue functions
+   */
+  get handle(): number {
+    this.checkOpen();
+    return this.pkey;
+  }
+
+  /**
+   * Sign a message
+   */
+  sign(data: Uint8Array | string, options: SignOptions = {}): Uint8Array {
+    this.checkOpen();
+    if (!this.isPrivate) {
+      throw new Error('Signing requires a private key');
+    }
+
+    const input = typeof data === 'string' ? new TextEncoder().encode(data) : data;
+    const arena = this.arena;
+    const mark = arena.mark();
+    try {
+      const dataPtr = arena.copyIn(input);
+      const sigPtr = arena.alloc(this.fns.size(this.pkey));
+      const sigLenPtr = arena.alloc(4);
+
+      const result = this.fns.sign(this.pkey, this.digestName(options.hash), options.padding === 'pss' ? 1 : 0, dataPtr, input.length, sigPtr, sigLenPtr);
+      if (result !== 1) {
+        throw new Error(`Signing failed: ${this.fns.error()}`);
+      }
+
+      return arena.copyOut(sigPtr, arena.heapU32[sigLenPtr >> 2]);
+    } finally {
+      arena.release(mark);
+    }
+  }
+
+  /**
+   * Verify a message signature
+   */
+  verify(data: Uint8Array | string, signature: Uint8Array, options: SignOptions = {}): boolean {
+    this.checkOpen();
+
+    const input = typeof data === 'string' ? new TextEncoder().encode(data) : data;
+    const arena = this.arena;
+    const mark = arena.mark();
+    try {
+      const dataPtr = arena.copyIn(input);
+      const sigPtr = arena.copyIn(signature);
+
+      return this.fns.verify(this.pkey, this.digestName(options.hash), options.padding === 'pss' ? 1 : 0, dataPtr, input.length, sigPtr, signature.length) === 1;
+    } finally {
+      arena.release(mark);
+    }
+  }
+
+  /**
+   * Derive a shared secret with a peer's public key (X25519, ECDH)
+   */
+  derive(peer: KeyHandle): Uint8Array {
+    this.checkOpen();
+    if (!this.isPrivate) {
+      throw new Error('Key derivation requires a private key');
+    }
+
+    const arena = this.arena;
+    const mark = arena.mark();
+    let outPtr = 0;
+    let outLength = 0;
+    try {
+      outPtr = arena.alloc(this.fns.size(this.pkey));
+      const outLenPtr = arena.alloc(4);
+
+      if (this.fns.derive(this.pkey, peer.handle, outPtr, outLenPtr) !== 1) {
+        throw new Error(`Key derivation failed: ${this.fns.error()}`);
+      }
+
+      outLength = arena.heapU32[outLenPtr >> 2];
+      return arena.copyOut(outPtr, outLength);
+    } finally {
+      if (outPtr !== 0) {
+        arena.heapU8.fill(0, outPtr, outPtr + outLength);
+      }
+      arena.release(mark);
+    }
+  }
+
+  /**
+   * Encrypt with RSA-OAEP
+   */
+  encrypt(data: Uint8Array | string, options: EncryptOptions = {}): Uint8Array {
+    return this.crypt(typeof data === 'string' ? new TextEncoder().encode(data) : data, true, options);
+  }
+
+  /**
+   * Decrypt RSA-OAEP ciphertext
+   */
+  decrypt(data: Uint8Array, options: EncryptOptions = {}): Uint8Array {
+    if (!this.isPrivate) {
+      throw new Error('Decryption requires a private key');
+    }
+    return this.crypt(data, false, options);
+  }
+
+  /**
+   * Raw public key: 32 bytes for X25519 and Ed25519, the uncompressed point
+   * for EC keys
+   */
+  rawPublicKey(): Uint8Array {
+    this.checkOpen();
+
+    const arena = this.arena;
+    const mark = arena.mark();
+    try {
+      const outPtr = arena.alloc(MAX_RAW_PUBLIC_KEY_LENGTH);
+      const outLenPtr = arena.alloc(4);
+      if (this.fns.getRawPublic(this.pkey, outPtr, outLenPtr) !== 1) {
+        throw new Error(`${this.type} keys have no raw public encoding`);
+      }
+      return arena.copyOut(outPtr, arena.heapU32[outLenPtr >> 2]);
+    } finally {
+      arena.release(mark);
+    }
+  }
+
+  /**
+   * Export the public key as SubjectPublicKeyInfo PEM
+   */
+  exportPublicKey(): string {
+    this.checkOpen();
+    return writePem(this.fns, this.arena, this.pkey, 'public');
+  }
+
+  /**
+   * Export the private key as PKCS#8 PEM, encrypted if a password is given
+   */
+  exportPrivateKey(options: ExportKeyOptions = {}): string {
+    this.checkOpen();
+    if (!this.isPrivate) {
+      throw new Error('Handle does not hold a private key');
+    }
+    return writePem(this.fns, this.arena, this.pkey, 'private', options);
+  }
+
+  /**
+   * Release this handle's reference to the native key
+   */
+  dispose(): void {
+    if (this.pkey !== 0) {
+      keyRegistry?.unregister(this);
+      this.fns.free(this.pkey);
+      this.pkey = 0;
+    }
+  }
+
+  private crypt(input: Uint8Array, encrypt: boolean, options: EncryptOptions): Uint8Array {
+    this.checkOpen();
+
+    const arena = this.arena;
+    const mark = arena.mark();
+    let outPtr = 0;
+    let outLength = 0;
+    try {
+      const inPtr = arena.copyIn(input);
+      outPtr = arena.alloc(this.fns.size(this.pkey));
+      const outLenPtr = arena.alloc(4);
+
+      if (this.fns.crypt(this.pkey, options.hash ?? 'sha256', encrypt ? 1 : 0, inPtr, input.length, outPtr, outLenPtr) !== 1) {
+        throw new Error(`${encrypt ? 'Encryption' : 'Decryption'} failed: ${this.fns.error()}`);
+      }
+
+      outLength = arena.heapU32[outLenPtr >> 2];
+      return arena.copyOut(outPtr, outLength);
+    } finally {
+      if (!encrypt && outPtr !== 0) {
+        arena.heapU8.fill(0, outPtr, outPtr + outLength);
+      }
+      arena.release(mark);
+    }
+  }
+
+  // Ed25519 and Ed448 hash internally and must be given no digest
+  private digestName(hash?: string): string | null {
+    return this.type === 'ED25519' || this.type === 'ED448' ? null : hash ?? 'sha256';
+  }
+
+  private checkOpen(): void {
+    if (this.pkey === 0) {
+      throw new Error('KeyHandle has been disposed');
+    }
+  }
+}
@@ -0,0 +1,415 @@
+/**
+ * Worker pool for running OpenSSL operations in parallel across cores
+ */
+
+import type { OpenSSL, OpenSSLOptions } from './index';
+import type { SignOptions } from './pkey';
+import { TreeHashOptions, TreeHashResult, checkChunkSize, leafCount } from './tree';
+import { selectVariant, selectTier, compileWasmModule } from './loader';
+
+/**
+ * OpenSSL methods that can run on a pool worker. Methods returning handles
+ * (createHash, createCipher) are not listed because handles cannot cross the
+ * worker boundary.
+ */
+export const POOLED_METHODS = [
+  'version',
+  'randomBytes',
+  'sha1',
+  'sha256',
+  'sha384',
+  'sha512',
+  'md5',
+  'hashMany',
+  'treeHashLeaves',
+  'treeHashRoot',
+  'hmac',
+  'hmacMany',
+  'pbkdf2',
+  'hkdf',
+  'scrypt',
+  'generateKeyPair',
+  'aesEncrypt',
+  'aesDecrypt',
+  'seal',
+  'open',
+  'base64Encode',
+  'base64Decode'
+] as const;
+
+/**
+ * OpenSSL methods a worker runs for the pool's own methods of the same name,
+ * which split the input across workers. Not reachable through call().
+ */
+export const SPLIT_METHODS = [
+  'verifyMany'
+] as const;
+
+/**
+ * Pooled methods that take a progress callback, and its argument position.
+ * Callbacks cannot be posted to a worker; the worker installs its own and
+ * forwards progress messages to the caller's callback instead.
+ */
+export const PROGRESS_ARGUMENTS: Partial<Record<PooledMethod, number>> = {
+  generateKeyPair: 1
+};
+
+export type PooledMethod = typeof POOLED_METHODS[number];
+
+export type SplitMethod = typeof SPLIT_METHODS[number];
+
+/**
+ * Promise-returning view of the pooled OpenSSL methods
+ */
+export type PooledOpenSSL = {
+  [K in PooledMethod]: OpenSSL[K] extends (...args: infer A) => infer R
+    ? (...args: A) => Promise<Awaited<R>>
+    : never;
+};
+
+/**
+ * Messages sent to a pool worker
+ */
+export type WorkerRequest =
+  | { type: 'init'; options?: OpenSSLOptions }
+  | { type: 'call'; id: number; method: string; args: unknown[] };
+
+/**
+ * Messages sent back by a pool worker
+ */
+export type WorkerResponse =
+  | { type: 'ready'; variant: string }
+  | { type: 'result'; id: number; result: unknown }
+  | { type: 'progress'; id: number; stage: number; count: number }
+  | { type: 'error'; id: number; message: string };
+
+export interface WorkerPoolOptions extends OpenSSLOptions {
+  /**
+   * Number of workers to start (default: navigator.hardwareConcurrency, or 4)
+   */
+  size?: number;
+  /**
+   * URL of the worker script (default: openssl.worker.js next to this bundle)
+   */
+  workerUrl?: string | URL;
+  /**
+   * Transfer input buffers to the worker instead of copying them. The
+   * caller's buffers are detached and must not be used after the call.
+   */
+  transfer?: boolean;
+  /**
+   * Start a worker for the given script URL (default: a module Worker).
+   * createNodePool() passes one that starts worker_threads.
+   */
+  createWorker?: (url: string | URL) => PoolWorkerLike;
+}
+
+/**
+ * The parts of the Worker interface the pool uses
+ */
+export interface PoolWorkerLike {
+  onmessage: ((event: MessageEvent<WorkerResponse>) => void) | null;
+  onerror: ((event: ErrorEvent) => void) | null;
+  postMessage(message: WorkerRequest, transfer?: Transferable[]): void;
+  terminate(): void;
+}
+
+interface PendingJob {
+  resolve: (value: any) => void;
+  reject: (reason: Error) => void;
+  onProgress?: (stage: number, count: number) => void;
+}
+
+interface PoolWorker {
+  worker: PoolWorkerLike;
+  pending: Map<number, PendingJob>;
+}
+
+/**
+ * Collect the ArrayBuffers backing typed array arguments so they can be
+ * transferred rather than copied. Shared buffers and duplicates are skipped.
+ */
+export function collectTransferables(values: unknown[]): Transferable[] {
+  const buffers = new Set<ArrayBuffer>();
+  for (const value of values) {
+    if (ArrayBuffer.isView(value) && value.buffer instanceof ArrayBuffer) {
+      buffers.add(value.buffer);
+    } else if (Array.isArray(value)) {
+      for (const buffer of collectTransferables(value)) {
+        buffers.add(buffer as ArrayBuffer);
+      }
+    }
+  }
+  return Array.from(buffers);
+}
+
+/**
+ * Pool of workers, each running its own OpenSSL module instance
+ */
+export class WorkerPool {
+  private workers: PoolWorker[];
+  private transfer: boolean;
+  private nextId = 1;
+  private terminated = false;
+
+  /**
+   * Constructor - should not be called directly, use WorkerPool.create() instead
+   */
+  private constructor(workers: PoolWorker[], transfer: boolean) {
+    this.workers = workers;
+    this.transfer = transfer;
+  }
+
+  /**
+   * Start a pool of workers and wait for every module instance to initialize
+   */
+  static async create(options: WorkerPoolOptions = {}): Promise<WorkerPool> {
+    const { size, workerUrl, transfer, createWorker, ...openSSLOptions } = options;
+    const count = size ?? ((typeof navigator !== 'undefined' && navigator.hardwareConcurrency) || 4);
+    if (!Number.isInteger(count) || count < 1) {
+      throw new Error('Worker pool size must be a positive integer');
+    }
+    const url = workerUrl ?? new URL('./openssl.worker.js', import.meta.url);
+    const callback = functionOption(openSSLOptions);
+    if (callback) {
+      throw new Error(`The ${callback} option cannot be passed to workers, since functions cannot be posted to them`);
+    }
+
+    // Compile the module once here and post it to every worker, which then
+    // only instantiates it. If it cannot be compiled here, each worker
+    // loads its own.
+    const variant = selectVariant(openSSLOptions.simd);
+    const tier = selectTier(openSSLOptions.features);
+    const wasmModule = openSSLOptions.wasmModule
+      ?? await compileWasmModule(variant, tier, openSSLOptions.wasmCache ?? true).catch(() => undefined);
+    const workerOptions: OpenSSLOptions = { ...openSSLOptions, simd: variant === 'simd', wasmModule };
+
+    const started = await Promise.allSettled(
+      Array.from({ length: count }, () => startWorker(url, workerOptions, createWorker ?? startModuleWorker))
+    );
+    const workers = started
+      .filter((outcome): outcome is PromiseFulfilledResult<PoolWorker> => outcome.status === 'fulfilled')
+      .map(outcome => outcome.value);
+    const failure = started.find((outcome): outcome is PromiseRejectedResult => outcome.status === 'rejected');
+    if (failure) {
+      workers.forEach(entry => entry.worker.terminate());
+      throw failure.reason;
+    }
+
+    return new WorkerPool(workers, transfer ?? false);
+  }
+
+  /**
+   * Number of workers in the pool
+   */
+  get size(): number {
+    return this.workers.length;
+  }
+
+  /**
+   * Run an OpenSSL method on the least busy worker
+   */
+  call<K extends PooledMethod>(method: K, ...args: Parameters<OpenSSL[K]>): Promise<Awaited<ReturnType<OpenSSL[K]>>> {
+    return this.dispatch(method, args, this.transfer);
+  }
+
+  /**
+   * Post a job to the least busy worker, optionally transferring the buffers
+   * backing its arguments
+   */
+  private dispatch(method: PooledMethod | SplitMethod, args: unknown[], transfer: boolean): Promise<any> {
+    if (this.terminated) {
+      return Promise.reject(new Error('Worker pool has been terminated'));
+    }
+
+    let target = this.workers[0];
+    for (const entry of this.workers) {
+      if (entry.pending.size < target.pending.size) {
+        target = entry;
+      }
+    }
+
+    // Keep any progress callback on this side of the worker boundary
+    const progressIndex = PROGRESS_ARGUMENTS[method as PooledMethod];
+    let onProgress: PendingJob['onProgress'];
+    if (progressIndex !== undefined && typeof args[progressIndex] === 'function') {
+      onProgress = args[progressIndex] as PendingJob['onProgress'];
+      args = args.slice(0, progressIndex);
+    }
+
+    const id = this.nextId++;
+    const request: WorkerRequest = { type: 'call', id, method, args };
+    return new Promise((resolve, reject) => {
+      target.pending.set(id, { resolve, reject, onProgress });
+      try {
+        target.worker.postMessage(request, transfer ? collectTransferables(args) : []);
+      } catch (e) {
+        target.pending.delete(id);
+        reject(e instanceof Error ? e : new Error(String(e)));
+      }
+    });
+  }
+
+  /**
+   * Tree hash a large input with its leaves hashed in parallel. The input is
+   * split into one contiguous run of whole leaves per worker, so the result
+   * matches OpenSSL.treeHash for the same chunk size.
+   */
+  async treeHash(algorithm: string, data: Uint8Array, options: TreeHashOptions = {}): Promise<TreeHashResult> {
+    const chunkSize = checkChunkSize(options.chunkSize);
+    const leavesPerWorker = Math.max(1, Math.ceil(leafCount(data.length, chunkSize) / this.workers.length));
+    const span = leavesPerWorker * chunkSize;
+
+    // Slice each run and transfer the copy, so each byte is copied once;
+    // posting a subarray would clone the whole underlying buffer
+    const jobs: Array<Promise<Uint8Array>> = [];
+    for (let offset = 0; offset < data.length; offset += span) {
+      jobs.push(this.dispatch('treeHashLeaves', [algorithm, data.slice(offset, offset + span), chunkSize], true));
+    }
+
+    const parts = await Promise.all(jobs);
+    const leaves = new Uint8Array(parts.reduce((total, part) => total + part.length, 0));
+    let position = 0;
+    for (const part of parts) {
+      leaves.set(part, position);
+      position += part.length;
+    }
+
+    const root = await this.dispatch('treeHashRoot', [algorithm, leaves], false);
+    return options.leaves ? { root, leaves } : { root };
+  }
+
+  /**
+   * Verify many signatures in parallel, as OpenSSL.verifyMany with PEM public
+   * keys. Each worker verifies a contiguous run whose length is a multiple
+   * of 8, so the partial bitmaps concatenate into the full one.
+   */
+  async verifyMany(keys: string | string[], messages: Array<Uint8Array | string>, signatures: Uint8Array[], options: SignOptions = {}): Promise<Uint8Array> {
+    const count = messages.length;
+    if (signatures.length !== count || (Array.isArray(keys) && keys.length !== count)) {
+      throw new Error('verifyMany needs one signature (and key) per message');
+    }
+    const span = Math.max(8, Math.ceil(count / this.workers.length / 8) * 8);
+
+    const jobs: Array<Promise<Uint8Array>> = [];
+    for (let offset = 0; offset < count; offset += span) {
+      const runKeys = Array.isArray(keys) ? keys.slice(offset, offset + span) : keys;
+      jobs.push(this.dispatch('verifyMany', [
+        runKeys,
+        messages.slice(offset, offset + span),
+        signatures.slice(offset, offset + span),
+        options
+      ], this.transfer));
+    }
+
+    const parts = await Promise.all(jobs);
+    const bitmap = new Uint8Array((count + 7) >> 3);
+    parts.forEach((part, index) => bitmap.set(part, index * (span >> 3)));
+    return bitmap;
+  }
+
+  /**
+   * Terminate all workers. Jobs still in flight are rejected.
+   */
+  terminate(): void {
+    if (this.terminated) {
+      return;
+    }
+    this.terminated = true;
+    for (const entry of this.workers) {
+      entry.worker.terminate();
+      for (const job of entry.pending.values()) {
+        job.reject(new Error('Worker pool has been terminated'));
+      }
+      entry.pending.clear();
+    }
+  }
+}
+
+// Expose every pooled method on the pool, e.g. pool.sha256(data)
+export interface WorkerPool extends PooledOpenSSL {}
+
+for (const method of POOLED_METHODS) {
+  (WorkerPool.prototype as any)[method] = function (this: WorkerPool, ...args: any[]) {
+    return (this.call as any)(method, ...args);
+  };
+}
+
+// Name of the first option holding a function, such as metrics.sink or
+// trackHandles.onLeak, or null. Options are posted to each worker, and
+// functions cannot be cloned.
+function functionOption(options: OpenSSLOptions): string | null {
+  for (const [name, value] of Object.entries(options)) {
+    if (typeof value === 'function') {
+      return name;
+    }
+    if (value !== null && typeof value === 'object') {
+      const nested = Object.keys(value).find(field => typeof (value as Record<string, unknown>)[field] === 'function');
+      if (nested !== undefined) {
+        return `${name}.${nested}`;
+      }
+    }
+  }
+  return null;
+}
+
+function startModuleWorker(url: string | URL): PoolWorkerLike {
+  return new Worker(url, { type: 'module' });
+}
+
+/**
+ * Start one worker and wait for its module instance to report ready
+ */
+function startWorker(url: string | URL, options: OpenSSLOptions, createWorker: (url: string | URL) => PoolWorkerLike): Promise<PoolWorker> {
+  const worker = createWorker(url);
+  const entry: PoolWorker = { worker, pending: new Map() };
+
+  return new Promise((resolve, reject) => {
+    worker.onerror = (event: ErrorEvent) => {
+      const error = new Error(`Worker error: ${event.message}`);
+      reject(error);
+      for (const job of entry.pending.values()) {
+        job.reject(error);
+      }
+      entry.pending.clear();
+    };
+
+    worker.onmessage = (event: MessageEvent<WorkerResponse>) => {
+      const message = event.data;
+      if (message.type === 'ready') {
+        resolve(entry);
+        return;
+      }
+
+      if (message.id === 0) {
+        reject(new Error(message.type === 'error' ? message.message : 'Unexpected worker message'));
+        return;
+      }
+
+      const job = entry.pending.get(message.id);
+      if (!job) {
+        return;
+      }
+      if (message.type === 'progress') {
+        job.onProgress?.(message.stage, message.count);
+        return;
+      }
+      entry.pending.delete(message.id);
+
+      if (message.type === 'result') {
+        job.resolve(message.result);
+      } else {
+        job.reject(new Error(message.message));
+      }
+    };
+
+    const request: WorkerRequest = { type: 'init', options };
+    try {
+      worker.postMessage(request);
+    } catch (e) {
+      // Modules cannot be posted across agent clusters; compile in the worker
+      const { wasmModule, ...rest } = options;
+      worker.postMessage({ type: 'init', options: rest } as WorkerRequest);
+    }
+  });
+}
@@ -0,0 +1,114 @@
+/**
+ * Buffered random bytes from the OpenSSL DRBG
+ */
+
+import type { OpenSSLWasmInstance } from './index';
+
+/**
+ * Default size of the random pool in the WASM heap
+ */
+export const DEFAULT_RANDOM_POOL_SIZE = 4096;
+
+/**
+ * Largest request served from the pool. Larger requests call RAND_bytes
+ * directly, where the call overhead is negligible next to the DRBG work.
+ */
+export const RANDOM_POOL_MAX_REQUEST = 256;
+
+/**
+ * Ring buffer of DRBG output in the WASM heap.
+ *
+ * One RAND_bytes call fills the whole buffer; small requests are then
+ * served by copying slices out of the heap without calling into the module.
+ * Each slice is zeroed in the heap as soon as it is handed out, so bytes
+ * already used never linger in module memory.
+ *
+ * Pooled bytes are generated ahead of use. The DRBG reseeds itself from the
+ * browser's entropy source on its own schedule, but a reseed only affects
+ * bytes generated afterwards, i.e. from the next refill on. discard() forces
+ * the next request to refill; OpenSSL.reseedRandom() pairs it with a DRBG
+ * reseed for cases such as restoring a serialized snapshot of the module,
+ * where a copied heap means a copied pool and a copied DRBG state.
+ */
+export class RandomPool {
+  private instance: OpenSSLWasmInstance;
+  private fill: (ptr: number, len: number) => number;
+  private error: () => string;
+  private base: number = 0;
+  private position: number;
+
+  /**
+   * Pool size in bytes
+   */
+  readonly size: number;
+
+  /**
+   * Constructor - should not be called directly, the pool is owned by OpenSSL
+   */
+  constructor(instance: OpenSSLWasmInstance, fill: (ptr: number, len: number) => number, error: () => string, size: number = DEFAULT_RANDOM_POOL_SIZE) {
+    if (!Number.isInteger(size) || size < RANDOM_POOL_MAX_REQUEST) {
+      throw new Error(`Random pool size must be an integer of at least ${RANDOM_POOL_MAX_REQUEST}`);
+    }
+    this.instance = instance;
+    this.fill = fill;
+    this.error = error;
+    this.size = size;
+    // Start empty; the buffer is allocated and filled on first use
+    this.position = size;
+  }
+
+  /**
+   * Fill target with random bytes, refilling the pool when it runs out
+   */
+  take(target: Uint8Array): void {
+    let written = 0;
+    while (written < target.length) {
+      if (this.position === this.size) {
+        this.refill();
+      }
+
+      const count = Math.min(target.length - written, this.size - this.position);
+      const start = this.base + this.position;
+      const heapU8 = this.instance.HEAPU8;
+      target.set(heapU8.subarray(start, start + count), written);
+      heapU8.fill(0, start, start + count);
+
+      this.position += count;
+      written += count;
+    }
+  }
+
+  /**
+   * Throw away the unused bytes so the next request draws fresh DRBG output
+   */
+  discard(): void {
+    if (this.base !== 0) {
+      this.instance.HEAPU8.fill(0, this.base + this.position, this.base + this.size);
+    }
+    this.position = this.size;
+  }
+
+  /**
+   * Wipe and free the heap buffer
+   */
+  dispose(): void {
+    this.discard();
+    if (this.base !== 0) {
+      this.instance._free(this.base);
+      this.base = 0;
+    }
+  }
+
+  private refill(): void {
+    if (this.base === 0) {
+      this.base = this.instance._malloc(this.size);
+      if (this.base === 0) {
+        throw new Error('Failed to allocate random pool');
+      }
+    }
+    if (this.fill(this.base, this.size) !== 1) {
+      throw new Error(`Failed to generate random bytes: ${this.error()}`);
+    }
+    this.position = 0;
+  }
+}
@@ -0,0 +1,62 @@
+/**
+ * Request handling for pool workers, shared by the browser and Node worker
+ * entry points. Each worker owns one OpenSSL module instance and runs the
+ * jobs posted to it one at a time.
+ */
+
+import OpenSSLWasmJS, { OpenSSL } from './index';
+import { POOLED_METHODS, SPLIT_METHODS, PROGRESS_ARGUMENTS, PooledMethod, WorkerRequest, WorkerResponse, collectTransferables } from './pool';
+
+/**
+ * The parts of a worker's global scope the handler uses
+ */
+export interface WorkerScope {
+  onmessage: ((event: MessageEvent<WorkerRequest>) => void) | null;
+  postMessage(message: WorkerResponse, transfer?: Transferable[]): void;
+}
+
+/**
+ * Answer pool requests posted to scope
+ */
+export function serve(scope: WorkerScope): void {
+  const allowed = new Set<string>([...POOLED_METHODS, ...SPLIT_METHODS]);
+  let openssl: OpenSSL | null = null;
+
+  scope.onmessage = async (event: MessageEvent<WorkerRequest>) => {
+    const request = event.data;
+
+    if (request.type === 'init') {
+      try {
+        openssl = await OpenSSLWasmJS.initialize(request.options);
+        scope.postMessage({ type: 'ready', variant: openssl.variant });
+      } catch (e) {
+        scope.postMessage({ type: 'error', id: 0, message: e instanceof Error ? e.message : String(e) });
+      }
+      return;
+    }
+
+    try {
+      if (!openssl) {
+        throw new Error('Worker is not initialized');
+      }
+      if (!allowed.has(request.method)) {
+        throw new Error(`Unsupported method: ${request.method}`);
+      }
+      const args = request.args.slice();
+      const progressIndex = PROGRESS_ARGUMENTS[request.method as PooledMethod];
+      if (progressIndex !== undefined) {
+        const id = request.id;
+        args.length = Math.max(args.length, progressIndex);
+        args[progressIndex] = (stage: number, count: number) => {
+          scope.postMessage({ type: 'progress', id, stage, count });
+        };
+      }
+
+      const result = await (openssl as any)[request.method](...args);
+      // Results are freshly allocated copies, so always transfer them back
+      scope.postMessage({ type: 'result', id: request.id, result }, collectTransferables([result]));
+    } catch (e) {
+      scope.postMessage({ type: 'error', id: request.id, message: e instanceof Error ? e.message : String(e) });
+    }
+  };
+}
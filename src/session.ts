@@ -0,0 +1,177 @@
+/**
+ * TLS session caches for resumption across connections and page loads
+ */
+
+/**
+ * Default number of sessions kept in memory
+ */
+export const DEFAULT_SESSION_CACHE_SIZE = 64;
+
+const DEFAULT_DATABASE_NAME = 'openssl-wasm-tls-sessions';
+const STORE_NAME = 'sessions';
+
+/**
+ * Storage for serialized TLS sessions (i2d_SSL_SESSION bytes), keyed by
+ * server. Implementations may be synchronous or asynchronous.
+ *
+ * Sessions hold the resumption secret, so a custom backend should store
+ * them with the same care as credentials.
+ */
+export interface TlsSessionCache {
+  get(key: string): Uint8Array | undefined | Promise<Uint8Array | undefined>;
+  set(key: string, session: Uint8Array): void | Promise<void>;
+  delete(key: string): void | Promise<void>;
+}
+
+/**
+ * In-memory LRU session cache. Sessions last as long as the page.
+ */
+export class MemorySessionCache implements TlsSessionCache {
+  private entries = new Map<string, Uint8Array>();
+
+  /**
+   * Maximum number of sessions kept
+   */
+  readonly capacity: number;
+
+  constructor(capacity: number = DEFAULT_SESSION_CACHE_SIZE) {
+    if (!Number.isInteger(capacity) || capacity < 1) {
+      throw new Error('Session cache size must be a positive integer');
+    }
+    this.capacity = capacity;
+  }
+
+  /**
+   * Number of sessions currently cached
+   */
+  get size(): number {
+    return this.entries.size;
+  }
+
+  get(key: string): Uint8Array | undefined {
+    const session = this.entries.get(key);
+    if (session) {
+      // Move to the most recently used end
+      this.entries.delete(key);
+      this.entries.set(key, session);
+    }
+    return session;
+  }
+
+  set(key: string, session: Uint8Array): void {
+    this.entries.delete(key);
+    this.entries.set(key, session);
+    for (const oldest of this.entries.keys()) {
+      if (this.entries.size <= this.capacity) {
+        break;
+      }
+      this.entries.delete(oldest);
+    }
+  }
+
+  delete(key: string): void {
+    this.entries.delete(key);
+  }
+
+  /**
+   * Drop every session
+   */
+  clear(): void {
+    this.entries.clear();
+  }
+}
+
+export interface IndexedDBSessionCacheOptions {
+  /**
+   * Database name (default: 'openssl-wasm-tls-sessions')
+   */
+  name?: string;
+  /**
+   * Number of sessions also kept in memory (default: 64)
+   */
+  capacity?: number;
+}
+
+function promisify<T>(request: IDBRequest<T>): Promise<T> {
+  return new Promise((resolve, reject) => {
+    request.onsuccess = () => resolve(request.result);
+    request.onerror = () => reject(request.error);
+  });
+}
+
+/**
+ * Session cache persisted in IndexedDB, so repeat visits resume.
+ *
+ * Lookups are served from an in-memory LRU first and only go to IndexedDB
+ * on a miss. Writes update memory at once and are persisted in the
+ * background; a failed write only costs a full handshake later.
+ */
+export class IndexedDBSessionCache implements TlsSessionCache {
+  private memory: MemorySessionCache;
+  private name: string;
+  private db: Promise<IDBDatabase> | null = null;
+
+  constructor(options: IndexedDBSessionCacheOptions = {}) {
+    this.memory = new MemorySessionCache(options.capacity);
+    this.name = options.name ?? DEFAULT_DATABASE_NAME;
+  }
+
+  async get(key: string): Promise<Uint8Array | undefined> {
+    const cached = this.memory.get(key);
+    if (cached) {
+      return cached;
+    }
+
+    try {
+      const store = await this.store('readonly');
+      const stored = await promisify<unknown>(store.get(key));
+      if (stored instanceof Uint8Array) {
+        this.memory.set(key, stored);
+        return stored;
+      }
+    } catch (e) {
+      // A database that cannot be opened behaves as an empty cache
+    }
+    return undefined;
+  }
+
+  set(key: string, session: Uint8Array): void {
+    this.memory.set(key, session);
+    this.store('readwrite')
+      .then(store => promisify(store.put(session, key)))
+      .catch(() => undefined);
+  }
+
+  delete(key: string): void {
+    this.memory.delete(key);
+    this.store('readwrite')
+      .then(store => promisify(store.delete(key)))
+      .catch(() => undefined);
+  }
+
+  /**
+   * Drop every session, in memory and in the database
+   */
+  async clear(): Promise<void> {
+    this.memory.clear();
+    const store = await this.store('readwrite');
+    await promisify(store.clear());
+  }
+
+  private async store(mode: IDBTransactionMode): Promise<IDBObjectStore> {
+    if (!this.db) {
+      this.db = new Promise((resolve, reject) => {
+        const request = indexedDB.open(this.name, 1);
+        request.onupgradeneeded = () => request.result.createObjectStore(STORE_NAME);
+        request.onsuccess = () => resolve(request.result);
+        request.onerror = () => reject(request.error);
+      });
+      // Let a later call retry if opening failed
+      this.db.catch(() => {
+        this.db = null;
+      });
+    }
+    const db = await this.db;
+    return db.transaction(STORE_NAME, mode).objectStore(STORE_NAME);
+  }
+}
@@ -0,0 +1,350 @@
+/**
+ * Web Streams adapters over the streaming handles
+ */
+
+import type { Hash } from './hash';
+import type { Cipher } from './cipher';
+import type { Base64Encoder, Base64Decoder } from './base64';
+
+/**
+ * Bytes handed to a hash or cipher per call. Smaller chunks are gathered
+ * up to this size and larger ones are cut into pieces of it, so a stream of
+ * tiny network reads does not cross into WASM for every few bytes and one
+ * huge chunk does not produce one huge output chunk.
+ */
+export const STREAM_BLOCK_SIZE = 64 * 1024;
+
+/**
+ * Bytes handed to a base64 encoder per call: a multiple of 3 close to
+ * STREAM_BLOCK_SIZE, so only the last block is padded
+ */
+export const BASE64_STREAM_BLOCK_SIZE = 3 * 16 * 1024;
+
+// Work done on a single chunk before letting the event loop run
+const YIELD_INTERVAL = 1024 * 1024;
+
+function nextTask(): Promise<void> {
+  return new Promise(resolve => setTimeout(resolve, 0));
+}
+
+/**
+ * Regroups a stream of byte chunks into blocks of a fixed size. Blocks are
+ * subarrays of the input where possible and of a reused staging buffer
+ * otherwise, so they are only valid during the callback.
+ */
+class Blocker {
+  private staging: Uint8Array;
+  private fill = 0;
+
+  constructor(size: number) {
+    this.staging = new Uint8Array(size);
+  }
+
+  async write(chunk: Uint8Array, process: (block: Uint8Array) => void): Promise<void> {
+    const size = this.staging.length;
+    let offset = 0;
+
+    if (this.fill > 0) {
+      offset = Math.min(size - this.fill, chunk.length);
+      this.staging.set(chunk.subarray(0, offset), this.fill);
+      this.fill += offset;
+      if (this.fill < size) {
+        return;
+      }
+      process(this.staging);
+      this.fill = 0;
+    }
+
+    let sinceYield = 0;
+    while (chunk.length - offset >= size) {
+      process(chunk.subarray(offset, offset + size));
+      offset += size;
+      sinceYield += size;
+      if (sinceYield >= YIELD_INTERVAL && chunk.length - offset >= size) {
+        await nextTask();
+        sinceYield = 0;
+      }
+    }
+
+    if (offset < chunk.length) {
+      this.staging.set(chunk.subarray(offset), 0);
+      this.fill = chunk.length - offset;
+    }
+  }
+
+  flush(process: (block: Uint8Array) => void): void {
+    if (this.fill > 0) {
+      process(this.staging.subarray(0, this.fill));
+      this.fill = 0;
+    }
+  }
+
+  wipe(): void {
+    this.staging.fill(0);
+    this.fill = 0;
+  }
+}
+
+const encoder = new TextEncoder();
+
+function toBytes(chunk: Uint8Array | string): Uint8Array {
+  return typeof chunk === 'string' ? encoder.encode(chunk) : chunk;
+}
+
+/**
+ * TransformStream that hashes everything written to it.
+ *
+ * Created with OpenSSL.createHashStream(). The digest is the stream's only
+ * output chunk and also resolves digest, so the readable side can simply be
+ * drained. With passThrough, the input is passed on unchanged instead and
+ * the digest is only available through digest.
+ */
+export class HashTransformStream extends TransformStream<Uint8Array | string, Uint8Array> {
+  /**
+   * Resolves to the digest once the input has ended, or rejects if the
+   * stream fails
+   */
+  readonly digest: Promise<Uint8Array>;
+
+  /**
+   * Constructor - should not be called directly, use OpenSSL.createHashStream() instead
+   */
+  constructor(hash: Hash, passThrough: boolean = false) {
+    let resolve!: (digest: Uint8Array) => void;
+    let reject!: (reason: unknown) => void;
+    const digest = new Promise<Uint8Array>((res, rej) => {
+      resolve = res;
+      reject = rej;
+    });
+    // Unobserved failures are reported through the stream itself
+    digest.catch(() => undefined);
+
+    const blocker = new Blocker(STREAM_BLOCK_SIZE);
+    const update = (block: Uint8Array) => {
+      hash.update(block);
+    };
+    const fail = (reason: unknown) => {
+      hash.dispose();
+      blocker.wipe();
+      reject(reason);
+    };
+
+    super({
+      async transform(chunk, controller) {
+        const data = toBytes(chunk);
+        try {
+          await blocker.write(data, update);
+        } catch (e) {
+          fail(e);
+          throw e;
+        }
+        if (passThrough) {
+          controller.enqueue(data);
+        }
+      },
+      flush(controller) {
+        try {
+          blocker.flush(update);
+          const result = hash.digest();
+          resolve(result);
+          if (!passThrough) {
+            controller.enqueue(result);
+          }
+        } catch (e) {
+          fail(e);
+          throw e;
+        } finally {
+          blocker.wipe();
+        }
+      },
+      cancel(reason) {
+        fail(reason);
+      }
+    } as Transformer<Uint8Array | string, Uint8Array>);
+
+    this.digest = digest;
+  }
+}
+
+/**
+ * TransformStream that encrypts or decrypts everything written to it.
+ *
+ * Created with OpenSSL.createCipherStream() or createDecipherStream(). For
+ * AEAD ciphers, call setAAD() before writing, read the tag with
+ * getAuthTag() once the stream has finished when encrypting, and supply it
+ * with setAuthTag() before closing the input when decrypting; the stream
+ * then errors with 'Authentication failed' if the data was modified.
+ * Decrypted output must not be trusted until the stream has closed
+ * without error.
+ */
+export class CipherTransformStream extends TransformStream<Uint8Array | string, Uint8Array> {
+  private cipher: Cipher;
+
+  /**
+   * Constructor - should not be called directly, use OpenSSL.createCipherStream()
+   * or OpenSSL.createDecipherStream() instead
+   */
+  constructor(cipher: Cipher) {
+    const blocker = new Blocker(STREAM_BLOCK_SIZE);
+    let controller: TransformStreamDefaultController<Uint8Array>;
+    // Each block's output is a fresh array, so it can be enqueued as is
+    const update = (block: Uint8Array) => {
+      const output = cipher.update(block);
+      if (output.length > 0) {
+        controller.enqueue(output);
+      }
+    };
+    const fail = () => {
+      cipher.dispose();
+      blocker.wipe();
+    };
+
+    super({
+      async transform(chunk, streamController) {
+        controller = streamController;
+        try {
+          await blocker.write(toBytes(chunk), update);
+        } catch (e) {
+          fail();
+          throw e;
+        }
+      },
+      flush(streamController) {
+        controller = streamController;
+        try {
+          blocker.flush(update);
+          const output = cipher.final();
+          if (output.length > 0) {
+            controller.enqueue(output);
+          }
+        } catch (e) {
+          fail();
+          throw e;
+        } finally {
+          blocker.wipe();
+        }
+      },
+      cancel() {
+        fail();
+      }
+    } as Transformer<Uint8Array | string, Uint8Array>);
+
+    this.cipher = cipher;
+  }
+
+  /**
+   * Feed additional authenticated data (AEAD only, before writing any data)
+   */
+  setAAD(aad: Uint8Array | string): this {
+    this.cipher.setAAD(aad);
+    return this;
+  }
+
+  /**
+   * Set the expected authentication tag (AEAD decryption only, before closing the input)
+   */
+  setAuthTag(tag: Uint8Array): this {
+    this.cipher.setAuthTag(tag);
+    return this;
+  }
+
+  /**
+   * Get the authentication tag (AEAD encryption only, after the stream has finished)
+   */
+  getAuthTag(): Uint8Array {
+    return this.cipher.getAuthTag();
+  }
+}
+
+/**
+ * Create a TransformStream from bytes to base64 text over an encoder
+ */
+export function base64EncodeStream(base64: Base64Encoder): TransformStream<Uint8Array | string, string> {
+  const blocker = new Blocker(BASE64_STREAM_BLOCK_SIZE);
+  let controller: TransformStreamDefaultController<string>;
+  const update = (block: Uint8Array) => {
+    const text = base64.update(block);
+    if (text.length > 0) {
+      controller.enqueue(text);
+    }
+  };
+
+  return new TransformStream({
+    async transform(chunk, streamController) {
+      controller = streamController;
+      try {
+        await blocker.write(toBytes(chunk), update);
+      } catch (e) {
+        base64.dispose();
+        throw e;
+      }
+    },
+    flush(streamController) {
+      controller = streamController;
+      try {
+        blocker.flush(update);
+        const text = base64.final();
+        if (text.length > 0) {
+          controller.enqueue(text);
+        }
+      } catch (e) {
+        base64.dispose();
+        throw e;
+      }
+    },
+    cancel() {
+      base64.dispose();
+    }
+  } as Transformer<Uint8Array | string, string>);
+}
+
+/**
+ * Create a TransformStream from base64 text to bytes over a decoder. Text
+ * chunks are gathered until STREAM_BLOCK_SIZE characters are pending and
+ * then decoded STREAM_BLOCK_SIZE characters at a time.
+ */
+export function base64DecodeStream(base64: Base64Decoder): TransformStream<string, Uint8Array> {
+  let pending: string[] = [];
+  let pendingLength = 0;
+  const decode = (controller: TransformStreamDefaultController<Uint8Array>) => {
+    const text = pending.length === 1 ? pending[0] : pending.join('');
+    pending = [];
+    pendingLength = 0;
+    for (let offset = 0; offset < text.length; offset += STREAM_BLOCK_SIZE) {
+      const output = base64.update(text.slice(offset, offset + STREAM_BLOCK_SIZE));
+      if (output.length > 0) {
+        controller.enqueue(output);
+      }
+    }
+  };
+
+  return new TransformStream({
+    transform(chunk, controller) {
+      pending.push(chunk);
+      pendingLength += chunk.length;
+      if (pendingLength >= STREAM_BLOCK_SIZE) {
+        try {
+          decode(controller);
+        } catch (e) {
+          base64.dispose();
+          throw e;
+        }
+      }
+    },
+    flush(controller) {
+      try {
+        decode(controller);
+        const output = base64.final();
+        if (output.length > 0) {
+          controller.enqueue(output);
+        }
+      } catch (e) {
+        base64.dispose();
+        throw e;
+      }
+    },
+    cancel() {
+      base64.dispose();
+    }
+  } as Transformer<string, Uint8Array>);
+}
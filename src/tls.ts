@@ -0,0 +1,733 @@
+/**
+ * TLS client engine over memory BIOs, carried by a WebSocket
+ *
+ * Browsers cannot open TCP sockets, so the TLS records travel as binary
+ * WebSocket messages to a relay (such as websockify) that forwards them to
+ * the server unchanged. The engine only ever sees the memory BIOs.
+ */
+
+import type { OpenSSLWasmInstance } from './index';
+import type { ScratchArena } from './arena';
+import { readAscii } from './base64';
+import type { TlsSessionCache } from './session';
+import type { TrustStore } from './trust';
+
+const TLS1_2_VERSION = 0x0303;
+const TLS1_3_VERSION = 0x0304;
+
+// Largest plaintext carried by one TLS record
+const TLS_RECORD_SIZE = 16384;
+
+// SSL_get_early_data_status
+const SSL_EARLY_DATA_ACCEPTED = 2;
+
+// WebSocket.readyState
+const WS_CONNECTING = 0;
+const WS_OPEN = 1;
+
+/**
+ * Wrapped TLS glue functions
+ */
+export interface TlsFunctions {
+  ctxNew: (minVersion: number, verify: number, ciphers: string | null) => number;
+  ctxAddCa: (ctx: number, pemPtr: number, pemLen: number) => number;
+  ctxSetAlpn: (ctx: number, protosPtr: number, protosLen: number) => number;
+  ctxSetTrustStore: (ctx: number, store: number, extend: number) => number;
+  ctxFree: (ctx: number) => void;
+  connNew: (ctx: number, host: string) => number;
+  setSession: (conn: number, derPtr: number, derLen: number) => number;
+  sessionVersion: (derPtr: number, derLen: number) => number;
+  maxEarlyData: (conn: number) => number;
+  writeEarly: (conn: number, dataPtr: number, dataLen: number) => number;
+  earlyDataStatus: (conn: number) => number;
+  handshake: (conn: number) => number;
+  feed: (conn: number, dataPtr: number, dataLen: number) => number;
+  write: (conn: number, dataPtr: number, dataLen: number) => number;
+  read: (conn: number, outPtr: number, outLen: number) => number;
+  output: (conn: number, ptrPtr: number) => number;
+  outputDone: (conn: number) => void;
+  sessionReady: (conn: number) => number;
+  takeSession: (conn: number, outPtr: number) => number;
+  version: (conn: number) => string;
+  cipher: (conn: number) => string;
+  resumed: (conn: number) => number;
+  alpn: (conn: number, ptrPtr: number) => number;
+  verifyResult: (conn: number) => number;
+  verifyErrorString: (result: number) => string;
+  peerCertificate: (conn: number, bio: number) => number;
+  shutdown: (conn: number) => number;
+  free: (conn: number) => void;
+  bioNewMem: () => number;
+  bioGetMemData: (bio: number, ptrPtr: number) => number;
+  bioFree: (bio: number) => void;
+  error: () => string;
+}
+
+/**
+ * Create the TLS function wrappers for a module instance
+ */
+export function wrapTlsFunctions(instance: OpenSSLWasmInstance): TlsFunctions {
+  return {
+    ctxNew: instance.cwrap('tls_ctx_new', 'number', ['number', 'number', 'string']) as TlsFunctions['ctxNew'],
+    ctxAddCa: instance.cwrap('tls_ctx_add_ca', 'number', ['number', 'number', 'number']) as TlsFunctions['ctxAddCa'],
+    ctxSetAlpn: instance.cwrap('tls_ctx_set_alpn', 'number', ['number', 'number', 'number']) as TlsFunctions['ctxSetAlpn'],
+    ctxSetTrustStore: instance.cwrap('tls_ctx_set_trust_store', 'number', ['number', 'number', 'number']) as TlsFunctions['ctxSetTrustStore'],
+    ctxFree: instance.cwrap('tls_ctx_free', 'void', ['number']) as TlsFunctions['ctxFree'],
+    connNew: instance.cwrap('tls_conn_new', 'number', ['number', 'string']) as TlsFunctions['connNew'],
+    setSession: instance.cwrap('tls_conn_set_session', 'number', ['number', 'number', 'number']) as TlsFunctions['setSession'],
+    sessionVersion: instance.cwrap('tls_session_version', 'number', ['number', 'number']) as TlsFunctions['sessionVersion'],
+    maxEarlyData: instance.cwrap('tls_conn_max_early_data', 'number', ['number']) as TlsFunctions['maxEarlyData'],
+    writeEarly: instance.cwrap('tls_conn_write_early', 'number', ['number', 'number', 'number']) as TlsFunctions['writeEarly'],
+    earlyDataStatus: instance.cwrap('tls_conn_early_data_status', 'number', ['number']) as TlsFunctions['earlyDataStatus'],
+    handshake: instance.cwrap('tls_conn_handshake', 'number', ['number']) as TlsFunctions['handshake'],
+    feed: instance.cwrap('tls_conn_feed', 'number', ['number', 'number', 'number']) as TlsFunctions['feed'],
+    write: instance.cwrap('tls_conn_write', 'number', ['number', 'number', 'number']) as TlsFunctions['write'],
+    read: instance.cwrap('tls_conn_read', 'number', ['number', 'number', 'number']) as TlsFunctions['read'],
+    output: instance.cwrap('tls_conn_output', 'number', ['number', 'number']) as TlsFunctions['output'],
+    outputDone: instance.cwrap('tls_conn_output_done', 'void', ['number']) as TlsFunctions['outputDone'],
+    sessionReady: instance.cwrap('tls_conn_session_ready', 'number', ['number']) as TlsFunctions['sessionReady'],
+    takeSession: instance.cwrap('tls_conn_take_session', 'number', ['number', 'number']) as TlsFunctions['takeSession'],
+    version: instance.cwrap('tls_conn_version', 'string', ['number']) as TlsFunctions['version'],
+    cipher: instance.cwrap('tls_conn_cipher', 'string', ['number']) as TlsFunctions['cipher'],
+    resumed: instance.cwrap('tls_conn_resumed', 'number', ['number']) as TlsFunctions['resumed'],
+    alpn: instance.cwrap('tls_conn_alpn', 'number', ['number', 'number']) as TlsFunctions['alpn'],
+    verifyResult: instance.cwrap('tls_conn_verify_result', 'number', ['number']) as TlsFunctions['verifyResult'],
+    verifyErrorString: instance.cwrap('x509_verify_error_string', 'string', ['number']) as TlsFunctions['verifyErrorString'],
+    peerCertificate: instance.cwrap('tls_conn_peer_certificate', 'number', ['number', 'number']) as TlsFunctions['peerCertificate'],
+    shutdown: instance.cwrap('tls_conn_shutdown', 'number', ['number']) as TlsFunctions['shutdown'],
+    free: instance.cwrap('tls_conn_free', 'void', ['number']) as TlsFunctions['free'],
+    bioNewMem: instance.cwrap('bio_new_mem', 'number', []) as TlsFunctions['bioNewMem'],
+    bioGetMemData: instance.cwrap('bio_get_mem_data', 'number', ['number', 'number']) as TlsFunctions['bioGetMemData'],
+    bioFree: instance.cwrap('bio_free', 'void', ['number']) as TlsFunctions['bioFree'],
+    error: instance.cwrap('get_error_string', 'string', []) as TlsFunctions['error']
+  };
+}
+
+export interface TlsContextOptions {
+  /**
+   * Trust store to verify servers against, shared with other contexts and
+   * verifyChain(). Either this or caCertificates is required when verify
+   * is enabled: browsers do not expose the system trust store.
+   */
+  trustStore?: TrustStore;
+  /**
+   * PEM certificates of the certificate authorities to trust, parsed into
+   * a store of this context's own. Combined with trustStore, the context
+   * trusts both through a private copy of the shared store, which is left
+   * unchanged.
+   */
+  caCertificates?: string[];
+  /**
+   * Verify the server certificate and host name (default: true)
+   */
+  verify?: boolean;
+  /**
+   * Lowest protocol version to negotiate (default: 'TLS1.2')
+   */
+  minVersion?: 'TLS1.2' | 'TLS1.3';
+  /**
+   * OpenSSL cipher list for TLS 1.2 (default: OpenSSL's default list)
+   */
+  ciphers?: string;
+  /**
+   * ALPN protocols to offer, e.g. ['h2', 'http/1.1']
+   */
+  alpn?: string[];
+  /**
+   * Where to keep sessions. Each connection offers the cached session for
+   * its server and stores the sessions the server issues.
+   */
+  sessionCache?: TlsSessionCache;
+}
+
+export interface TlsConnectOptions {
+  /**
+   * Server name, sent as SNI and checked against the certificate
+   */
+  host: string;
+  /**
+   * Serialized session from an earlier connection to offer for resumption.
+   * Takes precedence over the context's session cache.
+   */
+  session?: Uint8Array;
+  /**
+   * Session cache key (default: host). Use distinct keys for servers that
+   * share a name behind different relays or ports.
+   */
+  sessionKey?: string;
+  /**
+   * First application data to send. Sent as TLS 1.3 0-RTT data when the
+   * offered session allows it, otherwise right after the handshake. 0-RTT
+   * data can be replayed by an attacker, so only use it for idempotent
+   * requests.
+   */
+  earlyData?: Uint8Array | string;
+  /**
+   * Called with each new serialized session the server issues; store it and
+   * pass it as session on the next connection
+   */
+  onSession?: (session: Uint8Array) => void;
+}
+
+/**
+ * Encode protocol names in ALPN wire format
+ */
+function encodeAlpn(protocols: string[]): Uint8Array {
+  const encoder = new TextEncoder();
+  const names = protocols.map(name => encoder.encode(name));
+  const wire = new Uint8Array(names.reduce((total, name) => total + 1 + name.length, 0));
+  let offset = 0;
+  for (const name of names) {
+    if (name.length === 0 || name.length > 255) {
+      throw new Error('ALPN protocol names must be 1 to 255 bytes');
+    }
+    wire[offset++] = name.length;
+    wire.set(name, offset);
+    offset += name.length;
+  }
+  return wire;
+}
+
+/**
+ * Client configuration shared by many connections.
+ *
+ * Created with OpenSSL.createTlsContext(). The trusted certificates are
+ * parsed once here rather than on every connection. Connections keep the
+ * context alive, so dispose() may be called while they are still open.
+ */
+export class TlsContext {
+  private fns: TlsFunctions;
+  private arena: ScratchArena;
+  private ctx: number;
+  private sessionCache: TlsSessionCache | null;
+
+  /**
+   * Constructor - should not be called directly, use OpenSSL.createTlsContext() instead
+   */
+  constructor(fns: TlsFunctions, arena: ScratchArena, options: TlsContextOptions = {}) {
+    const verify = options.verify ?? true;
+    const caCertificates = options.caCertificates ?? [];
+    if (verify && caCertificates.length === 0 && !options.trustStore) {
+      throw new Error('A trustStore or caCertificates is required when verify is enabled');
+    }
+
+    this.fns = fns;
+    this.arena = arena;
+    this.sessionCache = options.sessionCache ?? null;
+    this.ctx = fns.ctxNew(options.minVersion === 'TLS1.3' ? TLS1_3_VERSION : TLS1_2_VERSION, verify ? 1 : 0, options.ciphers ?? null);
+    if (this.ctx === 0) {
+      throw new Error(`Failed to create TLS context: ${fns.error()}`);
+    }
+
+    const mark = arena.mark();
+    try {
+      // Extra CAs go into a private copy of the shared store, never into it
+      if (options.trustStore && fns.ctxSetTrustStore(this.ctx, options.trustStore.handle, caCertificates.length > 0 ? 1 : 0) !== 1) {
+        throw new Error(`Failed to set trust store: ${fns.error()}`);
+      }
+      for (const pem of caCertificates) {
+        const data = new TextEncoder().encode(pem);
+        if (fns.ctxAddCa(this.ctx, arena.copyIn(data), data.length) <= 0) {
+          throw new Error(`Invalid CA certificate: ${fns.error()}`);
+        }
+      }
+      if (options.alpn && options.alpn.length > 0) {
+        const wire = encodeAlpn(options.alpn);
+        if (fns.ctxSetAlpn(this.ctx, arena.copyIn(wire), wire.length) !== 1) {
+          throw new Error(`Failed to set ALPN protocols: ${fns.error()}`);
+        }
+      }
+    } catch (e) {
+      this.dispose();
+      throw e;
+    } finally {
+      arena.release(mark);
+    }
+  }
+
+  /**
+   * Run a TLS handshake over a WebSocket connected to a TCP relay.
+   *
+   * Resolves once the handshake completes. The socket may still be
+   * connecting; the handshake starts when it opens. With a session cache,
+   * the cached session for the server is offered automatically.
+   */
+  async connect(socket: WebSocket, options: TlsConnectOptions): Promise<TlsConnection> {
+    const cache = this.sessionCache;
+    const cached = cache ? await this.withCachedSession(cache, options) : null;
+    if (cached) {
+      options = cached.options;
+    }
+
+    if (this.ctx === 0) {
+      throw new Error('TlsContext has been disposed');
+    }
+    const conn = this.fns.connNew(this.ctx, options.host);
+    if (conn === 0) {
+      throw new Error(`Failed to create TLS connection: ${this.fns.error()}`);
+    }
+
+    const connection = await new Promise<TlsConnection>((resolve, reject) => {
+      new TlsConnection(this.fns, this.arena, conn, socket, options, resolve, reject);
+    });
+    await cached?.settle(connection);
+    return connection;
+  }
+
+  // Offer the cached session and store the ones the server issues. TLS 1.3
+  // tickets should not be offered twice (RFC 8446 C.4), so a cached one is
+  // removed as it is taken; the new connection receives fresh tickets. A
+  // TLS 1.2 session can be resumed any number of times and the server
+  // issues no replacement when it is, so it stays cached until a handshake
+  // falls back to a full one without a new session.
+  private async withCachedSession(cache: TlsSessionCache, options: TlsConnectOptions): Promise<{
+    options: TlsConnectOptions;
+    settle: (connection: TlsConnection) => Promise<void>;
+  }> {
+    const key = options.sessionKey ?? options.host;
+    let session = options.session;
+    let fromCache = false;
+    if (!session) {
+      session = await cache.get(key);
+      if (session) {
+        fromCache = true;
+        if (this.sessionVersion(session) === TLS1_3_VERSION) {
+          await cache.delete(key);
+        }
+      }
+    }
+
+    let replaced = false;
+    return {
+      options: {
+        ...options,
+        session,
+        onSession: issued => {
+          replaced = true;
+          cache.set(key, issued);
+          options.onSession?.(issued);
+        }
+      },
+      settle: async connection => {
+        if (fromCache && !replaced && !connection.resumed) {
+          await cache.delete(key);
+        }
+      }
+    };
+  }
+
+  private sessionVersion(session: Uint8Array): number {
+    const mark = this.arena.mark();
+    try {
+      return this.fns.sessionVersion(this.arena.copyIn(session), session.length);
+    } finally {
+      this.arena.release(mark);
+    }
+  }
+
+  /**
+   * Release the context. Open connections are not affected.
+   */
+  dispose(): void {
+    if (this.ctx !== 0) {
+      this.fns.ctxFree(this.ctx);
+      this.ctx = 0;
+    }
+  }
+}
+
+/**
+ * An established TLS connection.
+ *
+ * Records from every WebSocket message are decrypted together and the
+ * plaintext is delivered in one onData call. Records produced by write()
+ * are batched until the current task finishes and leave in one WebSocket
+ * message, sent straight from the WASM heap.
+ */
+export class TlsConnection {
+  private fns: TlsFunctions;
+  private arena: ScratchArena;
+  private conn: number;
+  private socket: WebSocket;
+  private options: TlsConnectOptions;
+  private established = false;
+  private flushScheduled = false;
+  private pendingEarlyData: Uint8Array | null = null;
+  private dataHandler: ((data: Uint8Array) => void) | null = null;
+  private undelivered: Uint8Array[] = [];
+  private onEstablished: (connection: TlsConnection) => void;
+  private onFailed: (error: Error) => void;
+
+  /**
+   * Called with the plaintext decrypted from each WebSocket message. Data
+   * that arrived before a handler was set is delivered when it is set.
+   */
+  get onData(): ((data: Uint8Array) => void) | null {
+    return this.dataHandler;
+  }
+
+  set onData(handler: ((data: Uint8Array) => void) | null) {
+    this.dataHandler = handler;
+    if (handler && this.undelivered.length > 0) {
+      const data = concat(this.undelivered);
+      this.undelivered = [];
+      handler(data);
+    }
+  }
+
+  /**
+   * Called once when the connection closes, with the error if it failed
+   */
+  onClose: ((error?: Error) => void) | null = null;
+
+  /**
+   * Negotiated protocol version, e.g. 'TLSv1.3'
+   */
+  protocol = '';
+
+  /**
+   * Negotiated cipher suite
+   */
+  cipher = '';
+
+  /**
+   * Whether the handshake resumed the offered session
+   */
+  resumed = false;
+
+  /**
+   * Protocol selected by ALPN, or null
+   */
+  alpnProtocol: string | null = null;
+
+  /**
+   * Whether the server accepted the early data as 0-RTT
+   */
+  earlyDataAccepted = false;
+
+  /**
+   * Latest serialized session issued by the server, or null
+   */
+  session: Uint8Array | null = null;
+
+  /**
+   * Constructor - should not be called directly, use TlsContext.connect() instead
+   */
+  constructor(fns: TlsFunctions, arena: ScratchArena, conn: number, socket: WebSocket, options: TlsConnectOptions,
+              onEstablished: (connection: TlsConnection) => void, onFailed: (error: Error) => void) {
+    this.fns = fns;
+    this.arena = arena;
+    this.conn = conn;
+    this.socket = socket;
+    this.options = options;
+    this.onEstablished = onEstablished;
+    this.onFailed = onFailed;
+
+    socket.binaryType = 'arraybuffer';
+    socket.addEventListener('message', event => {
+      if (event.data instanceof ArrayBuffer) {
+        this.receive(new Uint8Array(event.data));
+      }
+    });
+    socket.addEventListener('close', () => this.finish(this.established ? undefined : new Error('Connection closed during the TLS handshake')));
+
+    if (socket.readyState === WS_OPEN) {
+      this.start();
+    } else if (socket.readyState === WS_CONNECTING) {
+      socket.addEventListener('open', () => this.start(), { once: true });
+    } else {
+      this.finish(new Error('WebSocket is closed'));
+    }
+  }
+
+  /**
+   * Send application data. Records from every write() in the same task are
+   * sent together.
+   */
+  write(data: Uint8Array | string): void {
+    this.checkOpen();
+    this.writeRecords(typeof data === 'string' ? new TextEncoder().encode(data) : data);
+    this.scheduleFlush();
+  }
+
+  /**
+   * The server certificate as PEM, or null if none was presented
+   */
+  peerCertificate(): string | null {
+    this.checkOpen();
+
+    const bio = this.fns.bioNewMem();
+    if (bio === 0) {
+      throw new Error('Failed to allocate BIO');
+    }
+    const mark = this.arena.mark();
+    try {
+      if (this.fns.peerCertificate(this.conn, bio) !== 1) {
+        return null;
+      }
+      const ptrPtr = this.arena.alloc(4);
+      const length = this.fns.bioGetMemData(bio, ptrPtr);
+      return readAscii(this.arena.heapU8, this.arena.heapU32[ptrPtr >> 2], length);
+    } finally {
+      this.arena.release(mark);
+      this.fns.bioFree(bio);
+    }
+  }
+
+  /**
+   * Send close_notify and close the WebSocket
+   */
+  close(): void {
+    if (this.conn === 0) {
+      return;
+    }
+    this.fns.shutdown(this.conn);
+    this.flush();
+    this.socket.close();
+    this.finish();
+  }
+
+  private start(): void {
+    if (this.conn === 0) {
+      return;
+    }
+
+    const { session, earlyData } = this.options;
+    const mark = this.arena.mark();
+    try {
+      // A session that fails to parse just means a full handshake
+      if (session && session.length > 0) {
+        this.fns.setSession(this.conn, this.arena.copyIn(session), session.length);
+      }
+
+      if (earlyData !== undefined) {
+        const data = typeof earlyData === 'string' ? new TextEncoder().encode(earlyData) : earlyData;
+        this.pendingEarlyData = data;
+        if (data.length > 0 && data.length <= this.fns.maxEarlyData(this.conn)) {
+          if (this.fns.writeEarly(this.conn, this.arena.copyIn(data), data.length) !== data.length) {
+            throw new Error(`Failed to write early data: ${this.fns.error()}`);
+          }
+        }
+      }
+    } catch (e) {
+      this.fail(e instanceof Error ? e : new Error(String(e)));
+      return;
+    } finally {
+      this.arena.release(mark);
+    }
+
+    this.advance();
+    this.flush();
+  }
+
+  private receive(data: Uint8Array): void {
+    if (this.conn === 0) {
+      return;
+    }
+
+    const mark = this.arena.mark();
+    try {
+      if (this.fns.feed(this.conn, this.arena.copyIn(data), data.length) !== 1) {
+        throw new Error('Failed to buffer TLS records');
+      }
+    } catch (e) {
+      this.fail(e instanceof Error ? e : new Error(String(e)));
+      return;
+    } finally {
+      this.arena.release(mark);
+    }
+
+    if (!this.established && !this.advance()) {
+      return;
+    }
+    if (this.established) {
+      this.readRecords();
+    }
+    if (this.conn !== 0) {
+      this.takeSession();
+      this.flush();
+    }
+  }
+
+  // Continue the handshake; returns false if the connection failed
+  private advance(): boolean {
+    const result = this.fns.handshake(this.conn);
+    if (result < 0) {
+      const verify = this.fns.verifyResult(this.conn);
+      this.fail(new Error(verify !== 0
+        ? `Certificate verification failed: ${this.fns.verifyErrorString(verify)}`
+        : `TLS handshake failed: ${this.fns.error()}`));
+      return false;
+    }
+    if (result === 0) {
+      return true;
+    }
+
+    this.established = true;
+    this.protocol = this.fns.version(this.conn);
+    this.cipher = this.fns.cipher(this.conn);
+    this.resumed = this.fns.resumed(this.conn) === 1;
+    this.alpnProtocol = this.readAlpn();
+    this.earlyDataAccepted = this.fns.earlyDataStatus(this.conn) === SSL_EARLY_DATA_ACCEPTED;
+
+    // Early data that was not sent or was rejected goes out as normal data
+    if (this.pendingEarlyData && !this.earlyDataAccepted && this.pendingEarlyData.length > 0) {
+      this.writeRecords(this.pendingEarlyData);
+    }
+    this.pendingEarlyData = null;
+
+    this.onEstablished(this);
+    return true;
+  }
+
+  // Decrypt everything fed so far and deliver it in one onData call
+  private readRecords(): void {
+    const chunks: Uint8Array[] = [];
+    let closed = false;
+    let error: Error | undefined;
+
+    const mark = this.arena.mark();
+    try {
+      const outPtr = this.arena.alloc(TLS_RECORD_SIZE);
+      for (;;) {
+        const length = this.fns.read(this.conn, outPtr, TLS_RECORD_SIZE);
+        if (length > 0) {
+          chunks.push(this.arena.copyOut(outPtr, length));
+          continue;
+        }
+        if (length === -2) {
+          closed = true;
+        } else if (length === -1) {
+          error = new Error(`TLS read failed: ${this.fns.error()}`);
+        }
+        break;
+      }
+    } finally {
+      this.arena.release(mark);
+    }
+
+    if (chunks.length > 0) {
+      const data = chunks.length === 1 ? chunks[0] : concat(chunks);
+      if (this.dataHandler) {
+        this.dataHandler(data);
+      } else {
+        this.undelivered.push(data);
+      }
+    }
+    if (error) {
+      this.fail(error);
+    } else if (closed) {
+      this.close();
+    }
+  }
+
+  private writeRecords(data: Uint8Array): void {
+    const mark = this.arena.mark();
+    try {
+      if (data.length > 0 && this.fns.write(this.conn, this.arena.copyIn(data), data.length) !== 1) {
+        throw new Error(`TLS write failed: ${this.fns.error()}`);
+      }
+    } finally {
+      this.arena.release(mark);
+    }
+  }
+
+  private takeSession(): void {
+    if (this.fns.sessionReady(this.conn) !== 1) {
+      return;
+    }
+
+    const mark = this.arena.mark();
+    try {
+      const length = this.fns.takeSession(this.conn, 0);
+      const outPtr = this.arena.alloc(length);
+      this.session = this.arena.copyOut(outPtr, this.fns.takeSession(this.conn, outPtr));
+    } finally {
+      this.arena.release(mark);
+    }
+    this.options.onSession?.(this.session);
+  }
+
+  private readAlpn(): string | null {
+    const mark = this.arena.mark();
+    try {
+      const ptrPtr = this.arena.alloc(4);
+      const length = this.fns.alpn(this.conn, ptrPtr);
+      return length > 0 ? readAscii(this.arena.heapU8, this.arena.heapU32[ptrPtr >> 2], length) : null;
+    } finally {
+      this.arena.release(mark);
+    }
+  }
+
+  private scheduleFlush(): void {
+    if (!this.flushScheduled) {
+      this.flushScheduled = true;
+      queueMicrotask(() => {
+        this.flushScheduled = false;
+        this.flush();
+      });
+    }
+  }
+
+  // Send every pending record in one message. WebSocket.send copies its
+  // argument synchronously, so the records are sent from the heap in place.
+  private flush(): void {
+    if (this.conn === 0 || this.socket.readyState !== WS_OPEN) {
+      return;
+    }
+
+    const mark = this.arena.mark();
+    try {
+      const ptrPtr = this.arena.alloc(4);
+      const length = this.fns.output(this.conn, ptrPtr);
+      if (length > 0) {
+        const ptr = this.arena.heapU32[ptrPtr >> 2];
+        this.socket.send(this.arena.heapU8.subarray(ptr, ptr + length));
+        this.fns.outputDone(this.conn);
+      }
+    } finally {
+      this.arena.release(mark);
+    }
+  }
+
+  private fail(error: Error): void {
+    if (this.conn === 0) {
+      return;
+    }
+    // Send any alert the engine queued before closing
+    this.flush();
+    this.socket.close();
+    this.finish(error);
+  }
+
+  // Free the native connection and report the outcome exactly once
+  private finish(error?: Error): void {
+    if (this.conn === 0) {
+      return;
+    }
+    this.fns.free(this.conn);
+    this.conn = 0;
+
+    if (!this.established) {
+      this.onFailed(error ?? new Error('Connection closed during the TLS handshake'));
+    } else {
+      this.onClose?.(error);
+    }
+  }
+
+  private checkOpen(): void {
+    if (this.conn === 0) {
+      throw new Error('TlsConnection has been closed');
+    }
+  }
+}
+
+function concat(chunks: Uint8Array[]): Uint8Array {
+  const out = new Uint8Array(chunks.reduce((total, chunk) => total + chunk.length, 0));
+  let offset = 0;
+  for (const chunk of chunks) {
+    out.set(chunk, offset);
+    offset += chunk.length;
+  }
+  return out;
+}
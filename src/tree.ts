@@ -0,0 +1,79 @@
+/**
+ * Chunked tree (Merkle) hashing for very large inputs
+ *
+ * The input is split into fixed-size leaves. Each leaf digest is
+ * H(0x00 || chunk) and each interior node is H(0x01 || left || right), with
+ * the tree split as in RFC 6962 so any number of leaves is allowed. Leaves
+ * are independent, so they can be hashed in parallel and rehashed
+ * individually when part of the input changes.
+ */
+
+import type { OpenSSLWasmInstance } from './index';
+
+/**
+ * Default leaf size in bytes
+ */
+export const DEFAULT_TREE_CHUNK_SIZE = 1024 * 1024;
+
+/**
+ * Amount of input copied into the WASM heap per call while hashing leaves
+ */
+export const TREE_WINDOW_SIZE = 4 * 1024 * 1024;
+
+export interface TreeHashOptions {
+  /**
+   * Leaf size in bytes (default: 1 MiB)
+   */
+  chunkSize?: number;
+  /**
+   * Also return the packed leaf digests
+   */
+  leaves?: boolean;
+}
+
+export interface TreeHashResult {
+  /**
+   * Root of the tree
+   */
+  root: Uint8Array;
+  /**
+   * Leaf digests back to back, leaf i at offset i * digestLength. Only set
+   * when requested with the `leaves` option.
+   */
+  leaves?: Uint8Array;
+}
+
+/**
+ * Wrapped tree hash functions from the WASM module
+ */
+export interface TreeHashFunctions {
+  leaves: (name: string, dataPtr: number, dataLen: number, chunkSize: number, outPtr: number) => number;
+  root: (name: string, leavesPtr: number, count: number, outPtr: number) => number;
+}
+
+/**
+ * Create the tree hash function wrappers for a module instance
+ */
+export function wrapTreeHashFunctions(instance: OpenSSLWasmInstance): TreeHashFunctions {
+  return {
+    leaves: instance.cwrap('tree_hash_leaves', 'number', ['string', 'number', 'number', 'number', 'number']) as TreeHashFunctions['leaves'],
+    root: instance.cwrap('tree_hash_root', 'number', ['string', 'number', 'number', 'number']) as TreeHashFunctions['root']
+  };
+}
+
+/**
+ * Validate a leaf size and return it, applying the default
+ */
+export function checkChunkSize(chunkSize: number = DEFAULT_TREE_CHUNK_SIZE): number {
+  if (!Number.isInteger(chunkSize) || chunkSize < 1) {
+    throw new Error('Tree hash chunk size must be a positive integer');
+  }
+  return chunkSize;
+}
+
+/**
+ * Number of leaves for an input of the given length
+ */
+export function leafCount(length: number, chunkSize: number): number {
+  return Math.ceil(length / chunkSize);
+}
@@ -0,0 +1,252 @@
+/**
+ * Resident certificate trust store and chain verification
+ */
+
+import type { OpenSSLWasmInstance } from './index';
+import type { ScratchArena } from './arena';
+
+/**
+ * Default number of verified chains remembered by a TrustStore
+ */
+export const DEFAULT_VERIFY_CACHE_SIZE = 256;
+
+/**
+ * A certificate as PEM text or DER bytes. Bundles passed to
+ * addCertificates() may hold several PEM certificates.
+ */
+export type CertificateData = string | Uint8Array;
+
+/**
+ * Wrapped trust store glue functions
+ */
+export interface TrustFunctions {
+  storeNew: () => number;
+  storeAdd: (store: number, dataPtr: number, dataLen: number) => number;
+  storeCount: (store: number) => number;
+  storeFree: (store: number) => void;
+  verifyChain: (store: number, ptrsPtr: number, lensPtr: number, count: number, host: string, validForPtr: number) => number;
+  verifyErrorString: (result: number) => string;
+  error: () => string;
+}
+
+/**
+ * Create the trust store function wrappers for a module instance
+ */
+export function wrapTrustFunctions(instance: OpenSSLWasmInstance): TrustFunctions {
+  return {
+    storeNew: instance.cwrap('trust_store_new', 'number', []) as TrustFunctions['storeNew'],
+    storeAdd: instance.cwrap('trust_store_add', 'number', ['number', 'number', 'number']) as TrustFunctions['storeAdd'],
+    storeCount: instance.cwrap('trust_store_count', 'number', ['number']) as TrustFunctions['storeCount'],
+    storeFree: instance.cwrap('trust_store_free', 'void', ['number']) as TrustFunctions['storeFree'],
+    verifyChain: instance.cwrap('x509_verify_chain', 'number', ['number', 'number', 'number', 'number', 'string', 'number']) as TrustFunctions['verifyChain'],
+    verifyErrorString: instance.cwrap('x509_verify_error_string', 'string', ['number']) as TrustFunctions['verifyErrorString'],
+    error: instance.cwrap('get_error_string', 'string', []) as TrustFunctions['error']
+  };
+}
+
+export interface TrustStoreOptions {
+  /**
+   * Number of verified chains remembered (default: 256; 0 disables the cache)
+   */
+  cacheSize?: number;
+}
+
+export interface VerifyChainOptions {
+  /**
+   * Host name or IP address the leaf must be valid for as a TLS server
+   */
+  host?: string;
+}
+
+export interface VerifyChainResult {
+  /**
+   * Whether the chain leads to a trusted root
+   */
+  valid: boolean;
+  /**
+   * X509_V_OK (0), an X509_V_ERR_* code, or -1 if a certificate did not parse
+   */
+  code: number;
+  /**
+   * Description of the failure, or null if valid
+   */
+  error: string | null;
+  /**
+   * Whether the result came from the verification cache
+   */
+  cached: boolean;
+}
+
+/**
+ * Roots parsed once into a resident X509_STORE.
+ *
+ * Created with OpenSSL.createTrustStore(). The store can verify chains
+ * directly and be shared by TLS contexts. Successful verifications are
+ * remembered by the fingerprint of the (leaf, intermediates, host) tuple
+ * until the first certificate in the chain expires, so verifying the same
+ * chain again skips parsing and every signature check.
+ */
+export class TrustStore {
+  private fns: TrustFunctions;
+  private arena: ScratchArena;
+  private digest: (data: Uint8Array) => Uint8Array;
+  private store: number;
+  private verified = new Map<string, number>();
+  private cacheSize: number;
+  private encoder = new TextEncoder();
+
+  /**
+   * Constructor - should not be called directly, use OpenSSL.createTrustStore() instead
+   */
+  constructor(fns: TrustFunctions, arena: ScratchArena, digest: (data: Uint8Array) => Uint8Array, options: TrustStoreOptions = {}) {
+    const cacheSize = options.cacheSize ?? DEFAULT_VERIFY_CACHE_SIZE;
+    if (!Number.isInteger(cacheSize) || cacheSize < 0) {
+      throw new Error('Verification cache size must be a non-negative integer');
+    }
+
+    this.fns = fns;
+    this.arena = arena;
+    this.digest = digest;
+    this.cacheSize = cacheSize;
+    this.store = fns.storeNew();
+    if (this.store === 0) {
+      throw new Error(`Failed to create trust store: ${fns.error()}`);
+    }
+  }
+
+  /**
+   * Native X509_STORE pointer, for passing to other glue functions
+   */
+  get handle(): number {
+    this.checkOpen();
+    return this.store;
+  }
+
+  /**
+   * Number of trusted certificates
+   */
+  get size(): number {
+    this.checkOpen();
+    return this.fns.storeCount(this.store);
+  }
+
+  /**
+   * Trust more certificates: PEM bundles or single DER certificates.
+   * Returns the number of certificates added.
+   */
+  addCertificates(certificates: CertificateData | CertificateData[]): number {
+    this.checkOpen();
+
+    const list = Array.isArray(certificates) ? certificates : [certificates];
+    const arena = this.arena;
+    const mark = arena.mark();
+    let added = 0;
+    try {
+      for (const certificate of list) {
+        const data = typeof certificate === 'string' ? this.encoder.encode(certificate) : certificate;
+        const count = this.fns.storeAdd(this.store, arena.copyIn(data), data.length);
+        if (count <= 0) {
+          throw new Error(`Invalid certificate: ${this.fns.error()}`);
+        }
+        added += count;
+      }
+    } finally {
+      arena.release(mark);
+    }
+    return added;
+  }
+
+  /**
+   * Verify a chain: the leaf first, then any intermediates in any order
+   */
+  verifyChain(certificates: CertificateData[], options: VerifyChainOptions = {}): VerifyChainResult {
+    this.checkOpen();
+    if (certificates.length === 0) {
+      throw new Error('verifyChain needs at least the leaf certificate');
+    }
+
+    const encoded = certificates.map(c => typeof c === 'string' ? this.encoder.encode(c) : c);
+    const host = options.host ?? '';
+    const id = this.cacheSize > 0 ? this.fingerprint(encoded, host) : '';
+
+    const expires = this.verified.get(id);
+    if (expires !== undefined) {
+      this.verified.delete(id);
+      if (expires > Date.now()) {
+        this.verified.set(id, expires);
+        return { valid: true, code: 0, error: null, cached: true };
+      }
+    }
+
+    const arena = this.arena;
+    const mark = arena.mark();
+    let code: number;
+    let validFor: number;
+    try {
+      const { ptrsPtr, lensPtr } = arena.packMessages(encoded);
+      const validForPtr = arena.alloc(4);
+      code = this.fns.verifyChain(this.store, ptrsPtr, lensPtr, encoded.length, host, validForPtr);
+      validFor = arena.heapU32[validForPtr >> 2];
+    } finally {
+      arena.release(mark);
+    }
+
+    if (code !== 0) {
+      return { valid: false, code, error: code < 0 ? 'Invalid certificate encoding' : this.fns.verifyErrorString(code), cached: false };
+    }
+
+    if (this.cacheSize > 0) {
+      this.remember(id, Date.now() + validFor * 1000);
+    }
+    return { valid: true, code: 0, error: null, cached: false };
+  }
+
+  /**
+   * Forget every remembered verification
+   */
+  clearCache(): void {
+    this.verified.clear();
+  }
+
+  /**
+   * Free the store. TLS contexts using it keep their own reference.
+   */
+  dispose(): void {
+    if (this.store !== 0) {
+      this.fns.storeFree(this.store);
+      this.store = 0;
+      this.verified.clear();
+    }
+  }
+
+  private remember(id: string, expires: number): void {
+    this.verified.set(id, expires);
+    for (const oldest of this.verified.keys()) {
+      if (this.verified.size <= this.cacheSize) {
+        break;
+      }
+      this.verified.delete(oldest);
+    }
+  }
+
+  // SHA-256 over the host and the length-prefixed certificate encodings
+  private fingerprint(encoded: Uint8Array[], host: string): string {
+    const hostData = this.encoder.encode(host);
+    const parts = [hostData, ...encoded];
+    const input = new Uint8Array(parts.reduce((total, part) => total + 4 + part.length, 0));
+    const view = new DataView(input.buffer);
+    let offset = 0;
+    for (const part of parts) {
+      view.setUint32(offset, part.length, true);
+      input.set(part, offset + 4);
+      offset += 4 + part.length;
+    }
+    return String.fromCharCode(...this.digest(input));
+  }
+
+  private checkOpen(): void {
+    if (this.store === 0) {
+      throw new Error('TrustStore has been disposed');
+    }
+  }
+}
@@ -4,12 +4,238 @@
 #include <openssl/rand.h>
 #include <openssl/evp.h>
 #include <openssl/rsa.h>
+#include <openssl/core_names.h>
 #include <openssl/pem.h>
+#include <openssl/pkcs12.h>
 #include <openssl/bio.h>
 #include <openssl/hmac.h>
+#include <openssl/kdf.h>
 #include <openssl/buffer.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+#include <emscripten.h>
 #include <string.h>
 #include <stdlib.h>
+#include <malloc.h>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Build tiers
+ *
+ * scripts/build-wasm.js links one module per tier, each a superset of the
+ * one before: hash (digests, HMAC, KDFs, base64, random), cipher, pkey and
+ * tls. OPENSSL_WASM_TIER selects the glue compiled into a module, so that
+ * nothing references the algorithms its OpenSSL build was configured
+ * without. Builds that do not set it get everything.
+ */
+#define WASM_TIER_HASH 0
+#define WASM_TIER_CIPHER 1
+#define WASM_TIER_PKEY 2
+#define WASM_TIER_TLS 3
+
+#ifndef OPENSSL_WASM_TIER
+#define OPENSSL_WASM_TIER WASM_TIER_TLS
+#endif
+
+/*
+ * Fetched algorithm cache
+ *
+ * Implicitly fetched algorithms such as EVP_sha256() go through the provider
+ * method store every time they are used. Instead, the algorithms the glue
+ * relies on are fetched once at openssl_init time and kept here; other names
+ * are fetched on first use and kept in the remaining slots, which are reused
+ * round-robin once full. Contexts hold their own reference to the algorithm,
+ * so replacing a slot never invalidates a context that is still using it.
+ */
+#define ALG_CACHE_SIZE 16
+
+enum { MD_SHA1, MD_SHA256, MD_SHA384, MD_SHA512, MD_MD5, MD_PREFETCH_COUNT };
+enum {
+    CIPHER_AES_128_CBC, CIPHER_AES_192_CBC, CIPHER_AES_256_CBC,
+    CIPHER_AES_128_GCM, CIPHER_AES_256_GCM, CIPHER_CHACHA20_POLY1305,
+    CIPHER_PREFETCH_COUNT
+};
+
+typedef struct {
+    char name[32];
+    EVP_MD* md;
+} md_cache_entry;
+
+typedef struct {
+    char name[32];
+    EVP_CIPHER* cipher;
+} cipher_cache_entry;
+
+static md_cache_entry md_cache[ALG_CACHE_SIZE] = {
+    { "SHA1", NULL }, { "SHA256", NULL }, { "SHA384", NULL }, { "SHA512", NULL }, { "MD5", NULL }
+};
+static int md_cache_used = MD_PREFETCH_COUNT;
+static int md_cache_next = MD_PREFETCH_COUNT;
+
+static cipher_cache_entry cipher_cache[ALG_CACHE_SIZE] = {
+    { "AES-128-CBC", NULL }, { "AES-192-CBC", NULL }, { "AES-256-CBC", NULL },
+    { "AES-128-GCM", NULL }, { "AES-256-GCM", NULL }, { "ChaCha20-Poly1305", NULL }
+};
+static int cipher_cache_used = CIPHER_PREFETCH_COUNT;
+static int cipher_cache_next = CIPHER_PREFETCH_COUNT;
+
+static EVP_KDF* hkdf_alg = NULL;
+
+static const EVP_MD* md_slot(int slot) {
+    if (!md_cache[slot].md) {
+        md_cache[slot].md = EVP_MD_fetch(NULL, md_cache[slot].name, NULL);
+    }
+    return md_cache[slot].md;
+}
+
+#if OPENSSL_WASM_TIER >= WASM_TIER_CIPHER
+static const EVP_CIPHER* cipher_slot(int slot) {
+    if (!cipher_cache[slot].cipher) {
+        cipher_cache[slot].cipher = EVP_CIPHER_fetch(NULL, cipher_cache[slot].name, NULL);
+    }
+    return cipher_cache[slot].cipher;
+}
+#endif
+
+static const EVP_MD* get_md(const char* name) {
+    EVP_MD* md;
+    int slot;
+
+    for (slot = 0; slot < md_cache_used; slot++) {
+        if (OPENSSL_strcasecmp(md_cache[slot].name, name) == 0) {
+            return md_slot(slot);
+        }
+    }
+
+    if (strlen(name) >= sizeof(md_cache[0].name)) return NULL;
+
+    md = EVP_MD_fetch(NULL, name, NULL);
+    if (!md) return NULL;
+
+    if (md_cache_used < ALG_CACHE_SIZE) {
+        slot = md_cache_used++;
+    } else {
+        slot = md_cache_next;
+        md_cache_next = slot + 1 < ALG_CACHE_SIZE ? slot + 1 : MD_PREFETCH_COUNT;
+        EVP_MD_free(md_cache[slot].md);
+    }
+
+    strcpy(md_cache[slot].name, name);
+    md_cache[slot].md = md;
+    return md;
+}
+
+#if OPENSSL_WASM_TIER >= WASM_TIER_CIPHER
+static const EVP_CIPHER* get_cipher(const char* name) {
+    EVP_CIPHER* cipher;
+    int slot;
+
+    for (slot = 0; slot < cipher_cache_used; slot++) {
+        if (OPENSSL_strcasecmp(cipher_cache[slot].name, name) == 0) {
+            return cipher_slot(slot);
+        }
+    }
+
+    if (strlen(name) >= sizeof(cipher_cache[0].name)) return NULL;
+
+    cipher = EVP_CIPHER_fetch(NULL, name, NULL);
+    if (!cipher) return NULL;
+
+    if (cipher_cache_used < ALG_CACHE_SIZE) {
+        slot = cipher_cache_used++;
+    } else {
+        slot = cipher_cache_next;
+        cipher_cache_next = slot + 1 < ALG_CACHE_SIZE ? slot + 1 : CIPHER_PREFETCH_COUNT;
+        EVP_CIPHER_free(cipher_cache[slot].cipher);
+    }
+
+    strcpy(cipher_cache[slot].name, name);
+    cipher_cache[slot].cipher = cipher;
+    return cipher;
+}
+#endif
+
+static void free_alg_cache(void) {
+    int slot;
+
+    for (slot = 0; slot < md_cache_used; slot++) {
+        EVP_MD_free(md_cache[slot].md);
+        md_cache[slot].md = NULL;
+    }
+    md_cache_used = md_cache_next = MD_PREFETCH_COUNT;
+
+    for (slot = 0; slot < cipher_cache_used; slot++) {
+        EVP_CIPHER_free(cipher_cache[slot].cipher);
+        cipher_cache[slot].cipher = NULL;
+    }
+    cipher_cache_used = cipher_cache_next = CIPHER_PREFETCH_COUNT;
+
+    EVP_KDF_free(hkdf_alg);
+    hkdf_alg = NULL;
+}
+
+/*
+ * Context pools
+ *
+ * Released contexts are reset and kept for the next caller instead of being
+ * freed, so the per-call EVP_MD_CTX_new/EVP_CIPHER_CTX_new cost is only paid
+ * when more contexts are live at once than the pool holds.
+ */
+#define CTX_POOL_SIZE 8
+
+static EVP_MD_CTX* md_ctx_pool[CTX_POOL_SIZE];
+static int md_ctx_pool_count = 0;
+
+static EVP_CIPHER_CTX* cipher_ctx_pool[CTX_POOL_SIZE];
+static int cipher_ctx_pool_count = 0;
+
+static EVP_MD_CTX* md_ctx_acquire(void) {
+    if (md_ctx_pool_count > 0) {
+        return md_ctx_pool[--md_ctx_pool_count];
+    }
+    return EVP_MD_CTX_new();
+}
+
+static void md_ctx_release(EVP_MD_CTX* ctx) {
+    if (!ctx) return;
+
+    if (md_ctx_pool_count < CTX_POOL_SIZE && EVP_MD_CTX_reset(ctx) == 1) {
+        md_ctx_pool[md_ctx_pool_count++] = ctx;
+    } else {
+        EVP_MD_CTX_free(ctx);
+    }
+}
+
+#if OPENSSL_WASM_TIER >= WASM_TIER_CIPHER
+static EVP_CIPHER_CTX* cipher_ctx_acquire(void) {
+    if (cipher_ctx_pool_count > 0) {
+        return cipher_ctx_pool[--cipher_ctx_pool_count];
+    }
+    return EVP_CIPHER_CTX_new();
+}
+
+static void cipher_ctx_release(EVP_CIPHER_CTX* ctx) {
+    if (!ctx) return;
+
+    if (cipher_ctx_pool_count < CTX_POOL_SIZE && EVP_CIPHER_CTX_reset(ctx) == 1) {
+        cipher_ctx_pool[cipher_ctx_pool_count++] = ctx;
+    } else {
+        EVP_CIPHER_CTX_free(ctx);
+    }
+}
+#endif
+
+static void free_ctx_pools(void) {
+    while (md_ctx_pool_count > 0) {
+        EVP_MD_CTX_free(md_ctx_pool[--md_ctx_pool_count]);
+    }
+    while (cipher_ctx_pool_count > 0) {
+        EVP_CIPHER_CTX_free(cipher_ctx_pool[--cipher_ctx_pool_count]);
+    }
+}
 
 /**
  * Get OpenSSL version string
@@ -19,405 +245,1853 @@ const char* openssl_version() {
 }
 
 /**
- * Initialize OpenSSL
+ * Initialize OpenSSL
+ */
+int openssl_init() {
+    int slot;
+
+    if (OPENSSL_init_crypto(OPENSSL_INIT_ADD_ALL_CIPHERS | 
+                            OPENSSL_INIT_ADD_ALL_DIGESTS | 
+                            OPENSSL_INIT_LOAD_CONFIG, 
+                            NULL) != 1) {
+        return 0;
+    }
+
+    /* Fetch the commonly used algorithms up front */
+    for (slot = 0; slot < MD_PREFETCH_COUNT; slot++) {
+        md_slot(slot);
+    }
+#if OPENSSL_WASM_TIER >= WASM_TIER_CIPHER
+    for (slot = 0; slot < CIPHER_PREFETCH_COUNT; slot++) {
+        cipher_slot(slot);
+    }
+#endif
+
+    return 1;
+}
+
+/**
+ * Clean up OpenSSL
+ */
+void openssl_cleanup() {
+    free_ctx_pools();
+    free_alg_cache();
+    OPENSSL_cleanup();
+}
+
+/**
+ * Report allocator statistics
+ *
+ * Writes four values to out: bytes the allocator has taken from linear
+ * memory, bytes in use, bytes free, and the part of the free bytes at the
+ * top of the heap (the rest is fragmented between live allocations).
+ * mallinfo walks every chunk, so this is meant for occasional sampling.
+ */
+void heap_stats(size_t* out) {
+    struct mallinfo info = mallinfo();
+
+    out[0] = (size_t)info.arena;
+    out[1] = (size_t)info.uordblks;
+    out[2] = (size_t)info.fordblks;
+    out[3] = (size_t)info.keepcost;
+}
+
+/**
+ * Generate random bytes
+ */
+int random_bytes(unsigned char* buf, int len) {
+    return RAND_bytes(buf, len);
+}
+
+/**
+ * Reseed the DRBGs from the entropy source. The primary DRBG reseeds
+ * first, then the public and private DRBGs reseed from it.
+ */
+int random_reseed(void) {
+    EVP_RAND_CTX* primary = RAND_get0_primary(NULL);
+    EVP_RAND_CTX* public_drbg = RAND_get0_public(NULL);
+    EVP_RAND_CTX* private_drbg = RAND_get0_private(NULL);
+
+    if (primary == NULL || public_drbg == NULL || private_drbg == NULL) {
+        return 0;
+    }
+    if (!EVP_RAND_reseed(primary, 1, NULL, 0, NULL, 0)
+        || !EVP_RAND_reseed(public_drbg, 0, NULL, 0, NULL, 0)
+        || !EVP_RAND_reseed(private_drbg, 0, NULL, 0, NULL, 0)) {
+        return 0;
+    }
+    return 1;
+}
+
+static int digest_with_ctx(EVP_MD_CTX* ctx, const EVP_MD* type, const unsigned char* data, size_t data_len, unsigned char* md) {
+    unsigned int md_len;
+
+    return EVP_DigestInit_ex(ctx, type, NULL) == 1 &&
+           EVP_DigestUpdate(ctx, data, data_len) == 1 &&
+           EVP_DigestFinal_ex(ctx, md, &md_len) == 1;
+}
+
+static int oneshot_digest(const EVP_MD* type, const unsigned char* data, size_t data_len, unsigned char* md) {
+    EVP_MD_CTX* ctx;
+    int ret;
+
+    if (!type) return 0;
+
+    ctx = md_ctx_acquire();
+    if (!ctx) return 0;
+
+    ret = digest_with_ctx(ctx, type, data, data_len, md);
+    md_ctx_release(ctx);
+    return ret;
+}
+
+/**
+ * Calculate SHA1 digest
+ */
+int sha1_digest(const unsigned char* data, size_t data_len, unsigned char* md) {
+    return oneshot_digest(md_slot(MD_SHA1), data, data_len, md);
+}
+
+/**
+ * Calculate SHA256 digest
+ */
+int sha256_digest(const unsigned char* data, size_t data_len, unsigned char* md) {
+    return oneshot_digest(md_slot(MD_SHA256), data, data_len, md);
+}
+
+/**
+ * Calculate SHA384 digest
+ */
+int sha384_digest(const unsigned char* data, size_t data_len, unsigned char* md) {
+    return oneshot_digest(md_slot(MD_SHA384), data, data_len, md);
+}
+
+/**
+ * Calculate SHA512 digest
+ */
+int sha512_digest(const unsigned char* data, size_t data_len, unsigned char* md) {
+    return oneshot_digest(md_slot(MD_SHA512), data, data_len, md);
+}
+
+/**
+ * Calculate MD5 digest
+ */
+int md5_digest(const unsigned char* data, size_t data_len, unsigned char* md) {
+    return oneshot_digest(md_slot(MD_MD5), data, data_len, md);
+}
+
+/**
+ * Streaming digest initialization
+ *
+ * Looks up the digest by name (e.g. "sha256") and returns a context that can
+ * be fed with digest_update. The context is released by digest_final, or by
+ * evp_md_ctx_free if the digest is abandoned.
+ */
+EVP_MD_CTX* digest_init(const char* name) {
+    const EVP_MD* md = get_md(name);
+    EVP_MD_CTX* ctx;
+
+    if (!md) return NULL;
+
+    ctx = md_ctx_acquire();
+    if (!ctx) return NULL;
+
+    if (EVP_DigestInit_ex(ctx, md, NULL) != 1) {
+        md_ctx_release(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+/**
+ * Streaming digest update
+ */
+int digest_update(EVP_MD_CTX* ctx, const unsigned char* data, size_t data_len) {
+    return EVP_DigestUpdate(ctx, data, data_len);
+}
+
+/**
+ * Streaming digest final
+ */
+int digest_final(EVP_MD_CTX* ctx, unsigned char* md, unsigned int* md_len) {
+    int ret = EVP_DigestFinal_ex(ctx, md, md_len);
+    md_ctx_release(ctx);
+    return ret;
+}
+
+/**
+ * Get the output size of a streaming digest
+ */
+int digest_size(const EVP_MD_CTX* ctx) {
+    return EVP_MD_CTX_get_size(ctx);
+}
+
+/**
+ * Get the output size of a digest by name
+ */
+int digest_length(const char* name) {
+    const EVP_MD* md = get_md(name);
+    return md ? EVP_MD_get_size(md) : 0;
+}
+
+/**
+ * Hash a batch of messages in one call
+ *
+ * ptrs and lens hold the address and length of each of the count messages.
+ * The digests are written back to back into out, which must have room for
+ * count * digest_length(name) bytes. All messages share one context.
+ */
+int digest_batch(const char* name, const unsigned char* const* ptrs, const size_t* lens, int count, unsigned char* out) {
+    const EVP_MD* md = get_md(name);
+    EVP_MD_CTX* ctx;
+    int md_size;
+    int ret = 1;
+    int i;
+
+    if (!md) return 0;
+    md_size = EVP_MD_get_size(md);
+
+    ctx = md_ctx_acquire();
+    if (!ctx) return 0;
+
+    for (i = 0; i < count && ret; i++) {
+        ret = digest_with_ctx(ctx, md, ptrs[i], lens[i], out + (size_t)i * md_size);
+    }
+
+    md_ctx_release(ctx);
+    return ret;
+}
+
+/* Domain separation prefixes for tree hashing (RFC 6962, section 2.1) */
+static const unsigned char TREE_LEAF_PREFIX = 0x00;
+static const unsigned char TREE_NODE_PREFIX = 0x01;
+
+/**
+ * Hash the leaves of a tree hash
+ *
+ * Splits data into chunk_size pieces (the last may be shorter) and writes
+ * H(0x00 || chunk) for each one back to back into out, which must have room
+ * for ceil(data_len / chunk_size) * digest_length(name) bytes.
+ */
+int tree_hash_leaves(const char* name, const unsigned char* data, size_t data_len, size_t chunk_size, unsigned char* out) {
+    const EVP_MD* md = get_md(name);
+    EVP_MD_CTX* ctx;
+    size_t offset;
+    int md_size;
+    int ret = 1;
+
+    if (!md || chunk_size == 0) return 0;
+    md_size = EVP_MD_get_size(md);
+
+    ctx = md_ctx_acquire();
+    if (!ctx) return 0;
+
+    for (offset = 0; offset < data_len && ret; offset += chunk_size) {
+        size_t len = data_len - offset < chunk_size ? data_len - offset : chunk_size;
+        ret = EVP_DigestInit_ex(ctx, md, NULL) == 1
+            && EVP_DigestUpdate(ctx, &TREE_LEAF_PREFIX, 1) == 1
+            && EVP_DigestUpdate(ctx, data + offset, len) == 1
+            && EVP_DigestFinal_ex(ctx, out, NULL) == 1;
+        out += md_size;
+    }
+
+    md_ctx_release(ctx);
+    return ret;
+}
+
+/* Root of leaves[0..count), splitting at the largest power of two below count */
+static int tree_node(EVP_MD_CTX* ctx, const EVP_MD* md, int md_size, const unsigned char* leaves, size_t count, unsigned char* out) {
+    unsigned char left[EVP_MAX_MD_SIZE];
+    unsigned char right[EVP_MAX_MD_SIZE];
+    size_t split = 1;
+
+    if (count == 1) {
+        memcpy(out, leaves, md_size);
+        return 1;
+    }
+
+    while (split * 2 < count) split *= 2;
+
+    return tree_node(ctx, md, md_size, leaves, split, left)
+        && tree_node(ctx, md, md_size, leaves + split * md_size, count - split, right)
+        && EVP_DigestInit_ex(ctx, md, NULL) == 1
+        && EVP_DigestUpdate(ctx, &TREE_NODE_PREFIX, 1) == 1
+        && EVP_DigestUpdate(ctx, left, md_size) == 1
+        && EVP_DigestUpdate(ctx, right, md_size) == 1
+        && EVP_DigestFinal_ex(ctx, out, NULL) == 1;
+}
+
+/**
+ * Combine leaf digests into a tree hash root
+ *
+ * Interior nodes are H(0x01 || left || right) and the tree is split as in
+ * RFC 6962, so any leaf count is allowed. The root of zero leaves is the
+ * digest of the empty string.
+ */
+int tree_hash_root(const char* name, const unsigned char* leaves, size_t count, unsigned char* out) {
+    const EVP_MD* md = get_md(name);
+    EVP_MD_CTX* ctx;
+    int ret;
+
+    if (!md) return 0;
+
+    if (count == 0) {
+        return oneshot_digest(md, NULL, 0, out);
+    }
+
+    ctx = md_ctx_acquire();
+    if (!ctx) return 0;
+
+    ret = tree_node(ctx, md, EVP_MD_get_size(md), leaves, count, out);
+
+    md_ctx_release(ctx);
+    return ret;
+}
+
+/*
+ * Content-defined chunking
+ *
+ * FastCDC (Xia et al., USENIX ATC 2016) over a gear rolling hash, with the
+ * digest of each chunk computed in the same pass. Cut points depend only on
+ * the bytes near them, so an insertion early in a file moves the chunk
+ * boundaries around it and leaves the rest of the chunks, and their
+ * digests, unchanged.
+ *
+ * No cut is made in the first min_size bytes of a chunk. Up to avg_size a
+ * cut needs two more zero bits than log2(avg_size), after it two fewer, and
+ * at max_size the chunk is cut regardless ("normalized chunking", level 2),
+ * which keeps chunk sizes close to avg_size.
+ *
+ * The gear table is generated from a fixed seed, so boundaries are stable
+ * across builds. Changing the seed, the masks or the minimum skip changes
+ * every boundary and defeats deduplication against existing chunks.
+ */
+#define CDC_MIN_SIZE 64
+#define CDC_MAX_SIZE (1u << 30)
+#define CDC_RECORD_HEADER 12
+
+static uint64_t cdc_gear[256];
+static int cdc_gear_ready = 0;
+
+typedef struct {
+    const EVP_MD* md;
+    EVP_MD_CTX* ctx;
+    uint64_t fp;
+    uint64_t offset;   /* input offset of the current chunk */
+    size_t length;     /* bytes of the current chunk seen so far */
+    size_t min_size;
+    size_t avg_size;
+    size_t max_size;
+    uint64_t mask_small;
+    uint64_t mask_large;
+    int md_size;
+} cdc_state;
+
+static void cdc_init_gear(void) {
+    uint64_t x = 0;
+    int i;
+
+    if (cdc_gear_ready) return;
+
+    /* splitmix64 from seed 0 */
+    for (i = 0; i < 256; i++) {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        cdc_gear[i] = z ^ (z >> 31);
+    }
+    cdc_gear_ready = 1;
+}
+
+/* The top bits of a gear hash depend on the most bytes, so masks use them */
+static uint64_t cdc_mask(int bits) {
+    return ~(uint64_t)0 << (64 - bits);
+}
+
+/*
+ * Scan data for the end of the current chunk. Returns the number of bytes
+ * that belong to it and sets *found when the chunk ends there.
+ */
+static size_t cdc_scan(cdc_state* s, const unsigned char* data, size_t len, int* found) {
+    size_t base = s->length;
+    uint64_t fp = s->fp;
+    size_t i = 0;
+    size_t stop;
+
+    *found = 0;
+
+    if (base < s->min_size) {
+        i = s->min_size - base < len ? s->min_size - base : len;
+    }
+
+    stop = s->avg_size > base ? s->avg_size - base : 0;
+    if (stop > len) stop = len;
+    for (; i < stop; i++) {
+        fp = (fp << 1) + cdc_gear[data[i]];
+        if (!(fp & s->mask_small)) {
+            *found = 1;
+            s->fp = fp;
+            return i + 1;
+        }
+    }
+
+    stop = s->max_size - base < len ? s->max_size - base : len;
+    for (; i < stop; i++) {
+        fp = (fp << 1) + cdc_gear[data[i]];
+        if (!(fp & s->mask_large)) {
+            *found = 1;
+            s->fp = fp;
+            return i + 1;
+        }
+    }
+
+    *found = base + i == s->max_size;
+    s->fp = fp;
+    return i;
+}
+
+/* Write the record for the current chunk and start the next one */
+static int cdc_emit(cdc_state* s, unsigned char* out) {
+    uint32_t length = (uint32_t)s->length;
+
+    memcpy(out, &s->offset, 8);
+    memcpy(out + 8, &length, 4);
+    if (EVP_DigestFinal_ex(s->ctx, out + CDC_RECORD_HEADER, NULL) != 1
+        || EVP_DigestInit_ex(s->ctx, s->md, NULL) != 1) {
+        return 0;
+    }
+
+    s->offset += s->length;
+    s->length = 0;
+    s->fp = 0;
+    return 1;
+}
+
+/**
+ * Content-defined chunker setup
+ *
+ * Returns a chunker hashing each chunk with the named digest, or NULL if
+ * the digest is unknown or the sizes are not CDC_MIN_SIZE <= min_size <=
+ * avg_size <= max_size <= CDC_MAX_SIZE. Feed it with cdc_update and finish
+ * with cdc_final, or release it with cdc_free.
+ */
+cdc_state* cdc_init(const char* name, size_t min_size, size_t avg_size, size_t max_size) {
+    const EVP_MD* md = get_md(name);
+    cdc_state* s;
+    int bits = 0;
+
+    if (!md || min_size < CDC_MIN_SIZE || min_size > avg_size || avg_size > max_size || max_size > CDC_MAX_SIZE) {
+        return NULL;
+    }
+
+    s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+
+    s->ctx = md_ctx_acquire();
+    if (!s->ctx || EVP_DigestInit_ex(s->ctx, md, NULL) != 1) {
+        md_ctx_release(s->ctx);
+        free(s);
+        return NULL;
+    }
+
+    while (((size_t)2 << bits) <= avg_size) bits++;
+
+    cdc_init_gear();
+    s->md = md;
+    s->md_size = EVP_MD_get_size(md);
+    s->min_size = min_size;
+    s->avg_size = avg_size;
+    s->max_size = max_size;
+    s->mask_small = cdc_mask(bits + 2);
+    s->mask_large = cdc_mask(bits - 2);
+    return s;
+}
+
+/**
+ * Get the size of one chunk record: CDC_RECORD_HEADER plus the digest
+ */
+int cdc_record_size(const cdc_state* s) {
+    return CDC_RECORD_HEADER + s->md_size;
+}
+
+/**
+ * Chunk more input
+ *
+ * Writes a record for every chunk that ends within data to out and returns
+ * how many were written, or -1 on failure. Each record is the chunk's
+ * offset in the whole input (uint64), its length (uint32), both little
+ * endian, and its digest. A chunk may span any number of calls. out must
+ * have room for data_len / min_size + 1 records.
+ */
+int cdc_update(cdc_state* s, const unsigned char* data, size_t data_len, unsigned char* out) {
+    size_t record_size = CDC_RECORD_HEADER + s->md_size;
+    int count = 0;
+
+    while (data_len > 0) {
+        int found;
+        size_t n = cdc_scan(s, data, data_len, &found);
+
+        if (EVP_DigestUpdate(s->ctx, data, n) != 1) return -1;
+        s->length += n;
+        data += n;
+        data_len -= n;
+
+        if (found) {
+            if (!cdc_emit(s, out)) return -1;
+            out += record_size;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Release a chunker without finishing it
+ */
+void cdc_free(cdc_state* s) {
+    if (!s) return;
+    md_ctx_release(s->ctx);
+    free(s);
+}
+
+/**
+ * Finish chunking
+ *
+ * Writes the record for the last chunk, if any input is left over, and
+ * returns the number of records written (0 or 1), or -1 on failure. The
+ * chunker is released either way.
+ */
+int cdc_final(cdc_state* s, unsigned char* out) {
+    int ret = 0;
+
+    if (s->length > 0) {
+        ret = cdc_emit(s, out) ? 1 : -1;
+    }
+
+    cdc_free(s);
+    return ret;
+}
+
+#if OPENSSL_WASM_TIER >= WASM_TIER_CIPHER
+
+/**
+ * AES encryption context
+ */
+EVP_CIPHER_CTX* aes_encrypt_init(const unsigned char* key, int key_len, const unsigned char* iv) {
+    EVP_CIPHER_CTX* ctx;
+    const EVP_CIPHER* cipher = NULL;
+    
+    switch (key_len) {
+        case 16: cipher = cipher_slot(CIPHER_AES_128_CBC); break;
+        case 24: cipher = cipher_slot(CIPHER_AES_192_CBC); break;
+        case 32: cipher = cipher_slot(CIPHER_AES_256_CBC); break;
+    }
+    
+    if (!cipher) return NULL;
+    
+    ctx = cipher_ctx_acquire();
+    if (!ctx) return NULL;
+    
+    if (EVP_EncryptInit_ex(ctx, cipher, NULL, key, iv) != 1) {
+        cipher_ctx_release(ctx);
+        return NULL;
+    }
+    
+    return ctx;
+}
+
+/**
+ * AES encryption update
+ */
+int aes_encrypt_update(EVP_CIPHER_CTX* ctx, const unsigned char* in, int in_len, unsigned char* out, int* out_len) {
+    return EVP_EncryptUpdate(ctx, out, out_len, in, in_len);
+}
+
+/**
+ * AES encryption final
+ */
+int aes_encrypt_final(EVP_CIPHER_CTX* ctx, unsigned char* out, int* out_len) {
+    int ret = EVP_EncryptFinal_ex(ctx, out, out_len);
+    cipher_ctx_release(ctx);
+    return ret;
+}
+
+/**
+ * AES decryption context
+ */
+EVP_CIPHER_CTX* aes_decrypt_init(const unsigned char* key, int key_len, const unsigned char* iv) {
+    EVP_CIPHER_CTX* ctx;
+    const EVP_CIPHER* cipher = NULL;
+    
+    switch (key_len) {
+        case 16: cipher = cipher_slot(CIPHER_AES_128_CBC); break;
+        case 24: cipher = cipher_slot(CIPHER_AES_192_CBC); break;
+        case 32: cipher = cipher_slot(CIPHER_AES_256_CBC); break;
+    }
+    
+    if (!cipher) return NULL;
+    
+    ctx = cipher_ctx_acquire();
+    if (!ctx) return NULL;
+    
+    if (EVP_DecryptInit_ex(ctx, cipher, NULL, key, iv) != 1) {
+        cipher_ctx_release(ctx);
+        return NULL;
+    }
+    
+    return ctx;
+}
+
+/**
+ * AES decryption update
+ */
+int aes_decrypt_update(EVP_CIPHER_CTX* ctx, const unsigned char* in, int in_len, unsigned char* out, int* out_len) {
+    return EVP_DecryptUpdate(ctx, out, out_len, in, in_len);
+}
+
+/**
+ * AES decryption final
+ */
+int aes_decrypt_final(EVP_CIPHER_CTX* ctx, unsigned char* out, int* out_len) {
+    int ret = EVP_DecryptFinal_ex(ctx, out, out_len);
+    cipher_ctx_release(ctx);
+    return ret;
+}
+
+/**
+ * Cipher initialization by name
+ *
+ * Works for any cipher OpenSSL knows (e.g. "AES-256-CBC", "AES-256-GCM",
+ * "ChaCha20-Poly1305"). enc is 1 to encrypt and 0 to decrypt. For AEAD
+ * ciphers iv_len may differ from the default nonce length; for other ciphers
+ * it must match. Returns NULL on an unknown cipher or bad key/IV length.
+ */
+EVP_CIPHER_CTX* cipher_init(const char* name, const unsigned char* key, int key_len, const unsigned char* iv, int iv_len, int enc) {
+    const EVP_CIPHER* cipher = get_cipher(name);
+    EVP_CIPHER_CTX* ctx;
+    int aead;
+
+    if (!cipher || key_len != EVP_CIPHER_get_key_length(cipher)) return NULL;
+
+    aead = (EVP_CIPHER_get_flags(cipher) & EVP_CIPH_FLAG_AEAD_CIPHER) != 0;
+    if (!aead && iv_len != EVP_CIPHER_get_iv_length(cipher)) return NULL;
+
+    ctx = cipher_ctx_acquire();
+    if (!ctx) return NULL;
+
+    if (EVP_CipherInit_ex(ctx, cipher, NULL, NULL, NULL, enc) != 1 ||
+        (aead && iv_len != EVP_CIPHER_get_iv_length(cipher) &&
+         EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, iv_len, NULL) != 1) ||
+        EVP_CipherInit_ex(ctx, NULL, NULL, key, iv, enc) != 1) {
+        cipher_ctx_release(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+/**
+ * Cipher update
+ */
+int cipher_update(EVP_CIPHER_CTX* ctx, const unsigned char* in, int in_len, unsigned char* out, int* out_len) {
+    return EVP_CipherUpdate(ctx, out, out_len, in, in_len);
+}
+
+/**
+ * Feed additional authenticated data to an AEAD cipher
+ *
+ * Must be called before any cipher_update on the message.
+ */
+int cipher_update_aad(EVP_CIPHER_CTX* ctx, const unsigned char* aad, int aad_len) {
+    int out_len;
+    return EVP_CipherUpdate(ctx, NULL, &out_len, aad, aad_len);
+}
+
+/**
+ * Set the expected authentication tag before finishing an AEAD decryption
+ */
+int cipher_set_tag(EVP_CIPHER_CTX* ctx, const unsigned char* tag, int tag_len) {
+    return EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, tag_len, (void*)tag);
+}
+
+/**
+ * Cipher final
+ *
+ * When encrypting with an AEAD cipher, pass a tag buffer to receive the
+ * tag_len byte authentication tag; otherwise tag may be NULL. For AEAD
+ * decryption a return value of 0 means authentication failed. The context
+ * is released either way.
+ */
+int cipher_final(EVP_CIPHER_CTX* ctx, unsigned char* out, int* out_len, unsigned char* tag, int tag_len) {
+    int ret = EVP_CipherFinal_ex(ctx, out, out_len);
+
+    if (ret == 1 && tag && EVP_CIPHER_CTX_is_encrypting(ctx)) {
+        ret = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, tag_len, tag);
+    }
+
+    cipher_ctx_release(ctx);
+    return ret;
+}
+
+/**
+ * Get the block size of an initialized cipher (1 for stream and AEAD modes)
+ */
+int cipher_block_size(const EVP_CIPHER_CTX* ctx) {
+    return EVP_CIPHER_CTX_get_block_size(ctx);
+}
+
+/**
+ * Check whether an initialized cipher is an AEAD mode
+ */
+int cipher_is_aead(const EVP_CIPHER_CTX* ctx) {
+    return (EVP_CIPHER_get_flags(EVP_CIPHER_CTX_get0_cipher(ctx)) & EVP_CIPH_FLAG_AEAD_CIPHER) != 0;
+}
+
+/*
+ * Initialize a cipher for the one-shot AEAD functions, refusing non-AEAD
+ * modes: their final block would land in the tag slot and the tag request
+ * is not guaranteed to fail on provider ciphers
+ */
+static EVP_CIPHER_CTX* aead_init(const char* name, const unsigned char* key, int key_len,
+                                 const unsigned char* iv, int iv_len, int enc) {
+    EVP_CIPHER_CTX* ctx = cipher_init(name, key, key_len, iv, iv_len, enc);
+
+    if (ctx && !cipher_is_aead(ctx)) {
+        cipher_ctx_release(ctx);
+        ERR_raise(ERR_LIB_EVP, EVP_R_UNSUPPORTED_CIPHER);
+        return NULL;
+    }
+    return ctx;
+}
+
+/**
+ * One-shot AEAD encryption
+ *
+ * Encrypts in_len bytes from in into out (also in_len bytes) and writes the
+ * tag_len byte authentication tag to tag. Returns 0 for non-AEAD ciphers.
+ */
+int aead_seal(const char* name, const unsigned char* key, int key_len, const unsigned char* iv, int iv_len,
+              const unsigned char* aad, int aad_len, const unsigned char* in, int in_len,
+              unsigned char* out, unsigned char* tag, int tag_len) {
+    EVP_CIPHER_CTX* ctx = aead_init(name, key, key_len, iv, iv_len, 1);
+    int len;
+
+    if (!ctx) return 0;
+
+    if ((aad_len > 0 && cipher_update_aad(ctx, aad, aad_len) != 1) ||
+        EVP_CipherUpdate(ctx, out, &len, in, in_len) != 1) {
+        cipher_ctx_release(ctx);
+        return 0;
+    }
+
+    return cipher_final(ctx, out + len, &len, tag, tag_len);
+}
+
+/**
+ * One-shot AEAD decryption
+ *
+ * Decrypts in_len bytes from in into out (also in_len bytes). Returns 0 if the
+ * tag does not authenticate the ciphertext and AAD; out must then be discarded.
+ */
+int aead_open(const char* name, const unsigned char* key, int key_len, const unsigned char* iv, int iv_len,
+              const unsigned char* aad, int aad_len, const unsigned char* in, int in_len,
+              const unsigned char* tag, int tag_len, unsigned char* out) {
+    EVP_CIPHER_CTX* ctx = aead_init(name, key, key_len, iv, iv_len, 0);
+    int len;
+
+    if (!ctx) return 0;
+
+    if ((aad_len > 0 && cipher_update_aad(ctx, aad, aad_len) != 1) ||
+        EVP_CipherUpdate(ctx, out, &len, in, in_len) != 1 ||
+        cipher_set_tag(ctx, tag, tag_len) != 1) {
+        cipher_ctx_release(ctx);
+        return 0;
+    }
+
+    return cipher_final(ctx, out + len, &len, NULL, 0);
+}
+
+#endif
+
+#if OPENSSL_WASM_TIER >= WASM_TIER_PKEY
+
+/*
+ * Key generation progress
+ *
+ * Forwards the BN_GENCB-style progress of EVP_PKEY_generate to
+ * Module.onKeygenProgress(stage, count) when JS has installed a handler.
+ * For RSA, stage 0 is a candidate prime, 1 a primality test round, 2 a
+ * prime found and 3 a prime accepted.
+ */
+EM_JS(void, keygen_progress, (int stage, int count), {
+    if (Module["onKeygenProgress"]) {
+        Module["onKeygenProgress"](stage, count);
+    }
+});
+
+static int keygen_callback(EVP_PKEY_CTX* ctx) {
+    keygen_progress(EVP_PKEY_CTX_get_keygen_info(ctx, 0), EVP_PKEY_CTX_get_keygen_info(ctx, 1));
+    return 1;
+}
+
+/**
+ * Generate a key pair
+ *
+ * type is an OpenSSL key type name ("RSA", "RSA-PSS", "EC", "ED25519",
+ * "X25519"). bits sets the modulus size of RSA keys and group the curve of
+ * EC keys; pass 0 and NULL where they do not apply.
+ */
+EVP_PKEY* pkey_generate(const char* type, int bits, const char* group) {
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_from_name(NULL, type, NULL);
+    EVP_PKEY* pkey = NULL;
+
+    if (!ctx) return NULL;
+
+    if (EVP_PKEY_keygen_init(ctx) != 1 ||
+        (bits > 0 && EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, bits) != 1) ||
+        (group && *group && EVP_PKEY_CTX_set_group_name(ctx, group) != 1)) {
+        EVP_PKEY_CTX_free(ctx);
+        return NULL;
+    }
+
+    EVP_PKEY_CTX_set_cb(ctx, keygen_callback);
+    if (EVP_PKEY_generate(ctx, &pkey) != 1) {
+        pkey = NULL;
+    }
+
+    EVP_PKEY_CTX_free(ctx);
+    return pkey;
+}
+
+/* Set up RSA padding on a signing context; other key types are left alone */
+static int pkey_setup_padding(EVP_PKEY_CTX* pctx, EVP_PKEY* pkey, int pss) {
+    if (!pss || !EVP_PKEY_is_a(pkey, "RSA")) return 1;
+
+    return EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PSS_PADDING) == 1
+        && EVP_PKEY_CTX_set_rsa_pss_saltlen(pctx, RSA_PSS_SALTLEN_DIGEST) == 1;
+}
+
+/**
+ * Sign a message
+ *
+ * md_name selects the digest; pass NULL or "" for keys that hash
+ * internally (Ed25519). With pss set, RSA keys sign with PSS padding and a
+ * digest-length salt; RSA-PSS keys always do. sig must have room for
+ * pkey_size(pkey) bytes, and sig_len receives the signature length.
+ */
+int pkey_sign(EVP_PKEY* pkey, const char* md_name, int pss, const unsigned char* data, size_t data_len, unsigned char* sig, size_t* sig_len) {
+    EVP_MD_CTX* ctx = md_ctx_acquire();
+    EVP_PKEY_CTX* pctx = NULL;
+    int ret;
+
+    if (!ctx) return 0;
+
+    *sig_len = EVP_PKEY_get_size(pkey);
+    ret = EVP_DigestSignInit_ex(ctx, &pctx, md_name && *md_name ? md_name : NULL, NULL, NULL, pkey, NULL) == 1
+        && pkey_setup_padding(pctx, pkey, pss)
+        && EVP_DigestSign(ctx, sig, sig_len, data, data_len) == 1;
+
+    md_ctx_release(ctx);
+    return ret;
+}
+
+/**
+ * Verify a message signature
+ *
+ * Takes the same md_name and pss arguments as pkey_sign. Returns 1 if the
+ * signature is valid and 0 otherwise.
+ */
+int pkey_verify(EVP_PKEY* pkey, const char* md_name, int pss, const unsigned char* data, size_t data_len, const unsigned char* sig, size_t sig_len) {
+    EVP_MD_CTX* ctx = md_ctx_acquire();
+    EVP_PKEY_CTX* pctx = NULL;
+    int ret;
+
+    if (!ctx) return 0;
+
+    ret = EVP_DigestVerifyInit_ex(ctx, &pctx, md_name && *md_name ? md_name : NULL, NULL, NULL, pkey, NULL) == 1
+        && pkey_setup_padding(pctx, pkey, pss)
+        && EVP_DigestVerify(ctx, sig, sig_len, data, data_len) == 1;
+
+    /* A failed verification leaves an error on the queue; it is an answer,
+     * not an error */
+    ERR_clear_error();
+    md_ctx_release(ctx);
+    return ret;
+}
+
+/* Ed25519 and Ed448 hash internally and take no digest */
+static const char* pkey_md_name(EVP_PKEY* pkey, const char* md_name) {
+    if (!md_name || !*md_name || EVP_PKEY_is_a(pkey, "ED25519") || EVP_PKEY_is_a(pkey, "ED448")) {
+        return NULL;
+    }
+    return md_name;
+}
+
+/**
+ * Verify a batch of signatures
+ *
+ * keys, msgs and sigs hold count entries each (keys may repeat), with
+ * message and signature lengths in msg_lens and sig_lens. Bit i of bitmap
+ * (byte i / 8, bit i % 8) is set when signature i is valid; bitmap must
+ * have room for (count + 7) / 8 bytes. md_name is ignored for Ed25519 keys.
+ *
+ * Each run of signatures under the same key shares one initialized
+ * verification context, which is copied per signature instead of being set
+ * up again (EdDSA contexts cannot be copied and are cheap to set up). The
+ * key's own precomputation, such as the RSA Montgomery context, is cached
+ * on the key and computed once.
+ */
+int pkey_verify_batch(EVP_PKEY* const* keys, const char* md_name, int pss,
+                      const unsigned char* const* msgs, const size_t* msg_lens,
+                      const unsigned char* const* sigs, const size_t* sig_lens,
+                      int count, unsigned char* bitmap) {
+    EVP_MD_CTX* tmpl = md_ctx_acquire();
+    EVP_MD_CTX* work = md_ctx_acquire();
+    EVP_PKEY* current = NULL;
+    int ready = 0;
+    int i;
+
+    if (!tmpl || !work) {
+        if (tmpl) md_ctx_release(tmpl);
+        if (work) md_ctx_release(work);
+        return 0;
+    }
+
+    memset(bitmap, 0, ((size_t)count + 7) / 8);
+
+    for (i = 0; i < count; i++) {
+        int ok;
+
+        if (i == 0 || keys[i] != current) {
+            EVP_PKEY_CTX* pctx = NULL;
+
+            current = keys[i];
+            EVP_MD_CTX_reset(tmpl);
+            ready = EVP_DigestVerifyInit_ex(tmpl, &pctx, pkey_md_name(current, md_name), NULL, NULL, current, NULL) == 1
+                && pkey_setup_padding(pctx, current, pss);
+        }
+
+        if (!ready) continue;
+
+        if (pkey_md_name(current, md_name)) {
+            ok = EVP_MD_CTX_copy_ex(work, tmpl) == 1
+                && EVP_DigestVerify(work, sigs[i], sig_lens[i], msgs[i], msg_lens[i]) == 1;
+        } else {
+            /* Contexts without a digest cannot be copied; EdDSA setup is
+             * cheap, so initialize afresh */
+            EVP_MD_CTX_reset(work);
+            ok = EVP_DigestVerifyInit_ex(work, NULL, NULL, NULL, NULL, current, NULL) == 1
+                && EVP_DigestVerify(work, sigs[i], sig_lens[i], msgs[i], msg_lens[i]) == 1;
+        }
+        if (ok) {
+            bitmap[i >> 3] |= (unsigned char)(1 << (i & 7));
+        }
+    }
+
+    /* Invalid signatures leave errors on the queue; they are answers */
+    ERR_clear_error();
+    md_ctx_release(work);
+    md_ctx_release(tmpl);
+    return 1;
+}
+
+/**
+ * Derive a shared secret (X25519, ECDH)
+ *
+ * out must have room for pkey_size(pkey) bytes, and out_len receives the
+ * secret length.
+ */
+int pkey_derive(EVP_PKEY* pkey, EVP_PKEY* peer, unsigned char* out, size_t* out_len) {
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_from_pkey(NULL, pkey, NULL);
+    int ret;
+
+    if (!ctx) return 0;
+
+    *out_len = EVP_PKEY_get_size(pkey);
+    ret = EVP_PKEY_derive_init(ctx) == 1
+        && EVP_PKEY_derive_set_peer(ctx, peer) == 1
+        && EVP_PKEY_derive(ctx, out, out_len) == 1;
+
+    EVP_PKEY_CTX_free(ctx);
+    return ret;
+}
+
+/**
+ * RSA-OAEP encryption or decryption
+ *
+ * md_name selects the OAEP and MGF1 digest. out must have room for
+ * pkey_size(pkey) bytes, and out_len receives the output length.
+ */
+int pkey_crypt(EVP_PKEY* pkey, const char* md_name, int enc, const unsigned char* in, size_t in_len, unsigned char* out, size_t* out_len) {
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_from_pkey(NULL, pkey, NULL);
+    int ret;
+
+    if (!ctx) return 0;
+
+    *out_len = EVP_PKEY_get_size(pkey);
+    ret = (enc ? EVP_PKEY_encrypt_init(ctx) : EVP_PKEY_decrypt_init(ctx)) == 1
+        && EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_OAEP_PADDING) == 1
+        && EVP_PKEY_CTX_set_rsa_oaep_md_name(ctx, md_name, NULL) == 1
+        && EVP_PKEY_CTX_set_rsa_mgf1_md_name(ctx, md_name, NULL) == 1
+        && (enc ? EVP_PKEY_encrypt(ctx, out, out_len, in, in_len)
+                : EVP_PKEY_decrypt(ctx, out, out_len, in, in_len)) == 1;
+
+    EVP_PKEY_CTX_free(ctx);
+    return ret;
+}
+
+/**
+ * Largest signature, secret or ciphertext a key produces
+ */
+int pkey_size(const EVP_PKEY* pkey) {
+    return EVP_PKEY_get_size(pkey);
+}
+
+/**
+ * Key type name, e.g. "RSA", "EC" or "ED25519"
+ */
+const char* pkey_type_name(const EVP_PKEY* pkey) {
+    return EVP_PKEY_get0_type_name(pkey);
+}
+
+/**
+ * Create a public key from its raw encoding (X25519, Ed25519)
+ */
+EVP_PKEY* pkey_from_raw_public(const char* type, const unsigned char* key, size_t key_len) {
+    return EVP_PKEY_new_raw_public_key_ex(NULL, type, NULL, key, key_len);
+}
+
+/**
+ * Get the raw public key: the 32 bytes of an X25519 or Ed25519 key, or the
+ * uncompressed point of an EC key. out must have room for 133 bytes.
+ */
+int pkey_get_raw_public(const EVP_PKEY* pkey, unsigned char* out, size_t* out_len) {
+    return EVP_PKEY_get_octet_string_param(pkey, OSSL_PKEY_PARAM_ENCODED_PUBLIC_KEY, out, 133, out_len);
+}
+
+/**
+ * Read private key from PEM
+ */
+EVP_PKEY* pem_read_bio_private_key(BIO* bp, const char* password) {
+    return PEM_read_bio_PrivateKey(bp, NULL, NULL, (void*)password);
+}
+
+/**
+ * Read public key from PEM
+ */
+EVP_PKEY* pem_read_bio_pubkey(BIO* bp) {
+    return PEM_read_bio_PUBKEY(bp, NULL, NULL, NULL);
+}
+
+/**
+ * Read private key from DER
+ *
+ * Accepts PKCS#8 or traditional encodings; with a password the input must be
+ * an encrypted PKCS#8 structure.
+ */
+EVP_PKEY* der_read_bio_private_key(BIO* bp, const char* password) {
+    if (password && *password) {
+        return d2i_PKCS8PrivateKey_bio(bp, NULL, NULL, (void*)password);
+    }
+    return d2i_PrivateKey_bio(bp, NULL);
+}
+
+/**
+ * Read public key from DER SubjectPublicKeyInfo
+ */
+EVP_PKEY* der_read_bio_pubkey(BIO* bp) {
+    return d2i_PUBKEY_bio(bp, NULL);
+}
+
+/**
+ * Take another reference to a key; each reference is released with evp_pkey_free
+ */
+int evp_pkey_up_ref(EVP_PKEY* pkey) {
+    return EVP_PKEY_up_ref(pkey);
+}
+
+/**
+ * Write private key to PEM
+ */
+int pem_write_bio_private_key(BIO* bp, EVP_PKEY* key, const char* password, int iterations) {
+    PKCS8_PRIV_KEY_INFO* p8;
+    X509_SIG* encrypted;
+    int ret;
+
+    if (!password || !*password) {
+        return PEM_write_bio_PrivateKey(bp, key, NULL, NULL, 0, NULL, NULL);
+    }
+
+    /* PBES2 with AES-256-CBC and PBKDF2-HMAC-SHA256, as
+     * PEM_write_bio_PKCS8PrivateKey does, but with the caller's cost */
+    if (iterations <= 0) iterations = PKCS5_DEFAULT_ITER;
+
+    p8 = EVP_PKEY2PKCS8(key);
+    if (!p8) return 0;
+
+    encrypted = PKCS8_encrypt(-1, cipher_slot(CIPHER_AES_256_CBC), password, (int)strlen(password), NULL, 0, iterations, p8);
+    PKCS8_PRIV_KEY_INFO_free(p8);
+    if (!encrypted) return 0;
+
+    ret = PEM_write_bio_PKCS8(bp, encrypted);
+    X509_SIG_free(encrypted);
+    return ret;
+}
+
+/**
+ * Write public key to PEM
+ */
+int pem_write_bio_pubkey(BIO* bp, EVP_PKEY* key) {
+    return PEM_write_bio_PUBKEY(bp, key);
+}
+
+#endif
+
+/**
+ * HMAC key setup
+ *
+ * Looks up the digest by name and returns a context holding the keyed
+ * inner and outer pad state. The context is never finalized directly:
+ * hmac_batch rewinds it to the keyed state for each message, and hmac_dup
+ * clones it for streaming. Free it with hmac_free.
+ */
+HMAC_CTX* hmac_init(const char* name, const unsigned char* key, int key_len) {
+    const EVP_MD* md = get_md(name);
+    HMAC_CTX* ctx;
+
+    if (!md) return NULL;
+
+    ctx = HMAC_CTX_new();
+    if (!ctx) return NULL;
+
+    if (HMAC_Init_ex(ctx, key, key_len, md, NULL) != 1) {
+        HMAC_CTX_free(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+/**
+ * Clone a keyed HMAC context for one streamed message
+ *
+ * The clone starts from the keyed state, so the key is not processed again.
+ * It is released by hmac_final, or by hmac_free if the message is abandoned.
+ */
+HMAC_CTX* hmac_dup(HMAC_CTX* key_ctx) {
+    HMAC_CTX* ctx = HMAC_CTX_new();
+
+    if (!ctx) return NULL;
+
+    /* The key context may have been left finalized by hmac_batch, so
+     * rewind the clone to the keyed state */
+    if (HMAC_CTX_copy(ctx, key_ctx) != 1
+        || HMAC_Init_ex(ctx, NULL, 0, NULL, NULL) != 1) {
+        HMAC_CTX_free(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+/**
+ * HMAC update
+ */
+int hmac_update(HMAC_CTX* ctx, const unsigned char* data, int len) {
+    return HMAC_Update(ctx, data, len);
+}
+
+/**
+ * HMAC final
+ */
+int hmac_final(HMAC_CTX* ctx, unsigned char* md, unsigned int* len) {
+    int ret = HMAC_Final(ctx, md, len);
+    HMAC_CTX_free(ctx);
+    return ret;
+}
+
+/**
+ * Get the output size of an HMAC context
+ */
+int hmac_size(const HMAC_CTX* ctx) {
+    return (int)HMAC_size(ctx);
+}
+
+/**
+ * MAC a batch of messages with one keyed context
+ *
+ * ptrs and lens hold the address and length of each of the count messages.
+ * The MACs are written back to back into out, which must have room for
+ * count * hmac_size(key_ctx) bytes. The context is rewound to its keyed
+ * state before each message instead of being keyed again.
+ */
+int hmac_batch(HMAC_CTX* key_ctx, const unsigned char* const* ptrs, const size_t* lens, int count, unsigned char* out) {
+    size_t md_size = HMAC_size(key_ctx);
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (HMAC_Init_ex(key_ctx, NULL, 0, NULL, NULL) != 1
+            || HMAC_Update(key_ctx, ptrs[i], lens[i]) != 1
+            || HMAC_Final(key_ctx, out + (size_t)i * md_size, NULL) != 1) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Free an HMAC context
+ */
+void hmac_free(HMAC_CTX* ctx) {
+    HMAC_CTX_free(ctx);
+}
+
+/**
+ * PBKDF2
+ *
+ * Derives out_len bytes from the password and salt with iterations rounds
+ * of HMAC using the named digest. Returns 1 on success.
+ */
+int kdf_pbkdf2(const char* md_name, const char* password, int password_len,
+               const unsigned char* salt, int salt_len, int iterations,
+               unsigned char* out, int out_len) {
+    const EVP_MD* md = get_md(md_name);
+
+    if (!md || iterations < 1) return 0;
+
+    return PKCS5_PBKDF2_HMAC(password, password_len, salt, salt_len, iterations, md, out_len, out);
+}
+
+/**
+ * HKDF (RFC 5869)
+ *
+ * mode is EVP_KDF_HKDF_MODE_EXTRACT_AND_EXPAND (0), EXTRACT_ONLY (1) or
+ * EXPAND_ONLY (2). In extract-only mode out_len must be the digest size.
+ * The HKDF implementation is fetched once and kept with the algorithm cache.
  */
-int openssl_init() {
-    return OPENSSL_init_crypto(OPENSSL_INIT_ADD_ALL_CIPHERS | 
-                              OPENSSL_INIT_ADD_ALL_DIGESTS | 
-                              OPENSSL_INIT_LOAD_CONFIG, 
-                              NULL);
+int kdf_hkdf(const char* md_name, int mode,
+             const unsigned char* key, int key_len,
+             const unsigned char* salt, int salt_len,
+             const unsigned char* info, int info_len,
+             unsigned char* out, int out_len) {
+    EVP_KDF_CTX* ctx;
+    OSSL_PARAM params[6];
+    OSSL_PARAM* p = params;
+    int ret;
+
+    if (!hkdf_alg) {
+        hkdf_alg = EVP_KDF_fetch(NULL, "HKDF", NULL);
+        if (!hkdf_alg) return 0;
+    }
+
+    ctx = EVP_KDF_CTX_new(hkdf_alg);
+    if (!ctx) return 0;
+
+    *p++ = OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST, (char*)md_name, 0);
+    *p++ = OSSL_PARAM_construct_int(OSSL_KDF_PARAM_MODE, &mode);
+    *p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_KEY, (void*)key, key_len);
+    if (salt_len > 0) {
+        *p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SALT, (void*)salt, salt_len);
+    }
+    if (info_len > 0) {
+        *p++ = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_INFO, (void*)info, info_len);
+    }
+    *p = OSSL_PARAM_construct_end();
+
+    ret = EVP_KDF_derive(ctx, out, out_len, params);
+    EVP_KDF_CTX_free(ctx);
+    return ret;
 }
 
 /**
- * Clean up OpenSSL
+ * scrypt (RFC 7914)
+ *
+ * n must be a power of two greater than 1. max_mem caps the memory the
+ * derivation may allocate, about 128 * n * r bytes; 0 keeps OpenSSL's 32 MiB
+ * default. Parameters that would exceed it fail instead of growing the heap.
  */
-void openssl_cleanup() {
-    OPENSSL_cleanup();
+int kdf_scrypt(const char* password, int password_len,
+               const unsigned char* salt, int salt_len,
+               unsigned int n, unsigned int r, unsigned int p, unsigned int max_mem,
+               unsigned char* out, int out_len) {
+    return EVP_PBE_scrypt(password, password_len, salt, salt_len, n, r, p, max_mem, out, out_len);
 }
 
 /**
- * Generate random bytes
+ * Base64 encode
+ *
+ * Writes the padded encoding of in to out without line breaks and returns
+ * its length. out must have room for 4 * ((in_len + 2) / 3) + 1 bytes,
+ * including the terminating NUL.
  */
-int random_bytes(unsigned char* buf, int len) {
-    return RAND_bytes(buf, len);
+int base64_encode(const unsigned char* in, int in_len, char* out) {
+    return EVP_EncodeBlock((unsigned char*)out, in, in_len);
+}
+
+/* Whitespace skipped around the input, matching EVP_DecodeBlock */
+static int base64_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
 }
 
 /**
- * Calculate SHA1 digest
+ * Base64 decode
+ *
+ * Decodes in_len characters of padded base64 into out and returns the
+ * decoded length, or -1 if the input is malformed. Surrounding whitespace is
+ * ignored. out must have room for 3 * (in_len / 4) bytes.
  */
-int sha1_digest(const unsigned char* data, size_t data_len, unsigned char* md) {
-    const EVP_MD* sha1 = EVP_sha1();
-    unsigned int md_len;
-    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-    
-    if (!mdctx) return 0;
-    
-    if (EVP_DigestInit_ex(mdctx, sha1, NULL) != 1 ||
-        EVP_DigestUpdate(mdctx, data, data_len) != 1 ||
-        EVP_DigestFinal_ex(mdctx, md, &md_len) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        return 0;
+int base64_decode(const char* in, int in_len, unsigned char* out) {
+    int pad = 0;
+    int len;
+
+    while (in_len > 0 && base64_is_space(in[0])) {
+        in++;
+        in_len--;
     }
-    
-    EVP_MD_CTX_free(mdctx);
-    return 1;
+    while (in_len > 0 && base64_is_space(in[in_len - 1])) {
+        in_len--;
+    }
+
+    if (in_len % 4 != 0) return -1;
+
+    /* EVP_DecodeBlock decodes padding as zero bits; strip those bytes and
+     * reject padding anywhere but the end */
+    if (in_len > 0 && in[in_len - 1] == '=') pad++;
+    if (in_len > 1 && in[in_len - 2] == '=') pad++;
+    if (memchr(in, '=', in_len - pad)) return -1;
+
+    len = EVP_DecodeBlock(out, (const unsigned char*)in, in_len);
+    if (len < 0) return -1;
+
+    return len - pad;
 }
 
+#if OPENSSL_WASM_TIER >= WASM_TIER_TLS
+
 /**
- * Calculate SHA256 digest
+ * Certificate trust store
+ *
+ * A trust bundle is parsed once into an X509_STORE that stays resident.
+ * Chain verifications and TLS contexts using the store share the parsed
+ * roots instead of loading them again.
  */
-int sha256_digest(const unsigned char* data, size_t data_len, unsigned char* md) {
-    const EVP_MD* sha256 = EVP_sha256();
-    unsigned int md_len;
-    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-    
-    if (!mdctx) return 0;
-    
-    if (EVP_DigestInit_ex(mdctx, sha256, NULL) != 1 ||
-        EVP_DigestUpdate(mdctx, data, data_len) != 1 ||
-        EVP_DigestFinal_ex(mdctx, md, &md_len) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        return 0;
-    }
-    
-    EVP_MD_CTX_free(mdctx);
-    return 1;
+X509_STORE* trust_store_new(void) {
+    return X509_STORE_new();
+}
+
+/* Parse one certificate: DER if it starts with a SEQUENCE tag, else PEM */
+static X509* x509_parse(const unsigned char* data, size_t len) {
+    BIO* bio;
+    X509* cert;
+
+    if (len > 0 && data[0] == 0x30) return d2i_X509(NULL, &data, (long)len);
+
+    bio = BIO_new_mem_buf(data, (int)len);
+    cert = bio ? PEM_read_bio_X509(bio, NULL, NULL, NULL) : NULL;
+    BIO_free(bio);
+    return cert;
 }
 
 /**
- * Calculate SHA384 digest
+ * Add certificates to a trust store
+ *
+ * data is one DER certificate or a PEM bundle of any number of them.
+ * Returns the number of certificates added, or -1 on error.
  */
-int sha384_digest(const unsigned char* data, size_t data_len, unsigned char* md) {
-    const EVP_MD* sha384 = EVP_sha384();
-    unsigned int md_len;
-    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-    
-    if (!mdctx) return 0;
-    
-    if (EVP_DigestInit_ex(mdctx, sha384, NULL) != 1 ||
-        EVP_DigestUpdate(mdctx, data, data_len) != 1 ||
-        EVP_DigestFinal_ex(mdctx, md, &md_len) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        return 0;
+int trust_store_add(X509_STORE* store, const unsigned char* data, int len) {
+    BIO* bio;
+    X509* cert;
+    int count = 0;
+
+    if (len > 0 && data[0] == 0x30) {
+        int ok;
+        cert = x509_parse(data, len);
+        if (!cert) return -1;
+        ok = X509_STORE_add_cert(store, cert);
+        X509_free(cert);
+        return ok ? 1 : -1;
     }
-    
-    EVP_MD_CTX_free(mdctx);
-    return 1;
+
+    bio = BIO_new_mem_buf(data, len);
+    if (!bio) return -1;
+
+    while ((cert = PEM_read_bio_X509(bio, NULL, NULL, NULL)) != NULL) {
+        int ok = X509_STORE_add_cert(store, cert);
+        X509_free(cert);
+        if (!ok) {
+            BIO_free(bio);
+            return -1;
+        }
+        count++;
+    }
+    BIO_free(bio);
+
+    /* Reading past the last certificate leaves a "no start line" error */
+    if (count > 0) ERR_clear_error();
+    return count;
 }
 
 /**
- * Calculate SHA512 digest
+ * Number of certificates in a trust store
  */
-int sha512_digest(const unsigned char* data, size_t data_len, unsigned char* md) {
-    const EVP_MD* sha512 = EVP_sha512();
-    unsigned int md_len;
-    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-    
-    if (!mdctx) return 0;
-    
-    if (EVP_DigestInit_ex(mdctx, sha512, NULL) != 1 ||
-        EVP_DigestUpdate(mdctx, data, data_len) != 1 ||
-        EVP_DigestFinal_ex(mdctx, md, &md_len) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        return 0;
-    }
-    
-    EVP_MD_CTX_free(mdctx);
-    return 1;
+int trust_store_count(X509_STORE* store) {
+    return sk_X509_OBJECT_num(X509_STORE_get0_objects(store));
 }
 
 /**
- * Calculate MD5 digest
+ * Free a trust store. Contexts using it keep their own reference.
  */
-int md5_digest(const unsigned char* data, size_t data_len, unsigned char* md) {
-    const EVP_MD* md5 = EVP_md5();
-    unsigned int md_len;
-    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-    
-    if (!mdctx) return 0;
-    
-    if (EVP_DigestInit_ex(mdctx, md5, NULL) != 1 ||
-        EVP_DigestUpdate(mdctx, data, data_len) != 1 ||
-        EVP_DigestFinal_ex(mdctx, md, &md_len) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        return 0;
+void trust_store_free(X509_STORE* store) {
+    X509_STORE_free(store);
+}
+
+/* Seconds until the first certificate of chain expires, clamped to INT_MAX */
+static int x509_chain_valid_for(STACK_OF(X509)* chain) {
+    long long least = INT_MAX;
+    int i;
+
+    for (i = 0; i < sk_X509_num(chain); i++) {
+        int days, secs;
+        long long remaining;
+        if (!ASN1_TIME_diff(&days, &secs, NULL, X509_get0_notAfter(sk_X509_value(chain, i)))) return 0;
+        remaining = (long long)days * 86400 + secs;
+        if (remaining < least) least = remaining;
     }
-    
-    EVP_MD_CTX_free(mdctx);
-    return 1;
+    return least < 0 ? 0 : (int)least;
 }
 
 /**
- * AES encryption context
+ * Verify a certificate chain against a trust store
+ *
+ * certs[0] is the leaf and the rest are untrusted intermediates, each DER or
+ * PEM. If host is non-empty, the leaf must be valid for it as a TLS server.
+ * On success, valid_for receives the seconds until the first certificate of
+ * the verified chain expires. Returns X509_V_OK, an X509_V_ERR_* code, or -1
+ * if a certificate does not parse.
  */
-EVP_CIPHER_CTX* aes_encrypt_init(const unsigned char* key, int key_len, const unsigned char* iv) {
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    const EVP_CIPHER* cipher = NULL;
-    
-    if (!ctx) return NULL;
-    
-    switch (key_len) {
-        case 16: cipher = EVP_aes_128_cbc(); break;
-        case 24: cipher = EVP_aes_192_cbc(); break;
-        case 32: cipher = EVP_aes_256_cbc(); break;
-        default: 
-            EVP_CIPHER_CTX_free(ctx);
-            return NULL;
+int x509_verify_chain(X509_STORE* store, const unsigned char* const* certs, const size_t* lens, int count,
+                      const char* host, int* valid_for) {
+    STACK_OF(X509)* untrusted = sk_X509_new_null();
+    X509_STORE_CTX* ctx = NULL;
+    X509* leaf = NULL;
+    int result = -1;
+    int i;
+
+    *valid_for = 0;
+    if (count < 1 || !untrusted) goto done;
+
+    leaf = x509_parse(certs[0], lens[0]);
+    if (!leaf) goto done;
+    for (i = 1; i < count; i++) {
+        X509* cert = x509_parse(certs[i], lens[i]);
+        if (!cert || !sk_X509_push(untrusted, cert)) {
+            X509_free(cert);
+            goto done;
+        }
     }
-    
-    if (EVP_EncryptInit_ex(ctx, cipher, NULL, key, iv) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return NULL;
+
+    ctx = X509_STORE_CTX_new();
+    if (!ctx || !X509_STORE_CTX_init(ctx, store, leaf, untrusted)) goto done;
+
+    if (host && *host) {
+        X509_VERIFY_PARAM* param = X509_STORE_CTX_get0_param(ctx);
+        if (!X509_VERIFY_PARAM_set1_ip_asc(param, host) && !X509_VERIFY_PARAM_set1_host(param, host, 0)) goto done;
+        X509_STORE_CTX_set_purpose(ctx, X509_PURPOSE_SSL_SERVER);
     }
-    
-    return ctx;
+
+    if (X509_verify_cert(ctx) == 1) {
+        result = X509_V_OK;
+        *valid_for = x509_chain_valid_for(X509_STORE_CTX_get0_chain(ctx));
+    } else {
+        result = X509_STORE_CTX_get_error(ctx);
+        if (result == X509_V_OK) result = X509_V_ERR_UNSPECIFIED;
+    }
+
+done:
+    X509_STORE_CTX_free(ctx);
+    X509_free(leaf);
+    sk_X509_pop_free(untrusted, X509_free);
+    return result;
 }
 
 /**
- * AES encryption update
+ * Describe a certificate verification result
  */
-int aes_encrypt_update(EVP_CIPHER_CTX* ctx, const unsigned char* in, int in_len, unsigned char* out, int* out_len) {
-    return EVP_EncryptUpdate(ctx, out, out_len, in, in_len);
+const char* x509_verify_error_string(int result) {
+    return X509_verify_cert_error_string(result);
 }
 
 /**
- * AES encryption final
+ * TLS client connection over a pair of memory BIOs
+ *
+ * The engine never touches the network. Records received from the transport
+ * are written into rbio with tls_conn_feed; records produced by the engine
+ * accumulate in wbio until the caller takes them all at once with
+ * tls_conn_output, so several writes leave as one transport message.
  */
-int aes_encrypt_final(EVP_CIPHER_CTX* ctx, unsigned char* out, int* out_len) {
-    int ret = EVP_EncryptFinal_ex(ctx, out, out_len);
-    EVP_CIPHER_CTX_free(ctx);
-    return ret;
+typedef struct {
+    SSL* ssl;
+    BIO* rbio;
+    BIO* wbio;
+    SSL_SESSION* session;   /* latest resumable session from the server */
+    int session_ready;      /* session changed since it was last taken */
+} tls_conn;
+
+/* Client sessions are not kept in the SSL_CTX's internal cache; the newest
+ * one is held on the connection for the caller to serialize */
+static int tls_new_session_cb(SSL* ssl, SSL_SESSION* session) {
+    tls_conn* conn = SSL_get_app_data(ssl);
+    if (!conn || !SSL_SESSION_is_resumable(session)) return 0;
+
+    SSL_SESSION_free(conn->session);
+    conn->session = session;
+    conn->session_ready = 1;
+    return 1;
 }
 
 /**
- * AES decryption context
+ * Create a TLS client context
+ *
+ * min_version is a protocol version such as TLS1_2_VERSION. ciphers is the
+ * TLS 1.2 cipher list, or NULL/empty for the default.
  */
-EVP_CIPHER_CTX* aes_decrypt_init(const unsigned char* key, int key_len, const unsigned char* iv) {
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    const EVP_CIPHER* cipher = NULL;
-    
+SSL_CTX* tls_ctx_new(int min_version, int verify, const char* ciphers) {
+    SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
     if (!ctx) return NULL;
-    
-    switch (key_len) {
-        case 16: cipher = EVP_aes_128_cbc(); break;
-        case 24: cipher = EVP_aes_192_cbc(); break;
-        case 32: cipher = EVP_aes_256_cbc(); break;
-        default: 
-            EVP_CIPHER_CTX_free(ctx);
-            return NULL;
-    }
-    
-    if (EVP_DecryptInit_ex(ctx, cipher, NULL, key, iv) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
+
+    if (!SSL_CTX_set_min_proto_version(ctx, min_version) ||
+        (ciphers && *ciphers && !SSL_CTX_set_cipher_list(ctx, ciphers))) {
+        SSL_CTX_free(ctx);
         return NULL;
     }
-    
+
+    SSL_CTX_set_verify(ctx, verify ? SSL_VERIFY_PEER : SSL_VERIFY_NONE, NULL);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx, tls_new_session_cb);
     return ctx;
 }
 
 /**
- * AES decryption update
+ * Add the PEM certificates in pem to the context's own trust store
+ *
+ * Returns the number of certificates added, or -1 on error.
  */
-int aes_decrypt_update(EVP_CIPHER_CTX* ctx, const unsigned char* in, int in_len, unsigned char* out, int* out_len) {
-    return EVP_DecryptUpdate(ctx, out, out_len, in, in_len);
+int tls_ctx_add_ca(SSL_CTX* ctx, const char* pem, int len) {
+    return trust_store_add(SSL_CTX_get_cert_store(ctx), (const unsigned char*)pem, len);
+}
+
+/* A new store holding the certificates and CRLs of store */
+static X509_STORE* trust_store_copy(X509_STORE* store) {
+    STACK_OF(X509_OBJECT)* objects = X509_STORE_get0_objects(store);
+    X509_STORE* copy = X509_STORE_new();
+    int i;
+
+    if (!copy) return NULL;
+
+    for (i = 0; i < sk_X509_OBJECT_num(objects); i++) {
+        X509_OBJECT* object = sk_X509_OBJECT_value(objects, i);
+        X509* cert = X509_OBJECT_get0_X509(object);
+        X509_CRL* crl = X509_OBJECT_get0_X509_CRL(object);
+
+        if ((cert && !X509_STORE_add_cert(copy, cert)) || (crl && !X509_STORE_add_crl(copy, crl))) {
+            X509_STORE_free(copy);
+            return NULL;
+        }
+    }
+    return copy;
 }
 
 /**
- * AES decryption final
+ * Verify servers against a shared trust store instead of the context's own
+ *
+ * With extend set, the context gets a private copy of the store instead,
+ * so certificates added later with tls_ctx_add_ca do not reach the shared
+ * store or the other contexts using it. Returns 1 on success, 0 on error.
  */
-int aes_decrypt_final(EVP_CIPHER_CTX* ctx, unsigned char* out, int* out_len) {
-    int ret = EVP_DecryptFinal_ex(ctx, out, out_len);
-    EVP_CIPHER_CTX_free(ctx);
-    return ret;
+int tls_ctx_set_trust_store(SSL_CTX* ctx, X509_STORE* store, int extend) {
+    X509_STORE* copy;
+
+    if (!extend) {
+        SSL_CTX_set1_cert_store(ctx, store);
+        return 1;
+    }
+
+    copy = trust_store_copy(store);
+    if (!copy) return 0;
+    SSL_CTX_set_cert_store(ctx, copy);
+    return 1;
 }
 
 /**
- * RSA key generation
+ * Set the ALPN protocols offered, in wire format (length-prefixed names)
  */
-RSA* rsa_generate_key(int bits) {
-    BIGNUM* bn = BN_new();
-    RSA* rsa = NULL;
-    
-    if (!bn) return NULL;
-    
-    if (BN_set_word(bn, RSA_F4) != 1) {
-        BN_free(bn);
+int tls_ctx_set_alpn(SSL_CTX* ctx, const unsigned char* protos, int len) {
+    return SSL_CTX_set_alpn_protos(ctx, protos, len) == 0;
+}
+
+/**
+ * Free a TLS client context. Connections keep their own reference.
+ */
+void tls_ctx_free(SSL_CTX* ctx) {
+    SSL_CTX_free(ctx);
+}
+
+/**
+ * Create a client connection to host
+ *
+ * host is sent as SNI and checked against the certificate when it is a DNS
+ * name; an IP address literal is only checked against the certificate.
+ */
+tls_conn* tls_conn_new(SSL_CTX* ctx, const char* host) {
+    tls_conn* conn = calloc(1, sizeof(tls_conn));
+    if (!conn) return NULL;
+
+    conn->ssl = SSL_new(ctx);
+    conn->rbio = BIO_new(BIO_s_mem());
+    conn->wbio = BIO_new(BIO_s_mem());
+    if (!conn->ssl || !conn->rbio || !conn->wbio) {
+        BIO_free(conn->rbio);
+        BIO_free(conn->wbio);
+        SSL_free(conn->ssl);
+        free(conn);
         return NULL;
     }
-    
-    rsa = RSA_new();
-    if (!rsa) {
-        BN_free(bn);
-        return NULL;
+
+    /* An empty rbio means "wait for more records", not end of stream */
+    BIO_set_mem_eof_return(conn->rbio, -1);
+    SSL_set_bio(conn->ssl, conn->rbio, conn->wbio);
+    SSL_set_app_data(conn->ssl, conn);
+    SSL_set_connect_state(conn->ssl);
+
+    if (host && *host) {
+        if (!X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(conn->ssl), host) &&
+            (!SSL_set_tlsext_host_name(conn->ssl, host) || !SSL_set1_host(conn->ssl, host))) {
+            SSL_free(conn->ssl);
+            free(conn);
+            return NULL;
+        }
     }
-    
-    if (RSA_generate_key_ex(rsa, bits, bn, NULL) != 1) {
-        RSA_free(rsa);
-        BN_free(bn);
-        return NULL;
+
+    return conn;
+}
+
+/**
+ * Offer a serialized session for resumption before the handshake starts
+ *
+ * Returns 0 without offering it if the session does not parse, has expired
+ * or is not resumable, so the caller can drop it from its cache.
+ */
+int tls_conn_set_session(tls_conn* conn, const unsigned char* der, int len) {
+    SSL_SESSION* session = d2i_SSL_SESSION(NULL, &der, len);
+    int ok;
+
+    if (!session) return 0;
+    if (!SSL_SESSION_is_resumable(session) ||
+        SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session) < (long)time(NULL)) {
+        SSL_SESSION_free(session);
+        return 0;
     }
-    
-    BN_free(bn);
-    return rsa;
+    ok = SSL_set_session(conn->ssl, session);
+    SSL_SESSION_free(session);
+    return ok;
 }
 
 /**
- * RSA public key encryption
+ * Protocol version of a serialized session, e.g. TLS1_3_VERSION, or 0 if it
+ * does not parse
  */
-int rsa_public_encrypt(int flen, const unsigned char* from, unsigned char* to, RSA* rsa, int padding) {
-    return RSA_public_encrypt(flen, from, to, rsa, padding);
+int tls_session_version(const unsigned char* der, int len) {
+    SSL_SESSION* session = d2i_SSL_SESSION(NULL, &der, len);
+    int version = session ? SSL_SESSION_get_protocol_version(session) : 0;
+
+    SSL_SESSION_free(session);
+    return version;
 }
 
 /**
- * RSA private key decryption
+ * Maximum 0-RTT data the offered session allows, 0 if none
  */
-int rsa_private_decrypt(int flen, const unsigned char* from, unsigned char* to, RSA* rsa, int padding) {
-    return RSA_private_decrypt(flen, from, to, rsa, padding);
+int tls_conn_max_early_data(const tls_conn* conn) {
+    SSL_SESSION* session = SSL_get_session(conn->ssl);
+    uint32_t max = session ? SSL_SESSION_get_max_early_data(session) : 0;
+    return max > INT_MAX ? INT_MAX : (int)max;
 }
 
 /**
- * RSA private key encryption (for signing)
+ * Write 0-RTT data; starts the handshake
+ *
+ * Returns the number of bytes written, or -1 on error.
  */
-int rsa_private_encrypt(int flen, const unsigned char* from, unsigned char* to, RSA* rsa, int padding) {
-    return RSA_private_encrypt(flen, from, to, rsa, padding);
+int tls_conn_write_early(tls_conn* conn, const unsigned char* data, int len) {
+    size_t written;
+    return SSL_write_early_data(conn->ssl, data, len, &written) ? (int)written : -1;
 }
 
 /**
- * RSA public key decryption (for verification)
+ * Whether the server accepted the 0-RTT data: SSL_EARLY_DATA_NOT_SENT,
+ * SSL_EARLY_DATA_REJECTED or SSL_EARLY_DATA_ACCEPTED
  */
-int rsa_public_decrypt(int flen, const unsigned char* from, unsigned char* to, RSA* rsa, int padding) {
-    return RSA_public_decrypt(flen, from, to, rsa, padding);
+int tls_conn_early_data_status(const tls_conn* conn) {
+    return SSL_get_early_data_status(conn->ssl);
 }
 
 /**
- * RSA sign
+ * Advance the handshake with the records fed so far
+ *
+ * Returns 1 when complete, 0 if more records are needed, -1 on failure.
  */
-int rsa_sign(int type, const unsigned char* m, unsigned int m_len, unsigned char* sigret, unsigned int* siglen, RSA* rsa) {
-    return RSA_sign(type, m, m_len, sigret, siglen, rsa);
+int tls_conn_handshake(tls_conn* conn) {
+    int ret = SSL_do_handshake(conn->ssl);
+    int err;
+
+    if (ret == 1) return 1;
+    err = SSL_get_error(conn->ssl, ret);
+    return err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ? 0 : -1;
 }
 
 /**
- * RSA verify
+ * Pass records received from the transport to the engine
  */
-int rsa_verify(int type, const unsigned char* m, unsigned int m_len, const unsigned char* sigbuf, unsigned int siglen, RSA* rsa) {
-    return RSA_verify(type, m, m_len, sigbuf, siglen, rsa);
+int tls_conn_feed(tls_conn* conn, const unsigned char* data, int len) {
+    return BIO_write(conn->rbio, data, len) == len;
 }
 
 /**
- * Read private key from PEM
+ * Encrypt application data into records
  */
-EVP_PKEY* pem_read_bio_private_key(BIO* bp, const char* password) {
-    return PEM_read_bio_PrivateKey(bp, NULL, NULL, (void*)password);
+int tls_conn_write(tls_conn* conn, const unsigned char* data, int len) {
+    size_t written;
+    return SSL_write_ex(conn->ssl, data, len, &written) && written == (size_t)len;
 }
 
 /**
- * Read public key from PEM
+ * Decrypt application data from the records fed so far
+ *
+ * Returns the number of bytes read, 0 if more records are needed, -1 on
+ * error and -2 once the peer has closed the connection.
  */
-EVP_PKEY* pem_read_bio_pubkey(BIO* bp) {
-    return PEM_read_bio_PUBKEY(bp, NULL, NULL, NULL);
+int tls_conn_read(tls_conn* conn, unsigned char* out, int len) {
+    size_t read;
+    int err;
+
+    if (SSL_read_ex(conn->ssl, out, len, &read)) return (int)read;
+
+    err = SSL_get_error(conn->ssl, 0);
+    if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) return 0;
+    return err == SSL_ERROR_ZERO_RETURN ? -2 : -1;
 }
 
 /**
- * Write private key to PEM
+ * Records waiting to be sent
+ *
+ * Points ptr at the pending records in place and returns their length. Call
+ * tls_conn_output_done once they have been handed to the transport.
  */
-int pem_write_bio_private_key(BIO* bp, EVP_PKEY* key, const char* password) {
-    if (password && *password) {
-        return PEM_write_bio_PKCS8PrivateKey(bp, key, EVP_aes_256_cbc(), (char*)password, strlen(password), NULL, NULL);
-    } else {
-        return PEM_write_bio_PrivateKey(bp, key, NULL, NULL, 0, NULL, NULL);
-    }
+int tls_conn_output(tls_conn* conn, char** ptr) {
+    return (int)BIO_get_mem_data(conn->wbio, ptr);
 }
 
 /**
- * Write public key to PEM
+ * Discard the records returned by tls_conn_output, keeping the buffer
  */
-int pem_write_bio_pubkey(BIO* bp, EVP_PKEY* key) {
-    return PEM_write_bio_PUBKEY(bp, key);
+void tls_conn_output_done(tls_conn* conn) {
+    BIO_reset(conn->wbio);
 }
 
 /**
- * HMAC initialization
+ * Whether the server issued a new session since it was last taken
  */
-HMAC_CTX* hmac_init(const unsigned char* key, int key_len, const EVP_MD* md) {
-    HMAC_CTX* ctx = HMAC_CTX_new();
-    
-    if (!ctx) return NULL;
-    
-    if (HMAC_Init_ex(ctx, key, key_len, md, NULL) != 1) {
-        HMAC_CTX_free(ctx);
-        return NULL;
-    }
-    
-    return ctx;
+int tls_conn_session_ready(const tls_conn* conn) {
+    return conn->session_ready;
 }
 
 /**
- * HMAC update
+ * Serialize the latest session with i2d_SSL_SESSION
+ *
+ * With out NULL, returns the serialized length. Otherwise writes the session
+ * into out, marks it taken and returns the length. Returns 0 if there is no
+ * session.
  */
-int hmac_update(HMAC_CTX* ctx, const unsigned char* data, int len) {
-    return HMAC_Update(ctx, data, len);
+int tls_conn_take_session(tls_conn* conn, unsigned char* out) {
+    int len;
+
+    if (!conn->session) return 0;
+    if (!out) return i2d_SSL_SESSION(conn->session, NULL);
+
+    len = i2d_SSL_SESSION(conn->session, &out);
+    conn->session_ready = 0;
+    return len;
 }
 
 /**
- * HMAC final
+ * Negotiated protocol version, e.g. "TLSv1.3"
  */
-int hmac_final(HMAC_CTX* ctx, unsigned char* md, unsigned int* len) {
-    int ret = HMAC_Final(ctx, md, len);
-    HMAC_CTX_free(ctx);
-    return ret;
+const char* tls_conn_version(const tls_conn* conn) {
+    return SSL_get_version(conn->ssl);
 }
 
 /**
- * Base64 encode
+ * Negotiated cipher suite name
  */
-char* base64_encode(const unsigned char* in, int in_len, int* out_len) {
-    BIO* b64 = BIO_new(BIO_f_base64());
-    BIO* bmem = BIO_new(BIO_s_mem());
-    BUF_MEM* bptr;
-    char* buf;
-    
-    BIO_push(b64, bmem);
-    BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
-    BIO_write(b64, in, in_len);
-    BIO_flush(b64);
-    BIO_get_mem_ptr(b64, &bptr);
-    
-    buf = malloc(bptr->length + 1);
-    if (!buf) {
-        BIO_free_all(b64);
-        return NULL;
-    }
-    
-    memcpy(buf, bptr->data, bptr->length);
-    buf[bptr->length] = 0;
-    *out_len = bptr->length;
-    
-    BIO_free_all(b64);
-    return buf;
+const char* tls_conn_cipher(const tls_conn* conn) {
+    return SSL_get_cipher_name(conn->ssl);
 }
 
 /**
- * Base64 decode
+ * Whether the handshake resumed the offered session
  */
-unsigned char* base64_decode(const char* in, int in_len, int* out_len) {
-    BIO* b64 = BIO_new(BIO_f_base64());
-    BIO* bmem = BIO_new_mem_buf(in, in_len);
-    unsigned char* buf = malloc(in_len);
-    
-    if (!buf) {
-        BIO_free_all(b64);
-        BIO_free(bmem);
-        return NULL;
-    }
-    
-    bmem = BIO_push(b64, bmem);
-    BIO_set_flags(bmem, BIO_FLAGS_BASE64_NO_NL);
-    *out_len = BIO_read(bmem, buf, in_len);
-    
-    BIO_free_all(bmem);
-    return buf;
+int tls_conn_resumed(const tls_conn* conn) {
+    return SSL_session_reused(conn->ssl);
+}
+
+/**
+ * Negotiated ALPN protocol; points ptr at it and returns its length
+ */
+int tls_conn_alpn(const tls_conn* conn, const unsigned char** ptr) {
+    unsigned int len = 0;
+    SSL_get0_alpn_selected(conn->ssl, ptr, &len);
+    return (int)len;
+}
+
+/**
+ * Certificate verification result (X509_V_OK on success)
+ */
+int tls_conn_verify_result(const tls_conn* conn) {
+    return (int)SSL_get_verify_result(conn->ssl);
+}
+
+/**
+ * Write the server's certificate as PEM into a memory BIO
+ */
+int tls_conn_peer_certificate(const tls_conn* conn, BIO* bio) {
+    X509* cert = SSL_get0_peer_certificate(conn->ssl);
+    return cert ? PEM_write_bio_X509(bio, cert) : 0;
+}
+
+/**
+ * Queue a close_notify alert
+ */
+int tls_conn_shutdown(tls_conn* conn) {
+    return SSL_shutdown(conn->ssl) >= 0;
+}
+
+/**
+ * Free a connection and its BIOs
+ */
+void tls_conn_free(tls_conn* conn) {
+    if (!conn) return;
+    SSL_free(conn->ssl);
+    SSL_SESSION_free(conn->session);
+    free(conn);
 }
 
+#endif
+
+#if OPENSSL_WASM_TIER >= WASM_TIER_PKEY
+
 /**
  * Create a memory BIO
  */
@@ -425,6 +2099,13 @@ BIO* bio_new_mem_buf(const void* buf, int len) {
     return BIO_new_mem_buf(buf, len);
 }
 
+/**
+ * Create an empty memory BIO to write into
+ */
+BIO* bio_new_mem(void) {
+    return BIO_new(BIO_s_mem());
+}
+
 /**
  * Free a BIO
  */
@@ -460,20 +2141,26 @@ void evp_pkey_free(EVP_PKEY* pkey) {
     EVP_PKEY_free(pkey);
 }
 
+#endif
+
 /**
- * Free an EVP_MD_CTX
+ * Free an EVP_MD_CTX (returns it to the context pool)
  */
 void evp_md_ctx_free(EVP_MD_CTX* ctx) {
-    EVP_MD_CTX_free(ctx);
+    md_ctx_release(ctx);
 }
 
+#if OPENSSL_WASM_TIER >= WASM_TIER_CIPHER
+
 /**
- * Free an EVP_CIPHER_CTX
+ * Free an EVP_CIPHER_CTX (returns it to the context pool)
  */
 void evp_cipher_ctx_free(EVP_CIPHER_CTX* ctx) {
-    EVP_CIPHER_CTX_free(ctx);
+    cipher_ctx_release(ctx);
 }
 
+#endif
+
 /**
  * Get OpenSSL error string
  */
@@ -0,0 +1,234 @@
+/**
+ * Routing to WebCrypto for the operations browsers accelerate natively
+ */
+
+import type { OpenSSL } from './index';
+import type { Pbkdf2Options, HkdfOptions } from './kdf';
+
+/**
+ * Operations that can run on crypto.subtle with results identical to the
+ * OpenSSL path
+ */
+export type OffloadOperation = 'sha1' | 'sha256' | 'sha384' | 'sha512' | 'aes-128-gcm' | 'aes-256-gcm' | 'hkdf' | 'pbkdf2';
+
+/**
+ * Smallest size per operation from which WebCrypto is faster: bytes of
+ * input for digests and AES-GCM, bytes of output for HKDF and iterations
+ * for PBKDF2. null, or a missing entry, keeps the operation on OpenSSL.
+ * bench/suite.mjs measures these for each build variant.
+ */
+export type Crossovers = Partial<Record<OffloadOperation, number | null>>;
+
+/**
+ * The parts of a benchmark report (bench/node.mjs or bench/index.html
+ * output) the dispatcher reads
+ */
+export interface BenchmarkReport {
+  runs: Array<{ variant: string; webcrypto?: { crossovers: Crossovers } }>;
+}
+
+export interface WebCryptoOptions {
+  /**
+   * Crossover points, e.g. from crossoversFromBenchmark()
+   */
+  crossovers?: Crossovers;
+  /**
+   * A benchmark report to take the crossover points from, for the variant
+   * the instance loaded. Ignored when crossovers is given.
+   */
+  benchmark?: BenchmarkReport;
+}
+
+// WebCrypto hash names for the digests it supports
+const HASH_NAMES: Record<string, string> = {
+  sha1: 'SHA-1',
+  sha256: 'SHA-256',
+  sha384: 'SHA-384',
+  sha512: 'SHA-512'
+};
+
+// Digest lengths by WebCrypto hash name, for the HKDF output limit
+const DIGEST_LENGTHS: Record<string, number> = {
+  'SHA-1': 20,
+  'SHA-256': 32,
+  'SHA-384': 48,
+  'SHA-512': 64
+};
+
+// AES-GCM key length per cipher name; WebCrypto has no 192-bit AES in every browser
+const GCM_KEY_LENGTHS: Record<string, number> = {
+  'aes-128-gcm': 16,
+  'aes-256-gcm': 32
+};
+
+const GCM_TAG_LENGTH = 16;
+
+function hashName(name: string | undefined): string | undefined {
+  return HASH_NAMES[(name ?? 'sha256').toLowerCase().replace('-', '')];
+}
+
+function toBytes(data: Uint8Array | string): Uint8Array {
+  return typeof data === 'string' ? new TextEncoder().encode(data) : data;
+}
+
+/**
+ * Crossover points measured for a build variant in a benchmark report.
+ * Returns an empty map, which keeps everything on OpenSSL, if the report
+ * has no WebCrypto measurements for the variant.
+ */
+export function crossoversFromBenchmark(report: BenchmarkReport, variant: string): Crossovers {
+  const run = report.runs.find(candidate => candidate.variant === variant && candidate.webcrypto);
+  return run?.webcrypto?.crossovers ?? {};
+}
+
+/**
+ * Async front end that runs each call on crypto.subtle or on OpenSSL.
+ *
+ * Enabled with the webCrypto option and available as openssl.webCrypto.
+ * An operation goes to WebCrypto when crypto.subtle exists and the call's
+ * size reaches the crossover measured for it, and to the OpenSSL instance
+ * otherwise. Only operations whose WebCrypto results are identical are
+ * routed at all; everything else, such as MD5, streaming hashes, AES-CBC,
+ * ChaCha20-Poly1305 and anything involving PEM keys, stays on OpenSSL.
+ * Results and errors are the same on both paths.
+ */
+export class WebCryptoDispatcher {
+  private openssl: OpenSSL;
+  private subtle: SubtleCrypto | null;
+
+  /**
+   * Crossover points in use
+   */
+  readonly crossovers: Crossovers;
+
+  /**
+   * Constructor - should not be called directly, enable with the webCrypto option instead
+   */
+  constructor(openssl: OpenSSL, options: WebCryptoOptions = {}) {
+    this.openssl = openssl;
+    this.subtle = typeof crypto !== 'undefined' && crypto.subtle ? crypto.subtle : null;
+    this.crossovers = { ...(options.crossovers ?? (options.benchmark ? crossoversFromBenchmark(options.benchmark, openssl.variant) : {})) };
+  }
+
+  /**
+   * Whether a call of the given size would run on WebCrypto
+   */
+  usesWebCrypto(operation: OffloadOperation, size: number): boolean {
+    const crossover = this.crossovers[operation];
+    return this.subtle !== null && typeof crossover === 'number' && size >= crossover;
+  }
+
+  /**
+   * Hash data with the named digest, as OpenSSL.sha256() and the other
+   * one-shot digests, or createHash() for the rest
+   */
+  async digest(algorithm: string, data: Uint8Array | string): Promise<Uint8Array> {
+    const input = toBytes(data);
+    const operation = algorithm.toLowerCase().replace('-', '') as OffloadOperation;
+    if (HASH_NAMES[operation]) {
+      if (this.usesWebCrypto(operation, input.length)) {
+        return new Uint8Array(await this.subtle!.digest(HASH_NAMES[operation], input));
+      }
+      return this.openssl[operation as 'sha1' | 'sha256' | 'sha384' | 'sha512'](input);
+    }
+
+    const hash = this.openssl.createHash(algorithm);
+    try {
+      return hash.update(input).digest();
+    } finally {
+      hash.dispose();
+    }
+  }
+
+  /**
+   * Encrypt and authenticate, as OpenSSL.seal()
+   */
+  async seal(algorithm: string, key: Uint8Array, iv: Uint8Array, data: Uint8Array | string, aad?: Uint8Array | string): Promise<Uint8Array> {
+    const input = toBytes(data);
+    if (this.gcmOffload(algorithm, key, iv, input.length)) {
+      const cryptoKey = await this.subtle!.importKey('raw', key, 'AES-GCM', false, ['encrypt']);
+      const sealed = await this.subtle!.encrypt(this.gcmParams(iv, aad), cryptoKey, input);
+      return new Uint8Array(sealed);
+    }
+    return this.openssl.seal(algorithm, key, iv, input, aad);
+  }
+
+  /**
+   * Verify and decrypt, as OpenSSL.open()
+   */
+  async open(algorithm: string, key: Uint8Array, iv: Uint8Array, sealed: Uint8Array, aad?: Uint8Array | string): Promise<Uint8Array> {
+    if (sealed.length >= GCM_TAG_LENGTH && this.gcmOffload(algorithm, key, iv, sealed.length - GCM_TAG_LENGTH)) {
+      const cryptoKey = await this.subtle!.importKey('raw', key, 'AES-GCM', false, ['decrypt']);
+      try {
+        return new Uint8Array(await this.subtle!.decrypt(this.gcmParams(iv, aad), cryptoKey, sealed));
+      } catch (e) {
+        throw new Error(`${algorithm} decryption failed: authentication failed or invalid key/IV`);
+      }
+    }
+    return this.openssl.open(algorithm, key, iv, sealed, aad);
+  }
+
+  /**
+   * Derive keys with HKDF, as OpenSSL.hkdf()
+   */
+  async hkdf(key: Uint8Array | string, options: HkdfOptions): Promise<Uint8Array> {
+    const hash = hashName(options.hash);
+    // Only the full derivation exists in WebCrypto; out-of-range lengths go
+    // to OpenSSL so the error is the same
+    if (hash && (options.mode ?? 'extract-and-expand') === 'extract-and-expand'
+      && options.length > 0 && options.length <= 255 * DIGEST_LENGTHS[hash]
+      && this.usesWebCrypto('hkdf', options.length)) {
+      const keyData = toBytes(key);
+      try {
+        const baseKey = await this.subtle!.importKey('raw', keyData, 'HKDF', false, ['deriveBits']);
+        const bits = await this.subtle!.deriveBits(
+          { name: 'HKDF', hash, salt: toBytes(options.salt ?? ''), info: toBytes(options.info ?? '') },
+          baseKey,
+          options.length * 8
+        );
+        return new Uint8Array(bits);
+      } finally {
+        if (typeof key === 'string') {
+          keyData.fill(0);
+        }
+      }
+    }
+    return this.openssl.hkdf(key, options);
+  }
+
+  /**
+   * Derive a key from a password with PBKDF2, as OpenSSL.pbkdf2()
+   */
+  async pbkdf2(password: Uint8Array | string, salt: Uint8Array | string, options: Pbkdf2Options): Promise<Uint8Array> {
+    const hash = hashName(options.hash);
+    if (hash && options.iterations > 0 && options.length > 0 && this.usesWebCrypto('pbkdf2', options.iterations)) {
+      const passwordData = toBytes(password);
+      try {
+        const baseKey = await this.subtle!.importKey('raw', passwordData, 'PBKDF2', false, ['deriveBits']);
+        const bits = await this.subtle!.deriveBits(
+          { name: 'PBKDF2', hash, salt: toBytes(salt), iterations: options.iterations },
+          baseKey,
+          options.length * 8
+        );
+        return new Uint8Array(bits);
+      } finally {
+        if (typeof password === 'string') {
+          passwordData.fill(0);
+        }
+      }
+    }
+    return this.openssl.pbkdf2(password, salt, options);
+  }
+
+  // Invalid keys and empty nonces go to OpenSSL, so errors match it
+  private gcmOffload(algorithm: string, key: Uint8Array, iv: Uint8Array, size: number): boolean {
+    const name = algorithm.toLowerCase();
+    return GCM_KEY_LENGTHS[name] === key.length && iv.length > 0 && this.usesWebCrypto(name as OffloadOperation, size);
+  }
+
+  private gcmParams(iv: Uint8Array, aad?: Uint8Array | string): AesGcmParams {
+    return aad === undefined
+      ? { name: 'AES-GCM', iv, tagLength: GCM_TAG_LENGTH * 8 }
+      : { name: 'AES-GCM', iv, additionalData: toBytes(aad), tagLength: GCM_TAG_LENGTH * 8 };
+  }
+}
@@ -0,0 +1,7 @@
+/**
+ * Worker entry point for WorkerPool, loaded as a module worker
+ */
+
+import { serve, WorkerScope } from './serve';
+
+serve(self as unknown as WorkerScope);
@@ -7,7 +7,7 @@
 const { expect } = require('chai');
 const sinon = require('sinon');
 
-// Mock the OpenSSL WASM module since we can't actually load it in Node.js
+// Mock the OpenSSL WASM module so the tests run without building it
 const mockOpenSSLInstance = {
   version: () => 'OpenSSL 3.0.9 30 May 2023',
   cleanup: sinon.spy(),
@@ -170,6 +170,1280 @@ describe('AES Encryption (Mock)', () => {
   });
 });
 
+// The suites below run against the built library and its real WASM module,
+// and are skipped until `npm run build` has produced dist/
+const fs = require('fs');
+const path = require('path');
+
+const LIBRARY_PATH = path.join(__dirname, '..', 'dist', 'openssl.node.js');
+
+function hex(bytes) {
+  return Buffer.from(bytes).toString('hex');
+}
+
+// Each suite gets its own instance, so nothing it does is seen by another
+async function initializeLibrary(context, options = {}) {
+  if (!fs.existsSync(LIBRARY_PATH)) {
+    context.skip();
+  }
+  return require(LIBRARY_PATH).default.initialize(options);
+}
+
+describe('Streaming Hash', function () {
+  let openssl;
+
+  before(async function () {
+    openssl = await initializeLibrary(this);
+  });
+
+  after(() => {
+    if (openssl) openssl.cleanup();
+  });
+
+  // FIPS 180-2 test vectors
+  const ABC_SHA256 = 'ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad';
+  const LONG_MESSAGE = 'abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq';
+  const LONG_SHA256 = '248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1';
+
+  it('should match the one-shot digest when fed in chunks', () => {
+    const hash = openssl.createHash('sha256');
+    hash.update('a').update(new TextEncoder().encode('b')).update('').update('c');
+    expect(hex(hash.digest())).to.equal(ABC_SHA256);
+    expect(hex(openssl.sha256('abc'))).to.equal(ABC_SHA256);
+  });
+
+  it('should give the same digest for any split of the input', () => {
+    for (const split of [1, 7, 55, 56]) {
+      const hash = openssl.createHash('sha256');
+      hash.update(LONG_MESSAGE.slice(0, split)).update(LONG_MESSAGE.slice(split));
+      expect(hex(hash.digest()), `split at ${split}`).to.equal(LONG_SHA256);
+    }
+  });
+
+  it('should report the digest length', () => {
+    const hash = openssl.createHash('sha384');
+    expect(hash.digestLength).to.equal(48);
+    hash.dispose();
+  });
+
+  it('should not allow updates after digest', () => {
+    const hash = openssl.createHash('sha256');
+    hash.digest();
+    expect(() => hash.update('more')).to.throw('finalized');
+  });
+
+  it('should reject unknown algorithms', () => {
+    expect(() => openssl.createHash('not-a-digest')).to.throw();
+  });
+});
+
+describe('AEAD Encryption', function () {
+  let openssl;
+  let streamed;
+
+  before(async function () {
+    openssl = await initializeLibrary(this);
+    // Sends every seal() and open() through the streaming fallback
+    streamed = await initializeLibrary(this, { streamingThreshold: 16 });
+  });
+
+  after(() => {
+    if (openssl) openssl.cleanup();
+    if (streamed) streamed.cleanup();
+  });
+
+  const key = new Uint8Array(32).fill(7);
+  const iv = new Uint8Array(12).fill(9);
+  const message = new TextEncoder().encode('The quick brown fox jumps over the lazy dog');
+
+  it('should match the GCM specification test vector', () => {
+    // McGrew and Viega, test case 14
+    const sealed = openssl.seal('aes-256-gcm', new Uint8Array(32), new Uint8Array(12), new Uint8Array(16));
+    expect(hex(sealed)).to.equal('cea7403d4d606b6e074ec5d3baf39d18' + 'd0d1c8a799996bf0265b98b5d48ab919');
+  });
+
+  for (const algorithm of ['aes-256-gcm', 'chacha20-poly1305']) {
+    it(`should round-trip ${algorithm} with AAD on every path`, () => {
+      const sealed = openssl.seal(algorithm, key, iv, message, 'header');
+      expect(sealed.length).to.equal(message.length + 16);
+      expect(hex(streamed.seal(algorithm, key, iv, message, 'header'))).to.equal(hex(sealed));
+      expect(hex(openssl.open(algorithm, key, iv, sealed, 'header'))).to.equal(hex(message));
+      expect(hex(streamed.open(algorithm, key, iv, sealed, 'header'))).to.equal(hex(message));
+    });
+  }
+
+  it('should reject a modified ciphertext, tag or AAD', () => {
+    const sealed = openssl.seal('aes-256-gcm', key, iv, message, 'header');
+    for (const index of [0, message.length]) {
+      const tampered = sealed.slice();
+      tampered[index] ^= 1;
+      expect(() => openssl.open('aes-256-gcm', key, iv, tampered, 'header')).to.throw('authentication failed');
+      expect(() => streamed.open('aes-256-gcm', key, iv, tampered, 'header')).to.throw('authentication failed');
+    }
+    expect(() => openssl.open('aes-256-gcm', key, iv, sealed, 'other')).to.throw('authentication failed');
+    expect(() => openssl.open('aes-256-gcm', key, iv, sealed)).to.throw('authentication failed');
+  });
+
+  it('should round-trip in place and zero the buffer on failure', () => {
+    const buffer = openssl.alloc(message.length + 16);
+    try {
+      buffer.view.set(message);
+      const sealed = openssl.sealInPlace('aes-256-gcm', key, iv, buffer, message.length).slice();
+      expect(hex(sealed)).to.equal(hex(openssl.seal('aes-256-gcm', key, iv, message)));
+      expect(hex(openssl.openInPlace('aes-256-gcm', key, iv, buffer, sealed.length))).to.equal(hex(message));
+
+      buffer.view.set(sealed);
+      buffer.view[0] ^= 1;
+      expect(() => openssl.openInPlace('aes-256-gcm', key, iv, buffer, sealed.length)).to.throw('authentication failed');
+      expect(buffer.view.subarray(0, message.length).every(byte => byte === 0)).to.be.true;
+    } finally {
+      buffer.dispose();
+    }
+  });
+
+  it('should refuse ciphers that are not AEAD on every path', () => {
+    const cbcKey = new Uint8Array(32);
+    const cbcIv = new Uint8Array(16);
+    const data = new Uint8Array(64);
+    expect(() => openssl.seal('aes-256-cbc', cbcKey, cbcIv, data)).to.throw('encryption failed');
+    expect(() => streamed.seal('aes-256-cbc', cbcKey, cbcIv, data)).to.throw('encryption failed');
+    expect(() => openssl.open('aes-256-cbc', cbcKey, cbcIv, data)).to.throw('decryption failed');
+    expect(() => streamed.open('aes-256-cbc', cbcKey, cbcIv, data)).to.throw('decryption failed');
+
+    const buffer = openssl.alloc(data.length + 16);
+    try {
+      expect(() => openssl.sealInPlace('aes-256-cbc', cbcKey, cbcIv, buffer, data.length)).to.throw('encryption failed');
+    } finally {
+      buffer.dispose();
+    }
+  });
+});
+
+describe('Content-defined Chunking', function () {
+  let openssl;
+
+  before(async function () {
+    openssl = await initializeLibrary(this);
+  });
+
+  after(() => {
+    if (openssl) openssl.cleanup();
+  });
+
+  // xorshift32 pattern, the same as fill() in bench/suite.mjs
+  function pattern(length) {
+    const data = new Uint8Array(length);
+    let x = 2654435761;
+    for (let i = 0; i < length; i++) {
+      x ^= x << 13;
+      x ^= x >>> 17;
+      x ^= x << 5;
+      data[i] = x;
+    }
+    return data;
+  }
+
+  const options = { algorithm: 'sha256', minSize: 1024, avgSize: 4096, maxSize: 16384 };
+  const input = pattern(256 * 1024);
+
+  // Boundaries of the gear table and masks in the glue. A change here means
+  // every previously stored chunk stops deduplicating.
+  const GOLDEN_OFFSETS = [
+    0, 5163, 9437, 13693, 18827, 25669, 30133, 35273, 38520, 43626, 48439, 52551, 57475, 62143, 63754, 68329,
+    72634, 77177, 83245, 88831, 93469, 98968, 104388, 108712, 110220, 117017, 121263, 129683, 133907, 138660,
+    142934, 147081, 152038, 160054, 164802, 167236, 171765, 176030, 180799, 185540, 186970, 191991, 196341,
+    201159, 208757, 214342, 219239, 220494, 226074, 232394, 238519, 242819, 248654, 252860, 253973, 257017, 261903
+  ];
+
+  it('should cut the golden boundaries and hash each chunk', () => {
+    const chunks = openssl.chunkAndHash(input, options);
+    expect(chunks.map(chunk => chunk.offset)).to.deep.equal(GOLDEN_OFFSETS);
+    expect(hex(chunks[0].digest)).to.equal('f2ece1ae7f15563d712d8cbd45aced38dbe6fd0df920960b024e969844820e31');
+
+    let end = 0;
+    for (const chunk of chunks) {
+      expect(chunk.offset).to.equal(end);
+      expect(hex(chunk.digest)).to.equal(hex(openssl.sha256(input.subarray(chunk.offset, chunk.offset + chunk.length))));
+      end += chunk.length;
+    }
+    expect(end).to.equal(input.length);
+  });
+
+  it('should give the same records however the input is split', () => {
+    const expected = openssl.chunkAndHash(input, options);
+    for (const step of [1000, 4097, 65536]) {
+      const chunker = openssl.createChunker(options);
+      const parts = [];
+      for (let offset = 0; offset < input.length; offset += step) {
+        parts.push(...unpack(chunker.update(input.subarray(offset, offset + step)), chunker));
+      }
+      parts.push(...unpack(chunker.final(), chunker));
+      expect(parts.map(toKey), `updates of ${step} bytes`).to.deep.equal(expected.map(toKey));
+    }
+  });
+
+  it('should only change the chunks around an insertion', () => {
+    const edited = new Uint8Array(input.length + 100);
+    edited.set(input.subarray(0, 100000));
+    edited.fill(0x55, 100000, 100100);
+    edited.set(input.subarray(100000), 100100);
+
+    const before = new Set(openssl.chunkAndHash(input, options).map(chunk => hex(chunk.digest)));
+    const after = openssl.chunkAndHash(edited, options);
+    const shared = after.filter(chunk => before.has(hex(chunk.digest))).length;
+    expect(shared).to.be.at.least(after.length - 2);
+  });
+
+  it('should reject invalid sizes', () => {
+    expect(() => openssl.createChunker({ minSize: 8192, avgSize: 4096 })).to.throw('Chunk sizes');
+  });
+
+  function unpack(records, chunker) {
+    const { unpackChunks } = require(LIBRARY_PATH);
+    return unpackChunks(records, chunker.digestLength);
+  }
+
+  function toKey(chunk) {
+    return `${chunk.offset}:${chunk.length}:${hex(chunk.digest)}`;
+  }
+});
+
+describe('Key Derivation', function () {
+  let openssl;
+
+  before(async function () {
+    openssl = await initializeLibrary(this);
+  });
+
+  after(() => {
+    if (openssl) openssl.cleanup();
+  });
+
+  // RFC 6070, PBKDF2-HMAC-SHA1
+  it('should match the PBKDF2 test vectors', () => {
+    const vectors = [
+      [1, '0c60c80f961f0e71f3a9b524af6012062fe037a6'],
+      [2, 'ea6c014dc72d6f8ccd1ed92ace1d41f0d8de8957'],
+      [4096, '4b007901b765489abead49d926f721d065a429c1']
+    ];
+    for (const [iterations, expected] of vectors) {
+      const key = openssl.pbkdf2('password', 'salt', { iterations, length: 20, hash: 'sha1' });
+      expect(hex(key), `${iterations} iterations`).to.equal(expected);
+    }
+    const long = openssl.pbkdf2('passwordPASSWORDpassword', 'saltSALTsaltSALTsaltSALTsaltSALTsalt', { iterations: 4096, length: 25, hash: 'sha1' });
+    expect(hex(long)).to.equal('3d2eec4fe41c849b80c8d83662c0e44a8b291a964cf2f07038');
+  });
+
+  // RFC 5869, test case 1
+  const ikm = new Uint8Array(22).fill(0x0b);
+  const salt = Buffer.from('000102030405060708090a0b0c', 'hex');
+  const info = Buffer.from('f0f1f2f3f4f5f6f7f8f9', 'hex');
+  const PRK = '077709362c2e32df0ddc3f0dc47bba6390b6c73bb50f9c3122ec844ad7c2b3e5';
+  const OKM = '3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf34007208d5b887185865';
+
+  it('should match the HKDF test vectors in every mode', () => {
+    expect(hex(openssl.hkdf(ikm, { salt, info, length: 42 }))).to.equal(OKM);
+    expect(hex(openssl.hkdf(ikm, { salt, length: 32, mode: 'extract' }))).to.equal(PRK);
+    expect(hex(openssl.hkdf(Buffer.from(PRK, 'hex'), { info, length: 42, mode: 'expand' }))).to.equal(OKM);
+
+    // Test case 3: no salt and no info
+    expect(hex(openssl.hkdf(ikm, { length: 42 }))).to.equal(
+      '8da4e775a563c18f715f802a063c5a31b8a11f5c5ee1879ec3454e5f3c738d2d9d201395faa4b61a96c8');
+  });
+
+  it('should reject unknown HKDF modes', () => {
+    expect(() => openssl.hkdf(ikm, { length: 32, mode: 'both' })).to.throw('Unknown HKDF mode');
+  });
+
+  // RFC 7914, section 12
+  it('should match the scrypt test vectors', () => {
+    const empty = openssl.scrypt('', '', { N: 16, r: 1, p: 1, length: 64 });
+    expect(hex(empty)).to.equal(
+      '77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906');
+    const key = openssl.scrypt('password', 'NaCl', { N: 1024, r: 8, p: 16, length: 64 });
+    expect(hex(key)).to.equal(
+      'fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b3731622eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640');
+  });
+
+  it('should refuse scrypt parameters above maxmem before deriving', () => {
+    const before = openssl.memoryStats().heapSize;
+    expect(() => openssl.scrypt('password', 'NaCl', { N: 1024, r: 8, p: 16, length: 64, maxmem: 1024 * 1024 }))
+      .to.throw('above the maxmem budget');
+    expect(() => openssl.scrypt('password', 'NaCl', { N: 1000, length: 64 })).to.throw('power of two');
+    expect(openssl.memoryStats().heapSize).to.equal(before);
+  });
+
+  it('should round-trip a password-protected private key', () => {
+    const key = openssl.generateKey({ type: 'ed25519' });
+    try {
+      const pem = key.exportPrivateKey({ password: 'correct horse', iterations: 1000 });
+      expect(pem).to.include('BEGIN ENCRYPTED PRIVATE KEY');
+
+      const imported = openssl.importPrivateKey(pem, 'correct horse');
+      try {
+        expect(imported.exportPublicKey()).to.equal(key.exportPublicKey());
+      } finally {
+        imported.dispose();
+      }
+      expect(() => openssl.importPrivateKey(pem, 'wrong password')).to.throw('Failed to read private key');
+      expect(() => key.exportPrivateKey({ password: 'correct horse', iterations: 0 })).to.throw('iterations');
+    } finally {
+      key.dispose();
+    }
+  });
+});
+
+describe('Public-key Operations', function () {
+  let openssl;
+  let rsa;
+  let ec;
+
+  before(async function () {
+    this.timeout(30000);
+    openssl = await initializeLibrary(this);
+    rsa = openssl.generateKey({ type: 'rsa', bits: 2048 });
+    ec = openssl.generateKey({ type: 'ec', curve: 'P-256' });
+  });
+
+  after(() => {
+    if (rsa) rsa.dispose();
+    if (ec) ec.dispose();
+    if (openssl) openssl.cleanup();
+  });
+
+  // Unencrypted PKCS#8 DER for a raw 32-byte Ed25519 or X25519 private key
+  function pkcs8(oid, key) {
+    return Buffer.from(`302e020100300506032b65${oid}04220420${key}`, 'hex');
+  }
+
+  function pemToDer(pem) {
+    return Buffer.from(pem.replace(/-----[^-]+-----|\s/g, ''), 'base64');
+  }
+
+  // RFC 8032, section 7.1, tests 1 and 2
+  const ED25519_VECTORS = [
+    {
+      secret: '9d61b19deffd5a60ba844af492ec2cc44449c5697b326919703bac031cae7f60',
+      public: 'd75a980182b10ab7d54bfed3c964073a0ee172f3daa62325af021a68f707511a',
+      message: '',
+      signature: 'e5564300c360ac729086e2cc806e828a84877f1eb8e5d974d873e06522490155' +
+        '5fb8821590a33bacc61e39701cf9b46bd25bf5f0595bbe24655141438e7a100b'
+    },
+    {
+      secret: '4ccd089b28ff96da9db6c346ec114e0f5b8a319f35aba624da8cf6ed4fb8a6fb',
+      public: '3d4017c3e843895a92b70aa74d1b7ebc9c982ccf2ec4968cc0cd55f12af4660c',
+      message: '72',
+      signature: '92a009a9f0d4cab8720e820b5f642540a2b27b5416503f8fb3762223ebdb69da' +
+        '085ac1e43e15996e458f3613d0f11d8c387b2eaeb4302aeeb00d291612bb0c00'
+    }
+  ];
+
+  it('should match the Ed25519 test vectors', () => {
+    for (const vector of ED25519_VECTORS) {
+      const message = Buffer.from(vector.message, 'hex');
+      const key = openssl.importPrivateKey(pkcs8('70', vector.secret));
+      const publicKey = openssl.importRawPublicKey('ed25519', Buffer.from(vector.public, 'hex'));
+      try {
+        expect(key.type).to.equal('ED25519');
+        expect(hex(key.rawPublicKey())).to.equal(vector.public);
+        expect(hex(key.sign(message))).to.equal(vector.signature);
+        expect(publicKey.verify(message, Buffer.from(vector.signature, 'hex'))).to.be.true;
+        expect(publicKey.verify(Buffer.from('73', 'hex'), Buffer.from(vector.signature, 'hex'))).to.be.false;
+      } finally {
+        key.dispose();
+        publicKey.dispose();
+      }
+    }
+  });
+
+  for (const [name, options] of [['ECDSA P-256', {}], ['RSA-PSS', { padding: 'pss' }], ['RSA PKCS#1', {}]]) {
+    it(`should sign and verify with ${name} and reject tampering`, () => {
+      const key = name.startsWith('RSA') ? rsa : ec;
+      const publicKey = openssl.importPublicKey(key.exportPublicKey());
+      try {
+        const signature = key.sign('signed message', options);
+        expect(publicKey.verify('signed message', signature, options)).to.be.true;
+        expect(publicKey.verify('signed messagf', signature, options)).to.be.false;
+
+        const tampered = signature.slice();
+        tampered[tampered.length - 1] ^= 1;
+        expect(publicKey.verify('signed message', tampered, options)).to.be.false;
+        expect(publicKey.verify('signed message', signature, { ...options, hash: 'sha384' })).to.be.false;
+        expect(() => publicKey.sign('signed message', options)).to.throw('private key');
+      } finally {
+        publicKey.dispose();
+      }
+    });
+  }
+
+  it('should not accept a PSS signature as PKCS#1', () => {
+    const signature = rsa.sign('signed message', { padding: 'pss' });
+    expect(rsa.verify('signed message', signature, { padding: 'pss' })).to.be.true;
+    expect(rsa.verify('signed message', signature)).to.be.false;
+  });
+
+  // RFC 7748, section 6.1
+  it('should match the X25519 test vector', () => {
+    const alicePublic = '8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a';
+    const bobPublic = 'de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f';
+    const shared = '4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742';
+
+    const alice = openssl.importPrivateKey(pkcs8('6e', '77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a'));
+    const bob = openssl.importPrivateKey(pkcs8('6e', '5dab087e624a8a4b79e17f8b83800ee66f3bb1292618b6fd1c2f8b27ff88e0eb'));
+    const alicePeer = openssl.importRawPublicKey('x25519', Buffer.from(alicePublic, 'hex'));
+    const bobPeer = openssl.importRawPublicKey('x25519', Buffer.from(bobPublic, 'hex'));
+    try {
+      expect(hex(alice.rawPublicKey())).to.equal(alicePublic);
+      expect(hex(bob.rawPublicKey())).to.equal(bobPublic);
+      expect(hex(alice.derive(bobPeer))).to.equal(shared);
+      expect(hex(bob.derive(alicePeer))).to.equal(shared);
+    } finally {
+      [alice, bob, alicePeer, bobPeer].forEach(key => key.dispose());
+    }
+  });
+
+  it('should round-trip RSA-OAEP', () => {
+    const publicKey = openssl.importPublicKey(rsa.exportPublicKey());
+    try {
+      const ciphertext = publicKey.encrypt('key material');
+      expect(ciphertext.length).to.equal(256);
+      // OAEP is randomized
+      expect(hex(publicKey.encrypt('key material'))).to.not.equal(hex(ciphertext));
+      expect(new TextDecoder().decode(rsa.decrypt(ciphertext))).to.equal('key material');
+
+      const sha1 = publicKey.encrypt('key material', { hash: 'sha1' });
+      expect(new TextDecoder().decode(rsa.decrypt(sha1, { hash: 'sha1' }))).to.equal('key material');
+      expect(() => rsa.decrypt(sha1)).to.throw('Decryption failed');
+
+      const tampered = ciphertext.slice();
+      tampered[0] ^= 1;
+      expect(() => rsa.decrypt(tampered)).to.throw('Decryption failed');
+      expect(() => publicKey.decrypt(ciphertext)).to.throw('private key');
+    } finally {
+      publicKey.dispose();
+    }
+  });
+
+  it('should round-trip keys through PEM and DER', () => {
+    for (const key of [rsa, ec]) {
+      const publicPem = key.exportPublicKey();
+      const privatePem = key.exportPrivateKey();
+      expect(publicPem).to.include('BEGIN PUBLIC KEY');
+      expect(privatePem).to.include('BEGIN PRIVATE KEY');
+
+      const imported = [
+        openssl.importPrivateKey(privatePem),
+        openssl.importPrivateKey(pemToDer(privatePem)),
+        openssl.importPublicKey(publicPem),
+        openssl.importPublicKey(pemToDer(publicPem))
+      ];
+      try {
+        for (const handle of imported) {
+          expect(handle.type).to.equal(key.type);
+          expect(handle.exportPublicKey()).to.equal(publicPem);
+        }
+        expect(imported[1].exportPrivateKey()).to.equal(privatePem);
+        expect(imported[3].isPrivate).to.be.false;
+      } finally {
+        imported.forEach(handle => handle.dispose());
+      }
+    }
+    expect(() => openssl.importPublicKey('-----BEGIN PUBLIC KEY-----\nAAAA\n-----END PUBLIC KEY-----')).to.throw('Failed to read public key');
+  });
+});
+
+describe('HMAC', function () {
+  let openssl;
+
+  before(async function () {
+    openssl = await initializeLibrary(this);
+  });
+
+  after(() => {
+    if (openssl) openssl.cleanup();
+  });
+
+  // RFC 4231, test cases 1, 2 and 6
+  const CASES = [
+    {
+      key: new Uint8Array(20).fill(0x0b),
+      data: 'Hi There',
+      sha256: 'b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7',
+      sha512: '87aa7cdea5ef619d4ff0b4241a1d6cb02379f4e2ce4ec2787ad0b30545e17cde' +
+        'daa833b7d6b8a702038b274eaea3f4e4be9d914eeb61f1702e696c203a126854'
+    },
+    {
+      key: 'Jefe',
+      data: 'what do ya want for nothing?',
+      sha256: '5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843',
+      sha512: '164b7a7bfcf819e2e395fbe73b56e0a387bd64222e831fd610270cd7ea250554' +
+        '9758bf75c05a994a6d034f65f8f0e6fdcaeab1a34d4a6b4b636e070a38bce737'
+    },
+    {
+      key: new Uint8Array(131).fill(0xaa),
+      data: 'Test Using Larger Than Block-Size Key - Hash Key First',
+      sha256: '60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54',
+      sha512: '80b24263c7c1a3ebb71493c1dd7be8b49b46d1f41b4aeec1121b013783f8f352' +
+        '6b56d037e05f2598bd0fd2215d6a1e5295e64f73f63f0aec8b915a985d786598'
+    }
+  ];
+
+  it('should match the RFC 4231 test vectors', () => {
+    for (const [index, vector] of CASES.entries()) {
+      for (const algorithm of ['sha256', 'sha512']) {
+        expect(hex(openssl.hmac(algorithm, vector.key, vector.data)), `case ${index} ${algorithm}`).to.equal(vector[algorithm]);
+      }
+    }
+  });
+
+  it('should lay out hmacMany results at i * digestLength', () => {
+    const key = openssl.createHmacKey('sha256', CASES[0].key);
+    try {
+      const messages = ['Hi There', '', new TextEncoder().encode('Hi There'), 'what do ya want for nothing?'];
+      const macs = key.hmacMany(messages);
+      expect(macs.length).to.equal(messages.length * key.digestLength);
+      for (const [i, message] of messages.entries()) {
+        const mac = macs.subarray(i * key.digestLength, (i + 1) * key.digestLength);
+        expect(hex(mac), `message ${i}`).to.equal(hex(openssl.hmac('sha256', CASES[0].key, message)));
+      }
+      expect(hex(macs.subarray(0, 32))).to.equal(CASES[0].sha256);
+      expect(hex(openssl.hmacMany('sha256', CASES[0].key, messages))).to.equal(hex(macs));
+      expect(key.hmacMany([]).length).to.equal(0);
+    } finally {
+      key.dispose();
+    }
+  });
+
+  it('should match the vectors when streamed in any split', () => {
+    const key = openssl.createHmacKey('sha512', CASES[2].key);
+    try {
+      const data = CASES[2].data;
+      for (const split of [0, 1, 20, data.length]) {
+        const mac = key.createHmac();
+        mac.update(data.slice(0, split)).update(data.slice(split));
+        expect(hex(mac.digest()), `split at ${split}`).to.equal(CASES[2].sha512);
+      }
+    } finally {
+      key.dispose();
+    }
+  });
+
+  it('should keep the keyed state intact across copies and reuse', () => {
+    const key = openssl.createHmacKey('sha256', 'Jefe');
+    const expected = CASES[1].sha256;
+    expect(hex(key.hmac(CASES[1].data))).to.equal(expected);
+
+    // A streaming HMAC is cloned from the key; using it must not touch the key
+    const stream = key.createHmac();
+    stream.update('unrelated input');
+    expect(hex(key.hmac(CASES[1].data))).to.equal(expected);
+    expect(hex(key.hmac(CASES[1].data))).to.equal(expected);
+
+    const copy = key.createHmac();
+    key.dispose();
+    // Copies outlive the key they were cloned from
+    expect(hex(copy.update(CASES[1].data).digest())).to.equal(expected);
+    stream.dispose();
+    expect(() => key.hmac(CASES[1].data)).to.throw('has been disposed');
+  });
+
+  it('should reject unknown digests', () => {
+    expect(() => openssl.createHmacKey('not-a-digest', 'key')).to.throw('Unsupported digest algorithm');
+  });
+});
+
+describe('Base64', function () {
+  let openssl;
+  let streamed;
+
+  before(async function () {
+    openssl = await initializeLibrary(this);
+    // Sends base64Encode() and base64Decode() through the streaming fallback
+    streamed = await initializeLibrary(this, { streamingThreshold: 4 });
+  });
+
+  after(() => {
+    if (openssl) openssl.cleanup();
+    if (streamed) streamed.cleanup();
+  });
+
+  // RFC 4648, section 10
+  const VECTORS = [
+    ['', ''],
+    ['f', 'Zg=='],
+    ['fo', 'Zm8='],
+    ['foo', 'Zm9v'],
+    ['foob', 'Zm9vYg=='],
+    ['fooba', 'Zm9vYmE='],
+    ['foobar', 'Zm9vYmFy']
+  ];
+
+  it('should match the RFC 4648 test vectors on every path', () => {
+    for (const [plain, encoded] of VECTORS) {
+      for (const instance of [openssl, streamed]) {
+        expect(instance.base64Encode(plain), `encode "${plain}"`).to.equal(encoded);
+        expect(new TextDecoder().decode(instance.base64Decode(encoded)), `decode "${encoded}"`).to.equal(plain);
+      }
+    }
+  });
+
+  it('should tolerate surrounding whitespace and missing padding', () => {
+    for (const instance of [openssl, streamed]) {
+      expect(hex(instance.base64Decode(' Zm9vYg==\n'))).to.equal(hex(Buffer.from('foob')));
+      expect(hex(instance.base64Decode('Zm9vYg'))).to.equal(hex(Buffer.from('foob')));
+      expect(hex(instance.base64Decode('Zm9vYmE'))).to.equal(hex(Buffer.from('fooba')));
+    }
+  });
+
+  it('should reject malformed and mispadded input on every path', () => {
+    const invalid = ['Z', 'Zm9vY', 'Zm9v!A==', 'Zg==Zg==', 'Zm=v', 'Z===', '====', 'Zm9v Yg=', 'Zm9v\nYg=', 'Zm9vYé=='];
+    for (const text of invalid) {
+      for (const instance of [openssl, streamed]) {
+        expect(() => instance.base64Decode(text), JSON.stringify(text)).to.throw(/invalid/i);
+      }
+    }
+  });
+
+  // xorshift32 bytes covering every 6-bit group
+  const data = new Uint8Array(1000);
+  for (let i = 0, x = 88172645; i < data.length; i++) {
+    x ^= x << 13;
+    x ^= x >>> 17;
+    x ^= x << 5;
+    data[i] = x;
+  }
+  const encoded = Buffer.from(data).toString('base64');
+
+  it('should encode the same however the input is split', () => {
+    expect(openssl.base64Encode(data)).to.equal(encoded);
+    for (const step of [1, 2, 3, 4, 7, 500]) {
+      const encoder = openssl.createBase64Encoder();
+      let text = '';
+      for (let offset = 0; offset < data.length; offset += step) {
+        text += encoder.update(data.subarray(offset, offset + step));
+      }
+      text += encoder.final();
+      expect(text, `updates of ${step} bytes`).to.equal(encoded);
+    }
+  });
+
+  it('should decode the same however the text is split or wrapped', () => {
+    const wrapped = encoded.replace(/.{64}/g, '$&\r\n');
+    for (const text of [encoded, wrapped, encoded.replace(/=+$/, '')]) {
+      for (const step of [1, 3, 4, 5, 333]) {
+        const decoder = openssl.createBase64Decoder();
+        const parts = [];
+        for (let offset = 0; offset < text.length; offset += step) {
+          parts.push(decoder.update(text.slice(offset, offset + step)));
+        }
+        parts.push(decoder.final());
+        expect(hex(Buffer.concat(parts)), `updates of ${step} characters`).to.equal(hex(data));
+      }
+    }
+  });
+
+  it('should reject data after padding when streaming', () => {
+    const decoder = openssl.createBase64Decoder();
+    decoder.update('Zg==');
+    expect(() => decoder.update('Zg==')).to.throw('data after padding');
+    decoder.dispose();
+
+    const split = openssl.createBase64Decoder();
+    split.update('Zm9');
+    expect(() => split.update('!Zm9v')).to.throw('Invalid base64 input');
+    split.dispose();
+  });
+});
+
+describe('Tree Hash', function () {
+  const crypto = require('crypto');
+  let openssl;
+
+  before(async function () {
+    openssl = await initializeLibrary(this);
+  });
+
+  after(() => {
+    if (openssl) openssl.cleanup();
+  });
+
+  function sha256(...parts) {
+    const hash = crypto.createHash('sha256');
+    parts.forEach(part => hash.update(part));
+    return hash.digest();
+  }
+
+  // RFC 6962, section 2.1, independently of the glue
+  function expectedRoot(data, chunkSize) {
+    const leaves = [];
+    for (let offset = 0; offset < data.length; offset += chunkSize) {
+      leaves.push(sha256(Buffer.from([0]), data.subarray(offset, offset + chunkSize)));
+    }
+    const node = list => {
+      if (list.length === 1) return list[0];
+      let split = 1;
+      while (split * 2 < list.length) split *= 2;
+      return sha256(Buffer.from([1]), node(list.slice(0, split)), node(list.slice(split)));
+    };
+    return leaves.length === 0 ? sha256() : node(leaves);
+  }
+
+  it('should split three leaves as RFC 6962 does', () => {
+    const data = Buffer.from('aaaabbbbcc');
+    const [a, b, c] = ['aaaa', 'bbbb', 'cc'].map(chunk => sha256(Buffer.from([0]), Buffer.from(chunk)));
+    const root = sha256(Buffer.from([1]), sha256(Buffer.from([1]), a, b), c);
+    expect(hex(root)).to.equal('c496587773b3ba4e83b91d3a5d44549c46b8409da1f84abab7a31f16c5dd5c08');
+
+    const result = openssl.treeHash('sha256', data, { chunkSize: 4, leaves: true });
+    expect(hex(result.root)).to.equal(hex(root));
+    expect(hex(result.leaves)).to.equal(hex(Buffer.concat([a, b, c])));
+    expect(hex(openssl.treeHashRoot('sha256', result.leaves))).to.equal(hex(root));
+  });
+
+  it('should hash inputs that end mid-window and mid-leaf', function () {
+    this.timeout(10000);
+    // 1,000,000-byte leaves: four per 4 MiB window, so 9,500,001 bytes is
+    // three windows, the last holding a partial window and a partial leaf
+    const data = new Uint8Array(9500001);
+    for (let i = 0; i < data.length; i++) data[i] = i * 31 + (i >>> 11);
+    for (const chunkSize of [1000000, 5 * 1024 * 1024, 4099]) {
+      expect(hex(openssl.treeHash('sha256', data, { chunkSize }).root), `${chunkSize}-byte leaves`).to.equal(hex(expectedRoot(data, chunkSize)));
+    }
+  });
+
+  it('should give the digest of the empty string for no leaves', () => {
+    const empty = sha256();
+    const result = openssl.treeHash('sha256', new Uint8Array(0), { leaves: true });
+    expect(hex(result.root)).to.equal(hex(empty));
+    expect(result.leaves.length).to.equal(0);
+    expect(hex(openssl.treeHashRoot('sha256', new Uint8Array(0)))).to.equal(hex(empty));
+  });
+
+  it('should give the same root from a worker pool', async function () {
+    this.timeout(20000);
+    if (!fs.existsSync(path.join(path.dirname(LIBRARY_PATH), 'openssl.node-worker.js'))) {
+      this.skip();
+    }
+    const pool = await require(LIBRARY_PATH).createNodePool({ size: 3 });
+    try {
+      const data = new Uint8Array(1234567).map((_, i) => i % 251);
+      for (const [input, chunkSize] of [[data, 100000], [data, 1 << 20], [data.subarray(0, 10), 4], [new Uint8Array(0), 1024]]) {
+        const expected = openssl.treeHash('sha256', input, { chunkSize }).root;
+        const { root } = await pool.treeHash('sha256', input, { chunkSize });
+        expect(hex(root), `${input.length} bytes in ${chunkSize}-byte leaves`).to.equal(hex(expected));
+      }
+    } finally {
+      pool.terminate();
+    }
+  });
+
+  it('should reject invalid leaf sizes', () => {
+    expect(() => openssl.treeHash('sha256', 'data', { chunkSize: 0 })).to.throw('chunk size');
+  });
+});
+
+describe('Batch Hashing', function () {
+  const crypto = require('crypto');
+  let openssl;
+
+  before(async function () {
+    openssl = await initializeLibrary(this);
+  });
+
+  after(() => {
+    if (openssl) openssl.cleanup();
+  });
+
+  const messages = ['abc', '', new TextEncoder().encode('abc'), new Uint8Array(0), 'x'.repeat(1000), new Uint8Array([0, 255])];
+
+  for (const algorithm of ['sha256', 'sha512', 'md5']) {
+    it(`should concatenate the ${algorithm} digests in input order`, () => {
+      const digests = openssl.hashMany(algorithm, messages);
+      const expected = Buffer.concat(messages.map(message => crypto.createHash(algorithm).update(message).digest()));
+      expect(hex(digests)).to.equal(hex(expected));
+    });
+  }
+
+  it('should match the one-shot digests message by message', () => {
+    const digests = openssl.hashMany('sha256', messages);
+    messages.forEach((message, i) => {
+      expect(hex(digests.subarray(i * 32, (i + 1) * 32)), `message ${i}`).to.equal(hex(openssl.sha256(message)));
+    });
+    expect(hex(digests.subarray(32, 64))).to.equal('e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855');
+  });
+
+  it('should return nothing for no messages and reject unknown digests', () => {
+    expect(openssl.hashMany('sha256', []).length).to.equal(0);
+    expect(() => openssl.hashMany('not-a-digest', ['abc'])).to.throw('Unsupported digest algorithm');
+  });
+});
+
+describe('Batch Verification', function () {
+  let openssl;
+  let isVerified;
+  let keys;
+
+  before(async function () {
+    openssl = await initializeLibrary(this);
+    isVerified = require(LIBRARY_PATH).isVerified;
+    keys = {
+      ed25519: [1, 2, 3].map(() => openssl.generateKey({ type: 'ed25519' })),
+      ec: [1, 2, 3].map(() => openssl.generateKey({ type: 'ec' }))
+    };
+  });
+
+  after(() => {
+    if (keys) Object.values(keys).flat().forEach(key => key.dispose());
+    if (openssl) openssl.cleanup();
+  });
+
+  const COUNT = 21;
+  const messages = Array.from({ length: COUNT }, (_, i) => i % 2 ? `message ${i}` : new TextEncoder().encode(`message ${i}`));
+  // Indexes whose signature is broken, in every byte of the bitmap and in
+  // each of the ways signBatch() breaks them
+  const INVALID = new Set([0, 5, 10, 15, 20]);
+
+  function expectBitmap(bitmap) {
+    expect(bitmap.length).to.equal(Math.ceil(COUNT / 8));
+    for (let i = 0; i < COUNT; i++) {
+      expect(isVerified(bitmap, i), `signature ${i}`).to.equal(!INVALID.has(i));
+    }
+    // Bits past the last signature stay clear
+    expect(bitmap[bitmap.length - 1] >> (COUNT % 8)).to.equal(0);
+  }
+
+  // Signature i under signers[i], broken for the INVALID indexes in turn by
+  // signing another message, flipping a bit, leaving it empty, or signing
+  // with a key outside the batch
+  function signBatch(signers, other) {
+    return messages.map((message, i) => {
+      if (!INVALID.has(i)) return signers[i].sign(message);
+      switch (i % 4) {
+        case 0: return signers[i].sign(`${message} altered`);
+        case 1: {
+          const signature = signers[i].sign(message);
+          signature[signature.length >> 1] ^= 0x10;
+          return signature;
+        }
+        case 2: return new Uint8Array(0);
+        default: return other.sign(message);
+      }
+    });
+  }
+
+  for (const type of ['ed25519', 'ec']) {
+    it(`should set one bit per ${type} signature under a shared key`, () => {
+      const [key, other] = keys[type];
+      const signers = messages.map(() => key);
+      const signatures = signBatch(signers, other);
+      expectBitmap(openssl.verifyMany(key, messages, signatures));
+      expectBitmap(openssl.verifyMany(key.exportPublicKey(), messages, signatures));
+    });
+
+    it(`should set one bit per ${type} signature under per-message keys`, () => {
+      const [first, second, other] = keys[type];
+      // Runs of each key, so the batch both reuses and switches setups
+      const signers = messages.map((_, i) => (i % 6 < 3 ? first : second));
+      const signatures = signBatch(signers, other);
+      const handles = signers.map(signer => openssl.importPublicKey(signer.exportPublicKey()));
+      try {
+        expectBitmap(openssl.verifyMany(handles, messages, signatures));
+        // PEM keys, each parsed once for the batch
+        expectBitmap(openssl.verifyMany(signers.map(signer => signer.exportPublicKey()), messages, signatures));
+      } finally {
+        handles.forEach(handle => handle.dispose());
+      }
+    });
+  }
+
+  it('should verify a batch that mixes key types', () => {
+    const signers = messages.map((_, i) => (i % 2 ? keys.ed25519[0] : keys.ec[0]));
+    const signatures = signBatch(signers, keys.ed25519[2]);
+    expectBitmap(openssl.verifyMany(signers, messages, signatures));
+  });
+
+  it('should agree with verify() one signature at a time', () => {
+    const [key, other] = keys.ed25519;
+    const signatures = signBatch(messages.map(() => key), other);
+    const bitmap = openssl.verifyMany(key, messages, signatures);
+    messages.forEach((message, i) => {
+      expect(isVerified(bitmap, i), `signature ${i}`).to.equal(key.verify(message, signatures[i]));
+    });
+  });
+
+  it('should require one signature and key per message', () => {
+    const [key] = keys.ec;
+    expect(() => openssl.verifyMany(key, messages, [])).to.throw('one signature');
+    expect(() => openssl.verifyMany([key], messages, messages.map(() => new Uint8Array(0)))).to.throw('one signature');
+    expect(openssl.verifyMany(key, [], []).length).to.equal(0);
+  });
+});
+
+describe('Memory Management', function () {
+  const crypto = require('crypto');
+  let OpenSSLWasmJS;
+  let openssl;
+  let tracked;
+  let streamed;
+
+  before(async function () {
+    openssl = await initializeLibrary(this);
+    tracked = await initializeLibrary(this, { trackHandles: true });
+    // Sends every one-shot call above 64 KiB through the streaming fallback
+    streamed = await initializeLibrary(this, { streamingThreshold: 64 * 1024, trackHandles: true });
+    OpenSSLWasmJS = require(LIBRARY_PATH).default;
+  });
+
+  after(() => {
+    [openssl, tracked, streamed].forEach(instance => instance && instance.cleanup());
+  });
+
+  describe('liveHandles()', () => {
+    it('should require the trackHandles option', () => {
+      expect(() => openssl.liveHandles()).to.throw('trackHandles');
+    });
+
+    it('should count live handles by kind until they are released', () => {
+      const first = tracked.createHash('sha256');
+      const second = tracked.createHash('sha512');
+      const hmacKey = tracked.createHmacKey('sha256', 'key');
+      const key = tracked.generateKey({ type: 'ed25519' });
+      const buffer = tracked.alloc(64);
+      const encoder = tracked.createBase64Encoder();
+
+      let report = tracked.liveHandles();
+      expect(report.count).to.equal(6);
+      expect(tracked.memoryStats().liveHandles).to.equal(6);
+      expect(report.byKind.Hash.count).to.equal(2);
+      expect(report.byKind.HmacKey.count).to.equal(1);
+      expect(report.byKind.KeyHandle.count).to.equal(1);
+      expect(report.byKind.KeyHandle.bytes).to.be.above(0);
+      expect(report.byKind.HeapBuffer.count).to.equal(1);
+      expect(report.byKind.Base64Encoder.count).to.equal(1);
+      expect(report.bytes).to.equal(report.handles.reduce((sum, handle) => sum + handle.bytes, 0));
+      const keyEntry = report.handles.find(handle => handle.kind === 'KeyHandle');
+      expect(keyEntry.createdBy).to.equal('generateKey');
+      expect(keyEntry.freedOnCollect).to.equal(true);
+      expect(report.handles.find(handle => handle.kind === 'Hash').freedOnCollect).to.equal(false);
+
+      // Each release method untracks its handle
+      first.update('abc').digest();
+      expect(tracked.liveHandles().byKind.Hash.count).to.equal(1);
+      second.dispose();
+      expect(tracked.liveHandles().byKind).to.not.have.property('Hash');
+      encoder.update('abc');
+      encoder.final();
+      hmacKey.dispose();
+      key.dispose();
+      buffer.dispose();
+
+      report = tracked.liveHandles();
+      expect(report.count).to.equal(0);
+      expect(report.bytes).to.equal(0);
+      expect(report.byKind).to.deep.equal({});
+      expect(tracked.memoryStats().liveHandles).to.equal(0);
+
+      // Releasing twice does not untrack anything else
+      const other = tracked.createHash('sha256');
+      first.dispose();
+      buffer.dispose();
+      expect(tracked.liveHandles().count).to.equal(1);
+      other.dispose();
+    });
+
+    it('should untrack ciphers and decoders on final()', () => {
+      const cipher = tracked.createCipher(new Uint8Array(32), new Uint8Array(16));
+      const decoder = tracked.createBase64Decoder();
+      expect(tracked.liveHandles().count).to.equal(2);
+      cipher.update('abc');
+      cipher.final();
+      decoder.update('YWJj');
+      decoder.final();
+      expect(tracked.liveHandles().count).to.equal(0);
+    });
+
+    it('should record creation stacks when asked to', async function () {
+      const withStacks = await initializeLibrary(this, { trackHandles: { stacks: true } });
+      try {
+        const hash = withStacks.createHash('sha256');
+        const [entry] = withStacks.liveHandles().handles;
+        expect(entry.stack).to.be.a('string');
+        const plain = tracked.createHash('sha256');
+        expect(tracked.liveHandles().handles[0].stack).to.equal(undefined);
+        plain.dispose();
+        hash.dispose();
+      } finally {
+        withStacks.cleanup();
+      }
+    });
+  });
+
+  describe('recycle()', () => {
+    it('should refuse a shared instance', async function () {
+      // Options no other suite uses, so this instance is not shared with them
+      const shared = await initializeLibrary(this, { shared: true, keyCacheSize: 3 });
+      try {
+        expect(await initializeLibrary(this, { shared: true, keyCacheSize: 3 })).to.equal(shared);
+        let error;
+        try {
+          await OpenSSLWasmJS.recycle(shared);
+        } catch (e) {
+          error = e;
+        }
+        expect(error).to.be.an('error');
+        expect(error.message).to.contain('Cannot recycle a shared instance');
+        // Still usable, since it was not cleaned up
+        expect(hex(shared.sha256('abc'))).to.equal(crypto.createHash('sha256').update('abc').digest('hex'));
+      } finally {
+        shared.cleanup();
+      }
+    });
+
+    it('should refuse an instance with live handles', async function () {
+      const instance = await initializeLibrary(this, { trackHandles: true });
+      const hash = instance.createHash('sha256');
+      let error;
+      try {
+        await OpenSSLWasmJS.recycle(instance);
+      } catch (e) {
+        error = e;
+      }
+      expect(error).to.be.an('error');
+      expect(error.message).to.contain('1 live handles');
+
+      hash.dispose();
+      const fresh = await OpenSSLWasmJS.recycle(instance);
+      try {
+        expect(fresh).to.not.equal(instance);
+        // Created with the same options
+        expect(fresh.liveHandles().count).to.equal(0);
+        expect(hex(fresh.sha256('abc'))).to.equal(crypto.createHash('sha256').update('abc').digest('hex'));
+      } finally {
+        fresh.cleanup();
+      }
+    });
+
+    it('should count heap buffers as live handles without trackHandles', async function () {
+      const instance = await initializeLibrary(this);
+      const buffer = instance.alloc(16);
+      let error;
+      try {
+        await OpenSSLWasmJS.recycle(instance);
+      } catch (e) {
+        error = e;
+      }
+      expect(error).to.be.an('error');
+      expect(error.message).to.contain('live handles');
+      buffer.dispose();
+      (await OpenSSLWasmJS.recycle(instance)).cleanup();
+    });
+
+    it('should return an instance below its thresholds unchanged', async function () {
+      const instance = await initializeLibrary(this);
+      try {
+        expect(await OpenSSLWasmJS.recycle(instance, { heapSize: 2 ** 31 })).to.equal(instance);
+      } finally {
+        instance.cleanup();
+      }
+    });
+  });
+
+  describe('streaming fallback', () => {
+    const small = crypto.randomBytes(64 * 1024 + 1);
+    let large;
+
+    before(() => {
+      // Larger than the initial heap, so only the streaming path can leave it unchanged
+      large = crypto.randomBytes(20 * 1024 * 1024);
+    });
+
+    it('should match the one-shot digests above the threshold', () => {
+      for (const data of [small, small.subarray(1)]) {
+        expect(hex(streamed.sha256(data))).to.equal(hex(openssl.sha256(data)));
+        expect(hex(streamed.sha512(data))).to.equal(hex(openssl.sha512(data)));
+        expect(hex(streamed.hmac('sha256', 'key', data))).to.equal(hex(openssl.hmac('sha256', 'key', data)));
+      }
+    });
+
+    it('should digest inputs larger than the heap without growing it', () => {
+      const before = streamed.heapSize;
+      expect(hex(streamed.sha256(large))).to.equal(crypto.createHash('sha256').update(large).digest('hex'));
+      expect(hex(streamed.sha512(large))).to.equal(crypto.createHash('sha512').update(large).digest('hex'));
+      expect(hex(streamed.hmac('sha256', 'key', large))).to.equal(crypto.createHmac('sha256', 'key').update(large).digest('hex'));
+      expect(streamed.heapSize).to.equal(before);
+      // The fallbacks release the handles they create
+      expect(streamed.liveHandles().count).to.equal(0);
+    });
+
+    it('should match one-shot base64 above the threshold', () => {
+      // Lengths on either side of a whole number of groups
+      for (const data of [small, small.subarray(1), small.subarray(2)]) {
+        const encoded = openssl.base64Encode(data);
+        expect(streamed.base64Encode(data)).to.equal(encoded);
+        expect(hex(streamed.base64Decode(encoded))).to.equal(hex(data));
+        expect(hex(streamed.base64Decode(encoded.replace(/=+$/, '')))).to.equal(hex(data));
+      }
+    });
+
+    it('should encode and decode inputs larger than the heap without growing it', () => {
+      const before = streamed.heapSize;
+      const encoded = streamed.base64Encode(large);
+      expect(encoded).to.equal(Buffer.from(large).toString('base64'));
+      expect(Buffer.from(streamed.base64Decode(encoded)).equals(Buffer.from(large))).to.equal(true);
+      expect(streamed.heapSize).to.equal(before);
+      expect(streamed.liveHandles().count).to.equal(0);
+    });
+  });
+});
+describe('Trust Store', function () {
+  const { X509Certificate } = require('crypto');
+  const FIXTURES = path.join(__dirname, 'fixtures');
+  // ca.pem issues intermediate.pem, which issues leaf.pem for test.example,
+  // *.test.example and 127.0.0.1; other-ca.pem is an unrelated root
+  const fixture = name => fs.readFileSync(path.join(FIXTURES, name), 'utf8');
+  const root = fixture('ca.pem');
+  const intermediate = fixture('intermediate.pem');
+  const leaf = fixture('leaf.pem');
+  const otherRoot = fixture('other-ca.pem');
+  let openssl;
+  let store;
+
+  before(async function () {
+    openssl = await initializeLibrary(this);
+  });
+
+  beforeEach(() => {
+    if (openssl) store = openssl.createTrustStore(root);
+  });
+
+  afterEach(() => {
+    if (store) store.dispose();
+  });
+
+  after(() => {
+    if (openssl) openssl.cleanup();
+  });
+
+  it('should verify a chain up to a trusted root', () => {
+    expect(store.size).to.equal(1);
+    const result = store.verifyChain([leaf, intermediate]);
+    expect(result).to.deep.equal({ valid: true, code: 0, error: null, cached: false });
+    // DER certificates verify the same
+    const der = [leaf, intermediate].map(pem => new Uint8Array(new X509Certificate(pem).raw));
+    expect(store.verifyChain(der).valid).to.equal(true);
+  });
+
+  it('should reject chains that do not lead to a trusted root', () => {
+    // X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT_LOCALLY
+    expect(store.verifyChain([leaf])).to.include({ valid: false, code: 20, cached: false });
+    const other = openssl.createTrustStore(otherRoot);
+    try {
+      expect(other.verifyChain([leaf, intermediate])).to.include({ valid: false, code: 20 });
+    } finally {
+      other.dispose();
+    }
+    expect(store.verifyChain(['not a certificate'])).to.include({ valid: false, code: -1, error: 'Invalid certificate encoding' });
+    expect(() => store.verifyChain([])).to.throw('at least the leaf');
+  });
+
+  it('should check the leaf against the host', () => {
+    for (const host of ['test.example', 'www.test.example', '127.0.0.1']) {
+      expect(store.verifyChain([leaf, intermediate], { host }).valid, host).to.equal(true);
+    }
+    const mismatch = store.verifyChain([leaf, intermediate], { host: 'other.example' });
+    // X509_V_ERR_HOSTNAME_MISMATCH
+    expect(mismatch).to.include({ valid: false, code: 62, cached: false });
+    expect(mismatch.error).to.match(/hostname mismatch/i);
+    // X509_V_ERR_IP_ADDRESS_MISMATCH
+    expect(store.verifyChain([leaf, intermediate], { host: '127.0.0.2' })).to.include({ valid: false, code: 64 });
+  });
+
+  it('should remember successful verifications per chain and host', () => {
+    expect(store.verifyChain([leaf, intermediate], { host: 'test.example' }).cached).to.equal(false);
+    expect(store.verifyChain([leaf, intermediate], { host: 'test.example' }).cached).to.equal(true);
+    // Another host or another encoding is another entry
+    expect(store.verifyChain([leaf, intermediate]).cached).to.equal(false);
+    expect(store.verifyChain([leaf, intermediate]).cached).to.equal(true);
+    expect(store.verifyChain([leaf, intermediate], { host: 'www.test.example' }).cached).to.equal(false);
+
+    // Failures are never remembered
+    for (let i = 0; i < 2; i++) {
+      expect(store.verifyChain([leaf, intermediate], { host: 'other.example' })).to.include({ valid: false, cached: false });
+      expect(store.verifyChain([leaf])).to.include({ valid: false, cached: false });
+    }
+
+    store.clearCache();
+    expect(store.verifyChain([leaf, intermediate], { host: 'test.example' }).cached).to.equal(false);
+  });
+
+  it('should evict the least recently used verification', () => {
+    const small = openssl.createTrustStore(root, { cacheSize: 2 });
+    const uncached = openssl.createTrustStore(root, { cacheSize: 0 });
+    try {
+      const verify = host => small.verifyChain([leaf, intermediate], { host }).cached;
+      expect([verify('test.example'), verify('www.test.example')]).to.deep.equal([false, false]);
+      // A hit makes test.example the most recent, so www goes first
+      expect(verify('test.example')).to.equal(true);
+      expect(verify('127.0.0.1')).to.equal(false);
+      expect(verify('test.example')).to.equal(true);
+      expect(verify('www.test.example')).to.equal(false);
+
+      uncached.verifyChain([leaf, intermediate]);
+      expect(uncached.verifyChain([leaf, intermediate])).to.include({ valid: true, cached: false });
+      expect(() => openssl.createTrustStore(root, { cacheSize: -1 })).to.throw('non-negative integer');
+    } finally {
+      small.dispose();
+      uncached.dispose();
+    }
+  });
+
+  it('should forget a verification once the first certificate expires', () => {
+    // The leaf expires before the intermediate and the root
+    const expires = Date.parse(new X509Certificate(leaf).validTo);
+    expect(expires).to.be.below(Date.parse(new X509Certificate(intermediate).validTo));
+    store.verifyChain([leaf, intermediate]);
+
+    const now = Date.now;
+    try {
+      Date.now = () => expires - 60 * 1000;
+      expect(store.verifyChain([leaf, intermediate]).cached).to.equal(true);
+      Date.now = () => expires + 5 * 1000;
+      // Verified again, against the real clock the module uses
+      expect(store.verifyChain([leaf, intermediate])).to.include({ valid: true, cached: false });
+    } finally {
+      Date.now = now;
+    }
+  });
+
+  it('should keep the shared store unchanged by a context with extra CAs', () => {
+    const extended = openssl.createTlsContext({ trustStore: store, caCertificates: [otherRoot] });
+    const plain = openssl.createTlsContext({ trustStore: store });
+    try {
+      expect(store.size).to.equal(1);
+      // X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT: the extra root is not trusted here
+      expect(store.verifyChain([otherRoot])).to.include({ valid: false, code: 18 });
+      expect(store.verifyChain([leaf, intermediate]).valid).to.equal(true);
+
+      store.addCertificates(otherRoot);
+      expect(store.size).to.equal(2);
+      expect(store.verifyChain([otherRoot]).valid).to.equal(true);
+    } finally {
+      extended.dispose();
+      plain.dispose();
+    }
+  });
+
+  it('should add certificates and refuse use after dispose', () => {
+    const empty = openssl.createTrustStore();
+    expect(empty.size).to.equal(0);
+    expect(empty.verifyChain([leaf, intermediate]).valid).to.equal(false);
+    expect(empty.addCertificates(root + otherRoot)).to.equal(2);
+    expect(empty.verifyChain([leaf, intermediate]).valid).to.equal(true);
+    expect(() => empty.addCertificates('not a certificate')).to.throw('Invalid certificate');
+    empty.dispose();
+    expect(() => empty.verifyChain([leaf])).to.throw('has been disposed');
+  });
+});
 describe('RSA Operations (Mock)', () => {
   let openssl;
   